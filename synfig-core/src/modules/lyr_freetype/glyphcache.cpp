@@ -0,0 +1,189 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file glyphcache.cpp
+**	\brief Cache of glyph outlines for the "Text" layer
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include <ETL/stringf>
+
+#include "glyphcache.h"
+
+#include FT_OUTLINE_H
+
+#endif
+
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+class Decomposer
+{
+public:
+	typedef rendering::Contour::Chunk Chunk;
+	typedef rendering::Contour::ChunkList ChunkList;
+
+	static Vector vec(const FT_Vector *v)
+		{ return Vector(Real(v->x), Real(v->y)); }
+
+	static int move_to(const FT_Vector *to, void *user) {
+		ChunkList &chunks = *(ChunkList*)user;
+		if (!chunks.empty() && chunks.back().type != rendering::Contour::CLOSE)
+			chunks.push_back(Chunk(rendering::Contour::CLOSE, Vector()));
+		chunks.push_back(Chunk(rendering::Contour::MOVE, vec(to)));
+		return 0;
+	}
+
+	static int line_to(const FT_Vector *to, void *user)
+		{ ((ChunkList*)user)->push_back(Chunk(vec(to))); return 0; }
+
+	static int conic_to(const FT_Vector *control, const FT_Vector *to, void *user)
+		{ ((ChunkList*)user)->push_back(Chunk(vec(to), vec(control))); return 0; }
+
+	static int cubic_to(const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to, void *user)
+		{ ((ChunkList*)user)->push_back(Chunk(vec(to), vec(control1), vec(control2))); return 0; }
+
+	static bool decompose(FT_Outline &outline, ChunkList &out_chunks) {
+		FT_Outline_Funcs funcs;
+		funcs.move_to  = &move_to;
+		funcs.line_to  = &line_to;
+		funcs.conic_to = &conic_to;
+		funcs.cubic_to = &cubic_to;
+		funcs.shift = 0;
+		funcs.delta = 0;
+		if (FT_Outline_Decompose(&outline, &funcs, &out_chunks))
+			return false;
+		if (!out_chunks.empty() && out_chunks.back().type != rendering::Contour::CLOSE)
+			out_chunks.push_back(Chunk(rendering::Contour::CLOSE, Vector()));
+		return true;
+	}
+};
+
+}
+
+/* === M E T H O D S ======================================================= */
+
+GlyphCache&
+GlyphCache::instance()
+{
+	static GlyphCache cache;
+	return cache;
+}
+
+String
+GlyphCache::get_face_id(FT_Face face, const String &filename)
+{
+	if (!face) return String();
+
+	// file may be replaced by other version of the same font,
+	// so its path and mtime are the part of identifier
+	long long mtime = 0;
+	GStatBuf buf;
+	if (!filename.empty() && !g_stat(filename.c_str(), &buf))
+		mtime = (long long)buf.st_mtime;
+
+	const char *postscript_name = FT_Get_Postscript_Name(face);
+	return etl::strprintf("%s\n%lld\n%s\n%s\n%s\n%ld\n%ld\n%d",
+		filename.c_str(),
+		mtime,
+		face->family_name ? face->family_name : "",
+		face->style_name ? face->style_name : "",
+		postscript_name ? postscript_name : "",
+		(long)face->face_index,
+		(long)face->num_glyphs,
+		(int)face->units_per_EM );
+}
+
+GlyphCache::Glyph::Handle
+GlyphCache::load(FT_Face face, FT_UInt glyph_index, FT_Int32 load_flags)
+{
+	if (FT_Load_Glyph(face, glyph_index, load_flags | FT_LOAD_NO_SCALE))
+		return Glyph::Handle();
+
+	FT_GlyphSlot slot = face->glyph;
+	Glyph::Handle glyph(new Glyph());
+	glyph->advance = Vector(Real(slot->advance.x), Real(slot->advance.y));
+
+	// bitmap glyphs has no outline, they will not be rendered
+	if (slot->format == FT_GLYPH_FORMAT_OUTLINE)
+	{
+		FT_BBox bbox;
+		FT_Outline_Get_CBox(&slot->outline, &bbox);
+		glyph->top = Real(bbox.yMax);
+		glyph->even_odd = (slot->outline.flags & FT_OUTLINE_EVEN_ODD_FILL) != 0;
+		if (!Decomposer::decompose(slot->outline, glyph->chunks))
+			glyph->chunks.clear();
+	}
+
+	return glyph;
+}
+
+GlyphCache::Glyph::Handle
+GlyphCache::get(FT_Face face, const String &face_id, FT_UInt glyph_index, FT_Int32 load_flags)
+{
+	Key key(face_id, glyph_index, load_flags);
+
+	{
+		Mutex::Lock lock(mutex);
+		ItemMap::iterator i = items.find(key);
+		if (i != items.end())
+		{
+			lru.splice(lru.begin(), lru, i->second.lru);
+			return i->second.glyph;
+		}
+	}
+
+	Glyph::Handle glyph = load(face, glyph_index, load_flags);
+	if (!glyph) return glyph;
+
+	Mutex::Lock lock(mutex);
+	Item &item = items[key];
+	if (item.glyph) return item.glyph; // loaded by another thread
+	item.glyph = glyph;
+	item.lru = lru.insert(lru.begin(), key);
+	while((int)items.size() > max_glyphs)
+		{ items.erase(lru.back()); lru.pop_back(); }
+	return glyph;
+}
+
+void
+GlyphCache::clear()
+{
+	Mutex::Lock lock(mutex);
+	items.clear();
+	lru.clear();
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,126 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file glyphcache.h
+**	\brief Cache of glyph outlines for the "Text" layer
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_LYR_FREETYPE_GLYPHCACHE_H
+#define __SYNFIG_LYR_FREETYPE_GLYPHCACHE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <list>
+#include <map>
+
+#include <ETL/handle>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <synfig/mutex.h>
+#include <synfig/string.h>
+#include <synfig/vector.h>
+#include <synfig/rendering/primitive/contour.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+//! Process-wide cache of glyph outlines, shared between all text layers and frames.
+//! Outlines are loaded without scaling, so they are independent of the text size,
+//! all coordinates are in font units.
+class GlyphCache
+{
+public:
+	class Glyph: public etl::shared_object
+	{
+	public:
+		typedef etl::handle<Glyph> Handle;
+
+		synfig::rendering::Contour::ChunkList chunks;
+		synfig::Vector advance;
+		synfig::Real top;
+		bool even_odd;
+
+		Glyph(): top(), even_odd() { }
+	};
+
+	//! maximum count of glyphs in cache
+	static const int max_glyphs = 8192;
+
+private:
+	struct Key {
+		synfig::String face_id;
+		FT_UInt glyph_index;
+		FT_Int32 load_flags;
+
+		Key(): glyph_index(), load_flags() { }
+		Key(const synfig::String &face_id, FT_UInt glyph_index, FT_Int32 load_flags):
+			face_id(face_id), glyph_index(glyph_index), load_flags(load_flags) { }
+
+		bool operator< (const Key &other) const {
+			if (glyph_index < other.glyph_index) return true;
+			if (other.glyph_index < glyph_index) return false;
+			if (load_flags < other.load_flags) return true;
+			if (other.load_flags < load_flags) return false;
+			return face_id < other.face_id;
+		}
+	};
+
+	typedef std::list<Key> KeyList;
+
+	struct Item {
+		Glyph::Handle glyph;
+		KeyList::iterator lru;
+	};
+
+	typedef std::map<Key, Item> ItemMap;
+
+	synfig::Mutex mutex;
+	KeyList lru;
+	ItemMap items;
+
+public:
+	static GlyphCache& instance();
+
+	//! Returns unique identifier of the font face opened from file \a filename,
+	//! faces of the same font file opened by different layers have the same identifier,
+	//! so they will share cached glyphs. Modified font file gets new identifier.
+	static synfig::String get_face_id(FT_Face face, const synfig::String &filename);
+
+	//! Loads glyph from face bypassing the cache.
+	//! Caller must lock the face, FreeType faces are not thread-safe.
+	//! Returns null handle when glyph cannot be loaded
+	static Glyph::Handle load(FT_Face face, FT_UInt glyph_index, FT_Int32 load_flags);
+
+	//! Returns glyph from cache or loads it from face.
+	//! Caller must lock the face, FreeType faces are not thread-safe.
+	//! Returns null handle when glyph cannot be loaded
+	Glyph::Handle get(FT_Face face, const synfig::String &face_id, FT_UInt glyph_index, FT_Int32 load_flags);
+
+	void clear();
+};
+
+/* === E N D =============================================================== */
+
+#endif
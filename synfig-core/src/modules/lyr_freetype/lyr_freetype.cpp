@@ -42,10 +42,13 @@
 #include <pango/pangocairo.h>
 
 #include "lyr_freetype.h"
+#include "glyphcache.h"
 
 #include <synfig/localization.h>
 #include <synfig/general.h>
 
+#include <synfig/rendering/common/task/taskcontour.h>
+
 #include <synfig/canvasfilenaming.h>
 #include <synfig/cairo_renddesc.h>
 
@@ -75,8 +78,54 @@ SYNFIG_LAYER_SET_CATEGORY(Layer_Freetype,N_("Other"));
 SYNFIG_LAYER_SET_VERSION(Layer_Freetype,"0.2");
 SYNFIG_LAYER_SET_CVS_ID(Layer_Freetype,"$Id$");
 
+// FreeType faces are not thread-safe
+static synfig::RecMutex freetype_mutex;
+
+namespace {
+	//! glyph outline placed in the line of text, used by build_composite_task_vfunc()
+	struct PlacedGlyph {
+		GlyphCache::Glyph::Handle glyph;
+		Vector pos;
+		PlacedGlyph(const GlyphCache::Glyph::Handle &glyph, const Vector &pos):
+			glyph(glyph), pos(pos) { }
+	};
+
+	struct PlacedLine {
+		Real width;
+		std::vector<PlacedGlyph> glyphs;
+		PlacedLine(): width() { }
+	};
+}
+
 /* === P R O C E D U R E S ================================================= */
 
+/*! Reads one UTF-8 character, \a iter should point to the first byte,
+**	it will point to the last read byte on exit.
+**	Returns false for invalid sequences.
+*/
+static bool
+read_utf8_char(String::const_iterator &iter, const String::const_iterator &end, unsigned int &code)
+{
+	unsigned int c = (unsigned char)*iter;
+	code = c;
+	int bytes = 0;
+	while ((c & 0x80) != 0) { c = (c << 1) & 0xff; bytes++; }
+	bool bad_char = (bytes == 1);
+	if (bytes > 1)
+	{
+		bytes--;
+		code = c << (5*bytes - 1);
+		while (bytes > 0) {
+			iter++;
+			bytes--;
+			c = (unsigned char)*iter;
+			if (iter >= end || (c & 0xc0) != 0x80) { bad_char = true; break; }
+			code |= (c & 0x3f) << (6 * bytes);
+		}
+	}
+	return !bad_char;
+}
+
 /*Glyph::~Glyph()
 {
 	if(glyph)FT_Done_Glyph(glyph);
@@ -326,6 +375,16 @@ Layer_Freetype::new_font_(const synfig::String &font_fam_, int style, int weight
 	return false;
 }
 
+//! Opens font face and stores the file name on success,
+//! it is used as part of the glyph cache key
+static int
+open_face(FT_Library library, const String &filename, FT_Long face_index, FT_Face *face, String &out_filename)
+{
+	int error = FT_New_Face(library, filename.c_str(), face_index, face);
+	if (!error) out_filename = filename;
+	return error;
+}
+
 #ifdef USE_MAC_FT_FUNCS
 void fss2path(char *path, FSSpec *fss)
 {
@@ -363,6 +422,7 @@ Layer_Freetype::new_face(const String &newfont)
 	synfig::String font=param_font.get(synfig::String());
 	int error;
 	FT_Long face_index=0;
+	String face_filename;
 
 	// If we are already loaded, don't bother reloading.
 	if(face && font==newfont)
@@ -372,15 +432,16 @@ Layer_Freetype::new_face(const String &newfont)
 	{
 		FT_Done_Face(face);
 		face=0;
+		face_id.clear();
 	}
 
-	error=FT_New_Face(ft_library,newfont.c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,(newfont+".ttf").c_str(),face_index,&face);
+	error=open_face(ft_library,newfont,face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,newfont+".ttf",face_index,&face,face_filename);
 
 	if(get_canvas())
 	{
-		if(error)error=FT_New_Face(ft_library,(get_canvas()->get_file_path()+ETL_DIRECTORY_SEPARATOR+newfont).c_str(),face_index,&face);
-		if(error)error=FT_New_Face(ft_library,(get_canvas()->get_file_path()+ETL_DIRECTORY_SEPARATOR+newfont+".ttf").c_str(),face_index,&face);
+		if(error)error=open_face(ft_library,get_canvas()->get_file_path()+ETL_DIRECTORY_SEPARATOR+newfont,face_index,&face,face_filename);
+		if(error)error=open_face(ft_library,get_canvas()->get_file_path()+ETL_DIRECTORY_SEPARATOR+newfont+".ttf",face_index,&face,face_filename);
 	}
 
 #ifdef USE_MAC_FT_FUNCS
@@ -394,7 +455,7 @@ Layer_Freetype::new_face(const String &newfont)
 			fss2path(filename,&fs_spec);
 			//FSSpecToNativePathName(fs_spec,filename,sizeof(filename)-1, 0);
 
-			error=FT_New_Face(ft_library, filename, face_index,&face);
+			error=open_face(ft_library,filename,face_index,&face,face_filename);
 			//error=FT_New_Face_From_FSSpec(ft_library, &fs_spec, face_index,&face);
 			synfig::info(__FILE__":%d: \"%s\" (%s) -- ft_error=%d",__LINE__,newfont.c_str(),filename,error);
 		}
@@ -429,7 +490,7 @@ Layer_Freetype::new_face(const String &newfont)
 			if(fs && fs->nfont){
 				FcChar8* file;
 				if( FcPatternGetString (fs->fonts[0], FC_FILE, 0, &file) == FcResultMatch )
-					error=FT_New_Face(ft_library,(const char*)file,face_index,&face);
+					error=open_face(ft_library,(const char*)file,face_index,&face,face_filename);
 				FcFontSetDestroy(fs);
 			} else
 				synfig::warning("Layer_Freetype: fontconfig: %s",_("empty font set"));
@@ -438,31 +499,31 @@ Layer_Freetype::new_face(const String &newfont)
 #endif
 
 #ifdef _WIN32
-	if(error)error=FT_New_Face(ft_library,("C:\\WINDOWS\\FONTS\\"+newfont).c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,("C:\\WINDOWS\\FONTS\\"+newfont+".ttf").c_str(),face_index,&face);
+	if(error)error=open_face(ft_library,"C:\\WINDOWS\\FONTS\\"+newfont,face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,"C:\\WINDOWS\\FONTS\\"+newfont+".ttf",face_index,&face,face_filename);
 #else
 
 #ifdef __APPLE__
-	if(error)error=FT_New_Face(ft_library,("~/Library/Fonts/"+newfont).c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,("~/Library/Fonts/"+newfont+".ttf").c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,("~/Library/Fonts/"+newfont+".dfont").c_str(),face_index,&face);
+	if(error)error=open_face(ft_library,"~/Library/Fonts/"+newfont,face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,"~/Library/Fonts/"+newfont+".ttf",face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,"~/Library/Fonts/"+newfont+".dfont",face_index,&face,face_filename);
 
-	if(error)error=FT_New_Face(ft_library,("/Library/Fonts/"+newfont).c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,("/Library/Fonts/"+newfont+".ttf").c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,("/Library/Fonts/"+newfont+".dfont").c_str(),face_index,&face);
+	if(error)error=open_face(ft_library,"/Library/Fonts/"+newfont,face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,"/Library/Fonts/"+newfont+".ttf",face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,"/Library/Fonts/"+newfont+".dfont",face_index,&face,face_filename);
 #endif
 
-	if(error)error=FT_New_Face(ft_library,("/usr/X11R6/lib/X11/fonts/type1/"+newfont).c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,("/usr/X11R6/lib/X11/fonts/type1/"+newfont+".ttf").c_str(),face_index,&face);
+	if(error)error=open_face(ft_library,"/usr/X11R6/lib/X11/fonts/type1/"+newfont,face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,"/usr/X11R6/lib/X11/fonts/type1/"+newfont+".ttf",face_index,&face,face_filename);
 
-	if(error)error=FT_New_Face(ft_library,("/usr/share/fonts/truetype/"+newfont).c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,("/usr/share/fonts/truetype/"+newfont+".ttf").c_str(),face_index,&face);
+	if(error)error=open_face(ft_library,"/usr/share/fonts/truetype/"+newfont,face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,"/usr/share/fonts/truetype/"+newfont+".ttf",face_index,&face,face_filename);
 
-	if(error)error=FT_New_Face(ft_library,("/usr/X11R6/lib/X11/fonts/TTF/"+newfont).c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,("/usr/X11R6/lib/X11/fonts/TTF/"+newfont+".ttf").c_str(),face_index,&face);
+	if(error)error=open_face(ft_library,"/usr/X11R6/lib/X11/fonts/TTF/"+newfont,face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,"/usr/X11R6/lib/X11/fonts/TTF/"+newfont+".ttf",face_index,&face,face_filename);
 
-	if(error)error=FT_New_Face(ft_library,("/usr/X11R6/lib/X11/fonts/truetype/"+newfont).c_str(),face_index,&face);
-	if(error)error=FT_New_Face(ft_library,("/usr/X11R6/lib/X11/fonts/truetype/"+newfont+".ttf").c_str(),face_index,&face);
+	if(error)error=open_face(ft_library,"/usr/X11R6/lib/X11/fonts/truetype/"+newfont,face_index,&face,face_filename);
+	if(error)error=open_face(ft_library,"/usr/X11R6/lib/X11/fonts/truetype/"+newfont+".ttf",face_index,&face,face_filename);
 
 #endif
 	if(error)
@@ -472,6 +533,7 @@ Layer_Freetype::new_face(const String &newfont)
 	}
 
 	font=newfont;
+	face_id=GlyphCache::get_face_id(face, face_filename);
 
 	needs_sync_=true;
 	return true;
@@ -714,8 +776,6 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
 	synfig::Point origin=param_origin.get(Point());
 	synfig::Vector orient=param_orient.get(Vector());
 
-	static synfig::RecMutex freetype_mutex;
-
 	if(needs_sync_)
 		const_cast<Layer_Freetype*>(this)->sync();
 
@@ -819,25 +879,8 @@ Layer_Freetype::accelerated_render(Context context,Surface *surface,int quality,
 		else
 		{
 			// read uft8 char
-			unsigned int c = (unsigned char)*iter;
-			unsigned int code = c;
-			int bytes = 0;
-			while ((c & 0x80) != 0) { c = (c << 1) & 0xff; bytes++; }
-			bool bad_char = (bytes == 1);
-			if (bytes > 1)
-			{
-				bytes--;
-				code = c << (5*bytes - 1);
-				while (bytes > 0) {
-					iter++;
-					bytes--;
-					c = (unsigned char)*iter;
-					if (iter >= text.end() || (c & 0xc0) != 0x80) { bad_char = true; break; }
-					code |= (c & 0x3f) << (6 * bytes);
-				}
-			}
-
-			if (bad_char)
+			unsigned int code;
+			if (!read_utf8_char(iter, text.end(), code))
 			{
 				synfig::warning("Layer_Freetype: multibyte: %s",
 								_("Can't parse multibyte character.\n"));
@@ -1209,3 +1252,142 @@ Layer_Freetype::get_bounding_rect()const
 //	if(!is_disabled())
 		return synfig::Rect::full_plane();
 }
+
+rendering::Task::Handle
+Layer_Freetype::build_composite_task_vfunc(ContextParams context_params)const
+{
+	// Hinting depends on resolution of the target surface which is unknown here,
+	// and straight blending of the old renderer touches only pixels of glyphs,
+	// so these cases are still rendered by accelerated_render()
+	if (param_grid_fit.get(bool()) || Color::is_straight(get_blend_method()))
+		return Layer_Composite::build_composite_task_vfunc(context_params);
+
+	if(needs_sync_)
+		const_cast<Layer_Freetype*>(this)->sync();
+
+	String text(param_text.get(String()));
+	if(text=="@_FILENAME_@" && get_canvas() && !get_canvas()->get_file_name().empty())
+		text=basename(get_canvas()->get_file_name());
+
+	if(!face || text.empty())
+		return Layer_Composite::build_composite_task_vfunc(context_params);
+
+	bool use_kerning=param_use_kerning.get(bool());
+	Point origin=param_origin.get(Point());
+	Vector orient=param_orient.get(Vector());
+	Vector size=param_size.get(Vector())*2;
+
+	// Glyphs are loaded without scaling, so all metrics are in font units.
+	// The old renderer used em of size/1.125 (1pt at resolution of 64*size dpi)
+	// and multiplied spacing by 1/1.13/0.996 to compensate freetype's errors.
+	const Real error_k = 1.125/1.13/0.996;
+	const Real compress = param_compress.get(Real())*error_k;
+	const Real vcompress = param_vcompress.get(Real())*error_k;
+	const Real line_height = vcompress*(Real)face->height;
+	const FT_Int32 load_flags = FT_LOAD_DEFAULT|FT_LOAD_NO_HINTING;
+
+	std::vector<PlacedLine> lines(1);
+	GlyphCache &cache = GlyphCache::instance();
+
+	{
+		synfig::RecMutex::Lock lock(freetype_mutex);
+
+		Real bx = 0.0, by = 0.0;
+		FT_UInt previous = 0;
+		for(String::const_iterator iter = text.begin(); iter != text.end(); ++iter)
+		{
+			int multiplier = 1;
+			FT_UInt glyph_index = 0;
+			if (*iter == '\n')
+			{
+				lines.push_back(PlacedLine());
+				bx = by = 0.0;
+				previous = 0;
+				continue;
+			}
+			if (*iter == '\t')
+			{
+				multiplier = 8;
+				glyph_index = FT_Get_Char_Index(face, ' ');
+			}
+			else
+			{
+				unsigned int code;
+				if (!read_utf8_char(iter, text.end(), code))
+				{
+					synfig::warning("Layer_Freetype: multibyte: %s",
+									_("Can't parse multibyte character.\n"));
+					continue;
+				}
+				glyph_index = FT_Get_Char_Index(face, code);
+			}
+
+			if (FT_HAS_KERNING(face) && use_kerning && previous && glyph_index)
+			{
+				FT_Vector delta;
+				FT_Get_Kerning(face, previous, glyph_index, FT_KERNING_UNSCALED, &delta);
+				Real k = compress < 1.0 ? compress : 1.0;
+				bx += delta.x*k;
+				by += delta.y*k;
+			}
+
+			GlyphCache::Glyph::Handle glyph = cache.get(face, face_id, glyph_index, load_flags);
+			if (!glyph) continue;
+
+			previous = glyph_index;
+			lines.back().width = bx + glyph->advance[0];
+			lines.back().glyphs.push_back(PlacedGlyph(glyph, Vector(bx, by)));
+
+			if (multiplier > 1)
+			{
+				Real tab = glyph->advance[0]*multiplier*compress;
+				if (tab > 0.0) bx += tab - fmod(bx, tab);
+			}
+			else
+			{
+				bx += glyph->advance[0]*compress;
+			}
+			by += glyph->advance[1]*multiplier;
+		}
+	}
+
+	Real first_line_height = 0.0;
+	for(std::vector<PlacedGlyph>::const_iterator i = lines.front().glyphs.begin(); i != lines.front().glyphs.end(); ++i)
+		first_line_height = std::max(first_line_height, i->glyph->top);
+	Real text_height = (lines.size() - 1)*line_height + first_line_height;
+
+	rendering::Contour::Handle contour(new rendering::Contour());
+	bool even_odd = false;
+	for(int j = 0; j < (int)lines.size(); ++j)
+	{
+		Vector line_offset(
+			-orient[0]*lines[j].width,
+			(lines.size() - 1 - j)*line_height - text_height*(1.0 - orient[1]) );
+		for(std::vector<PlacedGlyph>::const_iterator i = lines[j].glyphs.begin(); i != lines[j].glyphs.end(); ++i)
+		{
+			Vector offset(line_offset[0] + i->pos[0], line_offset[1] - i->pos[1]);
+			const rendering::Contour::ChunkList &chunks = i->glyph->chunks;
+			for(rendering::Contour::ChunkList::const_iterator k = chunks.begin(); k != chunks.end(); ++k)
+				contour->add_chunk(rendering::Contour::Chunk(k->type, k->p1 + offset, k->pp0 + offset, k->pp1 + offset));
+			even_odd = even_odd || i->glyph->even_odd;
+		}
+	}
+	contour->color = param_color.get(Color());
+	contour->invert = param_invert.get(bool());
+	contour->antialias = true;
+	contour->winding_style = even_odd
+		? rendering::Contour::WINDING_EVEN_ODD
+		: rendering::Contour::WINDING_NON_ZERO;
+
+	Real units_per_em = face->units_per_EM > 0 ? (Real)face->units_per_EM : 1.0;
+	Real kx = fabs(size[0])/1.125/units_per_em;
+	Real ky = fabs(size[1])/1.125/units_per_em;
+
+	rendering::TaskContour::Handle task_contour(new rendering::TaskContour());
+	task_contour->transformation->matrix = Matrix(
+		kx,        0.0,       0.0,
+		0.0,       ky,        0.0,
+		origin[0], origin[1], 1.0 );
+	task_contour->contour = contour;
+	return task_contour;
+}
@@ -142,6 +142,8 @@ private:
 	ValueBase param_invert;
 
 	FT_Face face;
+	//! identifier of the face in the GlyphCache
+	synfig::String face_id;
 
 	bool old_version;
 	bool needs_sync_;
@@ -170,6 +172,9 @@ public:
 
 	virtual synfig::Rect get_bounding_rect()const;
 
+protected:
+	virtual rendering::Task::Handle build_composite_task_vfunc(ContextParams context_params)const;
+
 private:
 	void new_font(const synfig::String &family, int style=0, int weight=400);
 	bool new_font_(const synfig::String &family, int style=0, int weight=400);
@@ -44,6 +44,8 @@
 #include <synfig/valuenode.h>
 #include <ETL/calculus>
 #include <synfig/cairo_renddesc.h>
+#include <synfig/rendering/common/task/taskdistort.h>
+#include <synfig/rendering/common/task/tasklayer.h>
 
 #endif
 
@@ -154,6 +156,25 @@ find_closest_to_bline(bool fast, const std::vector<BLinePoint>& bline,const Poin
 	return ret;
 }
 
+namespace {
+
+//! CurveWarp::transform() reads parameters of layer,
+//! so distortion keeps own copy of layer
+class CurveWarpDistortion: public rendering::Distortion
+{
+public:
+	etl::handle<const CurveWarp> layer;
+
+protected:
+	virtual Point map_vfunc(const Point &p) const
+		{ return layer->transform(p); }
+	// distortion is defined by parameters of the layer
+	virtual bool hash_params_vfunc(rendering::TaskHash &hash) const
+		{ return layer && rendering::TaskLayer::hash_layer(hash, *layer); }
+};
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 inline void
@@ -440,6 +461,18 @@ CurveWarp::get_color(Context context, const Point &point)const
 	return context.get_color(transform(point));
 }
 
+rendering::Task::Handle
+CurveWarp::build_rendering_task_vfunc(Context context)const
+{
+	etl::handle<CurveWarpDistortion> distortion(new CurveWarpDistortion());
+	distortion->layer=etl::handle<CurveWarp>::cast_dynamic(clone(NULL));
+
+	rendering::TaskDistort::Handle task(new rendering::TaskDistort());
+	task->distortion=distortion;
+	task->sub_task()=context.build_rendering_task();
+	return task;
+}
+
 RendDesc
 CurveWarp::get_sub_renddesc_vfunc(const RendDesc &renddesc) const
 {
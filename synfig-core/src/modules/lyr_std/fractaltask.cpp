@@ -0,0 +1,197 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file fractaltask.cpp
+**	\brief Common parts of rendering tasks of fractal layers
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <sigc++/bind.h>
+
+#include <synfig/threadpool.h>
+
+#include "fractaltask.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+using namespace modules;
+using namespace lyr_std;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+	// minimal count of pixels to render in separate thread,
+	// each pixel costs several iterations, so bands are smaller than for gradients
+	const int band_pixels = 4096;
+}
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+template<bool broken, bool broken_new>
+void iterate_lanes(FractalLanes &l, int iterations, Real bailout)
+{
+	const int count = FractalLanes::count;
+	for(int i = 0; i < iterations; ++i) {
+		int alive = 0;
+		for(int j = 0; j < count; ++j) {
+			Real zr = l.zr[j]*l.zr[j] - l.zi[j]*l.zi[j] + l.cr[j];
+			if (broken && !broken_new) zr += l.zi[j];
+			Real zi = l.zr[j]*l.zi[j]*2 + l.ci[j];
+			if (broken && broken_new) zr += zi;
+			Real mag = (ColorReal)(zr*zr + zi*zi);
+
+			// escaped lanes keeps values of escape iteration
+			bool run = l.escape[j] < 0.0;
+			bool out = run && mag > bailout;
+			l.zr[j] = run ? zr : l.zr[j];
+			l.zi[j] = run ? zi : l.zi[j];
+			l.mag[j] = run ? mag : l.mag[j];
+			l.escape[j] = out ? (Real)i : l.escape[j];
+			alive += run && !out;
+		}
+		if (!alive) break;
+	}
+}
+
+} // namespace
+
+/* === M E T H O D S ======================================================= */
+
+void
+FractalLanes::iterate(int iterations, Real bailout, bool broken, bool broken_new)
+{
+	for(int j = 0; j < count; ++j)
+		{ mag[j] = 0.0; escape[j] = -1.0; }
+	if (!broken)
+		iterate_lanes<false, false>(*this, iterations, bailout);
+	else
+	if (broken_new)
+		iterate_lanes<true, true>(*this, iterations, bailout);
+	else
+		iterate_lanes<true, false>(*this, iterations, bailout);
+}
+
+
+struct TaskFractalSW::Rows {
+	synfig::Surface *surface;
+	const synfig::Surface *context;
+	RectInt rect;
+	RectInt context_rect;
+	VectorInt context_offset;
+	Vector origin;
+	Vector upp;
+
+	Rows(): surface(), context() { }
+};
+
+void
+TaskFractalSW::fill_rows(const Rows *rows, int begin, int end) const
+{
+	const RectInt &r = rows->rect;
+	const RectInt &cr = rows->context_rect;
+	int w = r.get_width();
+	synfig::Surface &surface = *rows->surface;
+
+	std::vector<Color> context(w, Color::alpha());
+	for(int y = begin; y < end; ++y) {
+		if (rows->context && y >= cr.miny && y < cr.maxy) {
+			const Color *src = &(*rows->context)[y - rows->context_offset[1]][cr.minx - rows->context_offset[0]];
+			std::copy(src, src + cr.get_width(), context.begin() + (cr.minx - r.minx));
+		} else
+		if (rows->context) {
+			std::fill(context.begin(), context.end(), Color::alpha());
+		}
+
+		Vector p( rows->origin[0],
+		          rows->origin[1] + ((Real)(y - r.miny) + 0.5)*rows->upp[1] );
+		fill_row(&surface[y][r.minx], &context.front(), w, p, rows->upp[0]);
+	}
+}
+
+bool
+TaskFractalSW::run_fractal() const
+{
+	const Task *task = dynamic_cast<const Task*>(this);
+	if (!task || !task->is_valid())
+		return true;
+
+	Rows rows;
+	rows.rect = task->target_rect;
+	rows.upp = task->get_units_per_pixel();
+	rows.origin = Vector(
+		task->source_rect.minx + 0.5*rows.upp[0],
+		task->source_rect.miny );
+
+	LockWrite la(task);
+	if (!la)
+		return false;
+	rows.surface = &la->get_surface();
+
+	// context is read at the same pixels, see TaskPixelProcessor::get_offset()
+	const Task::Handle &sub_task = task->sub_task(0);
+	LockRead lb(sub_task);
+	if (sub_task && sub_task->is_valid()) {
+		Vector offset = (sub_task->source_rect.get_min() - task->source_rect.get_min())
+		               .multiply_coords(task->get_pixels_per_unit());
+		VectorInt o = VectorInt((int)round(offset[0]), (int)round(offset[1])) - sub_task->target_rect.get_min();
+		RectInt rs = sub_task->target_rect + rows.rect.get_min() + o;
+		etl::set_intersect(rs, rs, rows.rect);
+		if (rs.is_valid()) {
+			if (!lb)
+				return false;
+			rows.context = &lb->get_surface();
+			rows.context_rect = rs;
+			rows.context_offset = rows.rect.get_min() + o;
+		}
+	}
+
+	int w = rows.rect.get_width();
+	int h = rows.rect.get_height();
+	int band = std::max(1, band_pixels/w);
+	if (band >= h) {
+		fill_rows(&rows, rows.rect.miny, rows.rect.maxy);
+		return true;
+	}
+
+	ThreadPool::Group group;
+	for(int y = rows.rect.miny; y < rows.rect.maxy; y += band)
+		group.enqueue( sigc::bind( sigc::mem_fun(this, &TaskFractalSW::fill_rows),
+			&rows, y, std::min(y + band, rows.rect.maxy) ));
+	group.run();
+	return true;
+}
+
+/* === E N T R Y P O I N T ================================================= */
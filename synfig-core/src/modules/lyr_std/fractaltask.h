@@ -0,0 +1,106 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file fractaltask.h
+**	\brief Common parts of rendering tasks of fractal layers
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_LYR_STD_FRACTALTASK_H
+#define __SYNFIG_LYR_STD_FRACTALTASK_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <synfig/color.h>
+#include <synfig/vector.h>
+
+#include <synfig/rendering/software/task/tasksw.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace modules
+{
+namespace lyr_std
+{
+
+//! \class FractalLanes
+//! \brief Group of pixels which iterates together.
+//!        Loops by lanes have no branches which depends from data,
+//!        so compiler may vectorize them.
+class FractalLanes
+{
+public:
+	enum { count = 8 };
+
+	Real cr[count], ci[count];
+	Real zr[count], zi[count];
+	//! squared magnitude of z, rounded to ColorReal as in get_color() of layers
+	Real mag[count];
+	//! iteration where point escapes, or negative value for points of set
+	Real escape[count];
+
+	//! Iterates z = z*z + c until all lanes escapes or \a iterations is reached.
+	//! When \a broken is set real part of z is increased by imaginary part,
+	//! by the new one when \a broken_new is set (Julia) and by the previous one
+	//! otherwise (Mandelbrot).
+	void iterate(int iterations, Real bailout, bool broken, bool broken_new);
+};
+
+
+//! \class TaskFractalSW
+//! \brief Common base for software implementations of fractal tasks.
+//!        Renders fractal by rows, large areas splits to bands
+//!        which renders simultaneously by ThreadPool.
+//!        First sub-task is a context, it's read at the same pixels.
+class TaskFractalSW: public synfig::rendering::TaskSW,
+	public synfig::rendering::TaskInterfaceSplit
+{
+private:
+	struct Rows;
+	void fill_rows(const Rows *rows, int begin, int end) const;
+
+protected:
+	//! Calculates colors for \a count pixels of row,
+	//! \a context is a colors of context at the same pixels,
+	//! \a p is a position of center of first pixel in layer units
+	//! and \a dx is a distance between neighbour pixels
+	virtual void fill_row(
+		synfig::Color *row,
+		const synfig::Color *context,
+		int count,
+		synfig::Vector p,
+		synfig::Real dx ) const = 0;
+
+	//! Renders fractal into target of task
+	bool run_fractal() const;
+};
+
+}; // END of namespace lyr_std
+}; // END of namespace modules
+}; // END of namespace synfig
+
+/* === E N D =============================================================== */
+
+#endif
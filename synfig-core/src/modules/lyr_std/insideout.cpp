@@ -46,6 +46,7 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 #include <synfig/transform.h>
+#include <synfig/rendering/common/task/taskdistort.h>
 
 #endif
 
@@ -68,6 +69,29 @@ SYNFIG_LAYER_SET_CVS_ID(InsideOut,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class InsideOutDistortion: public rendering::Distortion
+{
+public:
+	Point origin;
+
+protected:
+	// origin itself maps to NaN and will be transparent
+	virtual Point map_vfunc(const Point &p) const
+	{
+		Point pos(p-origin);
+		Real inv_mag=pos.inv_mag();
+		return pos*inv_mag*inv_mag+origin;
+	}
+	virtual bool hash_params_vfunc(rendering::TaskHash &hash) const {
+		hash.add(origin);
+		return true;
+	}
+};
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 InsideOut::InsideOut():
@@ -172,6 +196,18 @@ InsideOut::get_transform()const
 	return new InsideOut_Trans(this);
 }
 
+rendering::Task::Handle
+InsideOut::build_rendering_task_vfunc(Context context)const
+{
+	etl::handle<InsideOutDistortion> distortion(new InsideOutDistortion());
+	distortion->origin=param_origin.get(Point());
+
+	rendering::TaskDistort::Handle task(new rendering::TaskDistort());
+	task->distortion=distortion;
+	task->sub_task()=context.build_rendering_task();
+	return task;
+}
+
 Layer::Vocab
 InsideOut::get_param_vocab()const
 {
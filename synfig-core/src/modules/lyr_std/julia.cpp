@@ -46,6 +46,8 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 
+#include "fractaltask.h"
+
 #endif
 
 using namespace std;
@@ -101,6 +103,171 @@ color_neg_flip(Color &color)
 	}
 }
 
+namespace {
+
+class TaskJulia: public rendering::Task, public rendering::TaskInterfaceDraft
+{
+public:
+	typedef etl::handle<TaskJulia> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	//! count of iterations for draft renderer
+	static const int draft_iterations = 32;
+
+	Color icolor;
+	Color ocolor;
+	Angle color_shift;
+	int iterations;
+	Point seed;
+	bool shade_inside;
+	bool solid_inside;
+	bool invert_inside;
+	bool color_inside;
+	bool shade_outside;
+	bool solid_outside;
+	bool invert_outside;
+	bool color_outside;
+	bool color_cycle;
+	bool smooth_outside;
+	bool broken;
+
+	TaskJulia():
+		iterations(),
+		shade_inside(), solid_inside(), invert_inside(), color_inside(),
+		shade_outside(), solid_outside(), invert_outside(), color_outside(),
+		color_cycle(), smooth_outside(), broken() { }
+
+	const Task::Handle& sub_task() const { return Task::sub_task(0); }
+	Task::Handle& sub_task() { return Task::sub_task(0); }
+
+	virtual Task::Handle clone_draft() const {
+		if (iterations <= draft_iterations)
+			return Task::Handle();
+		Handle task = Handle::cast_dynamic(clone());
+		task->iterations = draft_iterations;
+		return task;
+	}
+
+	virtual bool hash_params(rendering::TaskHash &hash) const {
+		hash.add(icolor);
+		hash.add(ocolor);
+		hash.add(Angle::rad(color_shift).get());
+		hash.add(iterations);
+		hash.add(seed);
+		hash.add(shade_inside);
+		hash.add(solid_inside);
+		hash.add(invert_inside);
+		hash.add(color_inside);
+		hash.add(shade_outside);
+		hash.add(solid_outside);
+		hash.add(invert_outside);
+		hash.add(color_outside);
+		hash.add(color_cycle);
+		hash.add(smooth_outside);
+		hash.add(broken);
+		return true;
+	}
+};
+
+
+class TaskJuliaSW: public TaskJulia, public TaskFractalSW
+{
+public:
+	typedef etl::handle<TaskJuliaSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual Real get_pixel_cost() const
+		{ return 1.0 + 0.1*(Real)iterations; }
+
+protected:
+	// the same as Julia::get_color() for pixels with known iteration of escape
+	Color get_color(const FractalLanes &lanes, int j, const Color &context) const
+	{
+		Real zr = lanes.zr[j];
+		Real zi = lanes.zi[j];
+		ColorReal mag = (ColorReal)lanes.mag[j];
+		ColorReal depth;
+		Color ret;
+
+		if (lanes.escape[j] >= 0.0)
+		{
+			int i = (int)lanes.escape[j];
+			if(smooth_outside)
+			{
+				depth= (ColorReal)i - log(log(sqrt(mag))) / LOG_OF_2;
+				if(depth<0) depth=0;
+			}
+			else
+				depth=static_cast<ColorReal>(i);
+
+			ret = solid_outside ? ocolor : context;
+
+			if(invert_outside)
+				ret=~ret;
+
+			if(color_outside)
+				ret=ret.set_uv(zr,zi).clamped_negative();
+
+			if(color_cycle)
+				ret=ret.rotate_uv(color_shift.operator*(depth)).clamped_negative();
+
+			if(shade_outside)
+			{
+				ColorReal alpha=depth/static_cast<ColorReal>(iterations);
+				ret=(ocolor-ret)*alpha+ret;
+			}
+			return ret;
+		}
+
+		ret = solid_inside ? icolor : context;
+
+		if(invert_inside)
+			ret=~ret;
+
+		if(color_inside)
+			ret=ret.set_uv(zr,zi).clamped_negative();
+
+		if(shade_inside)
+			ret=(icolor-ret)*mag+ret;
+
+		return ret;
+	}
+
+	virtual void fill_row(Color *row, const Color *context, int count, Vector p, Real dx) const
+	{
+		FractalLanes lanes;
+		for(int x = 0; x < count; x += FractalLanes::count)
+		{
+			for(int j = 0; j < FractalLanes::count; ++j)
+			{
+				lanes.cr[j] = seed[0];
+				lanes.ci[j] = seed[1];
+				lanes.zr[j] = p[0] + (Real)(x + j)*dx;
+				lanes.zi[j] = p[1];
+			}
+			lanes.iterate(iterations, 4.0, broken, true);
+
+			int n = std::min(count - x, (int)FractalLanes::count);
+			for(int j = 0; j < n; ++j)
+				row[x + j] = get_color(lanes, j, context[x + j]);
+		}
+	}
+
+public:
+	virtual bool run(RunParams&) const
+		{ return run_fractal(); }
+};
+
+
+rendering::Task::Token TaskJulia::token(
+	DescAbstract<TaskJulia>("Julia") );
+rendering::Task::Token TaskJuliaSW::token(
+	DescReal<TaskJuliaSW, TaskJulia>("JuliaSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 Julia::Julia():
@@ -345,6 +512,41 @@ Julia::get_color(Context context, const Point &pos)const
 	return ret;
 }
 
+rendering::Task::Handle
+Julia::build_rendering_task_vfunc(Context context)const
+{
+	bool distort_inside=param_distort_inside.get(bool());
+	bool solid_inside=param_solid_inside.get(bool());
+	bool distort_outside=param_distort_outside.get(bool());
+	bool solid_outside=param_solid_outside.get(bool());
+
+	// distorted context is sampled at arbitrary points,
+	// so render it by get_color()
+	if ((!solid_inside && distort_inside) || (!solid_outside && distort_outside))
+		return Layer::build_rendering_task_vfunc(context);
+
+	TaskJulia::Handle task(new TaskJulia());
+	task->icolor=param_icolor.get(Color());
+	task->ocolor=param_ocolor.get(Color());
+	task->color_shift=param_color_shift.get(Angle());
+	task->iterations=param_iterations.get(int());
+	task->seed=param_seed.get(Point());
+	task->shade_inside=param_shade_inside.get(bool());
+	task->solid_inside=solid_inside;
+	task->invert_inside=param_invert_inside.get(bool());
+	task->color_inside=param_color_inside.get(bool());
+	task->shade_outside=param_shade_outside.get(bool());
+	task->solid_outside=solid_outside;
+	task->invert_outside=param_invert_outside.get(bool());
+	task->color_outside=param_color_outside.get(bool());
+	task->color_cycle=param_color_cycle.get(bool());
+	task->smooth_outside=param_smooth_outside.get(bool());
+	task->broken=param_broken.get(bool());
+	if (!solid_inside || !solid_outside)
+		task->sub_task() = context.build_rendering_task();
+	return task;
+}
+
 Layer::Vocab
 Julia::get_param_vocab()const
 {
@@ -46,6 +46,8 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 
+#include "fractaltask.h"
+
 #endif
 
 using namespace std;
@@ -101,6 +103,188 @@ color_neg_flip(Color &color)
 	}
 }
 
+namespace {
+
+class TaskMandelbrot: public rendering::Task, public rendering::TaskInterfaceDraft
+{
+public:
+	typedef etl::handle<TaskMandelbrot> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	//! count of iterations for draft renderer
+	static const int draft_iterations = 32;
+
+	int iterations;
+	Real bailout;
+	Real lp;
+	bool broken;
+
+	bool shade_inside;
+	bool solid_inside;
+	bool invert_inside;
+	Gradient gradient_inside;
+	Real gradient_offset_inside;
+	bool gradient_loop_inside;
+
+	bool shade_outside;
+	bool solid_outside;
+	bool invert_outside;
+	Gradient gradient_outside;
+	bool smooth_outside;
+	Real gradient_offset_outside;
+	Real gradient_scale_outside;
+
+	TaskMandelbrot():
+		iterations(), bailout(), lp(), broken(),
+		shade_inside(), solid_inside(), invert_inside(),
+		gradient_offset_inside(), gradient_loop_inside(),
+		shade_outside(), solid_outside(), invert_outside(), smooth_outside(),
+		gradient_offset_outside(), gradient_scale_outside() { }
+
+	const Task::Handle& sub_task() const { return Task::sub_task(0); }
+	Task::Handle& sub_task() { return Task::sub_task(0); }
+
+	virtual Task::Handle clone_draft() const {
+		if (iterations <= draft_iterations)
+			return Task::Handle();
+		Handle task = Handle::cast_dynamic(clone());
+		task->iterations = draft_iterations;
+		return task;
+	}
+
+	static void hash_gradient(rendering::TaskHash &hash, const Gradient &gradient) {
+		hash.add(gradient.size());
+		for(Gradient::const_iterator i = gradient.begin(); i != gradient.end(); ++i)
+			{ hash.add(i->pos); hash.add(i->color); }
+	}
+
+	virtual bool hash_params(rendering::TaskHash &hash) const {
+		hash.add(iterations);
+		hash.add(bailout);
+		hash.add(lp);
+		hash.add(broken);
+
+		hash.add(shade_inside);
+		hash.add(solid_inside);
+		hash.add(invert_inside);
+		hash_gradient(hash, gradient_inside);
+		hash.add(gradient_offset_inside);
+		hash.add(gradient_loop_inside);
+
+		hash.add(shade_outside);
+		hash.add(solid_outside);
+		hash.add(invert_outside);
+		hash_gradient(hash, gradient_outside);
+		hash.add(smooth_outside);
+		hash.add(gradient_offset_outside);
+		hash.add(gradient_scale_outside);
+		return true;
+	}
+};
+
+
+class TaskMandelbrotSW: public TaskMandelbrot, public TaskFractalSW
+{
+public:
+	typedef etl::handle<TaskMandelbrotSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual Real get_pixel_cost() const
+		{ return 1.0 + 0.1*(Real)iterations; }
+
+protected:
+	// the same as Mandelbrot::get_color() for pixels with known iteration of escape
+	Color get_color(const FractalLanes &lanes, int j, const Color &context) const
+	{
+		ColorReal mag = (ColorReal)lanes.mag[j];
+		ColorReal depth;
+		Color ret;
+
+		if (lanes.escape[j] >= 0.0)
+		{
+			int i = (int)lanes.escape[j];
+			if(smooth_outside)
+			{
+				depth= (ColorReal)i + LOG_OF_2*lp - log(log(sqrt(mag))) / LOG_OF_2;
+				if(depth<0) depth=0;
+			}
+			else
+				depth=static_cast<ColorReal>(i);
+
+			ColorReal amount(depth/static_cast<ColorReal>(iterations));
+			amount=amount*gradient_scale_outside+gradient_offset_outside;
+			amount-=floor(amount);
+
+			if(solid_outside)
+				ret=gradient_outside(amount);
+			else
+			{
+				ret=context;
+
+				if(invert_outside)
+					ret=~ret;
+
+				if(shade_outside)
+					ret=Color::blend(gradient_outside(amount), ret, 1.0);
+			}
+			return ret;
+		}
+
+		ColorReal amount(abs(mag+gradient_offset_inside));
+		if(gradient_loop_inside)
+			amount-=floor(amount);
+
+		if(solid_inside)
+			ret=gradient_inside(amount);
+		else
+		{
+			ret=context;
+
+			if(invert_inside)
+				ret=~ret;
+
+			if(shade_inside)
+				ret=Color::blend(gradient_inside(amount), ret, 1.0);
+		}
+
+		return ret;
+	}
+
+	virtual void fill_row(Color *row, const Color *context, int count, Vector p, Real dx) const
+	{
+		FractalLanes lanes;
+		for(int x = 0; x < count; x += FractalLanes::count)
+		{
+			for(int j = 0; j < FractalLanes::count; ++j)
+			{
+				lanes.cr[j] = p[0] + (Real)(x + j)*dx;
+				lanes.ci[j] = p[1];
+				lanes.zr[j] = 0.0;
+				lanes.zi[j] = 0.0;
+			}
+			lanes.iterate(iterations, bailout, broken, false);
+
+			int n = std::min(count - x, (int)FractalLanes::count);
+			for(int j = 0; j < n; ++j)
+				row[x + j] = get_color(lanes, j, context[x + j]);
+		}
+	}
+
+public:
+	virtual bool run(RunParams&) const
+		{ return run_fractal(); }
+};
+
+
+rendering::Task::Token TaskMandelbrot::token(
+	DescAbstract<TaskMandelbrot>("Mandelbrot") );
+rendering::Task::Token TaskMandelbrotSW::token(
+	DescReal<TaskMandelbrotSW, TaskMandelbrot>("MandelbrotSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 Mandelbrot::Mandelbrot():
@@ -313,6 +497,42 @@ Mandelbrot::get_sub_renddesc_vfunc(const RendDesc &renddesc) const
 	return desc;
 }
 
+rendering::Task::Handle
+Mandelbrot::build_rendering_task_vfunc(Context context)const
+{
+	bool distort_inside=param_distort_inside.get(bool());
+	bool solid_inside=param_solid_inside.get(bool());
+	bool distort_outside=param_distort_outside.get(bool());
+	bool solid_outside=param_solid_outside.get(bool());
+
+	// distorted context is sampled at arbitrary points,
+	// so render it by get_color()
+	if ((!solid_inside && distort_inside) || (!solid_outside && distort_outside))
+		return Layer::build_rendering_task_vfunc(context);
+
+	TaskMandelbrot::Handle task(new TaskMandelbrot());
+	task->iterations=param_iterations.get(int());
+	task->bailout=param_bailout.get(Real());
+	task->lp=lp;
+	task->broken=param_broken.get(bool());
+	task->shade_inside=param_shade_inside.get(bool());
+	task->solid_inside=solid_inside;
+	task->invert_inside=param_invert_inside.get(bool());
+	task->gradient_inside=param_gradient_inside.get(Gradient());
+	task->gradient_offset_inside=param_gradient_offset_inside.get(Real());
+	task->gradient_loop_inside=param_gradient_loop_inside.get(bool());
+	task->shade_outside=param_shade_outside.get(bool());
+	task->solid_outside=solid_outside;
+	task->invert_outside=param_invert_outside.get(bool());
+	task->gradient_outside=param_gradient_outside.get(Gradient());
+	task->smooth_outside=param_smooth_outside.get(bool());
+	task->gradient_offset_outside=param_gradient_offset_outside.get(Real());
+	task->gradient_scale_outside=param_gradient_scale_outside.get(Real());
+	if (!solid_inside || !solid_outside)
+		task->sub_task() = context.build_rendering_task();
+	return task;
+}
+
 Color
 Mandelbrot::get_color(Context context, const Point &pos)const
 {
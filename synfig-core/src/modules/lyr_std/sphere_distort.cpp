@@ -48,6 +48,7 @@
 #include <synfig/cairo_renddesc.h>
 
 #include <synfig/curve_helper.h>
+#include <synfig/rendering/common/task/taskdistort.h>
 
 #endif
 
@@ -304,6 +305,56 @@ inline Point sphtrans(const Point &p, const Point &center, const Real &radius,
 	return sphtrans(p, center, radius, percent, type, tmp);
 }
 
+namespace {
+
+class SphereDistortion: public rendering::Distortion
+{
+public:
+	Point center;
+	Real radius;
+	Real percent;
+	int type;
+	bool clip;
+
+	SphereDistortion(): radius(), percent(), type(), clip() { }
+
+protected:
+	virtual Point map_vfunc(const Point &p) const
+	{
+		bool clipped;
+		Point point(sphtrans(p,center,radius,percent,type,clipped));
+		return clip && clipped ? Point::nan() : point;
+	}
+
+	// clipped layer is visible only inside of distorted area
+	virtual Rect calc_bounds_vfunc(const Rect &/* source_bounds */) const
+	{
+		if (!clip) return Rect::infinite();
+		switch(type)
+		{
+			case TYPE_NORMAL:
+				return Rect(center).expand(fabs(radius));
+			case TYPE_DISTH:
+				return Rect::vertical_strip(center[0]-fabs(radius), center[0]+fabs(radius));
+			case TYPE_DISTV:
+				return Rect::horizontal_strip(center[1]-fabs(radius), center[1]+fabs(radius));
+			default:
+				break;
+		}
+		return Rect::infinite();
+	}
+	virtual bool hash_params_vfunc(rendering::TaskHash &hash) const {
+		hash.add(center);
+		hash.add(radius);
+		hash.add(percent);
+		hash.add(type);
+		hash.add(clip);
+		return true;
+	}
+};
+
+} // namespace
+
 Layer::Handle
 Layer_SphereDistort::hit_check(Context context, const Point &pos)const
 {
@@ -336,6 +387,22 @@ Layer_SphereDistort::get_color(Context context, const Point &pos)const
 	return context.get_color(point);
 }
 
+rendering::Task::Handle
+Layer_SphereDistort::build_rendering_task_vfunc(Context context)const
+{
+	etl::handle<SphereDistortion> distortion(new SphereDistortion());
+	distortion->center=param_center.get(Vector());
+	distortion->radius=param_radius.get(double());
+	distortion->percent=param_amount.get(double());
+	distortion->type=param_type.get(int());
+	distortion->clip=param_clip.get(bool());
+
+	rendering::TaskDistort::Handle task(new rendering::TaskDistort());
+	task->distortion=distortion;
+	task->sub_task()=context.build_rendering_task();
+	return task;
+}
+
 RendDesc
 Layer_SphereDistort::get_sub_renddesc_vfunc(const RendDesc &renddesc) const
 {
@@ -42,6 +42,8 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 #include <synfig/transform.h>
+#include <synfig/rendering/common/task/taskdistort.h>
+
 #include "twirl.h"
 
 #endif
@@ -65,6 +67,60 @@ SYNFIG_LAYER_SET_CVS_ID(Twirl,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+Point
+twirl(const Point &pos, const Point &center, Real radius, const Angle &rotations,
+	bool distort_inside, bool distort_outside, bool reverse)
+{
+	Point centered(pos-center);
+	Real mag(centered.mag());
+
+	Angle a;
+
+	if((distort_inside || mag>radius) && (distort_outside || mag<radius))
+		a=rotations*((centered.mag()-radius)/radius);
+	else
+		return pos;
+
+	if(reverse)	a=-a;
+
+	const Real sin(Angle::sin(a).get());
+	const Real cos(Angle::cos(a).get());
+
+	Point twirled;
+	twirled[0]=cos*centered[0]-sin*centered[1];
+	twirled[1]=sin*centered[0]+cos*centered[1];
+
+	return twirled+center;
+}
+
+class TwirlDistortion: public rendering::Distortion
+{
+public:
+	Point center;
+	Real radius;
+	Angle rotations;
+	bool distort_inside;
+	bool distort_outside;
+
+	TwirlDistortion(): radius(), distort_inside(), distort_outside() { }
+
+protected:
+	virtual Point map_vfunc(const Point &p) const
+		{ return twirl(p, center, radius, rotations, distort_inside, distort_outside, false); }
+	virtual bool hash_params_vfunc(rendering::TaskHash &hash) const {
+		hash.add(center);
+		hash.add(radius);
+		hash.add(Angle::rad(rotations).get());
+		hash.add(distort_inside);
+		hash.add(distort_outside);
+		return true;
+	}
+};
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -147,32 +203,14 @@ Twirl::get_param_vocab()const
 Point
 Twirl::distort(const Point &pos,bool reverse)const
 {
-	Point center=param_center.get(Point());
-	Real radius=param_radius.get(Real());
-	Angle rotations=param_rotations.get(Angle());
-	bool distort_inside=param_distort_inside.get(bool());
-	bool distort_outside=param_distort_outside.get(bool());
-	
-	Point centered(pos-center);
-	Real mag(centered.mag());
-
-	Angle a;
-
-	if((distort_inside || mag>radius) && (distort_outside || mag<radius))
-		a=rotations*((centered.mag()-radius)/radius);
-	else
-		return pos;
-
-	if(reverse)	a=-a;
-
-	const Real sin(Angle::sin(a).get());
-	const Real cos(Angle::cos(a).get());
-
-	Point twirled;
-	twirled[0]=cos*centered[0]-sin*centered[1];
-	twirled[1]=sin*centered[0]+cos*centered[1];
-
-	return twirled+center;
+	return twirl(
+		pos,
+		param_center.get(Point()),
+		param_radius.get(Real()),
+		param_rotations.get(Angle()),
+		param_distort_inside.get(bool()),
+		param_distort_outside.get(bool()),
+		reverse );
 }
 
 Layer::Handle
@@ -287,5 +325,18 @@ Twirl::get_sub_renddesc_vfunc(const RendDesc &renddesc) const
 }
 
 rendering::Task::Handle
-Twirl::build_rendering_task_vfunc(Context context) const
-	{ return Layer::build_rendering_task_vfunc(context); }
+Twirl::build_composite_fork_task_vfunc(ContextParams /* context_params */, rendering::Task::Handle sub_task)const
+{
+	etl::handle<TwirlDistortion> distortion(new TwirlDistortion());
+	distortion->center = param_center.get(Point());
+	distortion->radius = param_radius.get(Real());
+	distortion->rotations = param_rotations.get(Angle());
+	distortion->distort_inside = param_distort_inside.get(bool());
+	distortion->distort_outside = param_distort_outside.get(bool());
+
+	rendering::TaskDistort::Handle task_distort(new rendering::TaskDistort());
+	task_distort->distortion = distortion;
+	task_distort->sub_task() = sub_task ? sub_task->clone_recursive() : rendering::Task::Handle();
+
+	return task_distort;
+}
@@ -33,6 +33,8 @@
 #	include <config.h>
 #endif
 
+#include <cstring>
+
 #include "warp.h"
 
 #include <synfig/localization.h>
@@ -48,6 +50,7 @@
 #include <synfig/valuenode.h>
 #include <synfig/transform.h>
 #include <synfig/cairo_renddesc.h>
+#include <synfig/rendering/common/task/taskdistort.h>
 #include <ETL/misc>
 
 #endif
@@ -71,6 +74,88 @@ SYNFIG_LAYER_SET_CVS_ID(Warp,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class WarpDistortion: public rendering::Distortion
+{
+public:
+	Real matrix[3][3];
+	Real inv_matrix[3][3];
+	Rect src_rect;
+	Real horizon;
+	bool clip;
+
+	WarpDistortion(): horizon(), clip() { }
+
+	Point transform_forward(const Point& p)const
+	{
+		return Point(
+			(inv_matrix[0][0]*p[0] + inv_matrix[0][1]*p[1] + inv_matrix[0][2])/(inv_matrix[2][0]*p[0] + inv_matrix[2][1]*p[1] + inv_matrix[2][2]),
+			(inv_matrix[1][0]*p[0] + inv_matrix[1][1]*p[1] + inv_matrix[1][2])/(inv_matrix[2][0]*p[0] + inv_matrix[2][1]*p[1] + inv_matrix[2][2])
+		);
+	}
+
+	Point transform_backward(const Point& p)const
+	{
+		return Point(
+			(matrix[0][0]*p[0] + matrix[0][1]*p[1] + matrix[0][2])/(matrix[2][0]*p[0] + matrix[2][1]*p[1] + matrix[2][2]),
+			(matrix[1][0]*p[0] + matrix[1][1]*p[1] + matrix[1][2])/(matrix[2][0]*p[0] + matrix[2][1]*p[1] + matrix[2][2])
+		);
+	}
+
+	Real transform_backward_z(const Point& p)const
+		{ return matrix[2][0]*p[0] + matrix[2][1]*p[1] + matrix[2][2]; }
+
+protected:
+	virtual Point map_vfunc(const Point &p) const
+	{
+		Point newpos(transform_forward(p));
+		if(clip && !src_rect.is_inside(newpos))
+			return Point::nan();
+		const float z(transform_backward_z(newpos));
+		return z>0 && z<horizon ? newpos : Point::nan();
+	}
+
+	virtual Rect calc_source_bounds_vfunc(const Rect &rect) const
+	{
+		Rect bounds = Distortion::calc_source_bounds_vfunc(rect);
+		if (clip) bounds &= src_rect;
+		return bounds;
+	}
+
+	// clipped area is a quad when whole source is in front of the viewer
+	virtual Rect calc_bounds_vfunc(const Rect &/* source_bounds */) const
+	{
+		if (!clip)
+			return Rect::infinite();
+		Point corners[] = {
+			src_rect.get_min(),
+			Point(src_rect.maxx, src_rect.miny),
+			Point(src_rect.minx, src_rect.maxy),
+			src_rect.get_max() };
+		Rect bounds;
+		for(int i = 0; i < 4; ++i) {
+			if (!(transform_backward_z(corners[i]) > 0))
+				return Rect::infinite();
+			Point p = transform_backward(corners[i]);
+			if (i) bounds.expand(p); else bounds = Rect(p);
+		}
+		return bounds;
+	}
+	virtual bool hash_params_vfunc(rendering::TaskHash &hash) const {
+		hash.add(matrix);
+		hash.add(src_rect.minx);
+		hash.add(src_rect.miny);
+		hash.add(src_rect.maxx);
+		hash.add(src_rect.maxy);
+		hash.add(horizon);
+		hash.add(clip);
+		return true;
+	}
+};
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -509,6 +594,22 @@ Warp::get_color(Context context, const Point &p)const
 		return Color::alpha();
 }
 
+rendering::Task::Handle
+Warp::build_rendering_task_vfunc(Context context)const
+{
+	etl::handle<WarpDistortion> distortion(new WarpDistortion());
+	memcpy(distortion->matrix, matrix, sizeof(matrix));
+	memcpy(distortion->inv_matrix, inv_matrix, sizeof(inv_matrix));
+	distortion->src_rect=Rect(param_src_tl.get(Point()), param_src_br.get(Point()));
+	distortion->horizon=param_horizon.get(Real());
+	distortion->clip=param_clip.get(bool());
+
+	rendering::TaskDistort::Handle task(new rendering::TaskDistort());
+	task->distortion=distortion;
+	task->sub_task()=context.build_rendering_task();
+	return task;
+}
+
 //#define ACCEL_WARP_IS_BROKEN 1
 
 RendDesc
@@ -85,6 +85,13 @@ public:
 	TaskCheckerBoard(): antialias(true) { }
 	virtual const rendering::Transformation::Handle get_transformation() const
 		{ return transformation.handle(); }
+
+	virtual bool hash_params(rendering::TaskHash &hash) const {
+		hash.add(color);
+		hash.add(antialias);
+		hash.add(transformation->matrix.m);
+		return true;
+	}
 };
 
 
@@ -56,6 +56,8 @@ SYNFIG_TARGET_SET_EXT(gif,"gif");
 SYNFIG_TARGET_SET_VERSION(gif,"0.1");
 SYNFIG_TARGET_SET_CVS_ID(gif,"$Id$");
 
+/* === P R O C E D U R E S ================================================= */
+
 /* === M E T H O D S ======================================================= */
 
 gif::gif(const char *filename_, const synfig::TargetParam & /* params */):
@@ -322,32 +324,14 @@ gif::end_frame()
 	// Push a table reset into the bitstream
 	bs.push_value(1<<rootsize,codesize);
 
+	quantize_curr_surface();
+
 	for(int cur_scanline=0;cur_scanline<desc.get_h();cur_scanline++)
 	{
-		//color_to_pixelformat(curr_frame[cur_scanline], curr_surface[cur_scanline], PF_GRAY, &gamma(), desc.get_w());
-
 		// Now we compress it!
 		for(i=0;i<w;i++)
 		{
-			Color color(curr_surface[cur_scanline][i].clamped());
-			Palette::iterator iter(curr_palette.find_closest(color));
-
-			if(dithering)
-			{
-				Color error(color-iter->color);
-				//error*=0.25;
-				if(curr_surface.get_h()>cur_scanline+1)
-				{
-					curr_surface[cur_scanline+1][i-1]  += error * ((float)3/(float)16);
-					curr_surface[cur_scanline+1][i]    += error * ((float)5/(float)16);
-					if(curr_surface.get_w()>i+1)
-						curr_surface[cur_scanline+1][i+1]  += error * ((float)1/(float)16);
-				}
-				if(curr_surface.get_w()>i+1)
-					curr_surface[cur_scanline][i+1]    += error * ((float)7/(float)16);
-			}
-
-			curr_frame[cur_scanline][i]=iter-curr_palette.begin();
+			const PaletteItem &item(curr_palette[curr_frame[cur_scanline][i]]);
 
 			value=curr_frame[cur_scanline][i];
 			if(build_off_previous)
@@ -365,7 +349,7 @@ gif::end_frame()
 
 					// Lossy
 					if(
-						abs( ( iter->color-prev_palette[prev_frame[cur_scanline][i]-1].color ).get_y() ) > (1.0/16.0) ||
+						abs( ( item.color-prev_palette[prev_frame[cur_scanline][i]-1].color ).get_y() ) > (1.0/16.0) ||
 //						abs((int)value-(int)prev_frame[cur_scanline][i])>2||
 //						(value<=2 && value!=prev_frame[cur_scanline][i]) ||
 						(imagecount%iframe_density)==0 || imagecount==desc.get_frame_end()-1 ) // lossy version
@@ -443,6 +427,12 @@ gif::end_frame()
 	imagecount++;
 }
 
+void
+gif::quantize_curr_surface()
+{
+	curr_palette.quantize(curr_surface, curr_frame, dithering);
+}
+
 synfig::Color*
 gif::start_scanline(int scanline)
 {
@@ -194,6 +194,9 @@ private:
 
 	void output_curr_palette();
 
+	// Converts curr_surface into indices of curr_palette in curr_frame
+	void quantize_curr_surface();
+
 public:
 	gif(const char *filename, const synfig::TargetParam& /* params */);
 
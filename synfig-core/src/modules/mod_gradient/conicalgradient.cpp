@@ -43,7 +43,10 @@
 #include <synfig/valuenode.h>
 #include <synfig/angle.h>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+
 #include "conicalgradient.h"
+#include "gradienttask.h"
 
 #endif
 
@@ -64,6 +67,73 @@ SYNFIG_LAYER_SET_CVS_ID(ConicalGradient,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class TaskConicalGradient: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskConicalGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	Point center;
+	Real angle; // in rotations
+	CompiledGradient gradient;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual const rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+
+	virtual bool hash_params(rendering::TaskHash &hash) const {
+		hash.add(center);
+		hash.add(angle);
+		hash_compiled_gradient(hash, gradient);
+		hash.add(transformation->matrix.m);
+		return true;
+	}
+};
+
+
+class TaskConicalGradientSW: public TaskConicalGradient, public TaskGradientSW
+{
+public:
+	typedef etl::handle<TaskConicalGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+protected:
+	virtual const CompiledGradient& get_compiled_gradient() const
+		{ return gradient; }
+
+	virtual Real get_gradient_step(Real /*pw*/) const
+		{ return 0.0; }
+
+	virtual void fill_row(const GradientLUT &lut, Color *row, int count, Vector p, const Vector &dx, Real pw) const {
+		const Real k = 1.0/(2.0*PI);
+		const Real hpw = 0.5*pw;
+		for(Color *end = row + count; row != end; ++row, p += dx) {
+			const Point centered(p - center);
+			Real supersample = fabs(centered[0]) < hpw && fabs(centered[1]) < hpw
+			                 ? 0.25 : 0.5*k*pw/centered.mag();
+			Real dist = atan2(-centered[1], centered[0])*k + angle;
+			dist -= floor(dist);
+			*row = lut.average(dist - supersample, dist + supersample);
+		}
+	}
+
+public:
+	virtual bool run(RunParams&) const
+		{ return run_gradient(transformation->matrix); }
+};
+
+
+rendering::Task::Token TaskConicalGradient::token(
+	DescAbstract<TaskConicalGradient>("ConicalGradient") );
+rendering::Task::Token TaskConicalGradientSW::token(
+	DescReal<TaskConicalGradientSW, TaskConicalGradient>("ConicalGradientSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -257,6 +327,20 @@ ConicalGradient::accelerated_render(Context context,Surface *surface,int quality
 	return true;
 }
 
+rendering::Task::Handle
+ConicalGradient::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	Point center = param_center.get(Point());
+	Angle angle = param_angle.get(Angle());
+
+	TaskConicalGradient::Handle task(new TaskConicalGradient());
+	task->center = center;
+	task->angle = Angle::rot(angle).get();
+	task->gradient = compiled_gradient;
+
+	return task;
+}
+
 /////////
 bool
 ConicalGradient::accelerated_cairorender(Context context,cairo_t *cr,int quality, const RendDesc &renddesc, ProgressCallback *cb)const
@@ -51,6 +51,10 @@
 #include <ETL/hermite>
 #include <ETL/calculus>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+
+#include "gradienttask.h"
+
 #endif
 
 /* === M A C R O S ========================================================= */
@@ -197,79 +201,30 @@ find_closest(bool fast, const std::vector<synfig::BLinePoint>& bline,const Point
 	return ret;
 }
 
-/* === M E T H O D S ======================================================= */
-
-inline void
-CurveGradient::sync()
-{
-	std::vector<synfig::BLinePoint> bline(param_bline.get_list_of(BLinePoint()));
-	curve_length_=calculate_distance(bline, bline_loop);
-}
-
-void
-CurveGradient::compile()
-{
-	compiled_gradient.set(
-		param_gradient.get(Gradient()),
-		param_loop.get(bool()),
-		param_zigzag.get(bool()) );
-}
-
-
-CurveGradient::CurveGradient():
-	Layer_Composite(1.0,Color::BLEND_COMPOSITE),
-	param_origin(ValueBase(Point(0,0))),
-	param_width(ValueBase(Real(0.25))),
-	param_bline(ValueBase(std::vector<synfig::BLinePoint>())),
-	param_gradient(Gradient(Color::black(), Color::white())),
-	param_loop(ValueBase(false)),
-	param_zigzag(ValueBase(false)),
-	param_perpendicular(ValueBase(false)),
-	param_fast(ValueBase(true))
-{
-	std::vector<synfig::BLinePoint> bline;
-	bline.push_back(BLinePoint());
-	bline.push_back(BLinePoint());
-	bline.push_back(BLinePoint());
-	bline[0].set_vertex(Point(0,1));
-	bline[1].set_vertex(Point(0,-1));
-	bline[2].set_vertex(Point(1,0));
-	bline[0].set_tangent(bline[1].get_vertex()-bline[2].get_vertex()*0.5f);
-	bline[1].set_tangent(bline[2].get_vertex()-bline[0].get_vertex()*0.5f);
-	bline[2].set_tangent(bline[0].get_vertex()-bline[1].get_vertex()*0.5f);
-	bline[0].set_width(1.0f);
-	bline[1].set_width(1.0f);
-	bline[2].set_width(1.0f);
-	bline_loop=true;
-	param_bline.set_list_of(bline);
-
-	sync();
-
-	SET_INTERPOLATION_DEFAULTS();
-	SET_STATIC_DEFAULTS();
-}
-
-inline Color
-CurveGradient::color_func(const Point &point_, int quality, Real supersample)const
+//! Calculates position in gradient for the point and size of pixel in gradient units,
+//! returns false when color of the point is transparent
+static bool
+calc_curve_gradient_dist(const CurveGradient::Params &params, const Point &point_, int quality, Real &supersample, Real &dist)
 {
-	Point origin=param_origin.get(Point());
-	Real width=param_width.get(Real());
-	std::vector<synfig::BLinePoint> bline(param_bline.get_list_of(BLinePoint()));
-	bool loop=param_loop.get(bool());
-	bool perpendicular=param_perpendicular.get(bool());
-	bool fast=param_fast.get(bool());
+	const Point &origin=params.origin;
+	const Real width=params.width;
+	const std::vector<synfig::BLinePoint> &bline=params.bline;
+	const bool bline_loop=params.bline_loop;
+	const bool loop=params.loop;
+	const bool perpendicular=params.perpendicular;
+	const bool fast=params.fast;
+	const Real curve_length=params.curve_length;
 
 	Vector tangent;
 	Vector diff;
 	Point p1;
 	Real thickness;
-	Real dist;
 
 	Real perp_dist = 0;
 	bool edge_case = false;
 
 	if(bline.size()==0)
-		return Color::alpha();
+		return false;
 	else if(bline.size()==1)
 	{
 		tangent=bline.front().get_tangent1();
@@ -288,7 +243,7 @@ CurveGradient::color_func(const Point &point_, int quality, Real supersample)con
 		if(perpendicular)
 		{
 			next=find_closest(fast,bline,point,t,bline_loop,&perp_dist);
-			perp_dist/=curve_length_;
+			perp_dist/=curve_length;
 		}
 		else					// not perpendicular
 		{
@@ -404,7 +359,7 @@ CurveGradient::color_func(const Point &point_, int quality, Real supersample)con
 
 		if(perpendicular)
 		{
-			tangent*=curve_length_;
+			tangent*=curve_length;
 			p1-=tangent*perp_dist;
 			tangent=-tangent.perp();
 		}
@@ -453,6 +408,162 @@ CurveGradient::color_func(const Point &point_, int quality, Real supersample)con
 	}
 
 	supersample *= 0.5;
+	return true;
+}
+
+
+namespace {
+
+class TaskCurveGradient: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskCurveGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	CurveGradient::Params params;
+	CompiledGradient gradient;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual const rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+
+	virtual bool hash_params(rendering::TaskHash &hash) const {
+		hash.add(params.origin);
+		hash.add(params.width);
+		hash.add(params.bline.size());
+		for(std::vector<synfig::BLinePoint>::const_iterator i = params.bline.begin(); i != params.bline.end(); ++i) {
+			hash.add(i->get_vertex());
+			hash.add(i->get_tangent1());
+			hash.add(i->get_tangent2());
+			hash.add(i->get_width());
+			hash.add(i->get_origin());
+		}
+		hash.add(params.bline_loop);
+		hash.add(params.loop);
+		hash.add(params.perpendicular);
+		hash.add(params.fast);
+		hash.add(params.curve_length);
+		hash_compiled_gradient(hash, gradient);
+		hash.add(transformation->matrix.m);
+		return true;
+	}
+};
+
+
+class TaskCurveGradientSW: public TaskCurveGradient, public TaskGradientSW
+{
+public:
+	typedef etl::handle<TaskCurveGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+protected:
+	virtual const CompiledGradient& get_compiled_gradient() const
+		{ return gradient; }
+
+	virtual Real get_gradient_step(Real pw) const
+		{ return pw/fabs(params.width); }
+
+	virtual void fill_row(const GradientLUT &lut, Color *row, int count, Vector p, const Vector &dx, Real pw) const {
+		// quality is the same as was used by TaskLayerSW
+		const int quality = 4;
+		for(Color *end = row + count; row != end; ++row, p += dx) {
+			Real supersample = pw;
+			Real dist;
+			*row = calc_curve_gradient_dist(params, p, quality, supersample, dist)
+			     ? lut.average(dist - supersample, dist + supersample)
+			     : Color::alpha();
+		}
+	}
+
+public:
+	virtual bool run(RunParams&) const
+		{ return run_gradient(transformation->matrix); }
+};
+
+
+rendering::Task::Token TaskCurveGradient::token(
+	DescAbstract<TaskCurveGradient>("CurveGradient") );
+rendering::Task::Token TaskCurveGradientSW::token(
+	DescReal<TaskCurveGradientSW, TaskCurveGradient>("CurveGradientSW") );
+
+} // namespace
+
+/* === M E T H O D S ======================================================= */
+
+inline void
+CurveGradient::sync()
+{
+	std::vector<synfig::BLinePoint> bline(param_bline.get_list_of(BLinePoint()));
+	curve_length_=calculate_distance(bline, bline_loop);
+}
+
+void
+CurveGradient::compile()
+{
+	compiled_gradient.set(
+		param_gradient.get(Gradient()),
+		param_loop.get(bool()),
+		param_zigzag.get(bool()) );
+}
+
+void
+CurveGradient::fill_params(Params &params)const
+{
+	params.origin=param_origin.get(Point());
+	params.width=param_width.get(Real());
+	params.bline=param_bline.get_list_of(BLinePoint());
+	params.bline_loop=bline_loop;
+	params.loop=param_loop.get(bool());
+	params.perpendicular=param_perpendicular.get(bool());
+	params.fast=param_fast.get(bool());
+	params.curve_length=curve_length_;
+}
+
+
+CurveGradient::CurveGradient():
+	Layer_Composite(1.0,Color::BLEND_COMPOSITE),
+	param_origin(ValueBase(Point(0,0))),
+	param_width(ValueBase(Real(0.25))),
+	param_bline(ValueBase(std::vector<synfig::BLinePoint>())),
+	param_gradient(Gradient(Color::black(), Color::white())),
+	param_loop(ValueBase(false)),
+	param_zigzag(ValueBase(false)),
+	param_perpendicular(ValueBase(false)),
+	param_fast(ValueBase(true))
+{
+	std::vector<synfig::BLinePoint> bline;
+	bline.push_back(BLinePoint());
+	bline.push_back(BLinePoint());
+	bline.push_back(BLinePoint());
+	bline[0].set_vertex(Point(0,1));
+	bline[1].set_vertex(Point(0,-1));
+	bline[2].set_vertex(Point(1,0));
+	bline[0].set_tangent(bline[1].get_vertex()-bline[2].get_vertex()*0.5f);
+	bline[1].set_tangent(bline[2].get_vertex()-bline[0].get_vertex()*0.5f);
+	bline[2].set_tangent(bline[0].get_vertex()-bline[1].get_vertex()*0.5f);
+	bline[0].set_width(1.0f);
+	bline[1].set_width(1.0f);
+	bline[2].set_width(1.0f);
+	bline_loop=true;
+	param_bline.set_list_of(bline);
+
+	sync();
+
+	SET_INTERPOLATION_DEFAULTS();
+	SET_STATIC_DEFAULTS();
+}
+
+inline Color
+CurveGradient::color_func(const Point &point, int quality, Real supersample)const
+{
+	Params params;
+	fill_params(params);
+
+	Real dist;
+	if (!calc_curve_gradient_dist(params, point, quality, supersample, dist))
+		return Color::alpha();
 	return compiled_gradient.average(dist - supersample, dist + supersample);
 }
 
@@ -621,6 +732,16 @@ CurveGradient::accelerated_render(Context context,Surface *surface,int quality,
 	return true;
 }
 
+rendering::Task::Handle
+CurveGradient::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	TaskCurveGradient::Handle task(new TaskCurveGradient());
+	fill_params(task->params);
+	task->gradient = compiled_gradient;
+
+	return task;
+}
+
 ////
 bool
 CurveGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality, const RendDesc &renddesc_, ProgressCallback *cb)const
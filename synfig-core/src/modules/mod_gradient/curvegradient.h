@@ -49,6 +49,21 @@ class CurveGradient : public Layer_Composite, public Layer_NoDeform
 {
 	SYNFIG_LAYER_MODULE_EXT
 
+public:
+	//! Values of parameters required to calculate the color of point
+	struct Params {
+		Point origin;
+		Real width;
+		std::vector<synfig::BLinePoint> bline;
+		bool bline_loop;
+		bool loop;
+		bool perpendicular;
+		bool fast;
+		Real curve_length;
+		inline Params():
+			width(), bline_loop(), loop(), perpendicular(), fast(), curve_length() { }
+	};
+
 private:
 	//! Parameter: (Point)
 	ValueBase param_origin;
@@ -74,6 +89,7 @@ private:
 
 	void compile();
 	void sync();
+	void fill_params(Params &params)const;
 	Color color_func(const Point &x, int quality=10, Real supersample=0)const;
 	Real calc_supersample(const Point &x, Real pw, Real ph)const;
 
@@ -88,6 +104,9 @@ public:
 	Layer::Handle hit_check(synfig::Context context, const synfig::Point &point)const;
 
 	virtual Vocab get_param_vocab()const;
+
+protected:
+	virtual rendering::Task::Handle build_composite_task_vfunc(ContextParams context_params)const;
 };
 
 /* === E N D =============================================================== */
@@ -0,0 +1,204 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file gradienttask.cpp
+**	\brief Common parts of rendering tasks of gradient layers
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <sigc++/bind.h>
+
+#include <synfig/threadpool.h>
+
+#include "gradienttask.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+	const int lut_min_size = 256;
+	const int lut_max_size = 16384;
+	const int lut_default_size = 4096;
+
+	// minimal count of pixels to render in separate thread
+	const int band_pixels = 65536;
+}
+
+/* === P R O C E D U R E S ================================================= */
+
+void
+hash_compiled_gradient(rendering::TaskHash &hash, const CompiledGradient &gradient)
+{
+	// entries consists of Real values only, so they have no padding bytes
+	const CompiledGradient::List &list = gradient.get_list();
+	hash.add(gradient.empty());
+	hash.add(gradient.get_repeat());
+	hash.add(list.size());
+	if (!list.empty())
+		hash.add_data(&list.front(), list.size()*sizeof(list.front()));
+}
+
+/* === M E T H O D S ======================================================= */
+
+void
+GradientLUT::set(const CompiledGradient &gradient, Real step)
+{
+	// two samples per pixel is enough to not see the difference
+	// with exact calculation
+	Real s = step > real_precision<Real>() ? ceil(2.0/step) : (Real)lut_default_size;
+	size = (int)std::max((Real)lut_min_size, std::min((Real)lut_max_size, s));
+	k = (Real)size;
+	repeat = gradient.get_repeat();
+
+	colors.resize(size + 1);
+	sums.resize(size + 1);
+	CompiledGradient::List::const_iterator entry = gradient.get_list().begin();
+	CompiledGradient::List::const_iterator last = gradient.get_list().end() - 1;
+	for(int i = 0; i <= size; ++i) {
+		Real x = (Real)i/k;
+		// samples are sorted, so just go forward instead of binary search
+		while(entry != last && entry->next_pos < x) ++entry;
+		colors[i] = Accumulator(entry->color(x));
+		sums[i] = entry->summary(x);
+	}
+
+	summary_color = gradient.summary();
+	average_color = gradient.average();
+}
+
+
+struct TaskGradientSW::Rows {
+	const GradientLUT *lut;
+	synfig::Surface *surface;
+	RectInt rect;
+	Matrix inv_matrix;
+	Real pw;
+	bool copy;
+	Color::BlendMethod blend_method;
+	ColorReal amount;
+
+	Rows(): lut(), surface(), pw(), copy(), blend_method(), amount() { }
+};
+
+void
+TaskGradientSW::fill_rows(const Rows *rows, int begin, int end) const
+{
+	const RectInt &r = rows->rect;
+	int w = r.get_width();
+	Vector dx = rows->inv_matrix.axis_x();
+	Vector dy = rows->inv_matrix.axis_y();
+	Vector p = rows->inv_matrix.get_transformed( Vector((Real)r.minx, (Real)begin) );
+	synfig::Surface &surface = *rows->surface;
+
+	if (rows->copy) {
+		for(int y = begin; y < end; ++y, p += dy)
+			fill_row(*rows->lut, &surface[y][r.minx], w, p, dx, rows->pw);
+		return;
+	}
+
+	std::vector<Color> row(w);
+	synfig::Surface::alpha_pen apen(surface.get_pen(r.minx, begin));
+	apen.set_blend_method(rows->blend_method);
+	for(int y = begin; y < end; ++y, p += dy, apen.inc_y(), apen.dec_x(w)) {
+		fill_row(*rows->lut, &row.front(), w, p, dx, rows->pw);
+		for(std::vector<Color>::const_iterator i = row.begin(); i != row.end(); ++i, apen.inc_x())
+			apen.put_value(*i, rows->amount);
+	}
+}
+
+bool
+TaskGradientSW::run_gradient(const Matrix &matrix) const
+{
+	const Task *task = dynamic_cast<const Task*>(this);
+	if (!task || !task->is_valid())
+		return true;
+
+	Vector ppu = task->get_pixels_per_unit();
+
+	Matrix bounds_transfromation;
+	bounds_transfromation.m00 = ppu[0];
+	bounds_transfromation.m11 = ppu[1];
+	bounds_transfromation.m20 = task->target_rect.minx - ppu[0]*task->source_rect.minx;
+	bounds_transfromation.m21 = task->target_rect.miny - ppu[1]*task->source_rect.miny;
+
+	Rows rows;
+	rows.rect = task->target_rect;
+	rows.inv_matrix = (bounds_transfromation * matrix).get_inverted();
+	rows.pw = std::max(rows.inv_matrix.axis_x().mag(), rows.inv_matrix.axis_y().mag());
+	rows.copy = !blend
+	         || ( blend_method == Color::BLEND_STRAIGHT
+	           && approximate_equal_lp(amount, ColorReal(1.0)) );
+	rows.blend_method = blend ? blend_method : Color::BLEND_COMPOSITE;
+	rows.amount = blend ? amount : ColorReal(1.0);
+
+	GradientLUT lut;
+	lut.set(get_compiled_gradient(), get_gradient_step(rows.pw));
+	rows.lut = &lut;
+
+	LockWrite la(task);
+	if (!la)
+		return false;
+	rows.surface = &la->get_surface();
+
+	int w = rows.rect.get_width();
+	int h = rows.rect.get_height();
+	int band = std::max(1, band_pixels/w);
+	if (band >= h) {
+		fill_rows(&rows, rows.rect.miny, rows.rect.maxy);
+		return true;
+	}
+
+	ThreadPool::Group group;
+	for(int y = rows.rect.miny; y < rows.rect.maxy; y += band)
+		group.enqueue( sigc::bind( sigc::mem_fun(this, &TaskGradientSW::fill_rows),
+			&rows, y, std::min(y + band, rows.rect.maxy) ));
+	group.run();
+	return true;
+}
+
+void
+TaskGradientSW::on_target_set_as_source()
+{
+	Task *task = dynamic_cast<Task*>(this);
+	if (!task) return;
+	Task::Handle &subtask = target_subtask();
+	if ( subtask
+	  && subtask->target_surface == task->target_surface
+	  && !Color::is_straight(blend_method) )
+	{
+		task->trunc_by_bounds();
+		subtask->source_rect = task->source_rect;
+		subtask->target_rect = task->target_rect;
+	}
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,160 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file gradienttask.h
+**	\brief Common parts of rendering tasks of gradient layers
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_GRADIENTTASK_H
+#define __SYNFIG_GRADIENTTASK_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <synfig/color.h>
+#include <synfig/gradient.h>
+#include <synfig/matrix.h>
+#include <synfig/surface.h>
+
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/software/task/tasksw.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+//! Adds \a gradient to the \a hash of task parameters, see Task::hash_params()
+void hash_compiled_gradient(synfig::rendering::TaskHash &hash, const synfig::CompiledGradient &gradient);
+
+//! \class GradientLUT
+//! \brief Lookup table of CompiledGradient with uniform samples,
+//!        color and average color of range calculates without searching
+class GradientLUT
+{
+public:
+	typedef synfig::CompiledGradient::Accumulator Accumulator;
+
+private:
+	bool repeat;
+	int size;
+	synfig::Real k;
+	std::vector<Accumulator> colors;
+	std::vector<Accumulator> sums;
+	Accumulator summary_color;
+	synfig::Color average_color;
+
+	inline void locate(synfig::Real x, int &index, synfig::Real &offset) const {
+		x *= k;
+		index = std::max(0, std::min(size - 1, (int)floor(x)));
+		offset = x - (synfig::Real)index;
+	}
+
+public:
+	GradientLUT(): repeat(), size(), k() { }
+
+	//! Samples gradient, \a step is an expected minimal difference
+	//! of gradient position between neighbour pixels,
+	//! count of samples chooses from it
+	void set(const synfig::CompiledGradient &gradient, synfig::Real step = 0.0);
+
+	bool empty() const { return size <= 0; }
+
+	inline Accumulator summary(synfig::Real x) const {
+		if (repeat) {
+			synfig::Real count = floor(x);
+			return summary_color*count + summary_clamped(x - count);
+		}
+		if (x <= 0.0) return sums.front() + colors.front()*x;
+		if (x >= 1.0) return sums.back() + colors.back()*(x - 1.0);
+		return summary_clamped(x);
+	}
+
+	inline Accumulator summary_clamped(synfig::Real x) const {
+		int i; synfig::Real o;
+		locate(x, i, o);
+		return sums[i] + (sums[i+1] - sums[i])*o;
+	}
+
+	inline synfig::Color color(synfig::Real x) const {
+		x = repeat ? x - floor(x) : std::max(0.0, std::min(1.0, x));
+		int i; synfig::Real o;
+		locate(x, i, o);
+		return (colors[i] + (colors[i+1] - colors[i])*o).color();
+	}
+
+	inline synfig::Color average(synfig::Real x0, synfig::Real x1) const {
+		synfig::Real w = x1 - x0;
+		if (std::isnan(w) || std::isinf(w)) return average_color;
+		if (fabs(w)*k < 0.5) return color(0.5*(x0 + x1));
+		return ((summary(x1) - summary(x0))/w).color();
+	}
+};
+
+
+//! \class TaskGradientSW
+//! \brief Common base for software implementations of gradient tasks.
+//!        Renders gradient by rows, large areas splits to bands
+//!        which renders simultaneously by ThreadPool.
+class TaskGradientSW: public synfig::rendering::TaskSW,
+	public synfig::rendering::TaskInterfaceBlendToTarget,
+	public synfig::rendering::TaskInterfaceSplit
+{
+private:
+	struct Rows;
+	void fill_rows(const Rows *rows, int begin, int end) const;
+
+protected:
+	//! Compiled gradient used to build lookup table
+	virtual const synfig::CompiledGradient& get_compiled_gradient() const = 0;
+
+	//! Minimal difference of gradient position between neighbour pixels,
+	//! \a pw is a size of pixel in layer units
+	virtual synfig::Real get_gradient_step(synfig::Real pw) const = 0;
+
+	//! Calculates colors for \a count pixels of row,
+	//! \a p is a position of first pixel in layer units,
+	//! \a dx is a difference of positions of neighbour pixels
+	//! and \a pw is a size of pixel in layer units
+	virtual void fill_row(
+		const GradientLUT &lut,
+		synfig::Color *row,
+		int count,
+		synfig::Vector p,
+		const synfig::Vector &dx,
+		synfig::Real pw ) const = 0;
+
+	//! Renders gradient into target of task, \a matrix transforms from
+	//! gradient (layer) coordinates into task source coordinates
+	bool run_gradient(const synfig::Matrix &matrix) const;
+
+public:
+	virtual void on_target_set_as_source();
+	virtual synfig::Color::BlendMethodFlags get_supported_blend_methods() const
+		{ return synfig::Color::BLEND_METHODS_ALL; }
+};
+
+/* === E N D =============================================================== */
+
+#endif
@@ -46,6 +46,10 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+
+#include "gradienttask.h"
+
 #endif
 
 /* === M A C R O S ========================================================= */
@@ -61,6 +65,72 @@ SYNFIG_LAYER_SET_CVS_ID(LinearGradient,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class TaskLinearGradient: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskLinearGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	Point p1;
+	Point p2;
+	CompiledGradient gradient;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual const rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+
+	virtual bool hash_params(rendering::TaskHash &hash) const {
+		hash.add(p1);
+		hash.add(p2);
+		hash_compiled_gradient(hash, gradient);
+		hash.add(transformation->matrix.m);
+		return true;
+	}
+};
+
+
+class TaskLinearGradientSW: public TaskLinearGradient, public TaskGradientSW
+{
+public:
+	typedef etl::handle<TaskLinearGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+protected:
+	virtual const CompiledGradient& get_compiled_gradient() const
+		{ return gradient; }
+
+	virtual Real get_gradient_step(Real pw) const
+		{ return pw/(p2 - p1).mag(); }
+
+	virtual void fill_row(const GradientLUT &lut, Color *row, int count, Vector p, const Vector &dx, Real pw) const {
+		Vector diff = p2 - p1;
+		Real mag_squared = diff.mag_squared();
+		if (mag_squared > 0.0) diff /= mag_squared;
+
+		Real supersample = 0.5*get_gradient_step(pw);
+		Real dist = (p - p1)*diff;
+		Real dd = dx*diff;
+		for(Color *end = row + count; row != end; ++row, dist += dd)
+			*row = lut.average(dist - supersample, dist + supersample);
+	}
+
+public:
+	virtual bool run(RunParams&) const
+		{ return run_gradient(transformation->matrix); }
+};
+
+
+rendering::Task::Token TaskLinearGradient::token(
+	DescAbstract<TaskLinearGradient>("LinearGradient") );
+rendering::Task::Token TaskLinearGradientSW::token(
+	DescReal<TaskLinearGradientSW, TaskLinearGradient>("LinearGradientSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 inline void
@@ -269,6 +339,20 @@ LinearGradient::accelerated_render(Context context,Surface *surface,int quality,
 	return true;
 }
 
+rendering::Task::Handle
+LinearGradient::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	Params params;
+	fill_params(params);
+
+	TaskLinearGradient::Handle task(new TaskLinearGradient());
+	task->p1 = params.p1;
+	task->p2 = params.p2;
+	task->gradient = params.gradient;
+
+	return task;
+}
+
 
 bool
 LinearGradient::accelerated_cairorender(Context context, cairo_t *cr, int quality, const RendDesc &renddesc, ProgressCallback *cb)const
@@ -43,7 +43,10 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+
 #include "radialgradient.h"
+#include "gradienttask.h"
 
 #endif
 
@@ -64,6 +67,69 @@ SYNFIG_LAYER_SET_CVS_ID(RadialGradient,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class TaskRadialGradient: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskRadialGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	Point center;
+	Real radius;
+	CompiledGradient gradient;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual const rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+
+	virtual bool hash_params(rendering::TaskHash &hash) const {
+		hash.add(center);
+		hash.add(radius);
+		hash_compiled_gradient(hash, gradient);
+		hash.add(transformation->matrix.m);
+		return true;
+	}
+};
+
+
+class TaskRadialGradientSW: public TaskRadialGradient, public TaskGradientSW
+{
+public:
+	typedef etl::handle<TaskRadialGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+protected:
+	virtual const CompiledGradient& get_compiled_gradient() const
+		{ return gradient; }
+
+	virtual Real get_gradient_step(Real pw) const
+		{ return 1.2*pw/radius; }
+
+	virtual void fill_row(const GradientLUT &lut, Color *row, int count, Vector p, const Vector &dx, Real pw) const {
+		Real supersample = 0.5*get_gradient_step(pw);
+		Real k = 1.0/radius;
+		for(Color *end = row + count; row != end; ++row, p += dx) {
+			Real dist = (p - center).mag()*k;
+			*row = lut.average(dist - supersample, dist + supersample);
+		}
+	}
+
+public:
+	virtual bool run(RunParams&) const
+		{ return run_gradient(transformation->matrix); }
+};
+
+
+rendering::Task::Token TaskRadialGradient::token(
+	DescAbstract<TaskRadialGradient>("RadialGradient") );
+rendering::Task::Token TaskRadialGradientSW::token(
+	DescReal<TaskRadialGradientSW, TaskRadialGradient>("RadialGradientSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -245,6 +311,20 @@ RadialGradient::accelerated_render(Context context,Surface *surface,int quality,
 }
 
 
+rendering::Task::Handle
+RadialGradient::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	Point center = param_center.get(Point());
+	Real radius = param_radius.get(Real());
+
+	TaskRadialGradient::Handle task(new TaskRadialGradient());
+	task->center = center;
+	task->radius = radius;
+	task->gradient = compiled_gradient;
+
+	return task;
+}
+
 bool
 RadialGradient::accelerated_cairorender(Context context,cairo_t *cr, int quality, const RendDesc &renddesc, ProgressCallback *cb)const
 {
@@ -43,7 +43,10 @@
 #include <synfig/valuenode.h>
 #include <synfig/cairo_renddesc.h>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+
 #include "spiralgradient.h"
+#include "gradienttask.h"
 
 #endif
 
@@ -64,6 +67,81 @@ SYNFIG_LAYER_SET_CVS_ID(SpiralGradient,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class TaskSpiralGradient: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskSpiralGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	Point center;
+	Real radius;
+	Real angle; // in rotations
+	bool clockwise;
+	CompiledGradient gradient;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual const rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+
+	virtual bool hash_params(rendering::TaskHash &hash) const {
+		hash.add(center);
+		hash.add(radius);
+		hash.add(angle);
+		hash.add(clockwise);
+		hash_compiled_gradient(hash, gradient);
+		hash.add(transformation->matrix.m);
+		return true;
+	}
+};
+
+
+class TaskSpiralGradientSW: public TaskSpiralGradient, public TaskGradientSW
+{
+public:
+	typedef etl::handle<TaskSpiralGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+protected:
+	virtual const CompiledGradient& get_compiled_gradient() const
+		{ return gradient; }
+
+	virtual Real get_gradient_step(Real pw) const
+		{ return 0.5*1.41421*pw/radius; }
+
+	virtual void fill_row(const GradientLUT &lut, Color *row, int count, Vector p, const Vector &dx, Real pw) const {
+		const Real k = 1.0/(2.0*PI);
+		const Real kr = 1.0/radius;
+		const Real ss = get_gradient_step(pw);
+		for(Color *end = row + count; row != end; ++row, p += dx) {
+			const Point centered(p - center);
+			const Real mag = centered.mag();
+			Real supersample = 0.5*std::max(0.00001, ss + 0.5*1.41421*k*pw/mag);
+
+			Real a = atan2(-centered[1], centered[0])*k + angle;
+			a -= floor(a);
+			Real dist = mag*kr;
+			if (clockwise) dist += a; else dist -= a;
+			*row = lut.average(dist - supersample, dist + supersample);
+		}
+	}
+
+public:
+	virtual bool run(RunParams&) const
+		{ return run_gradient(transformation->matrix); }
+};
+
+
+rendering::Task::Token TaskSpiralGradient::token(
+	DescAbstract<TaskSpiralGradient>("SpiralGradient") );
+rendering::Task::Token TaskSpiralGradientSW::token(
+	DescReal<TaskSpiralGradientSW, TaskSpiralGradient>("SpiralGradientSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -253,6 +331,24 @@ SpiralGradient::accelerated_render(Context context,Surface *surface,int quality,
 	return true;
 }
 
+rendering::Task::Handle
+SpiralGradient::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	Point center = param_center.get(Point());
+	Real radius = param_radius.get(Real());
+	Angle angle = param_angle.get(Angle());
+	bool clockwise = param_clockwise.get(bool());
+
+	TaskSpiralGradient::Handle task(new TaskSpiralGradient());
+	task->center = center;
+	task->radius = radius;
+	task->angle = Angle::rot(angle).get();
+	task->clockwise = clockwise;
+	task->gradient = compiled_gradient;
+
+	return task;
+}
+
 ////
 bool
 SpiralGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality, const RendDesc &renddesc_, ProgressCallback *cb)const
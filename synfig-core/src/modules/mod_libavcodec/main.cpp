@@ -35,7 +35,7 @@
 #include <synfig/module.h>
 #include <synfig/layer.h>
 
-//#include "mptr.h"
+#include "mptr.h"
 #include "trgt_av.h"
 
 #endif
@@ -64,6 +64,11 @@ MODULE_INVENTORY_BEGIN(mod_libavcodec)
 		//TARGET_EXT(Target_LibAVCodec,"dv")
 	END_TARGETS
 	BEGIN_IMPORTERS
-//		IMPORTER(bmp_mptr)
+		// avi, mp4, mpg, mpeg and mov are claimed by mod_ffmpeg
+		IMPORTER_EXT(Importer_LibAVCodec,"mkv")
+		IMPORTER_EXT(Importer_LibAVCodec,"webm")
+		IMPORTER_EXT(Importer_LibAVCodec,"ogv")
+		IMPORTER_EXT(Importer_LibAVCodec,"flv")
+		IMPORTER_EXT(Importer_LibAVCodec,"wmv")
 	END_IMPORTERS
 MODULE_INVENTORY_END
@@ -6,6 +6,7 @@
 **
 **	\legal
 **	Copyright (c) 2002-2005 Robert B. Quattlebaum Jr., Adrian Bentley
+**	......... ... 2026 agent
 **
 **	This package is free software; you can redistribute it and/or
 **	modify it under the terms of the GNU General Public License as
@@ -29,15 +30,64 @@
 #	include <config.h>
 #endif
 
-#include "mptr.h"
-#include <synfig/general.h>
-#include <synfig/localization.h>
-#include <synfig/surface.h>
+// ffmpeg library headers have historically had multiple locations.
+// We should check all of the locations to be more portable.
 
-#include <algorithm>
-#include <functional>
+extern "C"
+{
+#ifdef HAVE_LIBAVFORMAT_AVFORMAT_H
+#	include <libavformat/avformat.h>
+#elif defined(HAVE_AVFORMAT_H)
+#	include <avformat.h>
+#elif defined(HAVE_FFMPEG_AVFORMAT_H)
+#	include <ffmpeg/avformat.h>
+#else
+#   ifndef DISABLE_MODULE
+#   define DISABLE_MODULE
+#   endif
+#endif
+
+#ifndef DISABLE_MODULE
+#	include <libavutil/pixdesc.h>
+#endif
+
+#ifdef HAVE_LIBSWSCALE_SWSCALE_H
+#	include <libswscale/swscale.h>
+#elif defined(HAVE_SWSCALE_H)
+#	include <swscale.h>
+#elif defined(HAVE_FFMPEG_SWSCALE_H)
+#	include <ffmpeg/swscale.h>
+#else
+#   ifndef DISABLE_MODULE
+#   define DISABLE_MODULE
+#   endif
+#endif
+} // extern "C"
+
+#ifndef DISABLE_MODULE
+#	include <climits>
+#	include <cmath>
+#	include <algorithm>
+#	include <mutex>
+#	include <vector>
+#	include <sigc++/bind.h>
+#	include <synfig/general.h>
+#	include <synfig/localization.h>
+#	include <synfig/surface.h>
+#	include <synfig/threadpool.h>
+#	include <synfig/rendering/software/surfacesw.h>
+#	include "mptr.h"
 #endif
 
+#endif
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+#	define MPTR_SSE2
+#	include <emmintrin.h>
+#endif
+
+#ifndef DISABLE_MODULE
+
 /* === U S I N G =========================================================== */
 
 using namespace synfig;
@@ -48,26 +98,562 @@ using namespace etl;
 
 SYNFIG_IMPORTER_INIT(Importer_LibAVCodec);
 SYNFIG_IMPORTER_SET_NAME(Importer_LibAVCodec,"libav");
-SYNFIG_IMPORTER_SET_EXT(Importer_LibAVCodec,"avi");
-SYNFIG_IMPORTER_SET_VERSION(Importer_LibAVCodec,"0.1");
+SYNFIG_IMPORTER_SET_EXT(Importer_LibAVCodec,"mkv");
+SYNFIG_IMPORTER_SET_VERSION(Importer_LibAVCodec,"0.2");
 SYNFIG_IMPORTER_SET_CVS_ID(Importer_LibAVCodec,"$Id$");
 SYNFIG_IMPORTER_SET_SUPPORTS_FILE_SYSTEM_WRAPPER(Importer_LibAVCodec, false);
 
+namespace {
+	// count of last decoded frames to keep, so neighbour frames requested
+	// by simultaneous rendering of several frames will not cause seeking
+	const int ring_size = 12;
 
-/* === M E T H O D S ======================================================= */
+	// count of frames to decode in background after the requested one,
+	// it should be less than ring_size
+	const int decode_ahead = 4;
 
+	// decode forward instead of seeking when requested frame is closer
+	// than this count of seconds to the last decoded frame
+	const Real max_skip_seconds = 2.0;
 
-Importer_LibAVCodec::Importer_LibAVCodec(const synfig::FileSystem::Identifier &identifier):
-	Importer(identifier)
-{
+	// minimal count of pixels to convert in separate thread
+	const int band_pixels = 65536;
+
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+	std::once_flag av_registered;
+#endif
 }
 
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+//! Decoding runs in separate thread owned by Internal.
+//! The thread decodes frames up to the last requested one
+//! plus \a decode_ahead frames and puts them into the ring.
+//! Ring, positions and requests are guarded by \a mutex,
+//! libav contexts are used by the decoding thread only.
+class Importer_LibAVCodec::Internal
+{
+private:
+	//! Decoded and converted frame, it shows while frames
+	//! with index from \a first to \a last are requested.
+	//! \a last is unknown until the next frame will be decoded,
+	//! so the frame rate of the video may be variable.
+	struct Frame {
+		int64_t first;
+		int64_t last;
+		rendering::SurfaceSW::Handle surface;
+		Frame(): first(-1), last(-1) { }
+		bool contains(int64_t index) const
+			{ return surface && first <= index && index <= last; }
+	};
+
+	struct Rows {
+		const AVFrame *frame;
+		synfig::Surface *surface;
+		Rows(): frame(), surface() { }
+	};
+
+	AVFormatContext *context;
+	AVStream *video_stream;
+	AVCodecContext *video_context;
+	AVPacket *packet;
+	AVFrame *video_frame;
+	AVFrame *video_frame_rgba;
+	SwsContext *video_swscale_context;
+	bool failed;
+
+	Real fps;
+	int64_t start_pts;
+
+	const Gamma *gamma;
+	bool linear;
+	//! gamma tables for 8-bit sources, small enough to stay in cache
+	ColorReal table_U8_to_F32[4][256];
+
+	Glib::Threads::Thread *thread;
+	Glib::Threads::Mutex mutex;
+	Glib::Threads::Cond cond;
+
+	// fields below are guarded by mutex
+	bool stopped;
+	bool eof;
+	int64_t last_index;
+	int64_t requested;
+	int64_t seek_index;
+	bool seek_pending;
+	int generation;
+
+	std::vector<Frame> ring;
+	int ring_next;
+	int ring_prev;
+
+	int64_t pts_to_index(int64_t pts, int64_t prev_index) const {
+		if (pts == AV_NOPTS_VALUE) return prev_index + 1;
+		Real time = (Real)(pts - start_pts)*av_q2d(video_stream->time_base);
+		return (int64_t)floor(time*fps + 0.5);
+	}
+
+	int64_t index_to_pts(int64_t index) const
+		{ return start_pts + (int64_t)floor((Real)index/fps/av_q2d(video_stream->time_base)); }
+
+	const Frame* find(int64_t index) const {
+		for(std::vector<Frame>::const_iterator i = ring.begin(); i != ring.end(); ++i)
+			if (i->contains(index)) return &*i;
+		return NULL;
+	}
+
+	const Frame* find_nearest(int64_t index) const {
+		const Frame *frame = NULL;
+		for(std::vector<Frame>::const_iterator i = ring.begin(); i != ring.end(); ++i)
+			if ( i->surface
+			  && ( !frame
+				|| (i->first <= index && (frame->first > index || frame->first < i->first))
+				|| (i->first > index && frame->first > index && i->first < frame->first) ))
+					frame = &*i;
+		return frame;
+	}
+
+	void convert_rows_8(const Rows *rows, int begin, int end) const {
+		int w = rows->frame->width;
+		for(int y = begin; y < end; ++y) {
+			const uint8_t *src = rows->frame->data[0] + y*rows->frame->linesize[0];
+			Color *dst = (*rows->surface)[y];
+			for(Color *dst_end = dst + w; dst != dst_end; ++dst, src += 4)
+				*dst = Color(
+					table_U8_to_F32[0][src[0]],
+					table_U8_to_F32[1][src[1]],
+					table_U8_to_F32[2][src[2]],
+					table_U8_to_F32[3][src[3]] );
+		}
+	}
+
+	void convert_rows_16(const Rows *rows, int begin, int end) const {
+		// the same constant as used to build the gamma tables,
+		// so linear conversion gives exactly the same result
+		const ColorReal k = 1.f/65535.f;
+		int w = rows->frame->width;
+		for(int y = begin; y < end; ++y) {
+			const uint16_t *src = (const uint16_t*)(rows->frame->data[0] + y*rows->frame->linesize[0]);
+			Color *dst = (*rows->surface)[y];
+			Color *dst_end = dst + w;
+			if (linear) {
+#ifdef MPTR_SSE2
+				const __m128 kk = _mm_set1_ps(k);
+				const __m128i zero = _mm_setzero_si128();
+				for(; dst + 2 <= dst_end; dst += 2, src += 8) {
+					__m128i s = _mm_loadu_si128((const __m128i*)src);
+					_mm_storeu_ps((float*)dst,     _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(s, zero)), kk));
+					_mm_storeu_ps((float*)(dst+1), _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(s, zero)), kk));
+				}
+#endif
+				for(; dst != dst_end; ++dst, src += 4)
+					*dst = Color((ColorReal)src[0]*k, (ColorReal)src[1]*k, (ColorReal)src[2]*k, (ColorReal)src[3]*k);
+			} else {
+				for(; dst != dst_end; ++dst, src += 4)
+					*dst = Color(
+						gamma->r_U16_to_F32(src[0]),
+						gamma->g_U16_to_F32(src[1]),
+						gamma->b_U16_to_F32(src[2]),
+						(ColorReal)src[3]*k );
+			}
+		}
+	}
+
+	void convert_rows(const Rows *rows, int begin, int end) const {
+		if (rows->frame->format == AV_PIX_FMT_RGBA)
+			convert_rows_8(rows, begin, end);
+		else
+			convert_rows_16(rows, begin, end);
+	}
+
+	rendering::SurfaceSW::Handle convert() {
+		int w = video_frame->width;
+		int h = video_frame->height;
+		if (w <= 0 || h <= 0)
+			return rendering::SurfaceSW::Handle();
+
+		// swscale has optimized converters from the most of YUV formats,
+		// so let it convert into RGBA of the same depth and then just apply gamma tables
+		AVPixelFormat format = AV_PIX_FMT_RGBA64;
+		if (const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat)video_frame->format))
+			if (desc->comp[0].depth <= 8)
+				format = AV_PIX_FMT_RGBA;
+
+		video_swscale_context = sws_getCachedContext(
+			video_swscale_context,
+			w, h, (AVPixelFormat)video_frame->format,
+			w, h, format,
+			SWS_BICUBIC, NULL, NULL, NULL );
+		if (!video_swscale_context) {
+			synfig::error("Importer_LibAVCodec: cannot initialize the conversion context");
+			return rendering::SurfaceSW::Handle();
+		}
+
+		if ( video_frame_rgba
+		  && ( video_frame_rgba->width != w
+			|| video_frame_rgba->height != h
+			|| video_frame_rgba->format != format ))
+			av_frame_free(&video_frame_rgba);
+		if (!video_frame_rgba) {
+			video_frame_rgba = av_frame_alloc();
+			assert(video_frame_rgba);
+			video_frame_rgba->format = format;
+			video_frame_rgba->width  = w;
+			video_frame_rgba->height = h;
+			if (av_frame_get_buffer(video_frame_rgba, 32) < 0) {
+				synfig::error("Importer_LibAVCodec: could not allocate the temporary video frame data");
+				av_frame_free(&video_frame_rgba);
+				return rendering::SurfaceSW::Handle();
+			}
+		}
+
+		sws_scale(
+			video_swscale_context,
+			(const uint8_t * const *)video_frame->data,
+			video_frame->linesize,
+			0,
+			h,
+			video_frame_rgba->data,
+			video_frame_rgba->linesize );
+
+		synfig::Surface *surface = new synfig::Surface(w, h);
+
+		Rows rows;
+		rows.frame = video_frame_rgba;
+		rows.surface = surface;
+
+		int band = std::max(1, band_pixels/w);
+		if (band >= h) {
+			convert_rows(&rows, 0, h);
+		} else {
+			ThreadPool::Group group;
+			for(int y = 0; y < h; y += band)
+				group.enqueue( sigc::bind( sigc::mem_fun(this, &Internal::convert_rows),
+					&rows, y, std::min(y + band, h) ));
+			group.run();
+		}
+
+		return new rendering::SurfaceSW(*surface, true);
+	}
+
+	//! Receives next frame from decoder into \a video_frame,
+	//! should be called without lock
+	int decode() {
+		while(true) {
+			int res = avcodec_receive_frame(video_context, video_frame);
+			if (res != AVERROR(EAGAIN))
+				return res;
+
+			// decoder wants more data
+			res = av_read_frame(context, packet);
+			if (res < 0) {
+				// end of file, flush the decoder
+				avcodec_send_packet(video_context, NULL);
+				continue;
+			}
+			if (packet->stream_index == video_stream->index)
+				if (avcodec_send_packet(video_context, packet) < 0)
+					synfig::warning("Importer_LibAVCodec: error while sending a packet for decoding");
+			av_packet_unref(packet);
+		}
+	}
+
+	//! Main loop of the decoding thread
+	void process() {
+		Glib::Threads::Mutex::Lock lock(mutex);
+		while(!stopped) {
+			if (seek_pending) {
+				seek_pending = false;
+				if (av_seek_frame(context, video_stream->index, index_to_pts(seek_index), AVSEEK_FLAG_BACKWARD) < 0)
+					synfig::warning("Importer_LibAVCodec: seeking failed");
+				avcodec_flush_buffers(video_context);
+				continue;
+			}
+
+			if (eof || requested < 0 || last_index >= requested + decode_ahead) {
+				cond.wait(mutex);
+				continue;
+			}
+
+			// frames with index less than min_index are not converted and not stored
+			int64_t min_index = requested - (ring_size - decode_ahead) + 1;
+			int64_t prev_index = last_index;
+			int current_generation = generation;
+
+			lock.release();
+			rendering::SurfaceSW::Handle surface;
+			int64_t index = -1;
+			int res = decode();
+			if (res == 0) {
+				index = std::max(prev_index + 1, pts_to_index(video_frame->best_effort_timestamp, prev_index));
+				if (index >= min_index)
+					surface = convert();
+				av_frame_unref(video_frame);
+			} else
+			if (res != AVERROR_EOF) {
+				synfig::error("Importer_LibAVCodec: error during decoding");
+			}
+			lock.acquire();
+
+			// drop the result if seeking was requested while decoding
+			if (generation != current_generation)
+				continue;
+
+			if (res != 0) {
+				// the last frame shows until the end
+				if (ring_prev >= 0) ring[ring_prev].last = LLONG_MAX;
+				eof = true;
+			} else {
+				if (ring_prev >= 0) ring[ring_prev].last = index - 1;
+				last_index = index;
+				ring_prev = -1;
+				if (surface) {
+					Frame &frame = ring[ring_next];
+					frame.first = frame.last = index;
+					frame.surface = surface;
+					ring_prev = ring_next;
+					ring_next = (ring_next + 1)%(int)ring.size();
+				}
+			}
+			cond.broadcast();
+		}
+	}
+
+	//! Requests seeking from the decoding thread, should be called under lock
+	void seek(int64_t index) {
+		seek_index = index;
+		seek_pending = true;
+		++generation;
+		eof = false;
+		last_index = -1;
+		ring_prev = -1;
+	}
+
+public:
+	Internal():
+		context(),
+		video_stream(),
+		video_context(),
+		packet(),
+		video_frame(),
+		video_frame_rgba(),
+		video_swscale_context(),
+		failed(),
+		fps(),
+		start_pts(),
+		gamma(),
+		linear(),
+		table_U8_to_F32(),
+		thread(),
+		stopped(),
+		eof(),
+		last_index(-1),
+		requested(-1),
+		seek_index(),
+		seek_pending(),
+		generation(),
+		ring_next(),
+		ring_prev(-1)
+	{ }
+	~Internal() { close(); }
+
+	bool is_opened() const { return context && video_context; }
+	bool is_failed() const { return failed; }
+
+	bool open(const String &filename, const Gamma &gamma) {
+		close();
+		failed = true;
+
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+		std::call_once(av_registered, av_register_all);
+#endif
+
+		if (avformat_open_input(&context, filename.c_str(), NULL, NULL) < 0) {
+			synfig::error("Importer_LibAVCodec: could not open file: %s", filename.c_str());
+			context = NULL;
+			close();
+			return false;
+		}
+
+		if (avformat_find_stream_info(context, NULL) < 0) {
+			synfig::error("Importer_LibAVCodec: could not find stream information: %s", filename.c_str());
+			close();
+			return false;
+		}
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+		const AVCodec *codec = NULL;
+#else
+		AVCodec *codec = NULL;
+#endif
+		int index = av_find_best_stream(context, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+		if (index < 0 || !codec) {
+			synfig::error("Importer_LibAVCodec: video stream or decoder not found: %s", filename.c_str());
+			close();
+			return false;
+		}
+		video_stream = context->streams[index];
+
+		video_context = avcodec_alloc_context3(codec);
+		if (!video_context) {
+			synfig::error("Importer_LibAVCodec: could not allocate a decoding video context");
+			close();
+			return false;
+		}
+		if (avcodec_parameters_to_context(video_context, video_stream->codecpar) < 0) {
+			synfig::error("Importer_LibAVCodec: could not copy the video stream parameters");
+			close();
+			return false;
+		}
+		video_context->thread_count = 0; // choose count of threads automatically
+		if (avcodec_open2(video_context, codec, NULL) < 0) {
+			synfig::error("Importer_LibAVCodec: could not open video codec");
+			close();
+			return false;
+		}
+
+		packet = av_packet_alloc();
+		assert(packet);
+		video_frame = av_frame_alloc();
+		assert(video_frame);
+
+		AVRational rate = av_guess_frame_rate(context, video_stream, NULL);
+		fps = rate.num > 0 && rate.den > 0 ? av_q2d(rate) : 24.0;
+		start_pts = video_stream->start_time != AV_NOPTS_VALUE ? video_stream->start_time : 0;
+
+		this->gamma = &gamma;
+		linear = gamma.get_gamma_r() == 1.f
+			  && gamma.get_gamma_g() == 1.f
+			  && gamma.get_gamma_b() == 1.f;
+		for(int i = 0; i < 256; ++i) {
+			for(int channel = 0; channel < 3; ++channel)
+				table_U8_to_F32[channel][i] = gamma.U16_to_F32(channel, (unsigned short)(i*257));
+			table_U8_to_F32[3][i] = (ColorReal)i*(1.f/255.f);
+		}
+
+		stopped = false;
+		eof = false;
+		last_index = -1;
+		requested = -1;
+		seek_pending = false;
+		ring.clear();
+		ring.resize(ring_size);
+		ring_next = 0;
+		ring_prev = -1;
+
+		thread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &Internal::process));
+
+		failed = false;
+		return true;
+	}
+
+	rendering::SurfaceSW::Handle get_frame(const Time &time) {
+		assert(is_opened());
+		if (!is_opened()) return rendering::SurfaceSW::Handle();
+
+		int64_t index = std::max((int64_t)0, (int64_t)floor((Real)time*fps + 1e-6));
+
+		Glib::Threads::Mutex::Lock lock(mutex);
+		requested = index;
+		cond.broadcast();
+
+		if (const Frame *frame = find(index))
+			return frame->surface;
+
+		// seek only when requested frame is out of the sequential decoding
+		int64_t position = last_index >= 0 ? last_index
+		                 : seek_index > 0  ? seek_index - 1 : -1;
+		if ( (last_index >= 0 && index <= last_index)
+		  || (last_index < 0 && index <= position)
+		  || (Real)(index - position) > max_skip_seconds*fps )
+		{
+			seek(index);
+			cond.broadcast();
+		}
+
+		while(true) {
+			if (const Frame *frame = find(index))
+				return frame->surface;
+			if (stopped || (!seek_pending && (eof || last_index >= index)))
+				break;
+			cond.wait(mutex);
+		}
+
+		if (const Frame *frame = find_nearest(index))
+			return frame->surface;
+		return rendering::SurfaceSW::Handle();
+	}
+
+	void close() {
+		if (thread) {
+			{
+				Glib::Threads::Mutex::Lock lock(mutex);
+				stopped = true;
+				cond.broadcast();
+			}
+			thread->join();
+			thread = NULL;
+		}
+
+		if (video_context) avcodec_free_context(&video_context);
+		if (video_swscale_context) {
+			sws_freeContext(video_swscale_context);
+			video_swscale_context = NULL;
+		}
+		if (video_frame) av_frame_free(&video_frame);
+		if (video_frame_rgba) av_frame_free(&video_frame_rgba);
+		if (packet) av_packet_free(&packet);
+		if (context) avformat_close_input(&context);
+		video_stream = NULL;
+		gamma = NULL;
+		ring.clear();
+		ring_next = 0;
+		ring_prev = -1;
+		last_index = -1;
+		requested = -1;
+		seek_index = 0;
+		seek_pending = false;
+		eof = false;
+	}
+};
+
+/* === M E T H O D S ======================================================= */
+
+Importer_LibAVCodec::Importer_LibAVCodec(const synfig::FileSystem::Identifier &identifier):
+	Importer(identifier),
+	internal(new Internal())
+{ }
+
 Importer_LibAVCodec::~Importer_LibAVCodec()
+	{ delete internal; }
+
+rendering::Surface::Handle
+Importer_LibAVCodec::get_frame(const RendDesc &/*renddesc*/, const Time &time)
 {
+	Glib::Threads::Mutex::Lock lock(mutex);
+
+	if (!internal->is_opened() && !internal->is_failed())
+		internal->open(identifier.filename, gamma());
+
+	rendering::Surface::Handle surface;
+	if (internal->is_opened())
+		surface = internal->get_frame(time);
+	if (!surface) {
+		synfig::warning("Importer_LibAVCodec: unable to get frame from \"%s\"", identifier.filename.c_str());
+		surface = new rendering::SurfaceSW();
+	}
+	return surface;
 }
 
 bool
-Importer_LibAVCodec::get_frame(Surface &/*surface*/, const RendDesc &/*renddesc*/, Time /*time*/, ProgressCallback */*callback*/)
+Importer_LibAVCodec::get_frame(Surface &surface, const RendDesc &renddesc, Time time, ProgressCallback */*callback*/)
 {
-	return false;
+	rendering::SurfaceSW::Handle frame =
+		rendering::SurfaceSW::Handle::cast_dynamic( get_frame(renddesc, time) );
+	if (!frame || !frame->is_exists())
+		return false;
+	surface = frame->get_surface();
+	return true;
 }
+
+#endif
@@ -6,6 +6,7 @@
 **
 **	\legal
 **	Copyright (c) 2002-2005 Robert B. Quattlebaum Jr., Adrian Bentley
+**	......... ... 2026 agent
 **
 **	This package is free software; you can redistribute it and/or
 **	modify it under the terms of the GNU General Public License as
@@ -27,6 +28,8 @@
 
 /* === H E A D E R S ======================================================= */
 
+#include <glibmm/threads.h>
+
 #include <synfig/importer.h>
 #include <synfig/string.h>
 #include <synfig/time.h>
@@ -38,18 +41,29 @@
 
 /* === C L A S S E S & S T R U C T S ======================================= */
 
+//! \class Importer_LibAVCodec
+//! \brief Imports video files through libavformat/libavcodec.
+//!        Decoder stays opened between calls, frames decodes sequentially
+//!        in background thread a few frames ahead of the requested one,
+//!        seeking performs only when requested frame is far from
+//!        the current position of decoder.
 class Importer_LibAVCodec : public synfig::Importer
 {
 SYNFIG_IMPORTER_MODULE_EXT
 
 private:
-	synfig::String filename;
+	class Internal;
+	Internal *internal;
+	Glib::Threads::Mutex mutex;
 
 public:
-	Importer_LibAVCodec(const synfig::FileSystem::Identifier &identifier); 
+	Importer_LibAVCodec(const synfig::FileSystem::Identifier &identifier);
 	~Importer_LibAVCodec();
 
+	virtual bool is_animated() { return true; }
+
 	virtual bool get_frame(synfig::Surface &surface, const synfig::RendDesc &renddesc, synfig::Time time, synfig::ProgressCallback *callback);
+	virtual synfig::rendering::Surface::Handle get_frame(const synfig::RendDesc &renddesc, const synfig::Time &time);
 };
 
 /* === E N D =============================================================== */
@@ -44,6 +44,7 @@
 #include <synfig/surface.h>
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
+#include <synfig/rendering/common/task/taskdistort.h>
 #include <time.h>
 
 #endif
@@ -65,41 +66,22 @@ SYNFIG_LAYER_SET_CVS_ID(NoiseDistort,"$Id$");
 
 /* === P R O C E D U R E S ================================================= */
 
-/* === M E T H O D S ======================================================= */
+namespace {
 
-NoiseDistort::NoiseDistort():
-	Layer_CompositeFork(1.0,Color::BLEND_STRAIGHT),
-	param_displacement(ValueBase(Vector(0.25,0.25))),
-	param_size(ValueBase(Vector(1,1))),
-	param_random(ValueBase(int(time(NULL)))),
-	param_smooth(ValueBase(int(RandomNoise::SMOOTH_COSINE))),
-	param_detail(ValueBase(int(4))),
-	param_speed(ValueBase(Real(0))),
-	param_turbulent(bool(false))
+int
+smooth_type(int smooth, Real speed)
 {
-	SET_INTERPOLATION_DEFAULTS();
-	SET_STATIC_DEFAULTS();
+	return (!speed && smooth == (int)(RandomNoise::SMOOTH_SPLINE)) ? (int)(RandomNoise::SMOOTH_FAST_SPLINE) : smooth;
 }
 
-inline Point
-NoiseDistort::point_func(const Point &point)const
+Point
+noise_distort(const Point &point, const Vector &displacement, const Vector &size,
+	const RandomNoise &random, int smooth, int detail, Time time, bool turbulent)
 {
-	Vector displacement=param_displacement.get(Vector());
-	Vector size=param_size.get(Vector());
-	RandomNoise random;
-	random.set_seed(param_random.get(int()));
-	int smooth_=param_smooth.get(int());
-	int detail=param_detail.get(int());
-	Real speed=param_speed.get(Real());
-	bool turbulent=param_turbulent.get(bool());
-	
 	float x(point[0]/size[0]*(1<<detail));
 	float y(point[1]/size[1]*(1<<detail));
 	
 	int i;
-	Time time = speed*get_time_mark();
-	int temp_smooth(smooth_);
-	int smooth((!speed && temp_smooth == (int)(RandomNoise::SMOOTH_SPLINE)) ? (int)(RandomNoise::SMOOTH_FAST_SPLINE) : temp_smooth);
 	
 	Vector vect(0,0);
 	for(i=0;i<detail;i++)
@@ -134,6 +116,75 @@ NoiseDistort::point_func(const Point &point)const
 	return point+vect;
 }
 
+class NoiseDistortion: public rendering::Distortion
+{
+public:
+	Vector displacement;
+	Vector size;
+	RandomNoise random;
+	int smooth;
+	int detail;
+	Time time;
+	bool turbulent;
+
+	NoiseDistortion(): smooth(), detail(), turbulent() { }
+
+protected:
+	virtual Point map_vfunc(const Point &p) const
+		{ return noise_distort(p, displacement, size, random, smooth, detail, time, turbulent); }
+
+	// shift of point is never greater than half of displacement
+	virtual Rect calc_source_bounds_vfunc(const Rect &rect) const
+		{ return Rect(rect).expand_x(0.5*fabs(displacement[0])).expand_y(0.5*fabs(displacement[1])); }
+	virtual Rect calc_bounds_vfunc(const Rect &source_bounds) const
+		{ return Rect(source_bounds).expand_x(0.5*fabs(displacement[0])).expand_y(0.5*fabs(displacement[1])); }
+	virtual bool hash_params_vfunc(rendering::TaskHash &hash) const {
+		hash.add(displacement);
+		hash.add(size);
+		hash.add(random.get_seed());
+		hash.add(smooth);
+		hash.add(detail);
+		hash.add((Time::value_type)time);
+		hash.add(turbulent);
+		return true;
+	}
+};
+
+} // namespace
+
+/* === M E T H O D S ======================================================= */
+
+NoiseDistort::NoiseDistort():
+	Layer_CompositeFork(1.0,Color::BLEND_STRAIGHT),
+	param_displacement(ValueBase(Vector(0.25,0.25))),
+	param_size(ValueBase(Vector(1,1))),
+	param_random(ValueBase(int(time(NULL)))),
+	param_smooth(ValueBase(int(RandomNoise::SMOOTH_COSINE))),
+	param_detail(ValueBase(int(4))),
+	param_speed(ValueBase(Real(0))),
+	param_turbulent(bool(false))
+{
+	SET_INTERPOLATION_DEFAULTS();
+	SET_STATIC_DEFAULTS();
+}
+
+inline Point
+NoiseDistort::point_func(const Point &point)const
+{
+	RandomNoise random;
+	random.set_seed(param_random.get(int()));
+	Real speed=param_speed.get(Real());
+	return noise_distort(
+		point,
+		param_displacement.get(Vector()),
+		param_size.get(Vector()),
+		random,
+		smooth_type(param_smooth.get(int()), speed),
+		param_detail.get(int()),
+		speed*get_time_mark(),
+		param_turbulent.get(bool()) );
+}
+
 inline Color
 NoiseDistort::color_func(const Point &point, float /*supersample*/,Context context)const
 {
@@ -361,5 +412,21 @@ NoiseDistort::accelerated_render(Context context,Surface *surface,int quality, c
 */
 
 rendering::Task::Handle
-NoiseDistort::build_rendering_task_vfunc(Context context) const
-	{ return Layer::build_rendering_task_vfunc(context); }
+NoiseDistort::build_composite_fork_task_vfunc(ContextParams /* context_params */, rendering::Task::Handle sub_task)const
+{
+	etl::handle<NoiseDistortion> distortion(new NoiseDistortion());
+	distortion->displacement = param_displacement.get(Vector());
+	distortion->size = param_size.get(Vector());
+	distortion->random.set_seed(param_random.get(int()));
+	distortion->detail = param_detail.get(int());
+	Real speed = param_speed.get(Real());
+	distortion->smooth = smooth_type(param_smooth.get(int()), speed);
+	distortion->time = speed*get_time_mark();
+	distortion->turbulent = param_turbulent.get(bool());
+
+	rendering::TaskDistort::Handle task_distort(new rendering::TaskDistort());
+	task_distort->distortion = distortion;
+	task_distort->sub_task() = sub_task ? sub_task->clone_recursive() : rendering::Task::Handle();
+
+	return task_distort;
+}
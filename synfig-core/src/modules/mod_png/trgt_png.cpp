@@ -43,6 +43,7 @@
 #include <functional>
 #include <ETL/misc>
 #include <string.h>
+#include <vector>
 
 #endif
 
@@ -60,46 +61,170 @@ SYNFIG_TARGET_SET_EXT(png_trgt,"png");
 SYNFIG_TARGET_SET_VERSION(png_trgt,"0.1");
 SYNFIG_TARGET_SET_CVS_ID(png_trgt,"$Id$");
 
+/* === C L A S S E S ======================================================= */
+
+//! Completed frame with all data needed by encoder, so it may be written from another thread
+class png_trgt::Frame: public WriterQueue::Frame
+{
+public:
+	FILE *file;
+	String filename;
+	int w, h;
+	bool alpha;
+	float gamma;
+	int x_res, y_res;
+	String title;
+	String description;
+	int compression;
+	int filter;
+	std::vector<unsigned char> pixels;
+
+	Frame(): file(), w(), h(), alpha(), gamma(), x_res(), y_res(), compression(-1), filter(PNG_FILTER_NONE) { }
+	virtual ~Frame() { close(); }
+
+	int get_channels() const { return alpha ? 4 : 3; }
+
+	void close()
+	{
+		if (file && file != stdout) fclose(file);
+		if (file == stdout) fflush(stdout);
+		file = NULL;
+	}
+
+	virtual bool write();
+};
+
 /* === M E T H O D S ======================================================= */
 
 void
-png_trgt::png_out_error(png_struct *png_data,const char *msg)
+png_trgt::png_out_error(png_struct */*png_data*/,const char *msg)
 {
-	png_trgt *me=(png_trgt*)png_get_error_ptr(png_data);
+	// libpng will jump to setjmp point of Frame::write() after return
 	synfig::error(strprintf("png_trgt: error: %s",msg));
-	me->ready=false;
 }
 
 void
-png_trgt::png_out_warning(png_struct *png_data,const char *msg)
+png_trgt::png_out_warning(png_struct */*png_data*/,const char *msg)
 {
-	png_trgt *me=(png_trgt*)png_get_error_ptr(png_data);
 	synfig::warning(strprintf("png_trgt: warning: %s",msg));
-	me->ready=false;
+}
+
+bool
+png_trgt::Frame::write()
+{
+	if (!file) return false;
+
+	png_structp png_ptr=png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)this, png_out_error, png_out_warning);
+	if (!png_ptr)
+	{
+		synfig::error("Unable to setup PNG struct");
+		close();
+		return false;
+	}
+
+	png_infop info_ptr= png_create_info_struct(png_ptr);
+	if (!info_ptr)
+	{
+		synfig::error("Unable to setup PNG info struct");
+		png_destroy_write_struct(&png_ptr,(png_infopp)NULL);
+		close();
+		return false;
+	}
+
+	if (setjmp(png_jmpbuf(png_ptr)))
+	{
+		synfig::error("png_trgt: unable to write file: %s", filename.c_str());
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		close();
+		return false;
+	}
+
+	png_init_io(png_ptr,file);
+	png_set_filter(png_ptr,0,filter);
+	if (compression >= 0)
+		png_set_compression_level(png_ptr, compression);
+
+	if (alpha)
+		png_set_IHDR(png_ptr,info_ptr,w,h,8,PNG_COLOR_TYPE_RGBA,PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
+	else
+		png_set_IHDR(png_ptr,info_ptr,w,h,8,PNG_COLOR_TYPE_RGB,PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
+
+	// Write the gamma
+	png_set_gAMA(png_ptr, info_ptr, gamma);
+
+	// Write the physical size
+	png_set_pHYs(png_ptr,info_ptr,x_res,y_res,PNG_RESOLUTION_METER);
+
+	char title_key      [] = "Title";
+	char description_key[] = "Description";
+	char software_key   [] = "Software";
+	char synfig         [] = "SYNFIG";
+
+	// Output any text info along with the file
+	png_text comments[3];
+	memset(comments, 0, sizeof(comments));
+
+	comments[0].compression = PNG_TEXT_COMPRESSION_NONE;
+	comments[0].key         = title_key;
+	comments[0].text        = const_cast<char *>(title.c_str());
+	comments[0].text_length = strlen(comments[0].text);
+
+	comments[1].compression = PNG_TEXT_COMPRESSION_NONE;
+	comments[1].key         = description_key;
+	comments[1].text        = const_cast<char *>(description.c_str());
+	comments[1].text_length = strlen(comments[1].text);
+
+	comments[2].compression = PNG_TEXT_COMPRESSION_NONE;
+	comments[2].key         = software_key;
+	comments[2].text        = synfig;
+	comments[2].text_length = strlen(comments[2].text);
+
+	png_set_text(png_ptr, info_ptr, comments, sizeof(comments)/sizeof(png_text));
+
+	png_write_info_before_PLTE(png_ptr, info_ptr);
+	png_write_info(png_ptr, info_ptr);
+
+	int stride = w*get_channels();
+	for(int y = 0; y < h; ++y)
+		png_write_row(png_ptr, &pixels[y*stride]);
+
+	png_write_end(png_ptr,info_ptr);
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+
+	// release memory as soon as possible, frame may wait in queue
+	std::vector<unsigned char>().swap(pixels);
+	close();
+	return true;
 }
 
 
 //Target *png_trgt::New(const char *filename){	return new png_trgt(filename);}
 
 png_trgt::png_trgt(const char *Filename, const synfig::TargetParam &params):
-	file(NULL),
-	png_ptr(NULL),
-	info_ptr(NULL),
 	multi_image(),
-	ready(false),
 	imagecount(),
 	filename(Filename),
-	buffer(NULL),
 	color_buffer(NULL),
-	sequence_separator(params.sequence_separator)
-{ }
+	sequence_separator(params.sequence_separator),
+	compression(params.compression),
+	filter(PNG_FILTER_NONE),
+	scanline(),
+	queue(NULL),
+	failed()
+{
+	if (params.filter == "sub")   filter = PNG_FILTER_SUB;   else
+	if (params.filter == "up")    filter = PNG_FILTER_UP;    else
+	if (params.filter == "avg")   filter = PNG_FILTER_AVG;   else
+	if (params.filter == "paeth") filter = PNG_FILTER_PAETH; else
+	if (params.filter == "all")   filter = PNG_ALL_FILTERS;  else
+	if (!params.filter.empty() && params.filter != "none")
+		synfig::warning("png_trgt: unknown filter: %s", params.filter.c_str());
+}
 
 png_trgt::~png_trgt()
 {
-	if(file)
-		fclose(file);
-	file=NULL;
-	delete [] buffer;
+	frame.reset();
+	delete queue;
 	delete [] color_buffer;
 }
 
@@ -113,150 +238,106 @@ png_trgt::set_rend_desc(RendDesc *given_desc)
 		multi_image=true;
 	else
 		multi_image=false;
+
+	// files of sequence are independent, so they may be encoded while next frame is rendering
+	delete queue;
+	queue = multi_image && filename != "-" ? new WriterQueue() : NULL;
 	return true;
 }
 
+bool
+png_trgt::render(synfig::ProgressCallback *cb)
+{
+	bool success = Target_Scanline::render(cb);
+	if (queue && !queue->wait())
+		success = false;
+	return success && !failed;
+}
+
 void
 png_trgt::end_frame()
 {
-	if(ready && file)
+	if (frame)
 	{
-		png_write_end(png_ptr,info_ptr);
-		png_destroy_write_struct(&png_ptr, &info_ptr);
+		if (queue ? !queue->push(frame) : !frame->write())
+			failed = true;
+		frame.reset();
 	}
-
-	if(file && file!=stdout)
-		fclose(file);
-	file=NULL;
 	imagecount++;
-	ready=false;
 }
 
 bool
 png_trgt::start_frame(synfig::ProgressCallback *callback)
 {
+	if (failed)
+		return false;
+
 	int w=desc.get_w(),h=desc.get_h();
 
-	if(file && file!=stdout)
-		fclose(file);
+	frame = new Frame();
 	if(filename=="-")
 	{
 		if(callback)callback->task(strprintf("(stdout) %d",imagecount).c_str());
-		file=stdout;
+		frame->file=stdout;
+		frame->filename="(stdout)";
 	}
 	else if(multi_image)
 	{
-		String newfilename(filename_sans_extension(filename) +
-						   sequence_separator +
-						   etl::strprintf("%04d",imagecount) +
-						   filename_extension(filename));
-		file=fopen(newfilename.c_str(),POPEN_BINARY_WRITE_TYPE);
-		if(callback)callback->task(newfilename);
+		frame->filename = filename_sans_extension(filename) +
+						  sequence_separator +
+						  etl::strprintf("%04d",imagecount) +
+						  filename_extension(filename);
+		frame->file=fopen(frame->filename.c_str(),POPEN_BINARY_WRITE_TYPE);
+		if(callback)callback->task(frame->filename);
 	}
 	else
 	{
-		file=fopen(filename.c_str(),POPEN_BINARY_WRITE_TYPE);
+		frame->filename=filename;
+		frame->file=fopen(filename.c_str(),POPEN_BINARY_WRITE_TYPE);
 		if(callback)callback->task(filename);
 	}
 
-	if(!file)
-		return false;
-
-	delete [] buffer;
-	buffer=new unsigned char[4*w];
-
-	delete [] color_buffer;
-	color_buffer=new Color[w];
-
-	png_ptr=png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)this,png_out_error, png_out_warning);
-	if (!png_ptr)
-	{
-		synfig::error("Unable to setup PNG struct");
-		fclose(file);
-		return false;
-	}
-
-	info_ptr= png_create_info_struct(png_ptr);
-	if (!info_ptr)
-	{
-		synfig::error("Unable to setup PNG info struct");
-		fclose(file);
-		png_destroy_write_struct(&png_ptr,(png_infopp)NULL);
-		return false;
-	}
-
-	if (setjmp(png_jmpbuf(png_ptr)))
+	if(!frame->file)
 	{
-		synfig::error("Unable to setup longjump");
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-		fclose(file);
+		synfig::error("png_trgt: unable to open file: %s", frame->filename.c_str());
+		frame.reset();
 		return false;
 	}
-	png_init_io(png_ptr,file);
-	png_set_filter(png_ptr,0,PNG_FILTER_NONE);
-
-	setjmp(png_jmpbuf(png_ptr));
-	if (get_alpha_mode()==TARGET_ALPHA_MODE_KEEP)
-		png_set_IHDR(png_ptr,info_ptr,w,h,8,PNG_COLOR_TYPE_RGBA,PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
-	else
-		png_set_IHDR(png_ptr,info_ptr,w,h,8,PNG_COLOR_TYPE_RGB,PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
-
-	// Write the gamma
-	//png_set_gAMA(png_ptr, info_ptr,1.0/gamma().get_gamma());
-	png_set_gAMA(png_ptr, info_ptr,gamma().get_gamma());
-
-	// Write the physical size
-	png_set_pHYs(png_ptr,info_ptr,round_to_int(desc.get_x_res()),round_to_int(desc.get_y_res()),PNG_RESOLUTION_METER);
-
-	char title      [] = "Title";
-	char description[] = "Description";
-	char software   [] = "Software";
-	char synfig     [] = "SYNFIG";
 
-	// Output any text info along with the file
-	png_text comments[3];
-	memset(comments, 0, sizeof(comments));
+	frame->w = w;
+	frame->h = h;
+	frame->alpha = get_alpha_mode()==TARGET_ALPHA_MODE_KEEP;
+	frame->gamma = gamma().get_gamma();
+	frame->x_res = round_to_int(desc.get_x_res());
+	frame->y_res = round_to_int(desc.get_y_res());
+	frame->title = get_canvas()->get_name();
+	frame->description = get_canvas()->get_description();
+	frame->compression = compression;
+	frame->filter = filter;
+	frame->pixels.resize(w*h*frame->get_channels());
 
-	comments[0].compression = PNG_TEXT_COMPRESSION_NONE;
-	comments[0].key         = title;
-	comments[0].text        = const_cast<char *>(get_canvas()->get_name().c_str());
-	comments[0].text_length = strlen(comments[0].text);
-
-	comments[1].compression = PNG_TEXT_COMPRESSION_NONE;
-	comments[1].key         = description;
-	comments[1].text        = const_cast<char *>(get_canvas()->get_description().c_str());
-	comments[1].text_length = strlen(comments[1].text);
-
-	comments[2].compression = PNG_TEXT_COMPRESSION_NONE;
-	comments[2].key         = software;
-	comments[2].text        = synfig;
-	comments[2].text_length = strlen(comments[2].text);
-
-	png_set_text(png_ptr, info_ptr, comments, sizeof(comments)/sizeof(png_text));
+	delete [] color_buffer;
+	color_buffer=new Color[w];
 
-	png_write_info_before_PLTE(png_ptr, info_ptr);
-	png_write_info(png_ptr, info_ptr);
-	ready=true;
 	return true;
 }
 
 Color *
-png_trgt::start_scanline(int /*scanline*/)
+png_trgt::start_scanline(int scanline)
 {
+	this->scanline = scanline;
 	return color_buffer;
 }
 
 bool
 png_trgt::end_scanline()
 {
-	if(!file || !ready)
+	if(!frame || scanline < 0 || scanline >= frame->h)
 		return false;
 
-	PixelFormat pf = get_alpha_mode()==TARGET_ALPHA_MODE_KEEP ? PF_RGB|PF_A : PF_RGB;
-	color_to_pixelformat(buffer, color_buffer, pf, &gamma(), desc.get_w());
-
-	setjmp(png_jmpbuf(png_ptr));
-	png_write_row(png_ptr,buffer);
+	PixelFormat pf = frame->alpha ? PF_RGB|PF_A : PF_RGB;
+	int stride = frame->w*frame->get_channels();
+	color_to_pixelformat(&frame->pixels[scanline*stride], color_buffer, pf, &gamma(), frame->w);
 
 	return true;
 }
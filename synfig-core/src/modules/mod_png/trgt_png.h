@@ -33,6 +33,7 @@
 #include <synfig/target_scanline.h>
 #include <synfig/string.h>
 #include <synfig/targetparam.h>
+#include <synfig/writerqueue.h>
 #include <cstdio>
 
 /* === M A C R O S ========================================================= */
@@ -45,24 +46,30 @@ class png_trgt : public synfig::Target_Scanline
 {
 	SYNFIG_TARGET_MODULE_EXT
 private:
-	FILE *file;
-	//int w,h;
-	png_structp png_ptr;
-	png_infop info_ptr;
+	class Frame;
 
 	static void png_out_error(png_struct *png,const char *msg);
 	static void png_out_warning(png_struct *png,const char *msg);
-	bool multi_image,ready;
+	bool multi_image;
 	int imagecount;
 	synfig::String filename;
-	unsigned char *buffer;
 	synfig::Color *color_buffer;
 	synfig::String sequence_separator;
+	int compression;
+	int filter;
+
+	etl::handle<Frame> frame;
+	int scanline;
+	//! encoders of sequence frames, NULL when frames are written synchronously
+	synfig::WriterQueue *queue;
+	bool failed;
+
 public:
-	png_trgt(const char *filename, const synfig::TargetParam& /* params */);
+	png_trgt(const char *filename, const synfig::TargetParam &params);
 	virtual ~png_trgt();
 
 	virtual bool set_rend_desc(synfig::RendDesc *desc);
+	virtual bool render(synfig::ProgressCallback *cb=NULL);
 	virtual bool start_frame(synfig::ProgressCallback *cb);
 	virtual void end_frame();
 
@@ -0,0 +1,1190 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file canvascache.cpp
+**	\brief Binary cache of loaded canvases
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glibmm/convert.h>
+
+#include <ETL/stringf>
+
+#include "canvascache.h"
+
+#include "blinepoint.h"
+#include "dashitem.h"
+#include "filesystemnative.h"
+#include "general.h"
+#include "gradient.h"
+#include "layer.h"
+#include "pair.h"
+#include "segment.h"
+#include "transformation.h"
+#include "valuenode.h"
+#include "valuenode_registry.h"
+#include "valueoperations.h"
+#include "weightedvalue.h"
+#include "widthpoint.h"
+
+#include "valuenodes/valuenode_animated.h"
+#include "valuenodes/valuenode_bline.h"
+#include "valuenodes/valuenode_bone.h"
+#include "valuenodes/valuenode_const.h"
+#include "valuenodes/valuenode_dilist.h"
+#include "valuenodes/valuenode_dynamiclist.h"
+#include "valuenodes/valuenode_staticlist.h"
+#include "valuenodes/valuenode_weightedaverage.h"
+#include "valuenodes/valuenode_wplist.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace synfig;
+using namespace etl;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+	const char magic[8] = { 'S', 'I', 'F', 'C', 'A', 'C', 'H', 'E' };
+	const unsigned int version = 3;
+	const unsigned int byte_order = 0x01020304;
+
+	//! header of cache file, all numbers are stored in native byte order
+	struct Header {
+		char magic[8];
+		unsigned int version;
+		unsigned int byte_order;
+		unsigned int real_size;
+		unsigned int reserved;
+		long long size;
+		long long mtime;
+		unsigned long long hash;
+	};
+
+	enum CanvasKind {
+		CANVAS_CHILD  = 'c', //!< exported canvas, created by Canvas::new_child_canvas()
+		CANVAS_INLINE = 'i'  //!< inline canvas, its content is stored right after reference
+	};
+
+	enum NodeKind {
+		NODE_CONST        = 'c',
+		NODE_ANIMATED     = 'a',
+		NODE_STATIC_LIST  = 's',
+		NODE_DYNAMIC_LIST = 'd',
+		NODE_LINKABLE     = 'l'
+	};
+
+	//! Canvases and value nodes are referenced by index in order of definition,
+	//! first reference is followed by definition
+	const unsigned int ref_null = 0;
+	const unsigned int ref_new = 1;
+	const unsigned int ref_index = 2;
+
+	//! Thrown by Writer when canvas contains something which cannot be cached
+	class Unsupported: public std::runtime_error
+	{
+	public:
+		explicit Unsupported(const String &what): std::runtime_error(what) { }
+	};
+
+	//! 64-bit FNV-1a
+	unsigned long long calc_hash(const char *data, size_t size)
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		for(const char *end = data + size; data < end; ++data)
+			hash = (hash ^ (unsigned char)*data) * 1099511628211ull;
+		return hash;
+	}
+
+	bool is_dynamic_list_name(const String &name)
+	{
+		return name == "dynamic_list"
+		    || name == "bline"
+		    || name == "wplist"
+		    || name == "dilist"
+		    || name == "weighted_average";
+	}
+
+	//! Serializes canvas graph into memory buffer
+	class Writer
+	{
+	private:
+		const Canvas *root;
+		String buffer;
+		std::map<String, unsigned int> names;
+		std::map<const Canvas*, unsigned int> canvases;
+		std::map<const ValueNode*, unsigned int> value_nodes;
+		std::set<const ValueNode*> value_nodes_in_progress;
+
+		void write_raw(const void *data, size_t size)
+			{ buffer.append((const char*)data, size); }
+
+		template<typename T>
+		void write_pod(const T &x)
+			{ write_raw(&x, sizeof(x)); }
+
+		void write_uint(unsigned int x) { write_pod(x); }
+		void write_int(int x) { write_pod(x); }
+		void write_bool(bool x) { write_pod((char)x); }
+		void write_real(Real x) { write_pod(x); }
+		void write_time(const Time &x) { write_pod((Time::value_type)x); }
+		void write_angle(const Angle &x) { write_real(Angle::rad(x).get()); }
+		void write_vector(const Vector &x) { write_real(x[0]); write_real(x[1]); }
+
+		void write_color(const Color &x)
+		{
+			write_pod(x.get_r());
+			write_pod(x.get_g());
+			write_pod(x.get_b());
+			write_pod(x.get_a());
+		}
+
+		void write_string(const String &x)
+		{
+			write_uint((unsigned int)x.size());
+			write_raw(x.c_str(), x.size());
+		}
+
+		void write_name(const String &x)
+		{
+			// new names are stored with index equal to count of known names
+			std::map<String, unsigned int>::const_iterator i = names.find(x);
+			if (i != names.end()) { write_uint(i->second); return; }
+			unsigned int index = (unsigned int)names.size();
+			names[x] = index;
+			write_uint(index);
+			write_string(x);
+		}
+
+		void write_type(Type &type)
+			{ write_name(type.description.name); }
+
+		void write_guid(const GUID &x)
+			{ write_raw(&x, sizeof(x)); }
+		//! GUIDs are stored relative to root canvas, like in sif file
+		void write_relative_guid(const GUID &x)
+			{ write_guid(x ^ root->get_guid()); }
+
+		void write_value(const ValueBase &x)
+		{
+			Type &type = x.get_type();
+			write_type(type);
+			write_bool(x.get_static());
+			write_bool(x.get_loop());
+			write_int((int)x.get_interpolation());
+
+			if (type == type_nil)
+				return;
+			if (type == type_bool)
+				{ write_bool(x.get(bool())); return; }
+			if (type == type_integer)
+				{ write_int(x.get(int())); return; }
+			if (type == type_real)
+				{ write_real(x.get(Real())); return; }
+			if (type == type_time)
+				{ write_time(x.get(Time())); return; }
+			if (type == type_angle)
+				{ write_angle(x.get(Angle())); return; }
+			if (type == type_vector)
+				{ write_vector(x.get(Vector())); return; }
+			if (type == type_color)
+				{ write_color(x.get(Color())); return; }
+			if (type == type_string)
+				{ write_string(x.get(String())); return; }
+			if (type == type_segment)
+			{
+				const Segment &segment = x.get(Segment());
+				write_vector(segment.p1);
+				write_vector(segment.t1);
+				write_vector(segment.p2);
+				write_vector(segment.t2);
+				return;
+			}
+			if (type == type_bline_point)
+			{
+				const BLinePoint &point = x.get(BLinePoint());
+				write_vector(point.get_vertex());
+				write_vector(point.get_tangent1());
+				write_vector(point.get_tangent2());
+				write_pod(point.get_width());
+				write_pod(point.get_origin());
+				write_bool(point.get_split_tangent_radius());
+				write_bool(point.get_split_tangent_angle());
+				write_bool(point.get_boned_vertex_flag());
+				write_vector(point.get_vertex_setup());
+				return;
+			}
+			if (type == type_width_point)
+			{
+				const WidthPoint &point = x.get(WidthPoint());
+				write_real(point.get_position());
+				write_real(point.get_width());
+				write_int(point.get_side_type_before());
+				write_int(point.get_side_type_after());
+				write_bool(point.get_dash());
+				write_real(point.get_lower_bound());
+				write_real(point.get_upper_bound());
+				return;
+			}
+			if (type == type_dash_item)
+			{
+				const DashItem &item = x.get(DashItem());
+				write_real(item.get_offset());
+				write_real(item.get_length());
+				write_int(item.get_side_type_before());
+				write_int(item.get_side_type_after());
+				return;
+			}
+			if (type == type_gradient)
+			{
+				const Gradient &gradient = x.get(Gradient());
+				write_uint((unsigned int)gradient.size());
+				for(Gradient::const_iterator i = gradient.begin(); i != gradient.end(); ++i)
+					{ write_real(i->pos); write_color(i->color); }
+				return;
+			}
+			if (type == type_transformation)
+			{
+				const Transformation &transformation = x.get(Transformation());
+				write_vector(transformation.offset);
+				write_angle(transformation.angle);
+				write_angle(transformation.skew_angle);
+				write_vector(transformation.scale);
+				return;
+			}
+			if (type == type_list)
+			{
+				const ValueBase::List &list = x.get_list();
+				write_uint((unsigned int)list.size());
+				for(ValueBase::List::const_iterator i = list.begin(); i != list.end(); ++i)
+					write_value(*i);
+				return;
+			}
+			if (type == type_canvas)
+				{ write_canvas_ref(x.get(Canvas::LooseHandle()).get()); return; }
+			if (types_namespace::TypeWeightedValueBase *t = dynamic_cast<types_namespace::TypeWeightedValueBase*>(&type))
+			{
+				write_real(t->extract_weight(x));
+				write_value(t->extract_value(x));
+				return;
+			}
+			if (types_namespace::TypePairBase *t = dynamic_cast<types_namespace::TypePairBase*>(&type))
+			{
+				write_value(t->extract_first(x));
+				write_value(t->extract_second(x));
+				return;
+			}
+			throw Unsupported("value of type " + type.description.name);
+		}
+
+		void write_value_node(const ValueNode &node)
+		{
+			if (dynamic_cast<const ValueNode_Bone*>(&node))
+				throw Unsupported("bones");
+
+			if (const ValueNode_Animated *animated = dynamic_cast<const ValueNode_Animated*>(&node))
+			{
+				write_pod((char)NODE_ANIMATED);
+				write_type(animated->get_type());
+				write_int((int)animated->get_interpolation());
+				const ValueNode_Animated::WaypointList &list = animated->waypoint_list();
+				write_uint((unsigned int)list.size());
+				for(ValueNode_Animated::WaypointList::const_iterator i = list.begin(); i != list.end(); ++i)
+				{
+					write_time(i->get_time());
+					write_value_node_ref(i->get_value_node().get());
+					write_int((int)i->get_before());
+					write_int((int)i->get_after());
+					write_real(i->get_tension());
+					write_real(i->get_continuity());
+					write_real(i->get_bias());
+					write_real(i->get_temporal_tension());
+				}
+				return;
+			}
+
+			if (const ValueNode_StaticList *list = dynamic_cast<const ValueNode_StaticList*>(&node))
+			{
+				if (list->get_name() != "static_list")
+					throw Unsupported("value node " + list->get_name());
+				write_pod((char)NODE_STATIC_LIST);
+				write_type(list->get_contained_type());
+				write_uint((unsigned int)list->list.size());
+				for(std::vector<ValueNode::RHandle>::const_iterator i = list->list.begin(); i != list->list.end(); ++i)
+					write_value_node_ref(i->get());
+				return;
+			}
+
+			if (const ValueNode_DynamicList *list = dynamic_cast<const ValueNode_DynamicList*>(&node))
+			{
+				if (!is_dynamic_list_name(list->get_name()))
+					throw Unsupported("value node " + list->get_name());
+				write_pod((char)NODE_DYNAMIC_LIST);
+				write_name(list->get_name());
+				write_type(list->get_contained_type());
+				write_bool(list->get_loop());
+				write_uint((unsigned int)list->list.size());
+				for(std::vector<ValueNode_DynamicList::ListEntry>::const_iterator i = list->list.begin(); i != list->list.end(); ++i)
+				{
+					write_value_node_ref(i->value_node.get());
+					write_uint((unsigned int)i->timing_info.size());
+					for(ValueNode_DynamicList::ListEntry::ActivepointList::const_iterator j = i->timing_info.begin(); j != i->timing_info.end(); ++j)
+					{
+						write_time(j->get_time());
+						write_bool(j->get_state());
+						write_int(j->get_priority());
+					}
+				}
+				return;
+			}
+
+			if (const ValueNode_Const *value_node = dynamic_cast<const ValueNode_Const*>(&node))
+			{
+				write_pod((char)NODE_CONST);
+				write_value(value_node->get_value());
+				return;
+			}
+
+			if (const LinkableValueNode *linkable = dynamic_cast<const LinkableValueNode*>(&node))
+			{
+				if (!ValueNodeRegistry::book().count(linkable->get_name()))
+					throw Unsupported("value node " + linkable->get_name());
+				write_pod((char)NODE_LINKABLE);
+				write_name(linkable->get_name());
+				write_type(linkable->get_type());
+				write_uint((unsigned int)linkable->link_count());
+				for(int i = 0; i < linkable->link_count(); ++i)
+				{
+					ValueNode::LooseHandle link = linkable->get_link(i);
+					if (!link)
+						throw Unsupported("empty link in value node " + linkable->get_name());
+					write_value_node_ref(link.get());
+				}
+				return;
+			}
+
+			throw Unsupported("value node " + node.get_name());
+		}
+
+		void write_value_node_ref(const ValueNode *node)
+		{
+			if (!node)
+				{ write_uint(ref_null); return; }
+			std::map<const ValueNode*, unsigned int>::const_iterator i = value_nodes.find(node);
+			if (i != value_nodes.end())
+				{ write_uint(ref_index + i->second); return; }
+
+			if (node->is_exported() && node->get_parent_canvas() && node->get_parent_canvas()->get_root().get() != root)
+				throw Unsupported("reference to value node of other file: " + node->get_id());
+			if (value_nodes_in_progress.count(node))
+				throw Unsupported("cyclic reference to value node");
+
+			// index is assigned when definition is complete,
+			// so reader can create value node before it will be referenced
+			value_nodes_in_progress.insert(node);
+			write_uint(ref_new);
+			write_relative_guid(node->get_guid());
+			write_value_node(*node);
+			value_nodes_in_progress.erase(node);
+			unsigned int index = (unsigned int)value_nodes.size();
+			value_nodes[node] = index;
+		}
+
+		void write_canvas_ref(const Canvas *canvas)
+		{
+			if (!canvas)
+				{ write_uint(ref_null); return; }
+			std::map<const Canvas*, unsigned int>::const_iterator i = canvases.find(canvas);
+			if (i != canvases.end())
+				{ write_uint(ref_index + i->second); return; }
+
+			if (canvas->get_root().get() != root)
+				throw Unsupported("reference to canvas of other file: " + canvas->get_id());
+
+			// only canvas itself is stored here, content of exported canvas
+			// is stored in list of children of its parent
+			write_uint(ref_new);
+			write_relative_guid(canvas->get_guid());
+			write_pod((char)(canvas->is_inline() ? CANVAS_INLINE : CANVAS_CHILD));
+			write_canvas_ref(canvas->parent().get());
+			if (!canvas->is_inline())
+				write_string(canvas->get_id());
+			unsigned int index = (unsigned int)canvases.size();
+			canvases[canvas] = index;
+			if (canvas->is_inline())
+				write_canvas(*canvas);
+		}
+
+		void write_layer(const Layer &layer)
+		{
+			write_name(layer.get_name());
+			write_relative_guid(layer.get_guid());
+			write_string(layer.get_description());
+			write_string(layer.get_group());
+			write_bool(layer.active());
+			write_bool(layer.get_exclude_from_rendering());
+
+			const Layer::DynamicParamList &dynamic_params = layer.dynamic_param_list();
+			write_uint((unsigned int)dynamic_params.size());
+			for(Layer::DynamicParamList::const_iterator i = dynamic_params.begin(); i != dynamic_params.end(); ++i)
+			{
+				write_name(i->first);
+				if (!i->second)
+					throw Unsupported("empty dynamic param " + i->first);
+				write_value_node_ref(i->second.get());
+			}
+
+			// static params are stored like in file, only critical ones
+			std::vector< std::pair<String, ValueBase> > params;
+			Layer::Vocab vocab = layer.get_param_vocab();
+			for(Layer::Vocab::const_iterator i = vocab.begin(); i != vocab.end(); ++i)
+			{
+				if (!i->get_critical() || dynamic_params.count(i->get_name()))
+					continue;
+				ValueBase value = layer.get_param(i->get_name());
+				if (!value.is_valid())
+					continue;
+				if (value.get_type() == type_canvas && !value.get(Canvas::LooseHandle()))
+					continue;
+				params.push_back(std::make_pair(i->get_name(), value));
+			}
+			write_uint((unsigned int)params.size());
+			for(std::vector< std::pair<String, ValueBase> >::const_iterator i = params.begin(); i != params.end(); ++i)
+				{ write_name(i->first); write_value(i->second); }
+		}
+
+		void write_canvas(const Canvas &canvas)
+		{
+			const RendDesc &desc = canvas.rend_desc();
+			write_int(desc.get_w());
+			write_int(desc.get_h());
+			write_real(desc.get_x_res());
+			write_real(desc.get_y_res());
+			write_vector(desc.get_tl());
+			write_vector(desc.get_br());
+			write_pod(desc.get_frame_rate());
+			write_time(desc.get_time_start());
+			write_time(desc.get_time_end());
+			write_int(desc.get_antialias());
+			write_color(desc.get_bg_color());
+			write_vector(desc.get_focus());
+			write_int(desc.get_flags());
+
+			write_string(canvas.get_name());
+			write_string(canvas.get_description());
+			write_string(canvas.get_author());
+
+			if (!canvas.is_inline())
+			{
+				std::list<String> keys = canvas.get_meta_data_keys();
+				write_uint((unsigned int)keys.size());
+				for(std::list<String>::const_iterator i = keys.begin(); i != keys.end(); ++i)
+					{ write_string(*i); write_string(canvas.get_meta_data(*i)); }
+
+				const KeyframeList &keyframes = canvas.keyframe_list();
+				write_uint((unsigned int)keyframes.size());
+				for(KeyframeList::const_iterator i = keyframes.begin(); i != keyframes.end(); ++i)
+				{
+					write_time(i->get_time());
+					write_relative_guid(i->get_guid());
+					write_string(i->get_description());
+					write_bool(i->active());
+				}
+
+				const ValueNodeList &exported = canvas.value_node_list();
+				write_uint((unsigned int)exported.size());
+				for(ValueNodeList::const_iterator i = exported.begin(); i != exported.end(); ++i)
+				{
+					write_value_node_ref(i->get());
+					write_string((*i)->get_id());
+				}
+
+				const std::list<Canvas::Handle> &children = canvas.children();
+				write_uint((unsigned int)children.size());
+				for(std::list<Canvas::Handle>::const_iterator i = children.begin(); i != children.end(); ++i)
+				{
+					write_canvas_ref(i->get());
+					write_canvas(**i);
+				}
+			}
+
+			write_uint((unsigned int)canvas.size());
+			for(Canvas::const_iterator i = canvas.begin(); i != canvas.end(); ++i)
+				write_layer(**i);
+		}
+
+	public:
+		Writer(): root() { }
+
+		//! returns serialized canvas or throws Unsupported
+		const String& write(const Canvas &canvas)
+		{
+			root = &canvas;
+			canvases[root] = 0;
+			write_guid(canvas.get_guid());
+			write_canvas(canvas);
+			return buffer;
+		}
+	};
+
+	//! Rebuilds canvas graph from mapped cache,
+	//! throws std::runtime_error when data is broken
+	class Reader
+	{
+	private:
+		const char *current;
+		const char *end;
+		std::vector<String> names;
+		std::vector<Canvas::Handle> canvases;
+		std::vector<ValueNode::Handle> value_nodes;
+
+		static void broken()
+			{ throw std::runtime_error("CanvasCache: broken file"); }
+
+		void read_raw(void *data, size_t size)
+		{
+			if ((size_t)(end - current) < size) broken();
+			memcpy(data, current, size);
+			current += size;
+		}
+
+		template<typename T>
+		T read_pod()
+			{ T x; read_raw(&x, sizeof(x)); return x; }
+
+		unsigned int read_uint() { return read_pod<unsigned int>(); }
+		int read_int() { return read_pod<int>(); }
+		bool read_bool() { return read_pod<char>() != 0; }
+		Real read_real() { return read_pod<Real>(); }
+		Time read_time() { return Time(read_pod<Time::value_type>()); }
+		Angle read_angle() { return Angle::rad(read_real()); }
+		Interpolation read_interpolation() { return (Interpolation)read_int(); }
+
+		Vector read_vector()
+		{
+			Real x = read_real();
+			Real y = read_real();
+			return Vector(x, y);
+		}
+
+		Color read_color()
+		{
+			Color color;
+			color.set_r(read_pod<Color::value_type>());
+			color.set_g(read_pod<Color::value_type>());
+			color.set_b(read_pod<Color::value_type>());
+			color.set_a(read_pod<Color::value_type>());
+			return color;
+		}
+
+		//! reads count of items, each item takes at least one byte
+		unsigned int read_count()
+		{
+			unsigned int count = read_uint();
+			if (count > (size_t)(end - current)) broken();
+			return count;
+		}
+
+		String read_string()
+		{
+			unsigned int size = read_count();
+			String x(current, size);
+			current += size;
+			return x;
+		}
+
+		String read_name()
+		{
+			unsigned int index = read_uint();
+			if (index > names.size()) broken();
+			if (index == names.size())
+				names.push_back(read_string());
+			return names[index];
+		}
+
+		Type& read_type()
+		{
+			Type *type = Type::try_get_type_by_name(read_name());
+			if (!type) broken();
+			return *type;
+		}
+
+		GUID read_guid()
+			{ GUID x = GUID::zero(); read_raw(&x, sizeof(x)); return x; }
+		GUID read_relative_guid()
+			{ return read_guid() ^ canvases.front()->get_guid(); }
+
+		//! GUID is already used when the same file is loaded again
+		//! while previous graph is still alive, then node keeps own GUID
+		static void restore_guid(Node &node, const GUID &guid)
+			{ if (guid && !find_node(guid)) node.set_guid(guid); }
+
+		ValueBase read_value()
+		{
+			Type &type = read_type();
+			bool static_ = read_bool();
+			bool loop = read_bool();
+			Interpolation interpolation = read_interpolation();
+
+			ValueBase x;
+			if (type == type_nil)
+				{ }
+			else
+			if (type == type_bool)
+				x.set(read_bool());
+			else
+			if (type == type_integer)
+				x.set(read_int());
+			else
+			if (type == type_real)
+				x.set(read_real());
+			else
+			if (type == type_time)
+				x.set(read_time());
+			else
+			if (type == type_angle)
+				x.set(read_angle());
+			else
+			if (type == type_vector)
+				x.set(read_vector());
+			else
+			if (type == type_color)
+				x.set(read_color());
+			else
+			if (type == type_string)
+				x.set(read_string());
+			else
+			if (type == type_segment)
+			{
+				Segment segment;
+				segment.p1 = read_vector();
+				segment.t1 = read_vector();
+				segment.p2 = read_vector();
+				segment.t2 = read_vector();
+				x.set(segment);
+			}
+			else
+			if (type == type_bline_point)
+			{
+				BLinePoint point;
+				point.set_vertex(read_vector());
+				Vector tangent1 = read_vector();
+				Vector tangent2 = read_vector();
+				point.set_width(read_pod<float>());
+				point.set_origin(read_pod<float>());
+				point.set_split_tangent_radius(read_bool());
+				point.set_split_tangent_angle(read_bool());
+				point.set_tangent1(tangent1);
+				point.set_tangent2(tangent2);
+				point.set_boned_vertex_flag(read_bool());
+				Vector vertex_setup = read_vector();
+				point.set_vertex_setup(vertex_setup);
+				x.set(point);
+			}
+			else
+			if (type == type_width_point)
+			{
+				Real position = read_real();
+				Real width = read_real();
+				int before = read_int();
+				int after = read_int();
+				bool dash = read_bool();
+				WidthPoint point(position, width, before, after, dash);
+				point.set_lower_bound(read_real());
+				point.set_upper_bound(read_real());
+				x.set(point);
+			}
+			else
+			if (type == type_dash_item)
+			{
+				Real offset = read_real();
+				Real length = read_real();
+				int before = read_int();
+				int after = read_int();
+				x.set(DashItem(offset, length, before, after));
+			}
+			else
+			if (type == type_gradient)
+			{
+				Gradient gradient;
+				for(unsigned int count = read_count(); count; --count)
+				{
+					Real pos = read_real();
+					gradient.push_back(Gradient::CPoint(pos, read_color()));
+				}
+				x.set(gradient);
+			}
+			else
+			if (type == type_transformation)
+			{
+				Transformation transformation;
+				transformation.offset = read_vector();
+				transformation.angle = read_angle();
+				transformation.skew_angle = read_angle();
+				transformation.scale = read_vector();
+				x.set(transformation);
+			}
+			else
+			if (type == type_list)
+			{
+				std::vector<ValueBase> list(read_count());
+				for(std::vector<ValueBase>::iterator i = list.begin(); i != list.end(); ++i)
+					*i = read_value();
+				x = list;
+			}
+			else
+			if (type == type_canvas)
+				x.set(read_canvas_ref());
+			else
+			if (types_namespace::TypeWeightedValueBase *t = dynamic_cast<types_namespace::TypeWeightedValueBase*>(&type))
+			{
+				Real weight = read_real();
+				x = t->create_weighted_value(weight, read_value());
+			}
+			else
+			if (types_namespace::TypePairBase *t = dynamic_cast<types_namespace::TypePairBase*>(&type))
+			{
+				ValueBase first = read_value();
+				x = t->create_value(first, read_value());
+			}
+			else
+				broken();
+
+			if (x.get_type() != type) broken();
+			x.set_static(static_);
+			x.set_loop(loop);
+			x.set_interpolation(interpolation);
+			return x;
+		}
+
+		ValueNode::Handle read_value_node(const Canvas::Handle &canvas)
+		{
+			char kind = read_pod<char>();
+
+			if (kind == NODE_CONST)
+				return ValueNode::Handle(ValueNode_Const::create(read_value()));
+
+			if (kind == NODE_ANIMATED)
+			{
+				Type &type = read_type();
+				ValueNode_Animated::Handle animated = ValueNode_Animated::create(type);
+				if (!animated) broken();
+				animated->set_root_canvas(canvas->get_root());
+				animated->set_interpolation(read_interpolation());
+				for(unsigned int count = read_count(); count; --count)
+				{
+					Time time = read_time();
+					ValueNode::Handle value_node = read_value_node_ref(canvas);
+					if (!value_node) broken();
+					ValueNode_Animated::WaypointList::iterator waypoint = animated->new_waypoint(time, value_node);
+					waypoint->set_before(read_interpolation());
+					waypoint->set_after(read_interpolation());
+					waypoint->set_tension(read_real());
+					waypoint->set_continuity(read_real());
+					waypoint->set_bias(read_real());
+					waypoint->set_temporal_tension(read_real());
+				}
+				animated->changed();
+				return animated;
+			}
+
+			if (kind == NODE_STATIC_LIST)
+			{
+				Type &type = read_type();
+				ValueNode_StaticList::Handle list = ValueNode_StaticList::create_on_canvas(type);
+				if (!list) broken();
+				list->set_root_canvas(canvas->get_root());
+				for(unsigned int count = read_count(); count; --count)
+				{
+					ValueNode::Handle value_node = read_value_node_ref(canvas);
+					if (!value_node) broken();
+					list->add(value_node);
+				}
+				return list;
+			}
+
+			if (kind == NODE_DYNAMIC_LIST)
+			{
+				String name = read_name();
+				Type &type = read_type();
+				ValueNode_DynamicList::Handle list;
+				if (name == "bline")
+					list = ValueNode_BLine::create(type_list, canvas);
+				else
+				if (name == "wplist")
+					list = ValueNode_WPList::create();
+				else
+				if (name == "dilist")
+					list = ValueNode_DIList::create();
+				else
+				if (name == "weighted_average")
+					list = new ValueNode_WeightedAverage(ValueAverage::get_type_from_weighted(type), canvas);
+				else
+				if (name == "dynamic_list")
+					list = ValueNode_DynamicList::create_on_canvas(type);
+				if (!list || list->get_contained_type() != type) broken();
+				list->set_root_canvas(canvas->get_root());
+				list->set_loop(read_bool());
+				for(unsigned int count = read_count(); count; --count)
+				{
+					ValueNode_DynamicList::ListEntry entry;
+					entry.value_node = read_value_node_ref(canvas);
+					if (!entry.value_node) broken();
+					entry.timing_info.clear();
+					for(unsigned int points = read_count(); points; --points)
+					{
+						Time time = read_time();
+						bool state = read_bool();
+						entry.timing_info.push_back(ValueNode_DynamicList::ListEntry::Activepoint(time, state, read_int()));
+					}
+					list->add(entry);
+					list->set_link(list->link_count() - 1, entry.value_node);
+				}
+				return list;
+			}
+
+			if (kind == NODE_LINKABLE)
+			{
+				String name = read_name();
+				Type &type = read_type();
+				LinkableValueNode::Handle linkable = ValueNodeRegistry::create(name, type);
+				if (!linkable || linkable->get_type() != type) broken();
+				if (read_uint() != (unsigned int)linkable->link_count()) broken();
+				for(int i = 0; i < linkable->link_count(); ++i)
+					if (!linkable->set_link(i, read_value_node_ref(canvas)))
+						broken();
+				return linkable;
+			}
+
+			broken();
+			return ValueNode::Handle();
+		}
+
+		ValueNode::Handle read_value_node_ref(const Canvas::Handle &canvas)
+		{
+			unsigned int ref = read_uint();
+			if (ref == ref_null)
+				return ValueNode::Handle();
+			if (ref >= ref_index)
+			{
+				if (ref - ref_index >= value_nodes.size()) broken();
+				return value_nodes[ref - ref_index];
+			}
+			GUID guid = read_relative_guid();
+			ValueNode::Handle value_node = read_value_node(canvas);
+			restore_guid(*value_node, guid);
+			value_node->set_root_canvas(canvas->get_root());
+			value_nodes.push_back(value_node);
+			return value_node;
+		}
+
+		Canvas::Handle read_canvas_ref()
+		{
+			unsigned int ref = read_uint();
+			if (ref == ref_null)
+				return Canvas::Handle();
+			if (ref >= ref_index)
+			{
+				if (ref - ref_index >= canvases.size()) broken();
+				return canvases[ref - ref_index];
+			}
+
+			GUID guid = read_relative_guid();
+			char kind = read_pod<char>();
+			Canvas::Handle parent = read_canvas_ref();
+			if (!parent) broken();
+
+			Canvas::Handle canvas;
+			if (kind == CANVAS_INLINE)
+				canvas = Canvas::create_inline(parent);
+			else
+			if (kind == CANVAS_CHILD)
+				canvas = parent->new_child_canvas(read_string());
+			else
+				broken();
+			restore_guid(*canvas, guid);
+			canvases.push_back(canvas);
+
+			if (kind == CANVAS_INLINE)
+				read_canvas(canvas);
+			return canvas;
+		}
+
+		Layer::Handle read_layer(const Canvas::Handle &canvas)
+		{
+			Layer::Handle layer = Layer::create(read_name());
+			if (!layer) broken();
+			restore_guid(*layer, read_relative_guid());
+			layer->set_canvas(canvas);
+			layer->set_description(read_string());
+			String group = read_string();
+			if (!group.empty())
+				layer->add_to_group(group);
+			layer->set_active(read_bool());
+			layer->set_exclude_from_rendering(read_bool());
+
+			for(unsigned int count = read_count(); count; --count)
+			{
+				String name = read_name();
+				ValueNode::Handle value_node = read_value_node_ref(canvas);
+				if (!value_node || !layer->connect_dynamic_param(name, value_node))
+					broken();
+			}
+
+			for(unsigned int count = read_count(); count; --count)
+			{
+				String name = read_name();
+				if (!layer->set_param(name, read_value()))
+					broken();
+			}
+			return layer;
+		}
+
+		void read_canvas(const Canvas::Handle &canvas)
+		{
+			RendDesc &desc = canvas->rend_desc();
+			desc.clear_flags();
+			desc.set_w(read_int());
+			desc.set_h(read_int());
+			desc.set_x_res(read_real());
+			desc.set_y_res(read_real());
+			desc.set_tl(read_vector());
+			desc.set_br(read_vector());
+			desc.set_frame_rate(read_pod<float>());
+			desc.set_time_start(read_time());
+			desc.set_time_end(read_time());
+			desc.set_antialias(read_int());
+			desc.set_bg_color(read_color());
+			desc.set_focus(read_vector());
+			desc.set_flags(read_int());
+
+			canvas->set_name(read_string());
+			canvas->set_description(read_string());
+			canvas->set_author(read_string());
+
+			if (!canvas->is_inline())
+			{
+				for(unsigned int count = read_count(); count; --count)
+				{
+					String key = read_string();
+					canvas->set_meta_data(key, read_string());
+				}
+
+				for(unsigned int count = read_count(); count; --count)
+				{
+					Keyframe keyframe(read_time());
+					keyframe.set_guid(read_relative_guid());
+					keyframe.set_description(read_string());
+					keyframe.set_active(read_bool());
+					canvas->keyframe_list().add(keyframe);
+				}
+				canvas->keyframe_list().sync();
+
+				for(unsigned int count = read_count(); count; --count)
+				{
+					ValueNode::Handle value_node = read_value_node_ref(canvas);
+					if (!value_node) broken();
+					canvas->add_value_node(value_node, read_string());
+				}
+
+				for(unsigned int count = read_count(); count; --count)
+				{
+					Canvas::Handle child = read_canvas_ref();
+					if (!child || child->is_inline() || child->parent().get() != canvas.get()) broken();
+					read_canvas(child);
+				}
+			}
+
+			for(unsigned int count = read_count(); count; --count)
+				canvas->push_back(read_layer(canvas));
+
+			canvas->set_version(CURRENT_CANVAS_VERSION);
+		}
+
+	public:
+		Reader(const char *begin, const char *end): current(begin), end(end) { }
+
+		void read(const Canvas::Handle &root)
+		{
+			canvases.push_back(root);
+			restore_guid(*root, read_guid());
+			read_canvas(root);
+			if (current != end) broken();
+		}
+	};
+}
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+CanvasCache::Source
+CanvasCache::get_source(const FileSystem::Identifier &identifier, String &out_real_filename)
+{
+	out_real_filename.clear();
+	if (!identifier.file_system) return Source();
+
+	String uri = identifier.file_system->get_real_uri(identifier.filename);
+	if (uri.empty()) return Source();
+	try { out_real_filename = Glib::filename_from_uri(uri); }
+	catch(...) { return Source(); }
+
+	GStatBuf buf;
+	if (out_real_filename.empty() || g_stat(out_real_filename.c_str(), &buf))
+		return Source();
+
+	// mtime has one second resolution on some systems,
+	// so file may be changed without change of size and mtime
+	GMappedFile *file = g_mapped_file_new(out_real_filename.c_str(), FALSE, NULL);
+	if (!file) return Source();
+
+	Source source;
+	source.size = (long long)buf.st_size;
+	source.mtime = (long long)buf.st_mtime;
+	source.hash = calc_hash(g_mapped_file_get_contents(file), g_mapped_file_get_length(file));
+	g_mapped_file_unref(file);
+	return source;
+}
+
+bool
+CanvasCache::write(const String &real_filename, const Source &source, const Canvas::Handle &canvas)
+{
+	if (!source.is_valid() || !canvas) return false;
+	String filename = get_cache_filename(real_filename);
+
+	Writer writer;
+	String data;
+	try
+	{
+		data = writer.write(*canvas);
+	}
+	catch(const Unsupported &e)
+	{
+		synfig::info("CanvasCache: canvas cannot be cached: %s", e.what());
+		FileSystemNative::instance()->file_remove(filename);
+		return false;
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.byte_order = byte_order;
+	header.real_size = sizeof(Real);
+	header.size = source.size;
+	header.mtime = source.mtime;
+	header.hash = source.hash;
+
+	// unique name of temporary file, because the same file may be loaded by several processes
+	String tmp_filename = strprintf("%s.%08x.TMP", filename.c_str(), (unsigned int)g_random_int());
+	bool success = false;
+	{
+		FileSystem::WriteStream::Handle stream = FileSystemNative::instance()->get_write_stream(tmp_filename);
+		if (stream)
+		{
+			stream->write((const char*)&header, sizeof(header));
+			stream->write(data.c_str(), data.size());
+			success = !stream->fail();
+		}
+	}
+
+	if (success && FileSystemNative::instance()->file_rename(tmp_filename, filename))
+		return true;
+
+	synfig::warning("CanvasCache: cannot write cache file: %s", filename.c_str());
+	FileSystemNative::instance()->file_remove(tmp_filename);
+	return false;
+}
+
+Canvas::Handle
+CanvasCache::read(
+	const String &real_filename,
+	const Source &source,
+	const FileSystem::Identifier &identifier,
+	const String &filename )
+{
+	if (!source.is_valid()) return Canvas::Handle();
+
+	String cache_filename = get_cache_filename(real_filename);
+	if (!g_file_test(cache_filename.c_str(), G_FILE_TEST_IS_REGULAR))
+		return Canvas::Handle();
+	GMappedFile *file = g_mapped_file_new(cache_filename.c_str(), FALSE, NULL);
+	if (!file) return Canvas::Handle();
+
+	const char *begin = g_mapped_file_get_contents(file);
+	const char *end = begin + g_mapped_file_get_length(file);
+
+	Header header;
+	bool valid = begin && (size_t)(end - begin) >= sizeof(header);
+	if (valid) memcpy(&header, begin, sizeof(header));
+	valid = valid
+	          && !memcmp(header.magic, magic, sizeof(magic))
+	          && header.version == version
+	          && header.byte_order == byte_order
+	          && header.real_size == sizeof(Real)
+	          && header.size == source.size
+	          && header.mtime == source.mtime
+	          && header.hash == source.hash;
+
+	Canvas::Handle canvas;
+	if (valid)
+	{
+		canvas = Canvas::create();
+		canvas->set_identifier(identifier);
+		canvas->set_file_name(filename);
+		try
+		{
+			Reader(begin + sizeof(header), end).read(canvas);
+		}
+		catch(const std::exception &e)
+		{
+			synfig::warning("CanvasCache: cannot read cache file %s: %s", cache_filename.c_str(), e.what());
+			canvas = Canvas::Handle();
+		}
+		catch(...)
+		{
+			synfig::warning("CanvasCache: cannot read cache file: %s", cache_filename.c_str());
+			canvas = Canvas::Handle();
+		}
+	}
+
+	g_mapped_file_unref(file);
+	return canvas;
+}
+
+/* === E N T R Y P O I N T ================================================= */
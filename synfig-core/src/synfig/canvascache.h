@@ -0,0 +1,88 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file canvascache.h
+**	\brief Binary cache of loaded canvases
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_CANVASCACHE_H
+#define __SYNFIG_CANVASCACHE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include "string.h"
+#include "canvas.h"
+#include "filesystem.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig {
+
+//! Binary cache of loaded canvas, it is stored near the source file
+//! (with additional extension ".cache") and contains the graph of canvases,
+//! layers and value nodes in binary form, so it can be loaded without
+//! xml parsing, decompression and conversion of values from text.
+//! Value nodes used in several places are stored once and referenced by index.
+//! GUIDs of canvases, layers, value nodes and keyframes are stored relative to
+//! GUID of root canvas, so links by GUID keep working after loading from cache.
+//! Cache is valid while size, modification time and content hash of source file are not changed.
+//! Canvases with bones or with references to other files are not cached.
+class CanvasCache
+{
+public:
+	//! Stat of source file
+	struct Source {
+		long long size;
+		long long mtime;
+		unsigned long long hash;
+		Source(): size(-1), mtime(), hash() { }
+		bool is_valid() const { return size >= 0; }
+	};
+
+	static String get_cache_filename(const String &real_filename)
+		{ return real_filename + ".cache"; }
+
+	//! Returns stat and content hash of source file,
+	//! or invalid Source if file is not in native file system
+	static Source get_source(const FileSystem::Identifier &identifier, String &out_real_filename);
+
+	//! Writes cache of loaded \a canvas into temporary file and renames it when complete.
+	//! Returns false when canvas contains something which cannot be stored,
+	//! previous cache is removed in this case.
+	static bool write(const String &real_filename, const Source &source, const Canvas::Handle &canvas);
+
+	//! Loads canvas from cache, returns null handle when cache
+	//! is missing, outdated or broken
+	static Canvas::Handle read(
+		const String &real_filename,
+		const Source &source,
+		const FileSystem::Identifier &identifier,
+		const String &filename );
+};
+
+}; // END of namespace synfig
+
+/* === E N D =============================================================== */
+
+#endif
@@ -24,10 +24,91 @@
 */
 /* ========================================================================= */
 
+#include <cstdlib>
+#include <string>
+
+#include <synfig/general.h>
+
 #include "pixelformat.h"
 
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+#	define PIXELFORMAT_SSE2
+#	include <emmintrin.h>
+#	include "pixelformattemplates.h"
+#endif
+
 using namespace synfig;
 
+namespace {
+#ifdef PIXELFORMAT_SSE2
+	//! four pixels per register
+	class TraitsSSE2
+	{
+	public:
+		typedef __m128 V;
+		typedef __m128i I;
+		enum { pixels = 4 };
+
+		static void load_colors(const Color *c, V &r, V &g, V &b, V &a)
+		{
+			r = _mm_loadu_ps((const float*)(c + 0));
+			g = _mm_loadu_ps((const float*)(c + 1));
+			b = _mm_loadu_ps((const float*)(c + 2));
+			a = _mm_loadu_ps((const float*)(c + 3));
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+		}
+
+		static void store_colors(Color *c, V r, V g, V b, V a)
+		{
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+			_mm_storeu_ps((float*)(c + 0), r);
+			_mm_storeu_ps((float*)(c + 1), g);
+			_mm_storeu_ps((float*)(c + 2), b);
+			_mm_storeu_ps((float*)(c + 3), a);
+		}
+
+		static void load4(const unsigned char *p, I &c0, I &c1, I &c2, I &c3)
+		{
+			const I mask = _mm_set1_epi32(255);
+			I x = _mm_loadu_si128((const I*)p);
+			c0 = _mm_and_si128(x, mask);
+			c1 = _mm_and_si128(_mm_srli_epi32(x, 8), mask);
+			c2 = _mm_and_si128(_mm_srli_epi32(x, 16), mask);
+			c3 = _mm_srli_epi32(x, 24);
+		}
+
+		static void store4(unsigned char *p, const I &c0, const I &c1, const I &c2, const I &c3)
+		{
+			_mm_storeu_si128((I*)p, _mm_or_si128(
+				_mm_or_si128(c0, _mm_slli_epi32(c1, 8)),
+				_mm_or_si128(_mm_slli_epi32(c2, 16), _mm_slli_epi32(c3, 24)) ));
+		}
+
+		static V set1(float x) { return _mm_set1_ps(x); }
+		static V add(const V &a, const V &b) { return _mm_add_ps(a, b); }
+		static V mul(const V &a, const V &b) { return _mm_mul_ps(a, b); }
+		static V div(const V &a, const V &b) { return _mm_div_ps(a, b); }
+		// max() returns second argument when first one is NaN, so NaN becomes zero as in scalar code
+		static V min(const V &a, const V &b) { return _mm_min_ps(a, b); }
+		static V max(const V &a, const V &b) { return _mm_max_ps(a, b); }
+		static V neq(const V &a, const V &b) { return _mm_cmpneq_ps(a, b); }
+		static V select(const V &mask, const V &a, const V &b)
+			{ return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+		static V cvt(const I &x) { return _mm_cvtepi32_ps(x); }
+		static I cvtt(const V &x) { return _mm_cvttps_epi32(x); }
+
+		// SSE2 has no gather instruction
+		static V lookup(const unsigned short *table, const I &index)
+		{
+			int i[4];
+			_mm_storeu_si128((I*)i, index);
+			return _mm_cvtepi32_ps(_mm_setr_epi32(table[i[0]], table[i[1]], table[i[2]], table[i[3]]));
+		}
+	};
+#endif
+} // namespace
+
 namespace {
 	struct Color2PFParams {
 		unsigned char *dst;
@@ -38,6 +119,8 @@ namespace {
 		int height;
 		int dst_stride_extra;
 		int src_stride_extra;
+		int pixel_size;
+		PixelFormatKernel::Color2PFFunc vfunc;
 
 		explicit inline Color2PFParams(
 			unsigned char *dst = NULL,
@@ -47,7 +130,8 @@ namespace {
 			int width = 0,
 			int height = 0,
 			int dst_stride_extra = 0,
-			int src_stride_extra = 0
+			int src_stride_extra = 0,
+			PixelFormatKernel::Color2PFFunc vfunc = NULL
 		):
 			dst(dst),
 			src(src),
@@ -56,7 +140,9 @@ namespace {
 			width(width),
 			height(height),
 			dst_stride_extra(dst_stride_extra),
-			src_stride_extra(src_stride_extra) { }
+			src_stride_extra(src_stride_extra),
+			pixel_size((int)synfig::pixel_size(pf)),
+			vfunc(vfunc) { }
 	};
 
 
@@ -197,7 +283,13 @@ namespace {
 	static unsigned char*
 	color2pf_image(Color2PFParams params) {
 		while(params.height-- > 0) {
-			for(int i = 0; i < params.width; ++i)
+			int i = 0;
+			if (params.vfunc) {
+				i = params.vfunc(params.dst, params.src, params.width, params.gamma);
+				params.dst += i*params.pixel_size;
+				params.src += i;
+			}
+			for(; i < params.width; ++i)
 				params.dst = func(params.dst, *params.src, params.gamma), ++params.src;
 			params.dst += params.dst_stride_extra;
 			params.src += params.src_stride_extra;
@@ -224,8 +316,11 @@ namespace {
 
 	static inline unsigned char*
 	color2pf_image_auto(const Color2PFParams &params) {
-		if (FLAGS(params.pf, PF_RAW_COLOR))
-			return color2pf_image<color2pf_raw>(params);
+		if (FLAGS(params.pf, PF_RAW_COLOR)) {
+			Color2PFParams p(params);
+			p.vfunc = NULL;
+			return color2pf_image<color2pf_raw>(p);
+		}
 
 		bool with_gamma    = (bool)params.gamma;
 		bool gray          = FLAGS(params.pf, PF_GRAY);
@@ -266,6 +361,8 @@ namespace {
 		int height;
 		int dst_stride_extra;
 		int src_stride_extra;
+		int pixel_size;
+		PixelFormatKernel::PF2ColorFunc vfunc;
 
 		explicit inline PF2ColorParams(
 			Color *dst = NULL,
@@ -274,7 +371,8 @@ namespace {
 			int width = 0,
 			int height = 0,
 			int dst_stride_extra = 0,
-			int src_stride_extra = 0
+			int src_stride_extra = 0,
+			PixelFormatKernel::PF2ColorFunc vfunc = NULL
 		):
 			dst(dst),
 			src(src),
@@ -282,7 +380,9 @@ namespace {
 			width(width),
 			height(height),
 			dst_stride_extra(dst_stride_extra),
-			src_stride_extra(src_stride_extra) { }
+			src_stride_extra(src_stride_extra),
+			pixel_size((int)synfig::pixel_size(pf)),
+			vfunc(vfunc) { }
 	};
 
 
@@ -343,7 +443,13 @@ namespace {
 	static const unsigned char*
 	pf2color_image(PF2ColorParams params) {
 		while(params.height-- > 0) {
-			for(int width = params.width; width > 0; --width)
+			int i = 0;
+			if (params.vfunc) {
+				i = params.vfunc(params.dst, params.src, params.width);
+				params.dst += i;
+				params.src += i*params.pixel_size;
+			}
+			for(; i < params.width; ++i)
 				params.src = func(*params.dst, params.src), ++params.dst;
 			params.dst += params.dst_stride_extra;
 			params.src += params.src_stride_extra;
@@ -369,8 +475,11 @@ namespace {
 
 	static inline const unsigned char*
 	pf2color_image_auto(const PF2ColorParams &params) {
-		if (FLAGS(params.pf, PF_RAW_COLOR))
-			return pf2color_image<pf2color_raw>(params);
+		if (FLAGS(params.pf, PF_RAW_COLOR)) {
+			PF2ColorParams p(params);
+			p.vfunc = NULL;
+			return pf2color_image<pf2color_raw>(p);
+		}
 		if (FLAGS(params.pf, PF_GRAY))
 			return pf2color_image_partauto<true,  false>(params);
 		if (FLAGS(params.pf, PF_BGR))
@@ -392,8 +501,67 @@ synfig::pixel_size(PixelFormat x)
 }
 
 
+PixelFormatKernel::PixelFormatKernel(const char *name):
+	name(name)
+{
+	memset(color2pf, 0, sizeof(color2pf));
+	memset(pf2color, 0, sizeof(pf2color));
+}
+
+
+int
+PixelFormatKernel::get_index(PixelFormat pf, bool with_gamma)
+{
+	if (FLAGS(pf, PF_RAW_COLOR))
+		return 0;
+	bool gray  = FLAGS(pf, PF_GRAY);
+	bool alpha = FLAGS(pf, PF_A);
+	return (gray                                ? INDEX_GRAY        : 0)
+	     | (!gray  && FLAGS(pf, PF_BGR)         ? INDEX_BGR         : 0)
+	     | (alpha                               ? INDEX_ALPHA       : 0)
+	     | (alpha  && FLAGS(pf, PF_A_START)     ? INDEX_ALPHA_START : 0)
+	     | (alpha  && FLAGS(pf, PF_A_PREMULT)   ? INDEX_PREMULT     : 0)
+	     | (with_gamma                          ? INDEX_GAMMA       : 0);
+}
+
+
+bool
+PixelFormatKernel::init_sse2(PixelFormatKernel &kernel)
+{
+#ifdef PIXELFORMAT_SSE2
+	assert(sizeof(Color) == 4*sizeof(float));
+	kernel = PixelFormatKernel("sse2");
+	PixelFormatTemplates::fill_kernel<TraitsSSE2>(kernel);
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+PixelFormatKernel
+PixelFormatKernel::create(const char *limit)
+{
+	std::string l = limit ? limit : "";
+	PixelFormatKernel kernel;
+	if (l != "scalar")
+		if (l == "sse2" || !init_avx2(kernel))
+			init_sse2(kernel);
+	info("PixelFormat: use %s kernel", kernel.name);
+	return kernel;
+}
+
+
+const PixelFormatKernel&
+PixelFormatKernel::get_default()
+{
+	static const PixelFormatKernel kernel = create(getenv("SYNFIG_PIXELFORMAT_KERNEL"));
+	return kernel;
+}
+
+
 unsigned char*
-synfig::color_to_pixelformat(
+PixelFormatKernel::color_to_pixelformat(
 	unsigned char *dst,
 	const Color *src,
 	PixelFormat pf,
@@ -401,30 +569,62 @@ synfig::color_to_pixelformat(
 	int width,
 	int height,
 	int dst_stride,
-	int src_stride )
+	int src_stride ) const
 {
 	assert(src_stride % sizeof(Color) == 0);
 	return color2pf_image_auto(Color2PFParams(
 		dst, src, pf, gamma, width, height,
 		dst_stride ? dst_stride - width*pixel_size(pf) : 0,
-		src_stride ? src_stride/sizeof(Color) - width  : 0 ));
+		src_stride ? src_stride/sizeof(Color) - width  : 0,
+		color2pf[get_index(pf, gamma != NULL)] ));
 }
 
 
 const unsigned char*
-synfig::pixelformat_to_color(
+PixelFormatKernel::pixelformat_to_color(
 	Color *dst,
 	const unsigned char *src,
 	PixelFormat pf,
 	int width,
 	int height,
 	int dst_stride,
-	int src_stride )
+	int src_stride ) const
 {
 	assert(dst_stride % sizeof(Color) == 0);
 	return pf2color_image_auto(PF2ColorParams(
 		dst, src, pf, width, height,
 		dst_stride ? dst_stride/sizeof(Color) - width  : 0,
-		src_stride ? src_stride - width*pixel_size(pf) : 0 ));
-	assert(src_stride % sizeof(Color) == 0);
+		src_stride ? src_stride - width*pixel_size(pf) : 0,
+		pf2color[get_index(pf, false)] ));
+}
+
+
+unsigned char*
+synfig::color_to_pixelformat(
+	unsigned char *dst,
+	const Color *src,
+	PixelFormat pf,
+	const Gamma *gamma,
+	int width,
+	int height,
+	int dst_stride,
+	int src_stride )
+{
+	return PixelFormatKernel::get_default().color_to_pixelformat(
+		dst, src, pf, gamma, width, height, dst_stride, src_stride );
+}
+
+
+const unsigned char*
+synfig::pixelformat_to_color(
+	Color *dst,
+	const unsigned char *src,
+	PixelFormat pf,
+	int width,
+	int height,
+	int dst_stride,
+	int src_stride )
+{
+	return PixelFormatKernel::get_default().pixelformat_to_color(
+		dst, src, pf, width, height, dst_stride, src_stride );
 }
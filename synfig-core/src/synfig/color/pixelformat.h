@@ -90,6 +90,67 @@ pixelformat_to_color(
 	int dst_stride = 0,
 	int src_stride = 0 );
 
+//! Set of vectorized functions which convert contiguous pixels for specific instruction set.
+//! Functions are indexed by get_index(), NULL means that format is not vectorized.
+//! Each function processes only whole groups of pixels of its instruction set
+//! and returns count of processed pixels, rest of pixels is converted by scalar code.
+//! Default kernel is selected once by CPU capabilities, it may be limited by
+//! environment variable SYNFIG_PIXELFORMAT_KERNEL ("scalar", "sse2" or "avx2").
+class PixelFormatKernel
+{
+public:
+	typedef int (*Color2PFFunc)(unsigned char *dst, const Color *src, int count, const Gamma *gamma);
+	typedef int (*PF2ColorFunc)(Color *dst, const unsigned char *src, int count);
+
+	enum {
+		INDEX_GRAY        = 1 << 0,
+		INDEX_BGR         = 1 << 1,
+		INDEX_ALPHA       = 1 << 2,
+		INDEX_ALPHA_START = 1 << 3,
+		INDEX_PREMULT     = 1 << 4,
+		INDEX_GAMMA       = 1 << 5,
+		INDEX_COUNT       = 1 << 6
+	};
+
+	const char *name;
+	Color2PFFunc color2pf[INDEX_COUNT];
+	PF2ColorFunc pf2color[INDEX_COUNT];
+
+	explicit PixelFormatKernel(const char *name = "scalar");
+
+	//! index of functions for PixelFormat, flags which are meaningless for format are dropped
+	static int get_index(PixelFormat pf, bool with_gamma);
+
+	static bool init_sse2(PixelFormatKernel &kernel);
+	static bool init_avx2(PixelFormatKernel &kernel);
+
+	//! creates the best supported kernel, but not better than 'limit' ("scalar", "sse2" or "avx2")
+	static PixelFormatKernel create(const char *limit = NULL);
+	//! kernel used by color_to_pixelformat() and pixelformat_to_color()
+	static const PixelFormatKernel& get_default();
+
+	//! the same as synfig::color_to_pixelformat() but uses functions of this kernel
+	unsigned char* color_to_pixelformat(
+		unsigned char *dst,
+		const Color *src,
+		PixelFormat pf,
+		const Gamma *gamma = NULL,
+		int width = 1,
+		int height = 1,
+		int dst_stride = 0,
+		int src_stride = 0 ) const;
+
+	//! the same as synfig::pixelformat_to_color() but uses functions of this kernel
+	const unsigned char* pixelformat_to_color(
+		Color *dst,
+		const unsigned char *src,
+		PixelFormat pf,
+		int width = 1,
+		int height = 1,
+		int dst_stride = 0,
+		int src_stride = 0 ) const;
+};
+
 } // synfig namespace
 
 #endif // __SYNFIG_COLOR_PIXELFORMAT_H
@@ -0,0 +1,179 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/color/pixelformatavx2.cpp
+**	\brief AVX2 PixelFormat conversions
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cassert>
+#include <algorithm>
+#include <cstring>
+
+#include "pixelformat.h"
+
+#endif
+
+// This file is built without -mavx2, so only the code between
+// target pragmas may use AVX2 instructions. All other headers must be
+// included before the pragmas, otherwise their inline functions
+// may be compiled with AVX2 and then used by another translation unit.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define PIXELFORMAT_AVX2
+#	include <immintrin.h>
+#	ifdef __clang__
+#		pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#	else
+#		pragma GCC push_options
+#		pragma GCC target("avx2")
+#	endif
+#	include "pixelformattemplates.h"
+#endif
+
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+#ifdef PIXELFORMAT_AVX2
+//! eight pixels per register
+class TraitsAVX2
+{
+public:
+	typedef __m256 V;
+	typedef __m256i I;
+	enum { pixels = 8 };
+
+	static V load_pair(const Color *c)
+	{
+		return _mm256_insertf128_ps(
+			_mm256_castps128_ps256(_mm_loadu_ps((const float*)c)),
+			_mm_loadu_ps((const float*)(c + 4)), 1 );
+	}
+
+	static void store_pair(Color *c, const V &v)
+	{
+		_mm_storeu_ps((float*)c, _mm256_castps256_ps128(v));
+		_mm_storeu_ps((float*)(c + 4), _mm256_extractf128_ps(v, 1));
+	}
+
+	// each 128-bit lane is transposed separately, so lanes holds pixels 0-3 and 4-7
+	static void load_colors(const Color *c, V &r, V &g, V &b, V &a)
+	{
+		V t0 = load_pair(c + 0), t1 = load_pair(c + 1), t2 = load_pair(c + 2), t3 = load_pair(c + 3);
+		V u0 = _mm256_unpacklo_ps(t0, t1), u1 = _mm256_unpackhi_ps(t0, t1);
+		V u2 = _mm256_unpacklo_ps(t2, t3), u3 = _mm256_unpackhi_ps(t2, t3);
+		r = _mm256_shuffle_ps(u0, u2, _MM_SHUFFLE(1, 0, 1, 0));
+		g = _mm256_shuffle_ps(u0, u2, _MM_SHUFFLE(3, 2, 3, 2));
+		b = _mm256_shuffle_ps(u1, u3, _MM_SHUFFLE(1, 0, 1, 0));
+		a = _mm256_shuffle_ps(u1, u3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	static void store_colors(Color *c, const V &r, const V &g, const V &b, const V &a)
+	{
+		V u0 = _mm256_unpacklo_ps(r, g), u1 = _mm256_unpackhi_ps(r, g);
+		V u2 = _mm256_unpacklo_ps(b, a), u3 = _mm256_unpackhi_ps(b, a);
+		store_pair(c + 0, _mm256_shuffle_ps(u0, u2, _MM_SHUFFLE(1, 0, 1, 0)));
+		store_pair(c + 1, _mm256_shuffle_ps(u0, u2, _MM_SHUFFLE(3, 2, 3, 2)));
+		store_pair(c + 2, _mm256_shuffle_ps(u1, u3, _MM_SHUFFLE(1, 0, 1, 0)));
+		store_pair(c + 3, _mm256_shuffle_ps(u1, u3, _MM_SHUFFLE(3, 2, 3, 2)));
+	}
+
+	static void load4(const unsigned char *p, I &c0, I &c1, I &c2, I &c3)
+	{
+		const I mask = _mm256_set1_epi32(255);
+		I x = _mm256_loadu_si256((const I*)p);
+		c0 = _mm256_and_si256(x, mask);
+		c1 = _mm256_and_si256(_mm256_srli_epi32(x, 8), mask);
+		c2 = _mm256_and_si256(_mm256_srli_epi32(x, 16), mask);
+		c3 = _mm256_srli_epi32(x, 24);
+	}
+
+	static void store4(unsigned char *p, const I &c0, const I &c1, const I &c2, const I &c3)
+	{
+		_mm256_storeu_si256((I*)p, _mm256_or_si256(
+			_mm256_or_si256(c0, _mm256_slli_epi32(c1, 8)),
+			_mm256_or_si256(_mm256_slli_epi32(c2, 16), _mm256_slli_epi32(c3, 24)) ));
+	}
+
+	static V set1(float x) { return _mm256_set1_ps(x); }
+	static V add(const V &a, const V &b) { return _mm256_add_ps(a, b); }
+	static V mul(const V &a, const V &b) { return _mm256_mul_ps(a, b); }
+	static V div(const V &a, const V &b) { return _mm256_div_ps(a, b); }
+	// max() returns second argument when first one is NaN, so NaN becomes zero as in scalar code
+	static V min(const V &a, const V &b) { return _mm256_min_ps(a, b); }
+	static V max(const V &a, const V &b) { return _mm256_max_ps(a, b); }
+	static V neq(const V &a, const V &b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+	static V select(const V &mask, const V &a, const V &b) { return _mm256_blendv_ps(b, a, mask); }
+
+	static V cvt(const I &x) { return _mm256_cvtepi32_ps(x); }
+	static I cvtt(const V &x) { return _mm256_cvttps_epi32(x); }
+
+	// gather reads 32-bit values, so it reads pair of previous and requested entries
+	// to not touch memory after the table, previous entry of the first one
+	// is still inside of the Gamma object
+	static V lookup(const unsigned short *table, const I &index)
+	{
+		I x = _mm256_i32gather_epi32((const int*)(const void*)(table - 1), index, 2);
+		return _mm256_cvtepi32_ps(_mm256_srli_epi32(x, 16));
+	}
+};
+#endif
+
+}
+
+#ifdef PIXELFORMAT_AVX2
+#	ifdef __clang__
+#		pragma clang attribute pop
+#	else
+#		pragma GCC pop_options
+#	endif
+#endif
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+bool
+PixelFormatKernel::init_avx2(PixelFormatKernel &kernel)
+{
+#ifdef PIXELFORMAT_AVX2
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("avx2"))
+		return false;
+	assert(sizeof(Color) == 4*sizeof(float));
+	kernel = PixelFormatKernel("avx2");
+	PixelFormatTemplates::fill_kernel<TraitsAVX2>(kernel);
+	return true;
+#else
+	return false;
+#endif
+}
+
+/* === E N T R Y P O I N T ================================================= */
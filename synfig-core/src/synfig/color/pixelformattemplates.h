@@ -0,0 +1,274 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/color/pixelformattemplates.h
+**	\brief Vectorized PixelFormat conversions
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_COLOR_PIXELFORMATTEMPLATES_H
+#define __SYNFIG_COLOR_PIXELFORMATTEMPLATES_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <algorithm>
+#include <cstring>
+
+#include "pixelformat.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+
+//! Conversions from pixelformat.cpp written for vector registers.
+//! Colors are transposed, so each register holds one channel of T::pixels colors.
+//! All integer math of scalar code is done with floats, products are less than 2^24,
+//! so they are exact and the result is the same as result of scalar code.
+//! Template argument T describes the instruction set, it should provide:
+//!   - types V (floats) and I (32-bit integers), each holds T::pixels values,
+//!   - load_colors(), store_colors() - unaligned load and store with transposition,
+//!   - load4(), store4() - unaligned load and store of 4-byte pixels split by bytes,
+//!   - set1(), add(), mul(), div(), min(), max(), select(), neq(),
+//!   - cvt() (from I to V), cvtt() (from V to I with truncation),
+//!   - lookup() - reads values from table of unsigned shorts by indices.
+//! Kernels are instantiated separately for each instruction set,
+//! so this file should be included only where the instruction set is enabled.
+class PixelFormatTemplates
+{
+public:
+	template<typename T>
+	static typename T::V clamp(const typename T::V &x)
+		{ return T::min(T::max(x, T::set1(0.f)), T::set1(1.f)); }
+
+	// truncation of non-negative value, the same as conversion to int in scalar code
+	template<typename T>
+	static typename T::V trunc(const typename T::V &x)
+		{ return T::cvt(T::cvtt(x)); }
+
+	// scalar code clamps value after scaling when gamma is not used,
+	// do the same to keep the output identical
+	template<typename T, bool with_gamma>
+	static typename T::V to_u16(const typename T::V &x, const Gamma *gamma, int channel)
+	{
+		if (!with_gamma)
+			return trunc<T>(clamp<T>(T::mul(x, T::set1(65535.9f))));
+		typename T::I i = T::cvtt(T::mul(clamp<T>(x), T::set1(65535.9f)));
+		return T::lookup(gamma->get_table_U16_to_U16(channel), i);
+	}
+
+	template<
+		typename T,
+		bool with_gamma,
+		bool gray,
+		bool bgr,
+		bool alpha,
+		bool alpha_start,
+		bool alpha_premult >
+	static int color2pf(
+		unsigned char *dst,
+		const Color *src,
+		int count,
+		const Gamma *gamma )
+	{
+		typedef typename T::V V;
+		typedef typename T::I I;
+
+		const int pixels = T::pixels;
+		const int channels = (gray ? 1 : 3) + (alpha ? 1 : 0);
+		const bool simple = !with_gamma && !gray && !alpha_premult;
+		const int yuv_r = (int)(EncodeYUV[0][0]*256.f);
+		const int yuv_g = (int)(EncodeYUV[0][1]*256.f);
+		const int yuv_b = 256 - yuv_r - yuv_g;
+
+		const int processed = count - count%pixels;
+		for(const Color *end = src + processed; src < end; src += pixels, dst += pixels*channels) {
+			V r, g, b, a;
+			T::load_colors(src, r, g, b, a);
+
+			I ac = T::cvtt(T::mul(clamp<T>(a), T::set1(255.9f)));
+			I c0, c1, c2;
+
+			if (simple) {
+				c0 = T::cvtt(T::mul(clamp<T>(r), T::set1(255.9f)));
+				c1 = T::cvtt(T::mul(clamp<T>(g), T::set1(255.9f)));
+				c2 = T::cvtt(T::mul(clamp<T>(b), T::set1(255.9f)));
+			} else {
+				V ri = to_u16<T, with_gamma>(r, gamma, 0);
+				V gi = to_u16<T, with_gamma>(g, gamma, 1);
+				V bi = to_u16<T, with_gamma>(b, gamma, 2);
+
+				if (alpha && alpha_premult) {
+					V ai = T::add(T::cvt(ac), T::set1(1.f));
+					if (gray) {
+						V k = T::mul(ai, T::set1(1.f/256.f));
+						V y = T::add(T::add(
+							T::mul(trunc<T>(T::mul(ri, k)), T::set1((float)yuv_r)),
+							T::mul(trunc<T>(T::mul(gi, k)), T::set1((float)yuv_g)) ),
+							T::mul(trunc<T>(T::mul(bi, k)), T::set1((float)yuv_b)) );
+						c0 = c1 = c2 = T::cvtt(T::mul(y, T::set1(1.f/65536.f)));
+					} else {
+						// ai is not multiplied by 1/65536 before, because ri*ai should be exact
+						c0 = T::cvtt(T::mul(T::mul(ri, ai), T::set1(1.f/65536.f)));
+						c1 = T::cvtt(T::mul(T::mul(gi, ai), T::set1(1.f/65536.f)));
+						c2 = T::cvtt(T::mul(T::mul(bi, ai), T::set1(1.f/65536.f)));
+					}
+				} else {
+					if (gray) {
+						V y = T::add(T::add(
+							T::mul(ri, T::set1((float)yuv_r)),
+							T::mul(gi, T::set1((float)yuv_g)) ),
+							T::mul(bi, T::set1((float)yuv_b)) );
+						c0 = c1 = c2 = T::cvtt(T::mul(y, T::set1(1.f/65536.f)));
+					} else {
+						c0 = T::cvtt(T::mul(ri, T::set1(1.f/256.f)));
+						c1 = T::cvtt(T::mul(gi, T::set1(1.f/256.f)));
+						c2 = T::cvtt(T::mul(bi, T::set1(1.f/256.f)));
+					}
+				}
+			}
+
+			if (bgr) std::swap(c0, c2);
+
+			if (channels == 4) {
+				if (alpha_start) T::store4(dst, ac, c0, c1, c2);
+				            else T::store4(dst, c0, c1, c2, ac);
+			} else
+			if (channels == 3) {
+				unsigned char buffer[4*pixels];
+				T::store4(buffer, c0, c1, c2, ac);
+				for(int i = 0; i < pixels; ++i)
+					memcpy(dst + 3*i, buffer + 4*i, 3);
+			} else {
+				unsigned char buffer[4*pixels];
+				T::store4(buffer, c0, ac, c0, c0);
+				for(int i = 0; i < pixels; ++i) {
+					if (alpha && alpha_start) {
+						dst[2*i] = buffer[4*i + 1];
+						dst[2*i + 1] = buffer[4*i];
+					} else
+					if (alpha) {
+						dst[2*i] = buffer[4*i];
+						dst[2*i + 1] = buffer[4*i + 1];
+					} else {
+						dst[i] = buffer[4*i];
+					}
+				}
+			}
+		}
+		return processed;
+	}
+
+	// only 4-byte pixels, unpacking of 3-byte pixels is not faster than scalar code
+	template<
+		typename T,
+		bool bgr,
+		bool alpha_start,
+		bool alpha_premult >
+	static int pf2color(
+		Color *dst,
+		const unsigned char *src,
+		int count )
+	{
+		typedef typename T::V V;
+		typedef typename T::I I;
+
+		const int pixels = T::pixels;
+		const V k = T::set1(ColorReal(1.0/255.0));
+
+		const int processed = count - count%pixels;
+		for(const Color *end = dst + processed; dst < end; dst += pixels, src += pixels*4) {
+			I c0, c1, c2, c3;
+			if (alpha_start) T::load4(src, c3, c0, c1, c2);
+			            else T::load4(src, c0, c1, c2, c3);
+			if (bgr) std::swap(c0, c2);
+
+			V r = T::mul(k, T::cvt(c0));
+			V g = T::mul(k, T::cvt(c1));
+			V b = T::mul(k, T::cvt(c2));
+			V a = T::mul(k, T::cvt(c3));
+
+			if (alpha_premult) {
+				V mask = T::neq(a, T::set1(0.f));
+				V inva = T::div(T::set1(1.f), a);
+				r = T::select(mask, T::mul(r, inva), T::set1(0.f));
+				g = T::select(mask, T::mul(g, inva), T::set1(0.f));
+				b = T::select(mask, T::mul(b, inva), T::set1(0.f));
+			}
+
+			T::store_colors(dst, r, g, b, a);
+		}
+		return processed;
+	}
+
+	// fills functions for meaningful combinations of flags only
+	template<typename T, int index, bool valid = (index & PixelFormatKernel::INDEX_ALPHA)
+	                                          || !(index & (PixelFormatKernel::INDEX_ALPHA_START | PixelFormatKernel::INDEX_PREMULT))>
+	class Filler
+	{
+	public:
+		static void fill(PixelFormatKernel &kernel)
+		{
+			const bool with_gamma    = index & PixelFormatKernel::INDEX_GAMMA;
+			const bool gray          = index & PixelFormatKernel::INDEX_GRAY;
+			const bool bgr           = index & PixelFormatKernel::INDEX_BGR;
+			const bool alpha         = index & PixelFormatKernel::INDEX_ALPHA;
+			const bool alpha_start   = index & PixelFormatKernel::INDEX_ALPHA_START;
+			const bool alpha_premult = index & PixelFormatKernel::INDEX_PREMULT;
+			if (!(gray && bgr))
+				kernel.color2pf[index] = &color2pf<T, with_gamma, gray, bgr, alpha, alpha_start, alpha_premult>;
+			if (!gray && !with_gamma && alpha)
+				kernel.pf2color[index] = &pf2color<T, bgr, alpha_start, alpha_premult>;
+		}
+	};
+
+	template<typename T, int index>
+	class Filler<T, index, false>
+		{ public: static void fill(PixelFormatKernel&) { } };
+
+	template<typename T, int index>
+	class Iterator
+	{
+	public:
+		static void fill(PixelFormatKernel &kernel)
+		{
+			enum { next = index - 1 };
+			Filler<T, next>::fill(kernel);
+			Iterator<T, next>::fill(kernel);
+		}
+	};
+
+	template<typename T>
+	class Iterator<T, 0>
+		{ public: static void fill(PixelFormatKernel&) { } };
+
+	template<typename T>
+	static void fill_kernel(PixelFormatKernel &kernel)
+		{ Iterator<T, PixelFormatKernel::INDEX_COUNT>::fill(kernel); }
+};
+
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -86,6 +86,9 @@ public:
 	inline unsigned short g_U16_to_U16(unsigned short i) const { return U16_to_U16(1, i); }
 	inline unsigned short b_U16_to_U16(unsigned short i) const { return U16_to_U16(2, i); }
 
+	//! table of U16_to_U16(), used by vectorized conversions
+	inline const unsigned short* get_table_U16_to_U16(int channel) const { return table_U16_to_U16[channel]; }
+
 	inline unsigned char U16_to_U8(int channel, unsigned short i) const { return (unsigned char)(U16_to_U16(channel, i) >> 8); }
 	inline unsigned char r_U16_to_U8(unsigned short i) const { return U16_to_U8(0, i); }
 	inline unsigned char g_U16_to_U8(unsigned short i) const { return U16_to_U8(1, i); }
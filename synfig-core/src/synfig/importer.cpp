@@ -63,6 +63,7 @@ using namespace synfig;
 Importer::Book* synfig::Importer::book_;
 
 static map<FileSystem::Identifier,Importer::LooseHandle> *__open_importers;
+static Glib::Threads::RecMutex open_importers_mutex;
 
 /* === P R O C E D U R E S ================================================= */
 
@@ -91,24 +92,14 @@ Importer::book()
 }
 
 Importer::Handle
-Importer::open(const FileSystem::Identifier &identifier, bool force)
+Importer::create_unshared(const FileSystem::Identifier &identifier)
 {
-	if (force) forget(identifier); // force reload
-
 	if(identifier.filename.empty())
 	{
 		synfig::error(_("Importer::open(): Cannot open empty filename"));
 		return 0;
 	}
 
-	// If we already have an importer open under that filename,
-	// then use it instead.
-	if(__open_importers->count(identifier))
-	{
-		//synfig::info("Found importer already open, using it...");
-		return (*__open_importers)[identifier];
-	}
-
 	if(filename_extension(identifier.filename) == "")
 	{
 		synfig::error(_("Importer::open(): Couldn't find extension"));
@@ -119,18 +110,15 @@ Importer::open(const FileSystem::Identifier &identifier, bool force)
 	if (ext.size()) ext = ext.substr(1); // skip initial '.'
 	std::transform(ext.begin(),ext.end(),ext.begin(),&::tolower);
 
-
-	if(!Importer::book().count(ext))
+	Book::const_iterator i = book().find(ext);
+	if(i == book().end())
 	{
 		synfig::error(_("Importer::open(): Unknown file type -- ")+ext);
 		return 0;
 	}
 
 	try {
-		Importer::Handle importer;
-		importer=Importer::book()[ext].factory(identifier);
-		(*__open_importers)[identifier]=importer;
-		return importer;
+		return i->second.factory(identifier);
 	}
 	catch (String str)
 	{
@@ -139,8 +127,30 @@ Importer::open(const FileSystem::Identifier &identifier, bool force)
 	return 0;
 }
 
+Importer::Handle
+Importer::open(const FileSystem::Identifier &identifier, bool force)
+{
+	if (force) forget(identifier); // force reload
+
+	Glib::Threads::RecMutex::Lock lock(open_importers_mutex);
+
+	// If we already have an importer open under that filename,
+	// then use it instead.
+	if(__open_importers->count(identifier))
+	{
+		//synfig::info("Found importer already open, using it...");
+		return (*__open_importers)[identifier];
+	}
+
+	Importer::Handle importer = create_unshared(identifier);
+	if (importer)
+		(*__open_importers)[identifier]=importer;
+	return importer;
+}
+
 void Importer::forget(const FileSystem::Identifier &identifier)
 {
+	Glib::Threads::RecMutex::Lock lock(open_importers_mutex);
 	__open_importers->erase(identifier);
 }
 
@@ -153,7 +163,9 @@ Importer::Importer(const FileSystem::Identifier &identifier):
 
 Importer::~Importer()
 {
-	// Remove ourselves from the open importer list
+	// Remove ourselves from the open importer list,
+	// importers may be destroyed in other threads (see create_unshared)
+	Glib::Threads::RecMutex::Lock lock(open_importers_mutex);
 	map<FileSystem::Identifier,Importer::LooseHandle>::iterator iter;
 	for(iter=__open_importers->begin();iter!=__open_importers->end();)
 		if(iter->second==this)
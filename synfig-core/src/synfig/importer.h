@@ -191,6 +191,9 @@ public:
 
 	//! Attempts to open \a filename, and returns a handle to the associated Importer
 	static Handle open(const FileSystem::Identifier &identifier, bool force=false);
+	//! Creates new Importer for \a filename which is not shared with other callers of open(),
+	//! so it may be used and released in any thread
+	static Handle create_unshared(const FileSystem::Identifier &identifier);
 	static void forget(const FileSystem::Identifier &identifier);
 };
 
@@ -45,6 +45,7 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 
+#include <synfig/rendering/common/task/taskaccumulate.h>
 #include <synfig/rendering/common/task/taskblend.h>
 
 #endif
@@ -267,6 +268,28 @@ Layer_Duplicate::build_rendering_task_vfunc(Context context) const
 	ColorReal amount = get_amount() * Context::z_depth_visibility(context.get_params(), *this);
 	Color::BlendMethod blend_method = get_blend_method();
 
+	// sub-tasks are built one by one, because context.set_time()
+	// changes the state of the layers, but rendering of the copies
+	// will be independent
+	if (rendering::TaskAccumulate::is_blend_method_supported(blend_method))
+	{
+		rendering::TaskAccumulate::Handle task(new rendering::TaskAccumulate());
+		task->blend_method = blend_method;
+
+		Mutex::Lock lock(mutex);
+		duplicate_param->reset_index(time_cur);
+		do
+		{
+			context.set_time(time_cur, true);
+			task->add(context.build_rendering_task(), amount);
+		}
+		while (duplicate_param->step(time_cur));
+
+		return task;
+	}
+
+	// straight blend methods depends on the previous copies outside of the copy bounds,
+	// so build the chain of blendings
 	rendering::Task::Handle task;
 
 	Mutex::Lock lock(mutex);
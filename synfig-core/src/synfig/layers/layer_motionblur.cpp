@@ -45,7 +45,7 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 
-#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/common/task/taskaccumulate.h>
 
 #endif
 
@@ -451,7 +451,8 @@ Layer_MotionBlur::build_rendering_task_vfunc(Context context) const
 	}
 
 	Real k = 1.0/sum;
-	rendering::Task::Handle task;
+	rendering::TaskAccumulate::Handle task(new rendering::TaskAccumulate());
+	task->blend_method = Color::BLEND_ADD_COMPOSITE;
 	for(int i = 0; i < samples; i++)
 	{
 		if (fabs(scales[i]*k) < 1e-8)
@@ -461,12 +462,8 @@ Layer_MotionBlur::build_rendering_task_vfunc(Context context) const
 		Real ipos = 1.0 - pos;
 		context.set_time(get_time_mark() - aperture*ipos);
 
-		rendering::TaskBlend::Handle task_blend(new rendering::TaskBlend());
-		task_blend->amount = scales[i]*k;
-		task_blend->blend_method = Color::BLEND_ADD_COMPOSITE;
-		task_blend->sub_task_a() = task;
-		task_blend->sub_task_b() = context.build_rendering_task();
-		task = task_blend;
+		// samples are independent and will be rendered simultaneously
+		task->add(context.build_rendering_task(), scales[i]*k);
 	}
 
 	return task;
@@ -127,16 +127,22 @@ Layer_Sound::get_param_vocab()const
 	return ret;
 }
 
-void
-Layer_Sound::fill_sound_processor(SoundProcessor &soundProcessor) const
+String
+Layer_Sound::get_real_filename() const
 {
 	if (!get_canvas() || !get_canvas()->get_file_system())
-		return;
+		return String();
 
 	String filename = param_filename.get(String());
 	filename = CanvasFileNaming::make_full_filename(get_canvas()->get_file_name(), filename);
 	filename = get_canvas()->get_file_system()->get_real_uri(filename);
-	filename = Glib::filename_from_uri(filename);
+	return filename.empty() ? String() : Glib::filename_from_uri(filename);
+}
+
+void
+Layer_Sound::fill_sound_processor(SoundProcessor &soundProcessor) const
+{
+	String filename = get_real_filename();
 	if (filename.empty())
 		return;
 
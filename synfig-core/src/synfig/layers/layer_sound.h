@@ -51,6 +51,10 @@ public:
 	virtual bool set_param(const String & param, const synfig::ValueBase &value);
 	virtual ValueBase get_param(const String & param)const;
 	virtual Vocab get_param_vocab()const;
+
+	//! Returns name of sound file in native file system, or empty string
+	String get_real_filename()const;
+
 	virtual void fill_sound_processor(SoundProcessor &soundProcessor) const;
 	virtual rendering::Task::Handle build_rendering_task_vfunc(Context context)const;
 }; // END of class Layer_SolidColor
@@ -30,14 +30,18 @@
 #	include <config.h>
 #endif
 
+#include <cstdlib>
 #include <fstream>
 
+#include <sigc++/bind.h>
+
 #include "listimporter.h"
 
 #include "general.h"
 #include <synfig/localization.h>
 
 #include "filesystemnative.h"
+#include "threadpool.h"
 #include <synfig/rendering/software/surfacesw.h>
 
 
@@ -51,7 +55,11 @@ using namespace synfig;
 
 /* === M A C R O S ========================================================= */
 
-#define LIST_IMPORTER_CACHE_SIZE	20
+//! Default size of cache in megabytes,
+//! may be changed by environment variable SYNFIG_LIST_IMPORTER_CACHE_SIZE
+#define LIST_IMPORTER_CACHE_SIZE	256
+//! Max count of next frames to decode in background
+#define LIST_IMPORTER_PREFETCH_FRAMES	8
 
 /* === G L O B A L S ======================================================= */
 
@@ -68,10 +76,22 @@ SYNFIG_IMPORTER_SET_SUPPORTS_FILE_SYSTEM_WRAPPER(ListImporter, false);
 
 //TODO factorize code with cairolistimporter.cpp
 ListImporter::ListImporter(const FileSystem::Identifier &identifier):
-Importer(identifier)
+	Importer(identifier),
+	cache_size(),
+	max_cache_size((size_t)LIST_IMPORTER_CACHE_SIZE*1024*1024),
+	frame_size(),
+	prefetch_count(LIST_IMPORTER_PREFETCH_FRAMES),
+	loading_count(),
+	access_counter(),
+	hits(),
+	misses(),
+	last_document_frame()
 {
 	fps=15;
 
+	if (const char *s = getenv("SYNFIG_LIST_IMPORTER_CACHE_SIZE"))
+		max_cache_size = (size_t)std::max(0, atoi(s))*1024*1024;
+
 	ifstream stream(identifier.filename.c_str());
 
 	if(!stream)
@@ -158,56 +178,176 @@ Importer(identifier)
 
 ListImporter::~ListImporter()
 {
+	if (hits || misses)
+		synfig::info("ListImporter: %s: cache hits %lld, misses %lld", identifier.filename.c_str(), hits, misses);
 }
 
-Importer::Handle
-ListImporter::get_sub_importer(const RendDesc &renddesc, Time time, ProgressCallback *cb)
+int
+ListImporter::get_frame_index(const RendDesc &renddesc, int document_frame) const
 {
 	float document_fps=renddesc.get_frame_rate();
-	int document_frame=round_to_int(time*document_fps);
 	int frame=floor_to_int(document_frame*fps/document_fps);
+	if(frame>=(signed)filename_list.size())frame=filename_list.size()-1;
+	if(frame<0)frame=0;
+	return frame;
+}
 
-	if(!filename_list.size())
+rendering::Surface::Handle
+ListImporter::load_surface(const String &filename, const RendDesc &renddesc)
+{
+	// importer is not shared, so it will not be reused by other threads
+	Importer::Handle importer(Importer::create_unshared(FileSystem::Identifier(FileSystemNative::instance(), filename)));
+	if(!importer)
 	{
-		if (cb) cb->error(_("No images in list"));
-		else synfig::error(_("No images in list"));
-		return Importer::Handle();
+		synfig::error(_("Unable to open ")+filename);
+		return rendering::Surface::Handle();
 	}
+	return importer->get_frame(renddesc, 0);
+}
 
-	if(frame<0)frame=0;
-	if(frame>=(signed)filename_list.size())frame=filename_list.size()-1;
+void
+ListImporter::load_in_background(etl::handle<ListImporter> importer, String filename, RendDesc renddesc)
+{
+	rendering::Surface::Handle surface;
+	try { surface = load_surface(filename, renddesc); } catch(...) { }
 
-	const String &filename = filename_list[frame];
-	Importer::Handle importer(Importer::open(FileSystem::Identifier(FileSystemNative::instance(), filename)));
-	if(!importer)
+	Glib::Threads::Mutex::Lock lock(importer->mutex);
+	--importer->loading_count;
+	importer->put_to_cache(filename, surface);
+}
+
+void
+ListImporter::put_to_cache(const String &filename, const rendering::Surface::Handle &surface)
+{
+	CacheEntry &entry = cache[filename];
+	cache_size -= entry.size;
+	entry.surface = surface;
+	entry.size = surface ? surface->get_buffer_size() : 0;
+	entry.loading = false;
+	entry.last_access = ++access_counter;
+	cache_size += entry.size;
+	if (entry.size) frame_size = entry.size;
+
+	shrink_cache(filename);
+	cond.broadcast();
+}
+
+void
+ListImporter::shrink_cache(const String &keep_filename)
+{
+	// remove least recently used images
+	while(cache_size > max_cache_size)
 	{
-		if(cb)cb->error(_("Unable to open ")+filename);
-		else synfig::error(_("Unable to open ")+filename);
-		return Importer::Handle();
+		Cache::iterator oldest = cache.end();
+		for(Cache::iterator i = cache.begin(); i != cache.end(); ++i)
+			if ( !i->second.loading
+			  && i->second.size
+			  && i->first != keep_filename
+			  && (oldest == cache.end() || i->second.last_access < oldest->second.last_access) )
+				oldest = i;
+		if (oldest == cache.end()) break;
+		cache_size -= oldest->second.size;
+		cache.erase(oldest);
 	}
+}
 
-	for(std::list<Importer::Handle>::iterator i = frame_cache.begin(); i != frame_cache.end();)
-		if (*i == importer) i = frame_cache.erase(i); else ++i;
+void
+ListImporter::prefetch(const RendDesc &renddesc, int document_frame, int direction)
+{
+	float document_fps=renddesc.get_frame_rate();
+	int begin=round_to_int(renddesc.get_time_start()*document_fps);
+	int end=round_to_int(renddesc.get_time_end()*document_fps);
+
+	for(int i = 1; i <= prefetch_count; ++i)
+	{
+		int frame = document_frame + i*direction;
+		if (frame < begin || frame > end) break;
+
+		// do not load more than cache can hold,
+		// otherwise prefetched images will push out each other
+		if (cache_size + (loading_count + 1)*frame_size > max_cache_size) break;
 
-	while (frame_cache.size() >= LIST_IMPORTER_CACHE_SIZE)
-		frame_cache.pop_front();
-	frame_cache.push_back(importer);
+		const String &filename = filename_list[get_frame_index(renddesc, frame)];
+		if (cache.count(filename)) continue;
 
-	return importer;
+		cache[filename].loading = true;
+		++loading_count;
+		ThreadPool::instance.enqueue( sigc::bind(
+			sigc::ptr_fun(&ListImporter::load_in_background),
+			etl::handle<ListImporter>(this), filename, renddesc ));
+	}
+}
+
+rendering::Surface::Handle
+ListImporter::get_surface(const RendDesc &renddesc, Time time)
+{
+	if(!filename_list.size())
+	{
+		synfig::error(_("No images in list"));
+		return rendering::Surface::Handle();
+	}
+
+	float document_fps=renddesc.get_frame_rate();
+	int document_frame=round_to_int(time*document_fps);
+	const String &filename = filename_list[get_frame_index(renddesc, document_frame)];
+
+	Glib::Threads::Mutex::Lock lock(mutex);
+
+	int direction = document_frame < last_document_frame ? -1 : 1;
+	last_document_frame = document_frame;
+
+	bool found = false;
+	rendering::Surface::Handle surface;
+	for(Cache::iterator i = cache.find(filename); i != cache.end(); i = cache.find(filename))
+	{
+		found = true;
+		if (!i->second.loading)
+		{
+			i->second.last_access = ++access_counter;
+			surface = i->second.surface;
+			break;
+		}
+		// wait while image loading in background,
+		// let ThreadPool know that current thread is not busy
+		ThreadPool::instance.wait(cond, mutex);
+	}
+
+	if (found)
+	{
+		++hits;
+	}
+	else
+	{
+		++misses;
+		cache[filename].loading = true;
+		lock.release();
+		surface = load_surface(filename, renddesc);
+		lock.acquire();
+		put_to_cache(filename, surface);
+	}
+
+	prefetch(renddesc, document_frame, direction);
+	return surface;
 }
 
 bool
 ListImporter::get_frame(Surface &surface, const RendDesc &renddesc, Time time, ProgressCallback *cb)
 {
-	Importer::Handle importer = get_sub_importer(renddesc, time, cb);
-	return importer && importer->get_frame(surface, renddesc, 0, cb);
+	rendering::Surface::Handle s = get_surface(renddesc, time);
+	if (!s || !s->is_exists())
+	{
+		if (cb) cb->error(_("Unable to get frame from image list"));
+		return false;
+	}
+	surface.set_wh(s->get_width(), s->get_height());
+	return s->get_pixels(&surface[0][0]);
 }
 
 rendering::Surface::Handle
 ListImporter::get_frame(const RendDesc &renddesc, const Time &time)
 {
-	Importer::Handle importer = get_sub_importer(renddesc, time, NULL);
-	return importer ? importer->get_frame(renddesc, 0) : new rendering::SurfaceSW();
+	rendering::Surface::Handle surface = get_surface(renddesc, time);
+	return surface ? surface : rendering::Surface::Handle(new rendering::SurfaceSW());
 }
 
 bool
@@ -215,3 +355,17 @@ ListImporter::is_animated()
 {
 	return true;
 }
+
+long long
+ListImporter::get_cache_hits()
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	return hits;
+}
+
+long long
+ListImporter::get_cache_misses()
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	return misses;
+}
@@ -31,8 +31,9 @@
 #include "importer.h"
 #include "surface.h"
 #include <ETL/smart_ptr>
+#include <glibmm/threads.h>
 #include <vector>
-#include <list>
+#include <map>
 #include <utility>
 
 /* === M A C R O S ========================================================= */
@@ -44,17 +45,51 @@
 namespace synfig {
 
 /*!	\class ListImporter
-**	\todo Write more detailed description
+**	\brief Imports sequence of images listed in text file.
+**	Decoded images are stored in cache limited by size in bytes.
+**	Images of the next frames of the document are decoded in background
+**	threads, so rendering of sequence does not wait for decoding.
 */
 class ListImporter : public Importer
 {
 	SYNFIG_IMPORTER_MODULE_EXT
 private:
+	struct CacheEntry
+	{
+		rendering::Surface::Handle surface;
+		size_t size;
+		bool loading;
+		long long last_access;
+		CacheEntry(): size(), loading(), last_access() { }
+	};
+	typedef std::map<String, CacheEntry> Cache;
+
 	float fps;
 	std::vector<String> filename_list;
-	std::list<Importer::Handle> frame_cache;
 
-	Importer::Handle get_sub_importer(const RendDesc &renddesc, Time time, ProgressCallback *cb);
+	Glib::Threads::Mutex mutex;
+	Glib::Threads::Cond cond;
+	Cache cache;
+	size_t cache_size;
+	size_t max_cache_size;
+	size_t frame_size;
+	int prefetch_count;
+	int loading_count;
+	long long access_counter;
+	long long hits;
+	long long misses;
+	int last_document_frame;
+
+	int get_frame_index(const RendDesc &renddesc, int document_frame) const;
+	rendering::Surface::Handle get_surface(const RendDesc &renddesc, Time time);
+
+	// following functions should be called with locked mutex
+	void put_to_cache(const String &filename, const rendering::Surface::Handle &surface);
+	void shrink_cache(const String &keep_filename);
+	void prefetch(const RendDesc &renddesc, int document_frame, int direction);
+
+	static rendering::Surface::Handle load_surface(const String &filename, const RendDesc &renddesc);
+	static void load_in_background(etl::handle<ListImporter> importer, String filename, RendDesc renddesc);
 
 public:
 	ListImporter(const FileSystem::Identifier &identifier);
@@ -65,6 +100,10 @@ public:
 	virtual rendering::Surface::Handle get_frame(const RendDesc &renddesc, const Time &time);
 	virtual bool is_animated();
 
+	//! Count of requested images which was found in cache (or was loading in background)
+	long long get_cache_hits();
+	//! Count of requested images which was loaded synchronously
+	long long get_cache_misses();
 };
 
 }; // END of namespace synfig
@@ -34,21 +34,27 @@
 #	include <config.h>
 #endif
 
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
+#include <algorithm>
+#include <exception>
 #include <iostream>
 #include <map>
 #include <vector>
 #include <stdexcept>
 
 #include <libxml++/libxml++.h>
+#include <libxml/parser.h>
+#include <libxml/SAX2.h>
 #include <sigc++/bind.h>
 
 #include <ETL/stringf>
 
 #include "loadcanvas.h"
+#include "canvascache.h"
 
 #include "general.h"
 #include "localization.h"
@@ -167,6 +173,7 @@ synfig::open_canvas_as(const FileSystem::Identifier &identifier,const String &as
 	Canvas::Handle canvas;
 	CanvasParser parser;
 	parser.set_allow_errors(true);
+	parser.set_cache(getenv("SYNFIG_CANVAS_CACHE") != NULL);
 
 	try
 	{
@@ -191,6 +198,233 @@ synfig::open_canvas_as(const FileSystem::Identifier &identifier,const String &as
 	return canvas;
 }
 
+/* === C L A S S E S ======================================================= */
+
+/*!	\class CanvasParser::StreamParser
+**	\brief Streaming parser of sif documents.
+**
+**	Document is read by the SAX parser of libxml2 chunk by chunk.
+**	The tree of elements is built only for one child of the root canvas
+**	(or for one item of its <defs> section) at time, this tree is passed
+**	to CanvasParser and then released. So the whole document tree
+**	is never kept in memory, and parsing goes simultaneously with
+**	reading and decompression of the stream.
+*/
+class CanvasParser::StreamParser
+{
+public:
+	enum { chunk_size = 64*1024 };
+
+private:
+	CanvasParser &parser;
+	const FileSystem::Identifier &identifier;
+	const String &path;
+
+	xmlParserCtxtPtr context;
+	std::exception_ptr exception;
+	String xml_error;
+
+	int depth;
+	bool in_defs;
+	bool skip;
+
+	xmlpp::Document root_document;
+	xmlpp::Element *root;
+	Canvas::Handle canvas;
+	std::list<ValueNode::Handle> bone_list;
+
+	xmlpp::Document *document;
+	xmlpp::Element *current;
+	int document_depth;
+	String text;
+
+	static String qualified_name(const xmlChar *localname, const xmlChar *prefix)
+	{
+		return prefix
+		     ? String((const char*)prefix) + ":" + (const char*)localname
+		     : String((const char*)localname);
+	}
+
+	void set_attributes(xmlpp::Element *element, int count, const xmlChar **attributes)
+	{
+		// each attribute is: localname, prefix, URI, value, end of value
+		for(int i = 0; i < count; ++i, attributes += 5)
+			element->set_attribute(
+				qualified_name(attributes[0], attributes[1]),
+				String((const char*)attributes[3], (const char*)attributes[4]) );
+		element->cobj()->line = (unsigned short)std::min(65535, xmlSAX2GetLineNumber(context));
+	}
+
+	void flush_text()
+	{
+		if (text.empty()) return;
+		current->add_child_text(text);
+		text.clear();
+	}
+
+	void start_element(const String &name, int attributes_count, const xmlChar **attributes)
+	{
+		if (document)
+		{
+			flush_text();
+			current = current->add_child(name);
+			set_attributes(current, attributes_count, attributes);
+		}
+		else
+		if (depth == 0)
+		{
+			root = root_document.create_root_node(name);
+			set_attributes(root, attributes_count, attributes);
+			canvas = parser.parse_canvas_header(root,0,false,identifier,path,skip);
+			if (!canvas) skip = true;
+		}
+		else
+		if (skip)
+		{
+			// canvas already loaded
+		}
+		else
+		if (depth == 1 && name == "defs")
+		{
+			in_defs = true;
+		}
+		else
+		{
+			document = new xmlpp::Document();
+			document_depth = depth;
+			current = document->create_root_node(name);
+			set_attributes(current, attributes_count, attributes);
+		}
+		++depth;
+	}
+
+	void end_element()
+	{
+		--depth;
+		if (document)
+		{
+			flush_text();
+			if (depth > document_depth)
+				{ current = current->get_parent(); return; }
+
+			xmlpp::Element *element = document->get_root_node();
+			if (in_defs)
+				parser.parse_canvas_def(element, canvas);
+			else
+				parser.parse_canvas_child(element, canvas, bone_list);
+			delete document;
+			document = NULL;
+			current = NULL;
+		}
+		else
+		if (depth == 1)
+		{
+			in_defs = false;
+		}
+		else
+		if (depth == 0 && !skip)
+		{
+			parser.parse_canvas_footer(root, canvas);
+		}
+	}
+
+	static void on_start_element(
+		void *ctx,
+		const xmlChar *localname,
+		const xmlChar *prefix,
+		const xmlChar * /* URI */,
+		int /* nb_namespaces */,
+		const xmlChar ** /* namespaces */,
+		int nb_attributes,
+		int /* nb_defaulted */,
+		const xmlChar **attributes )
+	{
+		StreamParser &p = *(StreamParser*)ctx;
+		if (p.exception) return;
+		try { p.start_element(qualified_name(localname, prefix), nb_attributes, attributes); }
+		catch(...) { p.exception = std::current_exception(); xmlStopParser(p.context); }
+	}
+
+	static void on_end_element(void *ctx, const xmlChar*, const xmlChar*, const xmlChar*)
+	{
+		StreamParser &p = *(StreamParser*)ctx;
+		if (p.exception) return;
+		try { p.end_element(); }
+		catch(...) { p.exception = std::current_exception(); xmlStopParser(p.context); }
+	}
+
+	static void on_characters(void *ctx, const xmlChar *ch, int len)
+	{
+		StreamParser &p = *(StreamParser*)ctx;
+		if (p.document) p.text.append((const char*)ch, len);
+	}
+
+	static void on_error(void *ctx, xmlErrorPtr error)
+	{
+		StreamParser &p = *(StreamParser*)ctx;
+		if (!error || error->level < XML_ERR_ERROR || !p.xml_error.empty())
+			return;
+		String message = error->message ? error->message : "";
+		while(!message.empty() && isspace((unsigned char)message[message.size()-1]))
+			message.erase(message.size()-1);
+		p.xml_error = strprintf("%s:%d: %s", p.path.c_str(), error->line, message.c_str());
+	}
+
+public:
+	StreamParser(CanvasParser &parser, const FileSystem::Identifier &identifier, const String &path):
+		parser(parser),
+		identifier(identifier),
+		path(path),
+		context(),
+		depth(),
+		in_defs(),
+		skip(),
+		root(),
+		document(),
+		current(),
+		document_depth()
+	{ }
+
+	~StreamParser()
+	{
+		delete document;
+		if (context) xmlFreeParserCtxt(context);
+	}
+
+	Canvas::Handle parse(std::istream &stream)
+	{
+		xmlSAXHandler handler;
+		memset(&handler, 0, sizeof(handler));
+		handler.initialized  = XML_SAX2_MAGIC;
+		handler.startElementNs = &on_start_element;
+		handler.endElementNs = &on_end_element;
+		handler.characters   = &on_characters;
+		handler.cdataBlock   = &on_characters;
+		handler.serror       = &on_error;
+
+		context = xmlCreatePushParserCtxt(&handler, this, NULL, 0, path.c_str());
+		if (!context)
+			throw runtime_error(String("  * ") + _("Can't open file") + " \"" + path + "\"");
+
+		std::vector<char> buffer(chunk_size);
+		while(!exception && xml_error.empty())
+		{
+			stream.read(&buffer.front(), buffer.size());
+			int size = (int)stream.gcount();
+			xmlParseChunk(context, &buffer.front(), size, size == 0);
+			if (size == 0) break;
+		}
+
+		if (exception)
+			std::rethrow_exception(exception);
+		if (!xml_error.empty() || !context->wellFormed)
+			throw runtime_error(xml_error.empty() ? String(_("Document is not well-formed")) : xml_error);
+		if (!root)
+			throw runtime_error(String(_("Document is empty")));
+		return canvas;
+	}
+};
+
 /* === M E T H O D S ======================================================= */
 
 void
@@ -2736,17 +2970,21 @@ CanvasParser::parse_canvas_defs(xmlpp::Element *element,Canvas::Handle canvas)
 	for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
 	{
 		xmlpp::Element *child(dynamic_cast<xmlpp::Element*>(*iter));
-		if(!child)
-			continue;
-		else
-		if(child->get_name()=="canvas")
-			parse_canvas(child, canvas);
-		else
-			parse_value_node(child,canvas);
+		if(child)
+			parse_canvas_def(child,canvas);
 	}
 	if (getenv("SYNFIG_DEBUG_LOAD_CANVAS")) printf("%s:%d parse_canvas_defs done\n", __FILE__, __LINE__);
 }
 
+void
+CanvasParser::parse_canvas_def(xmlpp::Element *element,Canvas::Handle canvas)
+{
+	if(element->get_name()=="canvas")
+		parse_canvas(element, canvas);
+	else
+		parse_value_node(element,canvas);
+}
+
 std::list<ValueNode::Handle>
 CanvasParser::parse_canvas_bones(xmlpp::Element *element,Canvas::Handle canvas)
 {
@@ -3130,8 +3368,9 @@ CanvasParser::parse_layer(xmlpp::Element *element,Canvas::Handle canvas)
 }
 
 Canvas::Handle
-CanvasParser::parse_canvas(xmlpp::Element *element,Canvas::Handle parent,bool inline_,const FileSystem::Identifier &identifier,String filename)
+CanvasParser::parse_canvas_header(xmlpp::Element *element,Canvas::Handle parent,bool inline_,const FileSystem::Identifier &identifier,String filename,bool &existing)
 {
+	existing=false;
 
 	if(element->get_name()!="canvas")
 	{
@@ -3178,7 +3417,10 @@ CanvasParser::parse_canvas(xmlpp::Element *element,Canvas::Handle parent,bool in
 	{
 		GUID guid(element->get_attribute("guid")->get_value());
 		if(guid_cast<Canvas>(guid))
+		{
+			existing=true;
 			return guid_cast<Canvas>(guid);
+		}
 		else
 			canvas->set_guid(guid);
 	}
@@ -3277,151 +3519,149 @@ CanvasParser::parse_canvas(xmlpp::Element *element,Canvas::Handle parent,bool in
 
 	canvas->rend_desc().set_flags(RendDesc::PX_ASPECT|RendDesc::IM_SPAN);
 
-	list<ValueNode::Handle> bone_list;
-	xmlpp::Element::NodeList list = element->get_children();
-	for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+	return canvas;
+}
+
+void
+CanvasParser::parse_canvas_child(xmlpp::Element *child,Canvas::Handle canvas,std::list<ValueNode::Handle> &bone_list)
+{
+	if(child->get_name()=="defs")
 	{
-		xmlpp::Element *child(dynamic_cast<xmlpp::Element*>(*iter));
-		if(child)
+		if(canvas->is_inline())
+			error(child,_("Group canvases cannot have a <defs> section"));
+		parse_canvas_defs(child, canvas);
+	}
+	else
+	if(child->get_name()=="bones")
+	{
+		if(canvas->is_inline())
+			error(child,_("Inline canvas cannot have a <bones> section"));
+		bone_list = parse_canvas_bones(child, canvas);
+	}
+	else
+	if(child->get_name()=="keyframe")
+	{
+		if(canvas->is_inline())
 		{
-			if(child->get_name()=="defs")
-			{
-				if(canvas->is_inline())
-					error(child,_("Group canvases cannot have a <defs> section"));
-				parse_canvas_defs(child, canvas);
-			}
-			else
-			if(child->get_name()=="bones")
-			{
-				if(canvas->is_inline())
-					error(child,_("Inline canvas cannot have a <bones> section"));
-				bone_list = parse_canvas_bones(child, canvas);
-			}
-			else
-			if(child->get_name()=="keyframe")
-			{
-				if(canvas->is_inline())
-				{
-					warning(child,_("Group canvases cannot have keyframes"));
-					continue;
-				}
+			warning(child,_("Group canvases cannot have keyframes"));
+			return;
+		}
 
-				canvas->keyframe_list().add(parse_keyframe(child,canvas));
-				canvas->keyframe_list().sync();
-			}
-			else
-			if(child->get_name()=="meta")
-			{
-				if(canvas->is_inline())
-				{
-					warning(child,_("Group canvases cannot have metadata"));
-					continue;
-				}
+		canvas->keyframe_list().add(parse_keyframe(child,canvas));
+		canvas->keyframe_list().sync();
+	}
+	else
+	if(child->get_name()=="meta")
+	{
+		if(canvas->is_inline())
+		{
+			warning(child,_("Group canvases cannot have metadata"));
+			return;
+		}
 
-				if(!child->get_attribute("name"))
-				{
-					warning(child,_("<meta> must have a name"));
-					continue;
-				}
+		if(!child->get_attribute("name"))
+		{
+			warning(child,_("<meta> must have a name"));
+			return;
+		}
 
-				if(!child->get_attribute("content"))
-				{
-					warning(child,_("<meta> must have content"));
-					continue;
-				}
-				
-				// In Synfig prior to version 1.0 we have messed decimal separator:
-				// some files use ".", but other ones use ","/
-				// Let's try to put a workaround for that.
-				std::vector<String> replacelist;
-				replacelist.push_back("background_first_color");
-				replacelist.push_back("background_second_color");
-				replacelist.push_back("background_size");
-				replacelist.push_back("grid_color");
-				replacelist.push_back("grid_size");
-				replacelist.push_back("jack_offset");
-				String content;
-				content=child->get_attribute("content")->get_value();
-				if(std::find(replacelist.begin(), replacelist.end(), child->get_attribute("name")->get_value()) != replacelist.end()) 
-				{
-					size_t index = 0;
-					while (true) {
-					     /* Locate the substring to replace. */
-					     index = content.find(",", index);
-					     if (index == string::npos) break;
+		if(!child->get_attribute("content"))
+		{
+			warning(child,_("<meta> must have content"));
+			return;
+		}
+		
+		// In Synfig prior to version 1.0 we have messed decimal separator:
+		// some files use ".", but other ones use ","/
+		// Let's try to put a workaround for that.
+		std::vector<String> replacelist;
+		replacelist.push_back("background_first_color");
+		replacelist.push_back("background_second_color");
+		replacelist.push_back("background_size");
+		replacelist.push_back("grid_color");
+		replacelist.push_back("grid_size");
+		replacelist.push_back("jack_offset");
+		String content;
+		content=child->get_attribute("content")->get_value();
+		if(std::find(replacelist.begin(), replacelist.end(), child->get_attribute("name")->get_value()) != replacelist.end()) 
+		{
+			size_t index = 0;
+			while (true) {
+			     /* Locate the substring to replace. */
+			     index = content.find(",", index);
+			     if (index == string::npos) break;
 
-					     /* Make the replacement. */
-					     content.replace(index, 1, ".");
+			     /* Make the replacement. */
+			     content.replace(index, 1, ".");
 
-					     /* Advance index forward so the next iteration doesn't pick it up as well. */
-					     index += 1;
-					}
-					
-				}
-				canvas->set_meta_data(child->get_attribute("name")->get_value(),content);
+			     /* Advance index forward so the next iteration doesn't pick it up as well. */
+			     index += 1;
 			}
-			else if(child->get_name()=="name")
-			{
-				xmlpp::Element::NodeList list = child->get_children();
+			
+		}
+		canvas->set_meta_data(child->get_attribute("name")->get_value(),content);
+	}
+	else if(child->get_name()=="name")
+	{
+		xmlpp::Element::NodeList list = child->get_children();
 
-				// If we don't have any name, warn
-				if(list.empty())
-					warning(child,_("blank \"name\" entity"));
+		// If we don't have any name, warn
+		if(list.empty())
+			warning(child,_("blank \"name\" entity"));
 
-				string tmp;
-				for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
-					if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
-				canvas->set_name(tmp);
-			}
-			else
-			if(child->get_name()=="desc")
-			{
+		string tmp;
+		for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+			if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
+		canvas->set_name(tmp);
+	}
+	else
+	if(child->get_name()=="desc")
+	{
 
-				xmlpp::Element::NodeList list = child->get_children();
+		xmlpp::Element::NodeList list = child->get_children();
 
-				// If we don't have any description, warn
-				if(list.empty())
-					warning(child,_("blank \"desc\" entity"));
+		// If we don't have any description, warn
+		if(list.empty())
+			warning(child,_("blank \"desc\" entity"));
 
-				string tmp;
-				for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
-					if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
-				canvas->set_description(tmp);
-			}
-			else
-			if(child->get_name()=="author")
-			{
+		string tmp;
+		for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+			if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
+		canvas->set_description(tmp);
+	}
+	else
+	if(child->get_name()=="author")
+	{
 
-				xmlpp::Element::NodeList list = child->get_children();
+		xmlpp::Element::NodeList list = child->get_children();
 
-				// If we don't have any description, warn
-				if(list.empty())
-					warning(child,_("blank \"author\" entity"));
+		// If we don't have any description, warn
+		if(list.empty())
+			warning(child,_("blank \"author\" entity"));
 
-				string tmp;
-				for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
-					if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
-				canvas->set_author(tmp);
-			}
-			else
-			if(child->get_name()=="layer")
-			{
-				//if(canvas->is_inline())
-				//	canvas->push_front(parse_layer(child,canvas->parent()));
-				//else
-					canvas->push_front(parse_layer(child,canvas));
-			}
-			else
-			{
-				printf("%s:%d\n", __FILE__, __LINE__);
-				error_unexpected_element(child,child->get_name());
-			}
-		}
-//		else
-//		if((child->get_name()=="text"||child->get_name()=="comment") && child->has_child_text())
-//			continue;
+		string tmp;
+		for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+			if(dynamic_cast<xmlpp::TextNode*>(*iter))tmp+=dynamic_cast<xmlpp::TextNode*>(*iter)->get_content();
+		canvas->set_author(tmp);
+	}
+	else
+	if(child->get_name()=="layer")
+	{
+		//if(canvas->is_inline())
+		//	canvas->push_front(parse_layer(child,canvas->parent()));
+		//else
+			canvas->push_front(parse_layer(child,canvas));
+	}
+	else
+	{
+		printf("%s:%d\n", __FILE__, __LINE__);
+		error_unexpected_element(child,child->get_name());
 	}
+}
 
+void
+CanvasParser::parse_canvas_footer(xmlpp::Element *element,Canvas::Handle canvas)
+{
 	if(canvas->value_node_list().placeholder_count())
 	{
 		String nodes;
@@ -3438,6 +3678,29 @@ CanvasParser::parse_canvas(xmlpp::Element *element,Canvas::Handle parent,bool in
 	}
 
 	canvas->set_version(CURRENT_CANVAS_VERSION);
+}
+
+Canvas::Handle
+CanvasParser::parse_canvas_stream(std::istream &stream,const FileSystem::Identifier &identifier,String filename)
+{
+	return StreamParser(*this,identifier,filename).parse(stream);
+}
+
+Canvas::Handle
+CanvasParser::parse_canvas(xmlpp::Element *element,Canvas::Handle parent,bool inline_,const FileSystem::Identifier &identifier,String filename)
+{
+	bool existing=false;
+	Canvas::Handle canvas=parse_canvas_header(element,parent,inline_,identifier,filename,existing);
+	if(!canvas || existing)
+		return canvas;
+
+	std::list<ValueNode::Handle> bone_list;
+	xmlpp::Element::NodeList list = element->get_children();
+	for(xmlpp::Element::NodeList::iterator iter = list.begin(); iter != list.end(); ++iter)
+		if(xmlpp::Element *child = dynamic_cast<xmlpp::Element*>(*iter))
+			parse_canvas_child(child,canvas,bone_list);
+
+	parse_canvas_footer(element,canvas);
 	return canvas;
 }
 
@@ -3487,31 +3750,61 @@ CanvasParser::parse_from_file_as(const FileSystem::Identifier &identifier,const
 			if (filename_extension(identifier.filename) == ".sifz")
 				stream = FileSystem::ReadStream::Handle(new ZReadStream(stream));
 
-			xmlpp::DomParser parser;
-			parser.parse_stream(*stream);
-			stream.reset();
-			if(parser)
+			Canvas::Handle canvas;
+			String real_filename;
+			CanvasCache::Source source;
+			bool write_cache = false;
+			if (cache_)
 			{
-				Canvas::Handle canvas(parse_canvas(parser.get_document()->get_root_node(),0,false,identifier,as));
-				if (!canvas) return canvas;
-				register_canvas_in_map(canvas, as);
-
-				const ValueNodeList& value_node_list(canvas->value_node_list());
+				source = CanvasCache::get_source(identifier, real_filename);
+				canvas = CanvasCache::read(real_filename, source, identifier, as);
+			}
 
-				again:
-				ValueNodeList::const_iterator iter;
-				for(iter=value_node_list.begin();iter!=value_node_list.end();++iter)
+			if (canvas)
+			{
+				synfig::info("Use cache of file: " + real_filename);
+				stream.reset();
+			}
+			else
+			{
+				if (streaming_)
 				{
-					ValueNode::Handle value_node(*iter);
-					if(value_node->is_exported() && value_node->get_id().find("Unnamed")==0)
-					{
-						canvas->remove_value_node(value_node, true);
-						goto again;
-					}
+					canvas = parse_canvas_stream(*stream,identifier,as);
+					stream.reset();
 				}
+				else
+				{
+					xmlpp::DomParser parser;
+					parser.parse_stream(*stream);
+					stream.reset();
+					if(parser)
+						canvas = parse_canvas(parser.get_document()->get_root_node(),0,false,identifier,as);
+				}
+				// cache is written for the graph which was loaded without errors
+				write_cache = cache_ && canvas && !error_count();
+			}
 
-				return canvas;
+			if (!canvas) return canvas;
+			register_canvas_in_map(canvas, as);
+
+			const ValueNodeList& value_node_list(canvas->value_node_list());
+
+			again:
+			ValueNodeList::const_iterator iter;
+			for(iter=value_node_list.begin();iter!=value_node_list.end();++iter)
+			{
+				ValueNode::Handle value_node(*iter);
+				if(value_node->is_exported() && value_node->get_id().find("Unnamed")==0)
+				{
+					canvas->remove_value_node(value_node, true);
+					goto again;
+				}
 			}
+
+			if (write_cache)
+				CanvasCache::write(real_filename, source, canvas);
+
+			return canvas;
 		} else {
 			throw runtime_error(String("  * ") + _("Can't find linked file") + " \"" + identifier.filename + "\"");
 		}
@@ -29,6 +29,9 @@
 
 /* === H E A D E R S ======================================================= */
 
+#include <iosfwd>
+#include <list>
+
 #include "string.h"
 #include "canvas.h"
 #include "valuenode.h"
@@ -74,6 +77,10 @@ private:
     int total_errors_;
 	//! True if errors doesn't stop canvas parsing
 	bool allow_errors_;
+	//! True if files are parsed by streaming parser, without building of the whole document tree
+	bool streaming_;
+	//! True if binary cache is used, see CanvasCache
+	bool cache_;
 	//! File name to parse
 	String filename;
 	//! Path of the file name to parse
@@ -95,7 +102,9 @@ public:
 		max_warnings_	(1000),
 		total_warnings_	(0),
 		total_errors_	(0),
-		allow_errors_	(false)
+		allow_errors_	(false),
+		streaming_		(true),
+		cache_			(false)
 	{ }
 
 	/*
@@ -107,6 +116,19 @@ public:
 	//! Sets allow errors variable
 	CanvasParser &set_allow_errors(bool x) { allow_errors_=x; return *this; }
 
+	//! Sets streaming mode, when it's off whole document tree is built before parsing
+	CanvasParser &set_streaming(bool x) { streaming_=x; return *this; }
+
+	//! Returns true when streaming mode is on
+	bool get_streaming()const { return streaming_; }
+
+	//! Enables binary cache, it will be read instead of file when valid,
+	//! or will be written after file is loaded without errors
+	CanvasParser &set_cache(bool x) { cache_=x; return *this; }
+
+	//! Returns true when binary cache is enabled
+	bool get_cache()const { return cache_; }
+
 	//! Sets the maximum number of warnings before a fatal error is thrown
 	CanvasParser &set_max_warnings(int i) { max_warnings_=i; return *this; }
 
@@ -150,6 +172,9 @@ public:
 
 private:
 
+	//! Streaming parser of documents, builds tree only for one child of the root canvas at time
+	class StreamParser;
+
 	//! Error handling function
 	void error(xmlpp::Node *node,const String &text);
 	//! Fatal Error handling function
@@ -163,8 +188,19 @@ private:
 
 	//! Canvas Parsing Function
 	Canvas::Handle parse_canvas(xmlpp::Element *node,Canvas::Handle parent=0,bool inline_=false,const FileSystem::Identifier &identifier = FileSystemNative::instance()->get_identifier(std::string()),String path=".");
+	//! Creates canvas from attributes of <canvas> element,
+	//! \param existing will be set when canvas already loaded (found by GUID), so its children should be skipped
+	Canvas::Handle parse_canvas_header(xmlpp::Element *node,Canvas::Handle parent,bool inline_,const FileSystem::Identifier &identifier,String path,bool &existing);
+	//! Canvas Child Element Parsing Function
+	void parse_canvas_child(xmlpp::Element *node,Canvas::Handle canvas,std::list<ValueNode::Handle> &bone_list);
+	//! Finishes canvas parsing when all children are parsed
+	void parse_canvas_footer(xmlpp::Element *node,Canvas::Handle canvas);
+	//! Streaming Canvas Parsing Function, see StreamParser
+	Canvas::Handle parse_canvas_stream(std::istream &stream,const FileSystem::Identifier &identifier,String path);
 	//! Canvas definitions Parsing Function (exported value nodes and exported canvases)
 	void parse_canvas_defs(xmlpp::Element *node,Canvas::Handle canvas);
+	//! Canvas Definition Parsing Function (single item of definitions)
+	void parse_canvas_def(xmlpp::Element *node,Canvas::Handle canvas);
 
 	std::list<ValueNode::Handle> parse_canvas_bones(xmlpp::Element *node,Canvas::Handle canvas);
 
@@ -34,8 +34,14 @@
 #include "palette.h"
 #include "surface.h"
 #include "general.h"
+#include <ETL/misc>
 #include <synfig/localization.h>
 #include "gamma.h"
+#include "threadpool.h"
+#include <glibmm/threads.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -74,6 +80,179 @@ bool luma_less_than(const PaletteItem& lhs,const float& rhs)
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+//! Coordinates of color in the space where Palette::find_closest() measures distance
+inline void
+prepare_coords(const Color& color, float *coords)
+{
+	coords[0]=powf(color.get_y(),2.2f)*color.get_a();
+	coords[1]=color.get_u();
+	coords[2]=color.get_v();
+	coords[3]=color.get_a();
+}
+
+const float coords_weights[4] = { 1.5f, 1.f, 1.f, 1.f };
+
+inline float
+coords_distance(const float *a, const float *b)
+{
+	const float diff_y(a[0]-b[0]);
+	const float diff_u(a[1]-b[1]);
+	const float diff_v(a[2]-b[2]);
+	const float diff_a(a[3]-b[3]);
+	return diff_y*diff_y*1.5f
+		 + diff_a*diff_a
+		 + diff_u*diff_u
+		 + diff_v*diff_v;
+}
+
+//! Median cut color quantizer.
+//! Colors are collected into histogram with 5 bits per RGB channel,
+//! then the box of histogram cells with the largest squared error is splitted
+//! at the weighted median of its widest channel until we have enough boxes.
+class MedianCut
+{
+public:
+	enum { bits = 5, cells = 1 << (3*bits) };
+
+private:
+	struct Cell
+	{
+		double sum[4];
+		double sum_sq[3];
+		int count;
+		Cell(): count() { for(int i=0;i<4;i++) sum[i]=0; for(int i=0;i<3;i++) sum_sq[i]=0; }
+		double mean(int channel)const { return sum[channel]/count; }
+	};
+
+	struct Box
+	{
+		int begin, end;
+		int count;
+		int axis;
+		double error;
+		Box(): begin(), end(), count(), axis(), error() { }
+	};
+
+	struct CellLess
+	{
+		int axis;
+		explicit CellLess(int axis): axis(axis) { }
+		bool operator()(const Cell *a, const Cell *b)const { return a->mean(axis) < b->mean(axis); }
+	};
+
+	std::vector<Cell> histogram;
+
+	static int cell_index(const Color& color)
+	{
+		const int max = (1 << bits) - 1;
+		return (round_to_int(color.get_r()*max) << (2*bits))
+			 | (round_to_int(color.get_g()*max) << bits)
+			 |  round_to_int(color.get_b()*max);
+	}
+
+	static void calc_box(Box &box, std::vector<Cell*> &list)
+	{
+		double sum[3] = {}, sum_sq[3] = {};
+		box.count = 0;
+		for(int i=box.begin;i<box.end;i++)
+		{
+			const Cell &c(*list[i]);
+			box.count+=c.count;
+			for(int j=0;j<3;j++) { sum[j]+=c.sum[j]; sum_sq[j]+=c.sum_sq[j]; }
+		}
+		box.axis=0;
+		box.error=0;
+		double max_error=-1;
+		for(int j=0;j<3;j++)
+		{
+			double e(sum_sq[j]-sum[j]*sum[j]/box.count);
+			box.error+=e;
+			if(e>max_error) { max_error=e; box.axis=j; }
+		}
+		// single cell cannot be splitted
+		if(box.end-box.begin<2)
+			box.error=-1;
+	}
+
+public:
+	MedianCut(): histogram(cells) { }
+
+	void add(const Color& color)
+	{
+		Cell &c(histogram[cell_index(color)]);
+		c.sum[0]+=color.get_r();
+		c.sum[1]+=color.get_g();
+		c.sum[2]+=color.get_b();
+		c.sum[3]+=color.get_a();
+		c.sum_sq[0]+=color.get_r()*color.get_r();
+		c.sum_sq[1]+=color.get_g()*color.get_g();
+		c.sum_sq[2]+=color.get_b()*color.get_b();
+		++c.count;
+	}
+
+	void build(Palette &palette, int max_colors)
+	{
+		std::vector<Cell*> list;
+		for(std::vector<Cell>::iterator i=histogram.begin();i!=histogram.end();++i)
+			if(i->count) list.push_back(&*i);
+		if(list.empty() || max_colors<=0) return;
+
+		std::vector<Box> boxes(1);
+		boxes.back().end=(int)list.size();
+		calc_box(boxes.back(),list);
+
+		while((int)boxes.size()<max_colors)
+		{
+			int index=0;
+			for(int i=1;i<(int)boxes.size();i++)
+				if(boxes[i].error>boxes[index].error) index=i;
+			if(boxes[index].error<=0) break;
+
+			Box &box(boxes[index]);
+			std::sort(list.begin()+box.begin,list.begin()+box.end,CellLess(box.axis));
+
+			// weighted median, both parts should be not empty
+			int half(box.count/2), count(0), split(box.begin+1);
+			for(int i=box.begin;i<box.end-1;i++)
+				if((count+=list[i]->count)>=half) { split=i+1; break; }
+
+			Box other;
+			other.begin=split;
+			other.end=box.end;
+			box.end=split;
+			calc_box(box,list);
+			calc_box(other,list);
+			boxes.push_back(other);
+		}
+
+		for(std::vector<Box>::const_iterator i=boxes.begin();i!=boxes.end();++i)
+		{
+			double sum[4]={};
+			for(int j=i->begin;j<i->end;j++)
+				for(int k=0;k<4;k++) sum[k]+=list[j]->sum[k];
+			double k(1.0/i->count);
+			palette.push_back(PaletteItem(Color(sum[0]*k,sum[1]*k,sum[2]*k,sum[3]*k),i->count));
+		}
+	}
+}; // END of class MedianCut
+
+//! Compares nodes by the given axis, ties are ordered by index of color in palette
+template<typename T>
+struct NodeLess
+{
+	int axis;
+	explicit NodeLess(int axis): axis(axis) { }
+	bool operator()(const T &a, const T &b)const
+	{
+		return a.coords[axis]<b.coords[axis]
+			|| (a.coords[axis]==b.coords[axis] && a.index<b.index);
+	}
+};
+
+} // END of anonymous namespace
+
 /* === M E T H O D S ======================================================= */
 
 Palette::Palette():
@@ -96,98 +275,31 @@ PaletteItem::add(const Color& x,int xweight)
 Palette::Palette(const Surface& surface, int max_colors):
 	name_(_("Surface Palette"))
 {
+	// reserve entries for black and white
 	max_colors-=2;
-	for(int i=0;(signed)size()<(max_colors-1) && i<max_colors*16;++i) {
-        int x=rand()%surface.get_w();
-        int y=rand()%surface.get_h();
-
-			float dist;
-			Color color(surface[y][x]);
-
-			if(empty())
-			{
-				push_back(color);
-				continue;
-			}
-
-			if(color.get_a()==0)
-			{
-				if(front().color.get_a()!=0)
-					insert(begin(),Color(1,0,1,0));
-				front().weight+=400;
-				continue;
-			}
-
-			iterator iter(find_closest(color,&dist));
-			if(sqrt(dist)<0.005)
-			{
-				iter->add(color);
-				continue;
-			}
-
-			/*if(size()>=max_colors)
-			{
-				iterator iterlight(find_light());
-				PaletteItem light(*iterlight);
-				erase(iterlight);
-				find_closest(light.color)->add(light.color,light.weight);
-			}
-			*/
-
-			push_back(color);
-			continue;
-    }
-
-/*
 
-	max_colors-=2;
+	MedianCut cut;
+	int transparent_count(0);
 	for(int y=0;y<surface.get_h();y++)
 		for(int x=0;x<surface.get_w();x++)
 		{
-			float dist;
-			Color color(surface[y][x]);
-
-			if(empty())
-			{
-				push_back(color);
-				continue;
-			}
-
-			if(color.get_a()==0)
-			{
-				if(front().color.get_a()!=0)
-					insert(begin(),Color(1,0,1,0));
-				front().weight+=400;
-				continue;
-			}
-
-			iterator iter(find_closest(color,&dist));
-			if(sqrt(dist)<0.005)
-			{
-				iter->add(color);
-				continue;
-			}
-
-
-			push_back(color);
-			continue;
+			const Color &color(surface[y][x]);
+			if(color.get_a()<=0)
+				++transparent_count;
+			else
+				cut.add(color.clamped());
 		}
-	sort(rbegin(),rend());
 
-	iterator iter;
-
-	iterator best_match(begin());
-	while((signed)size()>max_colors)
+	if(transparent_count)
 	{
-		PaletteItem item(back());
-		pop_back();
-		find_closest(item.color)->add(item.color,item.weight);
+		push_back(PaletteItem(Color(1,0,1,0),transparent_count));
+		--max_colors;
 	}
-*/
+
+	cut.build(*this,max_colors);
+
 	push_back(Color::black());
 	push_back(Color::white());
-
-//	sort(begin(),end(),&luma_less_than);
 }
 
 Palette::const_iterator
@@ -208,31 +320,13 @@ Palette::find_closest(const Color& color, float* dist)
 	iterator best_match(begin());
 	float best_dist(1000000);
 
-	const float prep_y(powf(color.get_y(),2.2f)*color.get_a());
-	const float prep_u(color.get_u());
-	const float prep_v(color.get_v());
+	float prep[4], coords[4];
+	prepare_coords(color,prep);
 
 	for(iter=begin();iter!=end();++iter)
 	{
-		const float diff_y(prep_y-powf(iter->color.get_y(),2.2f)*iter->color.get_a());
-		const float diff_u(prep_u-iter->color.get_u());
-		const float diff_v(prep_v-iter->color.get_v());
-		const float diff_a(color.get_a()-iter->color.get_a());
-
-
-		const float dist(
-			diff_y*diff_y*1.5f+
-			diff_a*diff_a+
-
-			diff_u*diff_u+
-			diff_v*diff_v
-
-			// cross product
-			/*abs(
-				prep_u*iter->color.get_u()-
-				prep_v*iter->color.get_v()
-			)*/
-		);
+		prepare_coords(iter->color,coords);
+		const float dist(coords_distance(prep,coords));
 		if(dist<best_dist)
 		{
 			best_dist=dist;
@@ -278,6 +372,220 @@ Palette::find_light()
 	return best_match;
 }
 
+void
+PaletteIndex::build_node(Node *begin, Node *end)
+{
+	if(end-begin<2)
+	{
+		if(begin<end) begin->axis=0;
+		return;
+	}
+
+	// split by the axis with the widest weighted range
+	float min[4], max[4];
+	for(int j=0;j<4;j++) min[j]=max[j]=begin->coords[j];
+	for(Node *i=begin+1;i<end;i++)
+		for(int j=0;j<4;j++)
+		{
+			if(i->coords[j]<min[j]) min[j]=i->coords[j];
+			if(i->coords[j]>max[j]) max[j]=i->coords[j];
+		}
+	int axis(0);
+	float best_range(-1);
+	for(int j=0;j<4;j++)
+	{
+		float range((max[j]-min[j])*(max[j]-min[j])*coords_weights[j]);
+		if(range>best_range) { best_range=range; axis=j; }
+	}
+
+	Node *middle(begin+(end-begin)/2);
+	std::nth_element(begin,middle,end,NodeLess<Node>(axis));
+	middle->axis=axis;
+	build_node(begin,middle);
+	build_node(middle+1,end);
+}
+
+void
+PaletteIndex::build(const Palette& palette)
+{
+	nodes.resize(palette.size());
+	for(int i=0;i<(int)palette.size();i++)
+	{
+		prepare_coords(palette[i].color,nodes[i].coords);
+		nodes[i].index=i;
+	}
+	if(!nodes.empty())
+		build_node(&nodes.front(),&nodes.front()+nodes.size());
+}
+
+void
+PaletteIndex::find_node(const Node *begin, const Node *end, const float *coords, int &best_index, float &best_dist)const
+{
+	while(begin<end)
+	{
+		const Node *middle(begin+(end-begin)/2);
+
+		const float dist(coords_distance(coords,middle->coords));
+		if(dist<best_dist || (dist==best_dist && middle->index<best_index))
+		{
+			best_dist=dist;
+			best_index=middle->index;
+		}
+
+		const float diff(coords[middle->axis]-middle->coords[middle->axis]);
+		const float plane_dist(diff*diff*coords_weights[middle->axis]);
+
+		// visit the nearest side first, the farthest side only when it may contain closer color,
+		// equal distance should be checked too, because the color with lower index wins
+		if(diff<0)
+		{
+			find_node(begin,middle,coords,best_index,best_dist);
+			begin=middle+1;
+		}
+		else
+		{
+			find_node(middle+1,end,coords,best_index,best_dist);
+			end=middle;
+		}
+
+		if(plane_dist>best_dist)
+			break;
+	}
+}
+
+int
+PaletteIndex::find_closest(const Color& color, float* dist)const
+{
+	if(nodes.empty())
+		return -1;
+
+	float coords[4];
+	prepare_coords(color,coords);
+
+	int best_index((int)nodes.size());
+	float best_dist(1000000);
+	find_node(&nodes.front(),&nodes.front()+nodes.size(),coords,best_index,best_dist);
+
+	// Palette::find_closest() returns the first color when nothing is closer than the initial distance
+	if(best_index>=(int)nodes.size())
+		best_index=0;
+	if(dist)
+		*dist=best_dist;
+	return best_index;
+}
+
+namespace {
+
+//! Finds closest palette colors for all pixels of surface.
+//! Floyd-Steinberg dithering is processed by rows in parallel (wavefront):
+//! pixel x of the row reads and modifies pixels x and x+1,
+//! and the previous row modifies pixels x'-1..x'+1 of this row when it processes pixel x',
+//! so pixel x may be processed only when the previous row already finished pixels 0..x+2.
+//! Each row follows the previous one with small lag,
+//! and result is the same as for sequential processing.
+class FrameQuantizer
+{
+public:
+	// count of pixels between updates of row progress
+	enum { progress_step = 16 };
+
+	struct Row
+	{
+		std::atomic<int> done;
+		Row(): done(0) { }
+	};
+
+	Surface &surface;
+	etl::surface<unsigned char> &frame;
+	const Palette &palette;
+	const PaletteIndex index;
+	const bool dithering;
+	std::vector<Row> rows;
+
+	FrameQuantizer(Surface &surface, etl::surface<unsigned char> &frame, const Palette &palette, bool dithering):
+		surface(surface),
+		frame(frame),
+		palette(palette),
+		index(palette),
+		dithering(dithering),
+		rows(surface.get_h())
+	{ }
+
+	void wait_row(int y, int x, int &done) const
+	{
+		if (done >= x) return;
+		while((done = rows[y].done.load(std::memory_order_acquire)) < x)
+			Glib::Threads::Thread::yield();
+	}
+
+	void process_row(int y)
+	{
+		const int w = surface.get_w(), h = surface.get_h();
+		Color *row = surface[y];
+		Color *next_row = y + 1 < h ? surface[y + 1] : NULL;
+		unsigned char *out = frame[y];
+		std::atomic<int> &progress = rows[y].done;
+		int prev_done = y > 0 && dithering ? 0 : w;
+
+		for(int x = 0; x < w; ++x)
+		{
+			// previous row should finish pixels up to x+2, the last one which touches pixel x+1
+			if (y > 0) wait_row(y - 1, std::min(w, x + 3), prev_done);
+
+			Color color(row[x].clamped());
+			int i = index.find_closest(color);
+			out[x] = (unsigned char)i;
+
+			if(dithering)
+			{
+				Color error(color - palette[i].color);
+				if(next_row)
+				{
+					if(x > 0)
+						next_row[x-1] += error * ((float)3/(float)16);
+					next_row[x]       += error * ((float)5/(float)16);
+					if(x + 1 < w)
+						next_row[x+1] += error * ((float)1/(float)16);
+				}
+				if(x + 1 < w)
+					row[x+1]          += error * ((float)7/(float)16);
+
+				if ((x + 1) % progress_step == 0)
+					progress.store(x + 1, std::memory_order_release);
+			}
+		}
+		progress.store(w, std::memory_order_release);
+	}
+
+	void run(bool threaded)
+	{
+		if (!threaded)
+		{
+			for(int y = 0; y < surface.get_h(); ++y)
+				process_row(y);
+			return;
+		}
+
+		// rows are taken by threads in order, so each row waits only for rows
+		// which are already in process, and wavefront cannot lock
+		ThreadPool::Group group;
+		for(int y = 0; y < surface.get_h(); ++y)
+			group.enqueue( sigc::bind( sigc::mem_fun(*this, &FrameQuantizer::process_row), y ));
+		group.run();
+	}
+};
+
+}
+
+void
+Palette::quantize(Surface& surface, etl::surface<unsigned char>& indices, bool dithering, bool threaded)const
+{
+	indices.set_wh(surface.get_w(), surface.get_h());
+	if (!surface.is_valid())
+		return;
+	FrameQuantizer(surface, indices, *this, dithering).run(threaded);
+}
+
 Palette
 Palette::grayscale(int steps)
 {
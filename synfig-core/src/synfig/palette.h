@@ -30,6 +30,7 @@
 #include "color.h"
 #include "string.h"
 #include <vector>
+#include <ETL/surface>
 
 /* === M A C R O S ========================================================= */
 
@@ -69,13 +70,24 @@ public:
 	Palette(const String& name_);
 
 	/*! Generates a palette for the given
-	**	surface
+	**	surface by median cut of the color histogram.
+	**	Transparent pixels are represented by single
+	**	transparent color at the beginning of palette,
+	**	black and white are always added to the end.
 	*/
 	Palette(const Surface& surface, int size=256);
 
 	iterator find_closest(const Color& color, float* dist=0);
 	const_iterator find_closest(const Color& color, float* dist=0)const;
 
+	/*! Writes indices of the closest colors of all pixels of \a surface into \a indices.
+	**	Floyd-Steinberg dithering modifies \a surface.
+	**	When \a threaded is set, rows are processed by ThreadPool in parallel,
+	**	the result is exactly the same as for sequential processing.
+	**	Palette should contain not more than 256 colors.
+	*/
+	void quantize(Surface& surface, etl::surface<unsigned char>& indices, bool dithering, bool threaded=true)const;
+
 	iterator find_heavy();
 
 	iterator find_light();
@@ -87,6 +99,39 @@ public:
 	static Palette load_from_file(const synfig::String& filename);
 }; // END of class Palette
 
+/*! Index for the fast search of the closest color in the palette,
+**	k-d tree built over the color space of Palette::find_closest().
+**	Results are exactly the same as Palette::find_closest() gives,
+**	but search takes about log(N) steps instead of N.
+**	Index doesn't track changes of palette, it should be rebuilt.
+**	Index is read-only after build, so it may be used from several threads.
+*/
+class PaletteIndex
+{
+	struct Node
+	{
+		float coords[4];
+		int index;
+		int axis;
+	};
+
+	std::vector<Node> nodes;
+
+	static void build_node(Node *begin, Node *end);
+	void find_node(const Node *begin, const Node *end, const float *coords, int &best_index, float &best_dist)const;
+
+public:
+	PaletteIndex() { }
+	explicit PaletteIndex(const Palette& palette) { build(palette); }
+
+	void build(const Palette& palette);
+	void clear() { nodes.clear(); }
+	bool empty()const { return nodes.empty(); }
+
+	//! Returns index of the closest color in palette or -1 if palette is empty
+	int find_closest(const Color& color, float* dist=0)const;
+}; // END of class PaletteIndex
+
 }; // END of namespace synfig
 
 /* === E N D =============================================================== */
@@ -94,7 +94,7 @@ public:
 	value_type get_width()const { return maxx - minx; }
 	value_type get_height()const { return maxy - miny; }
 
-	bool is_inside(const PointInt& x) { return x[0]>=minx && x[0]<maxx && x[1]>=miny && x[1]<maxy; }
+	bool is_inside(const PointInt& x)const { return x[0]>=minx && x[0]<maxx && x[1]>=miny && x[1]<maxy; }
 
 	int area()const
 	{
@@ -260,7 +260,7 @@ public:
 	value_type get_width()const { return maxx - minx; }
 	value_type get_height()const { return maxy - miny; }
 
-	bool is_inside(const Point& x)
+	bool is_inside(const Point& x)const
 	{
 		return approximate_less_or_equal(minx, x[0])
 			&& approximate_less_or_equal(x[0], maxx)
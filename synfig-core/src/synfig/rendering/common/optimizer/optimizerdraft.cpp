@@ -154,6 +154,17 @@ OptimizerDraftBlur::run(const RunParams &params) const
 }
 
 
+// OptimizerDraftTask
+
+void
+OptimizerDraftTask::run(const RunParams &params) const
+{
+	if (TaskInterfaceDraft *draft = params.ref_task.type_pointer<TaskInterfaceDraft>())
+		if (Task::Handle task = draft->clone_draft())
+			apply(params, task);
+}
+
+
 // OptimizerDraftLayerRemove
 
 OptimizerDraftLayerRemove::OptimizerDraftLayerRemove(const String &layername):
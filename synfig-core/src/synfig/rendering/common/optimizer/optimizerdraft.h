@@ -82,6 +82,14 @@ public:
 };
 
 
+//! Replaces tasks with TaskInterfaceDraft by their draft versions
+class OptimizerDraftTask: public OptimizerDraft
+{
+public:
+	virtual void run(const RunParams &params) const;
+};
+
+
 class OptimizerDraftLayerRemove: public OptimizerDraft
 {
 public:
@@ -29,6 +29,10 @@
 #	include <config.h>
 #endif
 
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
 #include <synfig/general.h>
 #include <synfig/localization.h>
 
@@ -47,44 +51,124 @@ using namespace rendering;
 
 /* === M E T H O D S ======================================================= */
 
-OptimizerSplit::OptimizerSplit()
+OptimizerSplit::OptimizerSplit(int threads):
+	threads(threads)
 {
 	category_id = CATEGORY_ID_LIST;
 	depends_from = CATEGORY_SPECIALIZED;
 	for_list = true;
 }
 
+bool
+OptimizerSplit::is_enabled()
+{
+	const char *s = getenv("SYNFIG_RENDERING_SPLIT");
+	return !s || atoi(s) != 0;
+}
+
+Real
+OptimizerSplit::estimate_cost(const Task &task)
+{
+	if (!task.is_valid())
+		return 0.0;
+
+	int count = 0;
+	for(Task::List::const_iterator i = task.sub_tasks.begin(); i != task.sub_tasks.end(); ++i)
+		if (*i && (*i)->is_valid()) ++count;
+
+	Real pixel_cost = 1.0;
+	if (const TaskInterfaceSplit *split = dynamic_cast<const TaskInterfaceSplit*>(&task))
+		pixel_cost = split->get_pixel_cost();
+
+	Real area = (Real)task.target_rect.get_width() * (Real)task.target_rect.get_height();
+	return area*pixel_cost*(1.0 + 0.5*(Real)count);
+}
+
 void
 OptimizerSplit::run(const RunParams &params) const
 {
-	if (!params.list) return;
-	const int min_area = 256*256;
+	if (!params.list || threads < 2) return;
+
+	Real total_cost = 0.0;
+	for(Task::List::const_iterator i = params.list->begin(); i != params.list->end(); ++i)
+		if (*i) total_cost += estimate_cost(**i);
+	if (total_cost <= real_precision<Real>()) return;
+
+	// task with cost less than share will not leave other threads idle
+	const Real share = total_cost/(Real)threads;
+	const long long min_area = (long long)min_tile_size*min_tile_size;
+
+	bool applied = false;
 	for(Task::List::iterator i = params.list->begin(); i != params.list->end(); ++i)
 	{
-		if (TaskInterfaceSplit *split = i->type_pointer<TaskInterfaceSplit>())
-		if (split->is_splittable())
+		if (!*i) continue;
+		TaskInterfaceSplit *split = i->type_pointer<TaskInterfaceSplit>();
+		if (!split || !split->is_splittable()) continue;
+
+		Real cost = estimate_cost(**i);
+		if (cost <= share) continue;
+
+		const RectInt r = (*i)->target_rect;
+		const int w = r.get_width();
+		const int h = r.get_height();
+
+		// tiles should not be smaller than cache-sized tile
+		int parts = (int)std::min((long long)ceil(cost/share), (long long)w*h/min_area);
+		if (parts < 2) continue;
+
+		// choose grid with tiles close to square
+		int cols = (int)round(sqrt((Real)parts*(Real)w/(Real)h));
+		cols = std::max(1, std::min(std::max(1, w/min_tile_size), cols));
+		int rows = (parts + cols - 1)/cols;
+		rows = std::max(1, std::min(std::max(1, h/min_tile_size), rows));
+		if (cols*rows < 2) continue;
+
+		// task may read the target surface (see TaskInterfaceTargetAsSource),
+		// each part reads only own area, so the sub-task should be truncated too,
+		// otherwise parts will depend from each other.
+		// Other sub-tasks are rendered completely into own surfaces
+		// before this task, so parts may read any area of them (blur margins for example)
+		int target_index = -1;
+		if (TaskInterfaceTargetAsSource *interface = i->type_pointer<TaskInterfaceTargetAsSource>())
 		{
-			RectInt r = (*i)->target_rect;
-			int w = r.maxx - r.minx;
-			int h = r.maxy - r.miny;
-			int t = std::min(h/10, w*h/min_area);
-			if (t >= 2)
+			int index = interface->get_target_subtask_index();
+			const Task::Handle &sub_task = (*i)->sub_task(index);
+			if (sub_task && sub_task->target_surface == (*i)->target_surface)
+				target_index = index;
+		}
+
+		Task::List parts_list;
+		parts_list.reserve(cols*rows);
+		for(int y = 0; y < rows; ++y)
+		{
+			for(int x = 0; x < cols; ++x)
 			{
-				int hh = h/t;
-				int y = r.miny;
-				for(int j = 1; j < t; ++j, y += hh)
+				RectInt tr(
+					r.minx + (int)((long long)w*x/cols),
+					r.miny + (int)((long long)h*y/rows),
+					r.minx + (int)((long long)w*(x + 1)/cols),
+					r.miny + (int)((long long)h*(y + 1)/rows) );
+
+				Task::Handle task = (*i)->clone();
+				task->trunc_target_rect(tr);
+				if (target_index >= 0)
 				{
-					Task::Handle task = (*i)->clone();
-					task->trunc_target_rect( RectInt(r.minx, y, r.maxx, y + hh) );
-					i = params.list->insert(i, task);
-					++i;
+					Task::Handle &sub_task = task->sub_task(target_index);
+					sub_task = sub_task->clone();
+					sub_task->trunc_target_rect(tr);
 				}
-				*i = (*i)->clone();
-				(*i)->trunc_target_rect( RectInt(r.minx, y, r.maxx, r.maxy) );
-				apply(params);
+				parts_list.push_back(task);
 			}
 		}
+
+		i = params.list->erase(i);
+		i = params.list->insert(i, parts_list.begin(), parts_list.end());
+		i += parts_list.size() - 1;
+		applied = true;
 	}
+
+	if (applied)
+		apply(params);
 }
 
 /* === E N T R Y P O I N T ================================================= */
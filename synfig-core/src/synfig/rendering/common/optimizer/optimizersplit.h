@@ -40,10 +40,29 @@ namespace synfig
 namespace rendering
 {
 
+//! Splits heavy tasks of linear list into tiles to load all rendering threads.
+//! Task splits only when its estimated cost is greater than
+//! the fair share of one thread for whole list.
 class OptimizerSplit: public Optimizer
 {
 public:
-	OptimizerSplit();
+	//! Minimal size of tile in pixels, tiles with size about 128x128
+	//! of Color values fits into L2 cache
+	static const int min_tile_size = 128;
+
+	//! Count of threads to load
+	int threads;
+
+	explicit OptimizerSplit(int threads);
+
+	//! Returns false when splitting disabled by environment variable
+	//! SYNFIG_RENDERING_SPLIT=0, renderers checks this before registration
+	static bool is_enabled();
+
+	//! Estimated relative cost of task, based on area,
+	//! count of sub-tasks and TaskInterfaceSplit::get_pixel_cost()
+	static Real estimate_cost(const Task &task);
+
 	virtual void run(const RunParams &params) const;
 };
 
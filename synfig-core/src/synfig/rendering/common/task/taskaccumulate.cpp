@@ -0,0 +1,103 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/task/taskaccumulate.cpp
+**	\brief TaskAccumulate
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include "taskaccumulate.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+
+Task::Token TaskAccumulate::token(
+	DescAbstract<TaskAccumulate>("Accumulate") );
+
+int
+TaskAccumulate::get_pass_subtask_index() const
+{
+	// first sub-task always blends onto transparent surface
+	if (Color::is_onto(blend_method))
+		return PASSTO_NO_TASK;
+
+	int index = PASSTO_NO_TASK;
+	for(int i = 0; i < (int)sub_tasks.size(); ++i)
+	{
+		if (!sub_tasks[i] || approximate_equal_lp(get_amount(i), ColorReal(0.0)))
+			continue;
+		if (index != PASSTO_NO_TASK)
+			return PASSTO_THIS_TASK;
+		index = i;
+	}
+
+	if ( index != PASSTO_NO_TASK
+	  && ( blend_method != Color::BLEND_COMPOSITE
+	    || !approximate_equal_lp(get_amount(index), ColorReal(1.0)) ))
+		return PASSTO_THIS_TASK;
+	return index;
+}
+
+Rect
+TaskAccumulate::calc_bounds() const
+{
+	Rect bounds = Rect::zero();
+	if (Color::is_onto(blend_method))
+		return bounds;
+	for(Task::List::const_iterator i = sub_tasks.begin(); i != sub_tasks.end(); ++i)
+	{
+		if (!*i) continue;
+		Rect r = (*i)->get_bounds();
+		if (!r.valid()) continue;
+		if (bounds.valid())
+			set_union(bounds, bounds, r);
+		else
+			bounds = r;
+	}
+	return bounds;
+}
+
+bool
+TaskAccumulate::hash_params(TaskHash &hash) const
+{
+	hash.add(blend_method);
+	for(int i = 0; i < (int)sub_tasks.size(); ++i)
+		hash.add(get_amount(i));
+	return true;
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,89 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/task/taskaccumulate.h
+**	\brief TaskAccumulate Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_TASKACCUMULATE_H
+#define __SYNFIG_RENDERING_TASKACCUMULATE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <vector>
+
+#include "../../task.h"
+#include "tasktransformation.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Blends all sub-tasks one by one onto transparent surface.
+//! Gives the same result as chain of TaskBlend, but sub-tasks
+//! are independent and may be rendered simultaneously,
+//! and there are no intermediate surfaces for each level of chain.
+//! Straight blend methods are not supported, use TaskBlend for them.
+class TaskAccumulate: public Task,
+	public TaskInterfaceTransformationPass,
+	public TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskAccumulate> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	Color::BlendMethod blend_method;
+	//! amount of each sub-task, indices are the same as in sub_tasks
+	std::vector<ColorReal> amounts;
+
+	TaskAccumulate():
+		blend_method(Color::BLEND_COMPOSITE) { }
+
+	static bool is_blend_method_supported(Color::BlendMethod blend_method)
+		{ return !Color::is_straight(blend_method); }
+
+	ColorReal get_amount(int index) const
+		{ return index < (int)amounts.size() ? amounts[index] : ColorReal(1.0); }
+
+	void add(const Task::Handle &task, ColorReal amount)
+		{ sub_tasks.push_back(task); amounts.push_back(amount); }
+
+	VectorInt get_offset(int index) const
+		{ return sub_task(index) ? TaskList::calc_target_offset(*this, *sub_task(index)) : VectorInt(); }
+
+	virtual int get_pass_subtask_index() const;
+	virtual Rect calc_bounds() const;
+	virtual bool hash_params(TaskHash &hash) const;
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -65,6 +65,13 @@ TaskBlend::get_pass_subtask_index() const
 		if (!a && approximate_equal_lp(amount, ColorReal(1.0)))
 			return 1;
 	}
+	if (blend_method == Color::BLEND_STRAIGHT) {
+		// task B fully replaces the context, so context is not needed at all
+		if ( b
+		  && approximate_equal_lp(amount, ColorReal(1.0))
+		  && sub_task_b()->get_bounds().is_full_infinite() )
+			return 1;
+	}
 	return PASSTO_THIS_TASK;
 }
 
@@ -88,4 +95,12 @@ TaskBlend::calc_bounds() const
 	return bounds;
 }
 
+bool
+TaskBlend::hash_params(TaskHash &hash) const
+{
+	hash.add(blend_method);
+	hash.add(amount);
+	return true;
+}
+
 /* === E N T R Y P O I N T ================================================= */
@@ -91,6 +91,7 @@ public:
 		{ return sub_task_b() ? TaskList::calc_target_offset(*this, *sub_task_b()) : VectorInt(); }
 
 	virtual Rect calc_bounds() const;
+	virtual bool hash_params(TaskHash &hash) const;
 };
 
 
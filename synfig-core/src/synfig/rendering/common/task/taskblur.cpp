@@ -93,4 +93,12 @@ TaskBlur::set_coords_sub_tasks()
 	sub_task()->set_coords(sub_source_rect, sub_target_size);
 }
 
+bool
+TaskBlur::hash_params(TaskHash &hash) const
+{
+	hash.add(blur.type);
+	hash.add(blur.size);
+	return true;
+}
+
 /* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,125 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/task/taskdistort.cpp
+**	\brief TaskDistort
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cmath>
+#include <algorithm>
+#include <typeinfo>
+
+#include "taskdistort.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+	// free pixels around area of source, reserved for interpolation
+	const int border = 2;
+	// area of source may be larger than area of target not more than in
+	// area_factor times, otherwise it will be rendered with lower resolution
+	const Real area_factor = 4.0;
+	const Real min_area = 256.0*256.0;
+}
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+
+Task::Token TaskDistort::token(
+	DescAbstract<TaskDistort>("Distort") );
+
+Rect
+TaskDistort::calc_bounds() const
+{
+	if (!sub_task() || !distortion) return Rect::zero();
+	return distortion->calc_bounds(sub_task()->get_bounds());
+}
+
+void
+TaskDistort::set_coords_sub_tasks()
+{
+	if (!sub_task())
+		{ trunc_to_zero(); return; }
+	if (!is_valid_coords() || !distortion)
+		{ sub_task()->set_coords_zero(); return; }
+
+	Rect rect = distortion->calc_source_bounds(source_rect);
+	rect &= sub_task()->get_bounds();
+	if (rect.is_nan_or_inf())
+		rect &= source_rect;
+	if (!rect.is_valid())
+		{ sub_task()->set_coords_zero(); return; }
+
+	// keep resolution of task while area of source is reasonable
+	Vector ppu = get_pixels_per_unit();
+	Real w = rect.get_width()*fabs(ppu[0]);
+	Real h = rect.get_height()*fabs(ppu[1]);
+	Real max_area = std::max(
+		min_area,
+		area_factor*target_rect.get_width()*target_rect.get_height() );
+	Real k = w*h > max_area ? sqrt(max_area/(w*h)) : 1.0;
+
+	VectorInt size(
+		std::max(1, (int)ceil(w*k - real_precision<Real>())),
+		std::max(1, (int)ceil(h*k - real_precision<Real>())) );
+	rect.expand_x(border*rect.get_width()/size[0]);
+	rect.expand_y(border*rect.get_height()/size[1]);
+	size += VectorInt(border, border)*2;
+
+	sub_task()->set_coords(rect, size);
+}
+
+Task::Handle
+TaskDistort::clone_draft() const
+{
+	if (interpolation == Color::INTERPOLATION_NEAREST)
+		return Task::Handle();
+	Handle task = Handle::cast_dynamic(clone());
+	task->interpolation = Color::INTERPOLATION_NEAREST;
+	return task;
+}
+
+bool
+TaskDistort::hash_params(TaskHash &hash) const
+{
+	if (!distortion) return false;
+	// different distortions may have the same parameters
+	hash.add_string(typeid(*distortion).name());
+	hash.add(interpolation);
+	return distortion->hash_params(hash);
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,80 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/task/taskdistort.h
+**	\brief TaskDistort Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_TASKDISTORT_H
+#define __SYNFIG_RENDERING_TASKDISTORT_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <synfig/color.h>
+
+#include "../../task.h"
+#include "../../primitive/distortion.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Draws sub-task distorted by inverse mapping,
+//! sub-task renders once into area of source estimated by the distortion
+class TaskDistort: public Task, public TaskInterfaceDraft
+{
+public:
+	typedef etl::handle<TaskDistort> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	Distortion::Handle distortion;
+	Color::Interpolation interpolation;
+
+	TaskDistort(): interpolation(Color::INTERPOLATION_CUBIC) { }
+
+	virtual int get_pass_subtask_index() const
+		{ return sub_task() && distortion ? PASSTO_THIS_TASK : PASSTO_NO_TASK; }
+
+	const Task::Handle& sub_task() const { return Task::sub_task(0); }
+	Task::Handle& sub_task() { return Task::sub_task(0); }
+
+	virtual Rect calc_bounds() const;
+	virtual void set_coords_sub_tasks();
+	virtual Task::Handle clone_draft() const;
+	virtual bool hash_params(TaskHash &hash) const;
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -29,7 +29,10 @@
 #	include <config.h>
 #endif
 
+#include <synfig/blinepoint.h>
 #include <synfig/context.h>
+#include <synfig/gradient.h>
+#include <synfig/transformation.h>
 #include <synfig/layers/layer_rendering_task.h>
 
 #include "tasklayer.h"
@@ -129,4 +132,92 @@ TaskLayer::set_coords_sub_tasks()
 	}
 }
 
+bool
+TaskLayer::hash_params(TaskHash &hash) const
+	{ return layer && hash_layer(hash, *layer); }
+
+bool
+TaskLayer::hash_value(TaskHash &hash, const ValueBase &value)
+{
+	Type &type = value.get_type();
+	hash.add(type.identifier);
+
+	if (type == type_nil)
+		return true;
+	if (type == type_bool)
+		{ hash.add(value.get(bool())); return true; }
+	if (type == type_integer)
+		{ hash.add(value.get(int())); return true; }
+	if (type == type_angle)
+		{ hash.add(Angle::rad(value.get(Angle())).get()); return true; }
+	if (type == type_time)
+		{ hash.add((Time::value_type)value.get(Time())); return true; }
+	if (type == type_real)
+		{ hash.add(value.get(Real())); return true; }
+	if (type == type_vector)
+		{ hash.add(value.get(Vector())); return true; }
+	if (type == type_color)
+		{ hash.add(value.get(Color())); return true; }
+	if (type == type_matrix)
+		{ hash.add(value.get(Matrix()).m); return true; }
+	if (type == type_string)
+		{ hash.add_string(value.get(String())); return true; }
+
+	if (type == type_transformation) {
+		const Transformation &t = value.get(Transformation());
+		hash.add(t.offset);
+		hash.add(Angle::rad(t.angle).get());
+		hash.add(Angle::rad(t.skew_angle).get());
+		hash.add(t.scale);
+		return true;
+	}
+
+	if (type == type_gradient) {
+		const Gradient &gradient = value.get(Gradient());
+		hash.add(gradient.size());
+		for(Gradient::const_iterator i = gradient.begin(); i != gradient.end(); ++i)
+			{ hash.add(i->pos); hash.add(i->color); }
+		return true;
+	}
+
+	if (type == type_bline_point) {
+		const BLinePoint &point = value.get(BLinePoint());
+		hash.add(point.get_vertex());
+		hash.add(point.get_tangent1());
+		hash.add(point.get_tangent2());
+		hash.add(point.get_width());
+		hash.add(point.get_origin());
+		return true;
+	}
+
+	if (type == type_list) {
+		const ValueBase::List &list = value.get_list();
+		hash.add(list.size());
+		for(ValueBase::List::const_iterator i = list.begin(); i != list.end(); ++i)
+			if (!hash_value(hash, *i))
+				return false;
+		return true;
+	}
+
+	return false;
+}
+
+bool
+TaskLayer::hash_layer(TaskHash &hash, const Layer &layer)
+{
+	// layer may hold another data, but all of it depends on
+	// the parameters and the time
+	hash.add_string(layer.get_name());
+	hash.add((Time::value_type)layer.get_time_mark());
+
+	Layer::ParamList params = layer.get_param_list();
+	hash.add(params.size());
+	for(Layer::ParamList::const_iterator i = params.begin(); i != params.end(); ++i) {
+		hash.add_string(i->first);
+		if (!hash_value(hash, i->second))
+			return false;
+	}
+	return true;
+}
+
 /* === E N T R Y P O I N T ================================================= */
@@ -56,6 +56,13 @@ public:
 
 	virtual Rect calc_bounds() const;
 	virtual void set_coords_sub_tasks();
+	virtual bool hash_params(TaskHash &hash) const;
+
+	//! Adds type and content of \a value to \a hash,
+	//! returns false for types which can not be hashed (canvases, bones, etc)
+	static bool hash_value(TaskHash &hash, const ValueBase &value);
+	//! Adds name, time and all parameters of \a layer to \a hash
+	static bool hash_layer(TaskHash &hash, const Layer &layer);
 
 private:
 	static bool renddesc_less(const RendDesc &a, const RendDesc &b);
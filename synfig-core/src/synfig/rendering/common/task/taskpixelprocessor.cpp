@@ -70,4 +70,19 @@ TaskPixelProcessor::get_offset() const
 	return VectorInt((int)round(offset[0]), (int)round(offset[1])) - sub_task()->target_rect.get_min();
 }
 
+bool
+TaskPixelGamma::hash_params(TaskHash &hash) const
+{
+	hash.add(gamma);
+	return true;
+}
+
+bool
+TaskPixelColorMatrix::hash_params(TaskHash &hash) const
+{
+	for(int i = 0; i < 5; ++i)
+		hash.add(matrix[i]);
+	return true;
+}
+
 /* === E N T R Y P O I N T ================================================= */
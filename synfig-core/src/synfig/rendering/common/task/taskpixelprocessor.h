@@ -105,6 +105,8 @@ public:
 			&& approximate_equal_lp(gamma_b, ColorReal(1.0))
 			&& approximate_equal_lp(gamma_a, ColorReal(1.0));
 	}
+
+	virtual bool hash_params(TaskHash &hash) const;
 };
 
 
@@ -125,6 +127,8 @@ public:
 		{ return matrix.is_constant(); }
 	virtual bool is_affects_transparent() const
 		{ return matrix.is_affects_transparent(); }
+
+	virtual bool hash_params(TaskHash &hash) const;
 };
 
 
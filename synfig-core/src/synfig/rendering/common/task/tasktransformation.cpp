@@ -141,4 +141,14 @@ TaskTransformationAffine::get_pass_subtask_index() const
 		return 0;
 	return TaskTransformation::get_pass_subtask_index();
 }
+
+bool
+TaskTransformationAffine::hash_params(TaskHash &hash) const
+{
+	hash.add(interpolation);
+	hash.add(supersample);
+	hash.add(transformation->matrix.m);
+	return true;
+}
+
 /* === E N T R Y P O I N T ================================================= */
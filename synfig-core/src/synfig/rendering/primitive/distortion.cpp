@@ -0,0 +1,111 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/primitive/distortion.cpp
+**	\brief Distortion
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include "distortion.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+	// count of segments of grid to estimate bounds of source
+	const int bounds_grid = 16;
+}
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+void
+Distortion::map_row_vfunc(Point *dst, const Point &p, const Vector &dp, int count) const
+{
+	for(int i = 0; i < count; ++i)
+		dst[i] = map(p + dp*(Real)i);
+}
+
+Rect
+Distortion::calc_source_bounds_vfunc(const Rect &rect) const
+{
+	if (!rect.is_valid() || rect.is_nan_or_inf())
+		return Rect::infinite();
+
+	const int count = bounds_grid + 1;
+	Vector dx(rect.get_width()/bounds_grid, 0.0);
+	Vector dy(0.0, rect.get_height()/bounds_grid);
+
+	std::vector<Point> rows[2];
+	rows[0].resize(count);
+	rows[1].resize(count);
+
+	// gaps between samples are covered by the largest distance
+	// between neighbour samples of source
+	bool found = false;
+	Rect bounds;
+	Real gap = 0.0;
+	for(int i = 0; i < count; ++i) {
+		std::vector<Point> &row = rows[i%2];
+		const std::vector<Point> &prev = rows[(i + 1)%2];
+		map_row(&row.front(), rect.get_min() + dy*(Real)i, dx, count);
+		for(int j = 0; j < count; ++j) {
+			const Point &p = row[j];
+			if (p.is_nan_or_inf()) continue;
+			if (found) bounds.expand(p); else bounds = Rect(p);
+			found = true;
+			if (j > 0 && !row[j-1].is_nan_or_inf())
+				gap = std::max(gap, (p - row[j-1]).mag());
+			if (i > 0 && !prev[j].is_nan_or_inf())
+				gap = std::max(gap, (p - prev[j]).mag());
+		}
+	}
+
+	if (!found)
+		return Rect::zero();
+	bounds.expand(gap);
+	return bounds;
+}
+
+Rect
+Distortion::calc_bounds_vfunc(const Rect& /* source_bounds */) const
+	{ return Rect::infinite(); }
+
+bool
+Distortion::hash_params_vfunc(TaskHash& /* hash */) const
+	{ return false; }
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,95 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/primitive/distortion.h
+**	\brief Distortion Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_DISTORTION_H
+#define __SYNFIG_RENDERING_DISTORTION_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <ETL/handle>
+
+#include <synfig/rect.h>
+#include <synfig/vector.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+class TaskHash;
+
+//! Non-linear distortion described by inverse mapping:
+//! for each point of result it returns point of source (context)
+//! where the color should be taken from.
+//! Points without source should be mapped to NaN, they will be transparent.
+class Distortion: public etl::shared_object
+{
+public:
+	typedef etl::handle<Distortion> Handle;
+
+protected:
+	virtual Point map_vfunc(const Point &p) const = 0;
+	virtual void map_row_vfunc(Point *dst, const Point &p, const Vector &dp, int count) const;
+	virtual Rect calc_source_bounds_vfunc(const Rect &rect) const;
+	virtual Rect calc_bounds_vfunc(const Rect &source_bounds) const;
+	virtual bool hash_params_vfunc(TaskHash &hash) const;
+
+public:
+	virtual ~Distortion() { }
+
+	//! Returns point of source for point \a p of result
+	Point map(const Point &p) const
+		{ return map_vfunc(p); }
+
+	//! Maps \a count points of row, starting from \a p with step \a dp
+	void map_row(Point *dst, const Point &p, const Vector &dp, int count) const
+		{ if (count > 0) map_row_vfunc(dst, p, dp, count); }
+
+	//! Returns bounds of source area needed to draw the \a rect of result,
+	//! by default it's estimated by samples of map()
+	Rect calc_source_bounds(const Rect &rect) const
+		{ return calc_source_bounds_vfunc(rect); }
+
+	//! Returns bounds of result for \a source_bounds, by default it's infinite
+	Rect calc_bounds(const Rect &source_bounds) const
+		{ return calc_bounds_vfunc(source_bounds); }
+
+	//! Adds parameters of distortion to \a hash, see Task::hash_params(),
+	//! returns false if mapping can not be identified by parameters (by default)
+	bool hash_params(TaskHash &hash) const
+		{ return hash_params_vfunc(hash); }
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,258 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/rendercache.cpp
+**	\brief RenderCache
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cstdlib>
+
+#include <algorithm>
+
+#include "rendercache.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+
+RenderCache::RenderCache(size_t max_size):
+	max_size(max_size), size() { }
+
+size_t
+RenderCache::get_env_max_size()
+{
+	if (const char *s = getenv("SYNFIG_RENDERING_CACHE_SIZE"))
+	{
+		int megabytes = atoi(s);
+		if (megabytes > 0)
+			return (size_t)megabytes*1024*1024;
+	}
+	return 0;
+}
+
+void
+RenderCache::clear()
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	items.clear();
+	lru.clear();
+	seen.clear();
+	seen_lru.clear();
+	size = 0;
+}
+
+bool
+RenderCache::find(const Key &key, Entry &out_entry)
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	ItemMap::iterator i = items.find(key);
+	if (i == items.end())
+		return false;
+	lru.splice(lru.begin(), lru, i->second.lru);
+	out_entry = i->second.entry;
+	return true;
+}
+
+bool
+RenderCache::touch_seen(TaskHash::Value hash)
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	SeenMap::iterator i = seen.find(hash);
+	if (i != seen.end()) {
+		seen_lru.splice(seen_lru.begin(), seen_lru, i->second);
+		return true;
+	}
+
+	seen[hash] = seen_lru.insert(seen_lru.begin(), hash);
+	while((int)seen.size() > max_seen_keys)
+		{ seen.erase(seen_lru.back()); seen_lru.pop_back(); }
+	return false;
+}
+
+void
+RenderCache::store(const EntryList &entries)
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	for(EntryList::const_iterator i = entries.begin(); i != entries.end(); ++i)
+	{
+		size_t entry_size = i->get_size();
+		if (!i->surface || entry_size > max_size || items.count(i->key))
+			continue;
+
+		Item &item = items[i->key];
+		item.entry = *i;
+		item.lru = lru.insert(lru.begin(), i->key);
+		size += entry_size;
+
+		while(size > max_size) {
+			ItemMap::iterator j = items.find(lru.back());
+			size -= j->second.entry.get_size();
+			items.erase(j);
+			lru.pop_back();
+		}
+	}
+}
+
+const RenderCache::Key&
+RenderCache::calc_hash(const Task::Handle &task, const String &renderer, HashMap &hashes) const
+{
+	HashMap::const_iterator i = hashes.find(task.get());
+	if (i != hashes.end())
+		return i->second;
+
+	// sub-tasks should be processed in any case,
+	// they may be cached even when parent is not
+	bool valid = true;
+	std::vector<const Key*> sub_keys;
+	sub_keys.reserve(task->sub_tasks.size());
+	for(Task::List::const_iterator j = task->sub_tasks.begin(); j != task->sub_tasks.end(); ++j)
+	{
+		const Key *key = *j ? &calc_hash(*j, renderer, hashes) : NULL;
+		if (key && !key->is_valid()) valid = false;
+		sub_keys.push_back(key);
+	}
+
+	TaskHash hash;
+	if (task->is_valid_coords())
+	{
+		hash.add_string(renderer);
+		hash.add_string(task->get_token()->name);
+		if (valid)
+			valid = task->hash_params(hash);
+		hash.add(task->source_rect.minx);
+		hash.add(task->source_rect.miny);
+		hash.add(task->source_rect.maxx);
+		hash.add(task->source_rect.maxy);
+		hash.add(task->target_rect.get_width());
+		hash.add(task->target_rect.get_height());
+		hash.add(sub_keys.size());
+		if (valid)
+			for(std::vector<const Key*>::const_iterator j = sub_keys.begin(); j != sub_keys.end(); ++j)
+				{ hash.add((bool)*j); if (*j) hash.add_string((*j)->data); }
+	}
+	else
+	{
+		// task will not draw anything, so parameters doesn't matter
+		valid = true;
+	}
+
+	// map doesn't move elements, so reference stays valid
+	Key &key = hashes[task.get()];
+	if (valid) key = Key(hash);
+	return key;
+}
+
+bool
+RenderCache::process_sub_tasks(Task::Handle &task, const HashMap &hashes, Task::List &list, EntryList &entries)
+{
+	bool changed = false;
+	for(int i = 0; i < (int)task->sub_tasks.size(); ++i)
+	{
+		Task::Handle sub_task = task->sub_tasks[i];
+		if (sub_task && process_task(sub_task, hashes, list, entries))
+		{
+			// don't modify the original task, it may be used somewhere else
+			if (!changed) { task = task->clone(); changed = true; }
+			task->sub_tasks[i] = sub_task;
+		}
+	}
+	return changed;
+}
+
+bool
+RenderCache::process_task(Task::Handle &task, const HashMap &hashes, Task::List &list, EntryList &entries)
+{
+	HashMap::const_iterator i = hashes.find(task.get());
+	const Key &key = i == hashes.end() ? Key() : i->second;
+	if ( key.is_valid()
+	  && task->is_valid()
+	  && task->target_rect.get_width()*task->target_rect.get_height() >= min_pixels
+	  && !task.type_is<TaskSurface>() )
+	{
+		Entry entry;
+		if (find(key, entry))
+		{
+			Task::Handle surface(new TaskSurface());
+			surface->assign_target(*task);
+			surface->target_surface = entry.surface;
+			surface->target_rect = entry.rect;
+			task = surface;
+			return true;
+		}
+
+		if (touch_seen(key.hash))
+		{
+			// task was met before, so probably it's a static part of the scene,
+			// render it into the own surface which will be stored after rendering
+			Task::Handle separate = task->clone();
+			process_sub_tasks(separate, hashes, list, entries);
+			separate->target_rect = RectInt(VectorInt::zero(), task->target_rect.get_size());
+			separate->target_surface = new SurfaceResource();
+			separate->target_surface->create(separate->target_rect.get_size());
+			list.push_back(separate);
+			entries.push_back(Entry(key, separate->target_surface, separate->target_rect));
+
+			Task::Handle surface(new TaskSurface());
+			surface->assign_target(*separate);
+			task = surface;
+			return true;
+		}
+	}
+
+	return process_sub_tasks(task, hashes, list, entries);
+}
+
+void
+RenderCache::process(Task::List &list, const String &renderer, EntryList &out_entries)
+{
+	HashMap hashes;
+	for(Task::List::const_iterator i = list.begin(); i != list.end(); ++i)
+		if (*i) calc_hash(*i, renderer, hashes);
+
+	// root tasks are never replaced, their targets are owned by caller
+	Task::List new_list;
+	new_list.reserve(list.size());
+	for(Task::List::const_iterator i = list.begin(); i != list.end(); ++i)
+	{
+		Task::Handle task = *i;
+		if (task) process_sub_tasks(task, hashes, new_list, out_entries);
+		new_list.push_back(task);
+	}
+	list.swap(new_list);
+}
+
+/* === E N T R Y P O I N T ================================================= */
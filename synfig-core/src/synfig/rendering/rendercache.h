@@ -0,0 +1,162 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/rendercache.h
+**	\brief RenderCache Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_RENDERCACHE_H
+#define __SYNFIG_RENDERING_RENDERCACHE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <glibmm/threads.h>
+
+#include "task.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Keeps rendered surfaces of task sub-trees which are repeated from frame to frame.
+//! Sub-tree is identified by name of renderer and by parameters, coordinates
+//! and sub-tasks of each task, see Task::hash_params(). Different renderers
+//! may optimize the same tasks differently, so they never share surfaces.
+//! Sub-tree will be stored only when it was met before,
+//! so animated parts of the scene don't pollute the cache.
+//! Cached surfaces are never modified, tasks refers them via TaskSurface.
+class RenderCache
+{
+public:
+	//! Identity of task sub-tree: hash for fast comparison and
+	//! all hashed bytes, which are compared when hashes are equal
+	class Key {
+	public:
+		TaskHash::Value hash; //!< zero means that sub-tree cannot be identified
+		String data;
+
+		Key(): hash() { }
+		explicit Key(const TaskHash &x):
+			hash(std::max(x.get(), TaskHash::Value(1))), data(x.get_data()) { }
+
+		bool is_valid() const
+			{ return hash != 0; }
+		bool operator<(const Key &other) const
+			{ return hash < other.hash || (hash == other.hash && data < other.data); }
+	};
+
+	struct Entry {
+		Key key;
+		SurfaceResource::Handle surface;
+		RectInt rect;
+
+		Entry() { }
+		Entry(const Key &key, const SurfaceResource::Handle &surface, const RectInt &rect):
+			key(key), surface(surface), rect(rect) { }
+
+		size_t get_size() const
+			{ return (size_t)rect.get_width()*(size_t)rect.get_height()*sizeof(Color); }
+	};
+
+	typedef std::vector<Entry> EntryList;
+
+	//! tasks with less count of pixels are cheaper to render again
+	static const int min_pixels = 4096;
+	//! count of remembered keys of tasks which are not stored yet
+	static const int max_seen_keys = 65536;
+
+private:
+	typedef std::list<Key> KeyList;
+	typedef std::map<const Task*, Key> HashMap;
+
+	struct Item {
+		Entry entry;
+		KeyList::iterator lru;
+	};
+
+	typedef std::map<Key, Item> ItemMap;
+
+	// seen tasks are identified by hash only, collision just causes
+	// storing of the task which was not met before
+	typedef std::list<TaskHash::Value> SeenList;
+	typedef std::map<TaskHash::Value, SeenList::iterator> SeenMap;
+
+	mutable Glib::Threads::Mutex mutex;
+	size_t max_size;
+	size_t size;
+	KeyList lru;
+	ItemMap items;
+	SeenList seen_lru;
+	SeenMap seen;
+
+	bool find(const Key &key, Entry &out_entry);
+	bool touch_seen(TaskHash::Value hash);
+
+	const Key& calc_hash(const Task::Handle &task, const String &renderer, HashMap &hashes) const;
+	bool process_task(Task::Handle &task, const HashMap &hashes, Task::List &list, EntryList &entries);
+	bool process_sub_tasks(Task::Handle &task, const HashMap &hashes, Task::List &list, EntryList &entries);
+
+public:
+	explicit RenderCache(size_t max_size);
+
+	//! Returns cache size in bytes from environment variable
+	//! SYNFIG_RENDERING_CACHE_SIZE (in megabytes), zero means that cache is disabled
+	static size_t get_env_max_size();
+
+	size_t get_max_size() const
+		{ Glib::Threads::Mutex::Lock lock(mutex); return max_size; }
+	size_t get_size() const
+		{ Glib::Threads::Mutex::Lock lock(mutex); return size; }
+
+	void clear();
+
+	//! Replaces sub-tasks found in cache by TaskSurface.
+	//! Sub-trees which should be stored are moved to the separate tasks
+	//! before the tasks which uses them, results are returned in 'out_entries',
+	//! pass them to store() when tasks are complete.
+	//! Tasks in list must have calculated coordinates.
+	//! Name of renderer is the part of keys of tasks.
+	void process(Task::List &list, const String &renderer, EntryList &out_entries);
+
+	void store(const EntryList &entries);
+
+	//! handler for TaskEvent::signal_finished
+	void on_finished(bool success, EntryList entries)
+		{ if (success) store(entries); }
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -43,6 +43,7 @@
 
 #include "renderer.h"
 #include "renderqueue.h"
+#include "rendercache.h"
 
 #include "software/renderersw.h"
 #include "software/rendererdraftsw.h"
@@ -82,6 +83,7 @@ using namespace rendering;
 Renderer::Handle Renderer::blank;
 std::map<String, Renderer::Handle> *Renderer::renderers;
 RenderQueue *Renderer::queue;
+RenderCache *Renderer::cache;
 Renderer::DebugOptions Renderer::debug_options;
 long long Renderer::last_registered_optimizer_index = 0;
 long long Renderer::last_batch_index = 0;
@@ -835,6 +837,16 @@ Renderer::enqueue(const Task::List &list, const TaskEvent::Handle &finish_event_
 		log(get_debug_options().task_list_log, list, "input list");
 
 	Task::List optimized_list(list);
+	if (cache)
+	{
+		// cache identifies tasks by coordinates, so calculate them before
+		calc_coords(optimized_list);
+		RenderCache::EntryList entries;
+		cache->process(optimized_list, get_name(), entries);
+		if (!entries.empty())
+			finish_event_task->signal_finished.connect(
+				sigc::bind(sigc::mem_fun(*cache, &RenderCache::on_finished), entries) );
+	}
 	optimize(optimized_list);
 	find_deps(optimized_list, ++last_batch_index);
 
@@ -988,6 +1000,11 @@ Renderer::initialize()
 
 	renderers = new std::map<String, Handle>();
 	queue = new RenderQueue();
+	if (size_t cache_size = RenderCache::get_env_max_size())
+	{
+		cache = new RenderCache(cache_size);
+		synfig::info("rendering cache %d MB", (int)(cache_size/1024/1024));
+	}
 
 	initialize_renderers();
 }
@@ -1005,6 +1022,8 @@ Renderer::deinitialize()
 
 	delete renderers;
 	delete queue;
+	delete cache;
+	cache = NULL;
 }
 
 void
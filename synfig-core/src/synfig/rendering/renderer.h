@@ -46,6 +46,7 @@ namespace rendering
 {
 
 class RenderQueue;
+class RenderCache;
 
 class Renderer: public etl::shared_object
 {
@@ -63,6 +64,7 @@ private:
 	static Handle blank;
 	static std::map<String, Handle> *renderers;
 	static RenderQueue *queue;
+	static RenderCache *cache;
 	static DebugOptions debug_options;
 	static long long last_registered_optimizer_index;
 	static long long last_batch_index; // TODO: atomic
@@ -140,6 +142,8 @@ private:
 
 public:
 	int get_max_simultaneous_threads() const;
+	//! queue which runs tasks of all renderers, NULL before initialization
+	static const RenderQueue* get_queue() { return queue; }
 	void optimize(Task::List &list) const;
 
 	bool run(
@@ -183,6 +187,10 @@ public:
 	static const DebugOptions& get_debug_options()
 		{ return debug_options; }
 
+	//! returns NULL when cache is disabled, see RenderCache::get_env_max_size()
+	static RenderCache* get_cache()
+		{ return cache; }
+
 	static bool subsys_init()
 		{ initialize(); return true; }
 	static bool subsys_stop()
@@ -33,12 +33,14 @@
 #include <climits>
 
 #include <typeinfo>
+#include <algorithm>
 
 #include <synfig/general.h>
 #include <synfig/localization.h>
 #include <synfig/debug/debugsurface.h>
 #include <synfig/debug/log.h>
 #include <synfig/debug/measure.h>
+#include <synfig/threadpool.h>
 
 #include "renderqueue.h"
 #include "renderer.h"
@@ -52,6 +54,8 @@ using namespace rendering;
 #define SYNFIG_RENDERING_MAX_THREADS 256
 
 
+//#define DEBUG_QUEUE_STATS
+
 #ifndef NDEBUG
 //#define DEBUG_THREAD_TASK
 //#define DEBUG_THREAD_WAIT
@@ -85,7 +89,17 @@ Task::Token TaskSubQueue::token(
 } // end of anonimous namespace
 
 
-RenderQueue::RenderQueue(): started(false) { start(); }
+RenderQueue::RenderQueue():
+	single_sleeping(0),
+	single_ready_count(0),
+	ready_count(0),
+	pool_slots(0),
+	started(false),
+	stats_tasks(0),
+	stats_idle_time(0),
+	stats_max_queue_depth(0)
+	{ start(); }
+
 RenderQueue::~RenderQueue() { stop(); }
 
 void
@@ -94,27 +108,31 @@ RenderQueue::start()
 	Glib::Threads::Mutex::Lock lock(mutex);
 	if (started) return;
 
-	// one thread reserved for non-multithreading tasks (OpenGL)
+	// multithreading tasks are processed by threads of ThreadPool,
+	// one more thread reserved for non-multithreading tasks (OpenGL)
 	// also this thread almost don't use CPU time
 	// so we have ~50% of one core for GUI
-	int count = g_get_num_processors();
+	int count = ThreadPool::instance.get_max_threads();
 
 	#ifdef DEBUG_TASK_SURFACE
-	count = 2;
+	count = 1;
 	#endif
 
 	if (const char *s = getenv("SYNFIG_RENDERING_THREADS"))
-		count = atoi(s) + 1;
+		count = atoi(s);
 
-	if (count > SYNFIG_RENDERING_MAX_THREADS) count = SYNFIG_RENDERING_MAX_THREADS;
-	if (count < 2) count = 2;
+	if (count > SYNFIG_RENDERING_MAX_THREADS - 1) count = SYNFIG_RENDERING_MAX_THREADS - 1;
+	if (count < 1) count = 1;
 
-	for(int i = 0; i < count; ++i)
-		threads.push_back(
-			Glib::Threads::Thread::create(
-				sigc::bind(sigc::mem_fun(*this, &RenderQueue::process), i) ));
-	info("rendering threads %d", count);
+	if (count != ThreadPool::instance.get_max_threads())
+		ThreadPool::instance.set_max_threads(count);
+
+	// thread should see the flag at start
 	started = true;
+	threads.push_back(
+		Glib::Threads::Thread::create(
+			sigc::mem_fun(*this, &RenderQueue::process) ));
+	info("rendering threads %d", count + 1);
 }
 
 void
@@ -123,142 +141,217 @@ RenderQueue::stop()
 	{
 		Glib::Threads::Mutex::Lock lock(mutex);
 		started = false;
-		cond.broadcast();
+	}
+	{
+		Glib::Threads::Mutex::Lock lock(sleep_mutex);
 		single_cond.broadcast();
 	}
 	while(!threads.empty())
 		{ threads.front()->join(); threads.pop_front(); }
+
+	// slots in ThreadPool refer to this queue, so wait for them
+	{
+		Glib::Threads::Mutex::Lock lock(pool_mutex);
+		ready_count -= (int)pool_ready.size();
+		pool_ready.clear();
+	}
+	{
+		Glib::Threads::Mutex::Lock lock(sleep_mutex);
+		while(pool_slots > 0)
+			cond.wait(sleep_mutex);
+	}
+
+	#ifdef DEBUG_QUEUE_STATS
+	Stats stats = get_stats();
+	info( "rendering queue: tasks %lld, steals %lld, idle time %.6f, max queue depth %d",
+		  stats.tasks,
+		  stats.steals,
+		  (double)stats.idle_time*1e-6,
+		  stats.max_queue_depth );
+	#endif
+}
+
+void
+RenderQueue::process()
+{
+	while(Task::Handle task = get())
+		process_task(task);
 }
 
 void
-RenderQueue::process(int thread_index)
+RenderQueue::process_pool(Task::Handle task)
 {
-	while(Task::Handle task = get(thread_index))
+	bool cancelled;
 	{
-		#ifdef DEBUG_THREAD_TASK
-		info( "thread %d: begin task #%05d-%04d '%s'",
-			  thread_index,
-			  task->renderer_data.batch_index,
-			  task->renderer_data.index,
-			  task->get_token()->name.c_str() );
-		#endif
+		Glib::Threads::Mutex::Lock lock(pool_mutex);
+		cancelled = !pool_ready.erase(task);
+	}
+	if (!cancelled) {
+		--ready_count;
+		process_task(task);
+	}
+
+	if (--pool_slots == 0 && !started)
+		{ Glib::Threads::Mutex::Lock lock(sleep_mutex); cond.broadcast(); }
+}
+
+void
+RenderQueue::process_task(const Task::Handle &task)
+{
+	++stats_tasks;
+
+	#ifdef DEBUG_THREAD_TASK
+	info( "thread %p: begin task #%05d-%04d '%s'",
+		  Glib::Threads::Thread::self(),
+		  task->renderer_data.batch_index,
+		  task->renderer_data.index,
+		  task->get_token()->name.c_str() );
+	#endif
+
+	if (TaskSubQueue::Handle task_sub_queue = TaskSubQueue::Handle::cast_dynamic(task))
+	{
+		done(task_sub_queue->sub_task());
+		done(task_sub_queue);
+		return;
+	}
 
-		if (TaskSubQueue::Handle task_sub_queue = TaskSubQueue::Handle::cast_dynamic(task))
+	bool success = false;
+	try {
+		success = task->run(task->renderer_data.params);
+	} catch(...) { }
+	if (!success)
+		task->renderer_data.success = false;
+
+	#ifdef DEBUG_TASK_SURFACE
+	debug::DebugSurface::save_to_file(
+		task->target_surface,
+		etl::strprintf(
+			"task-%05d-%04d-%05d",
+			task->renderer_data.batch_index,
+			task->renderer_data.index,
+			task->target_surface ? task->target_surface->get_id() : 0 ));
+	#endif
+
+	#ifdef DEBUG_THREAD_TASK
+	info( "thread %p: end task #%05d-%04d '%s'",
+		  Glib::Threads::Thread::self(),
+		  task->renderer_data.batch_index,
+		  task->renderer_data.index,
+		  task->get_token()->name.c_str() );
+	#endif
+
+	if (!task->renderer_data.params.sub_queue.empty())
+	{
+		if (task->renderer_data.params.renderer)
 		{
-			done(thread_index, task_sub_queue->sub_task());
-			done(thread_index, task_sub_queue);
-			continue;
+			TaskSubQueue::Handle task_sub_queue(new TaskSubQueue());
+			task_sub_queue->sub_task() = task;
+			task->renderer_data.params.renderer->enqueue(task->renderer_data.params.sub_queue, task_sub_queue, true);
+			return;
 		}
+		task->renderer_data.success = false;
+	}
 
-		bool success = false;
-		try {
-			success = task->run(task->renderer_data.params);
-		} catch(...) { }
-		if (!success)
-			task->renderer_data.success = false;
-
-		#ifdef DEBUG_TASK_SURFACE
-		debug::DebugSurface::save_to_file(
-			task->target_surface,
-			etl::strprintf(
-				"task-%05d-%04d-%05d",
-				task->renderer_data.batch_index,
-				task->renderer_data.index,
-				task->target_surface ? task->target_surface->get_id() : 0 ));
-		#endif
+	done(task);
+}
 
-		#ifdef DEBUG_THREAD_TASK
-		info( "thread %d: end task #%05d-%04d '%s'",
-			  thread_index,
-			  task->renderer_data.batch_index,
-			  task->renderer_data.index,
-			  task->get_token()->name.c_str() );
-		#endif
+void
+RenderQueue::push(const Task::Handle &task)
+{
+	// deps_lock must be already locked
 
-		if (!task->renderer_data.params.sub_queue.empty())
+	if (!task->get_allow_multithreading())
+	{
 		{
-			if (task->renderer_data.params.renderer)
-			{
-				TaskSubQueue::Handle task_sub_queue(new TaskSubQueue());
-				task_sub_queue->sub_task() = task;
-				task->renderer_data.params.renderer->enqueue(task->renderer_data.params.sub_queue, task_sub_queue, true);
-				continue;
-			}
-			task->renderer_data.success = false;
+			Glib::Threads::Mutex::Lock lock(single_mutex);
+			single_tasks.push_back(task);
 		}
+		++single_ready_count;
+		return;
+	}
 
-		done(thread_index, task);
+	{
+		Glib::Threads::Mutex::Lock lock(pool_mutex);
+		if (!pool_ready.insert(task).second) return;
 	}
+	int depth = ++ready_count;
+	int max_depth = stats_max_queue_depth;
+	while(depth > max_depth && !stats_max_queue_depth.compare_exchange_weak(max_depth, depth)) { }
+
+	// task which was unlocked by the thread of pool probably uses
+	// the same surfaces, so pool keeps it in the queue of this thread
+	++pool_slots;
+	ThreadPool::instance.enqueue(
+		sigc::bind(sigc::mem_fun(*this, &RenderQueue::process_pool), task) );
 }
 
 void
-RenderQueue::done(int thread_index, const Task::Handle &task)
+RenderQueue::wakeup(int single_signals)
+{
+	// there is no need to wakeup more threads than sleeps now
+	single_signals = std::min(single_signals, (int)single_sleeping);
+	if (single_signals <= 0)
+		return;
+
+	Glib::Threads::Mutex::Lock lock(sleep_mutex);
+	while(single_signals-- > 0) single_cond.signal();
+}
+
+void
+RenderQueue::done(const Task::Handle &task)
 {
 	assert(task);
 	int single_signals = 0;
-	int signals = 0;
-	Glib::Threads::Mutex::Lock lock(mutex);
-	for(Task::Set::iterator i = task->renderer_data.back_deps.begin(); i != task->renderer_data.back_deps.end(); ++i)
 	{
-		assert(*i);
-		(*i)->renderer_data.deps.erase(task);
-		if ((*i)->renderer_data.deps.empty())
+		Glib::Threads::RWLock::ReaderLock lock(deps_lock);
+		Task::RendererData &task_rd = task->renderer_data;
+		for(Task::Set::iterator i = task_rd.back_deps.begin(); i != task_rd.back_deps.end(); ++i)
 		{
-			bool mt = (*i)->get_allow_multithreading();
-			TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-			TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-			wait.erase(*i);
-			queue.push_back(*i);
-			++(mt ? signals : single_signals);
+			assert(*i);
+			Task::RendererData &back_rd = (*i)->renderer_data;
+			if (--back_rd.deps_count == 0)
+			{
+				// only one thread reaches zero, so it's safe to modify the set
+				back_rd.deps.clear();
+				push(*i);
+				if (!(*i)->get_allow_multithreading())
+					++single_signals;
+			}
 		}
+		task_rd.back_deps.clear();
 	}
-	task->renderer_data.back_deps.clear();
-	assert( tasks_in_process.count(thread_index) == 1 );
-	tasks_in_process.erase(thread_index);
-	//info("rendering threads used %d", tasks_in_process.size());
-
-	// limit signals count
-	int threads = get_threads_count() - 1;
-	if (signals > threads) signals = threads;
-	if (single_signals > 1) single_signals = 1;
-
-	// we don't need to wakeup the current thread
-	--(thread_index ? signals : single_signals);
-
-	// wake up
-	while(signals-- > 0) cond.signal();
-	while(single_signals-- > 0) single_cond.signal();
+	wakeup(single_signals);
 }
 
 Task::Handle
-RenderQueue::get(int thread_index)
+RenderQueue::get()
 {
-	Glib::Threads::Mutex::Lock lock(mutex);
-
-	TaskQueue &queue  = thread_index == 0 ? single_ready_tasks     : ready_tasks;
-	TaskQueue &queue2 = thread_index != 0 ? single_ready_tasks     : ready_tasks;
-	TaskSet   &wait   = thread_index == 0 ? single_not_ready_tasks : not_ready_tasks;
 	while(started)
 	{
-		if (!queue.empty())
 		{
-			Task::Handle task = queue.front();
-			queue.pop_front();
-			if (!task) continue;
-			assert( tasks_in_process.count(thread_index) == 0 );
-			tasks_in_process[thread_index] = task;
-			//info("rendering threads used %d", tasks_in_process.size());
-			return task;
+			Glib::Threads::Mutex::Lock lock(single_mutex);
+			if (!single_tasks.empty()) {
+				Task::Handle task = single_tasks.front();
+				single_tasks.pop_front();
+				--single_ready_count;
+				return task;
+			}
 		}
 
 		#ifdef DEBUG_THREAD_WAIT
-		if (!wait.empty())
-			info("thread %d: rendering wait for task", thread_index);
+		info("rendering wait for task");
 		#endif
 
-		assert( wait.empty() || !tasks_in_process.empty() || !queue2.empty() );
-
-		(thread_index ? cond : single_cond).wait(mutex);
+		gint64 time = g_get_monotonic_time();
+		{
+			Glib::Threads::Mutex::Lock lock(sleep_mutex);
+			++single_sleeping;
+			// task may be added while we tried to pop, see wakeup()
+			if (started && single_ready_count <= 0)
+				single_cond.wait(sleep_mutex);
+			--single_sleeping;
+		}
+		stats_idle_time += g_get_monotonic_time() - time;
 	}
 	return Task::Handle();
 }
@@ -266,94 +359,79 @@ RenderQueue::get(int thread_index)
 void
 RenderQueue::fix_task(const Task &task, const Task::RunParams &params)
 {
-	//for(Task::List::iterator i = task.back_deps.begin(); i != task.back_deps.end();)
-	//	if (*i) ++i; else i = (*i)->back_deps.erase(i);
 	task.renderer_data.params = params;
 	task.renderer_data.params.sub_queue.clear();
 	task.renderer_data.success = true;
+	task.renderer_data.deps_count = (int)task.renderer_data.deps.size();
 }
 
 int
 RenderQueue::get_threads_count() const
 {
-	return threads.size();
+	return ThreadPool::instance.get_max_threads() + (int)threads.size();
 }
 
-bool
-RenderQueue::remove_if_orphan(const Task::Handle &task, bool in_queue)
+RenderQueue::Stats
+RenderQueue::get_stats() const
 {
-	// mutex must be already locked
-
-	if (!task)
-		return true;
-
-	TaskSet *tasks = NULL;
-	TaskSet::iterator ii;
-	if (!in_queue) {
-		bool mt = task->get_allow_multithreading();
-		tasks = mt ? &not_ready_tasks : &single_not_ready_tasks;
-		ii = tasks->find(task);
-		if (ii == tasks->end())
-			return true;
-	}
-
-	if (TaskEvent::Handle task_event = TaskEvent::Handle::cast_dynamic(task))
-		if (!task_event->is_finished())
-			return false;
-
-	if (!task->renderer_data.back_deps.empty())
-		return false;
-		
-	for(TaskSet::iterator i = task->renderer_data.deps.begin(); i != task->renderer_data.deps.end(); ++i)
-		if (*i) {
-			(*i)->renderer_data.back_deps.erase(task);
-			if ((*i)->renderer_data.back_deps.empty())
-				remove_if_orphan(*i, false);
-		}
-	task->renderer_data.deps.clear();
-
-	// don't remove task if 'in_queue' is set (it will removed by caller)
-	if (tasks) tasks->erase(ii);
-	return true;
+	ThreadPool::Stats pool_stats = ThreadPool::instance.get_stats();
+	Stats stats;
+	stats.tasks = stats_tasks;
+	stats.steals = pool_stats.steals;
+	stats.idle_time = stats_idle_time + pool_stats.idle_time;
+	stats.queue_depth = ready_count + single_ready_count;
+	stats.max_queue_depth = stats_max_queue_depth;
+	return stats;
 }
 
 void
-RenderQueue::remove_orphans()
+RenderQueue::detach_task(const Task::Handle &task, TaskSet &removed)
 {
-	// mutex must be already locked
+	// deps_lock must be already locked for writing
 
-	for(TaskQueue::iterator i = ready_tasks.begin(); i != ready_tasks.end();)
-		if (remove_if_orphan(*i, true)) ready_tasks.erase(i++); else ++i;
-	for(TaskQueue::iterator i = single_ready_tasks.begin(); i != single_ready_tasks.end();)
-		if (remove_if_orphan(*i, true)) single_ready_tasks.erase(i++); else ++i;
+	Task::Set deps;
+	deps.swap(task->renderer_data.deps);
+	for(Task::Set::iterator i = deps.begin(); i != deps.end(); ++i)
+	{
+		Task::RendererData &dep_rd = (*i)->renderer_data;
+		dep_rd.back_deps.erase(task);
+		if (!dep_rd.back_deps.empty())
+			continue;
 
-	for(TaskSet::iterator i = not_ready_tasks.begin(); i != not_ready_tasks.end();)
-		if (remove_if_orphan(*i, true)) not_ready_tasks.erase(i++); else ++i;
-	for(TaskSet::iterator i = single_not_ready_tasks.begin(); i != single_not_ready_tasks.end();)
-		if (remove_if_orphan(*i, true)) single_not_ready_tasks.erase(i++); else ++i;
+		// nobody waits for this task, so remove it too
+		if (TaskEvent::Handle task_event = TaskEvent::Handle::cast_dynamic(*i))
+			if (!task_event->is_finished())
+				continue;
+		removed.insert(*i);
+		detach_task(*i, removed);
+	}
 }
 
-
 void
-RenderQueue::enqueue(const Task::Handle &task, const Task::RunParams &params)
+RenderQueue::remove_ready_tasks(const TaskSet &tasks)
 {
-	if (!task) return;
-	fix_task(*task, params);
-	Glib::Threads::Mutex::Lock lock(mutex);
+	// deps_lock must be already locked for writing
+
+	if (tasks.empty()) return;
 
-	bool mt = task->get_allow_multithreading();
-	TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-	TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-	if (task->renderer_data.deps.empty()) {
-		queue.push_back(task);
-		(mt ? cond : single_cond).signal();
+	{
+		Glib::Threads::Mutex::Lock lock(single_mutex);
+		for(TaskQueue::iterator i = single_tasks.begin(); i != single_tasks.end();)
+			if (tasks.count(*i)) { i = single_tasks.erase(i); --single_ready_count; } else ++i;
 	}
-	else
+
+	// slots of these tasks stay in ThreadPool, but they will be skipped
 	{
-		wait.insert(task);
+		Glib::Threads::Mutex::Lock lock(pool_mutex);
+		for(TaskSet::const_iterator i = tasks.begin(); i != tasks.end(); ++i)
+			if (pool_ready.erase(*i)) --ready_count;
 	}
+}
 
-	remove_orphans();
+void
+RenderQueue::enqueue(const Task::Handle &task, const Task::RunParams &params)
+{
+	if (task) enqueue(Task::List(1, task), params);
 }
 
 void
@@ -361,56 +439,29 @@ RenderQueue::enqueue(const Task::List &tasks, const Task::RunParams &params)
 {
 	Task::RunParams p(params);
 	p.sub_queue.clear();
-	int count = 0;
+
+	// dependency counters should be set before any task starts,
+	// so choose the ready tasks before pushing
+	Task::List ready;
 	for(Task::List::const_iterator i = tasks.begin(); i != tasks.end(); ++i)
-		if (*i) { fix_task(**i, p); ++count; }
-	if (!count) return;
+		if (*i) {
+			fix_task(**i, p);
+			if ((*i)->renderer_data.deps.empty())
+				ready.push_back(*i);
+		}
+	if (ready.empty()) return;
 
-	Glib::Threads::Mutex::Lock lock(mutex);
 	int single_signals = 0;
-	int signals = 0;
-	for(Task::List::const_iterator i = tasks.begin(); i != tasks.end(); ++i)
 	{
-		if (*i)
+		Glib::Threads::RWLock::ReaderLock lock(deps_lock);
+		for(Task::List::const_iterator i = ready.begin(); i != ready.end(); ++i)
 		{
-			bool mt = (*i)->get_allow_multithreading();
-			TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-			TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-			if ((*i)->renderer_data.deps.empty()) {
-				queue.push_back(*i);
-				++(mt ? signals : single_signals);
-			} else {
-				wait.insert(*i);
-			}
+			push(*i);
+			if (!(*i)->get_allow_multithreading())
+				++single_signals;
 		}
 	}
-
-	// limit signals count
-	int threads = get_threads_count() - 1;
-	if (signals > threads) signals = threads;
-	if (single_signals > 1) single_signals = 1;
-
-	// wake up
-	while(signals-- > 0) cond.signal();
-	while(single_signals-- > 0) single_cond.signal();
-
-	remove_orphans();
-}
-
-bool
-RenderQueue::remove_task(const Task::Handle &task)
-{
-	bool found = false;
-	if (task) {
-		bool mt = task->get_allow_multithreading();
-		TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-		TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-
-		for(TaskQueue::iterator i = queue.begin(); i != queue.end();)
-			if (*i == task) found = true, queue.erase(i++); else ++i;
-		if (wait.erase(task)) found = true;
-	}
-	return found;
+	wakeup(single_signals);
 }
 
 void
@@ -419,9 +470,11 @@ RenderQueue::cancel(const Task::Handle &task)
 	if (!task) return;
 
 	{
-		Glib::Threads::Mutex::Lock lock(mutex);
-		if (remove_task(task))
-			remove_orphans();
+		Glib::Threads::RWLock::WriterLock lock(deps_lock);
+		TaskSet removed;
+		removed.insert(task);
+		detach_task(task, removed);
+		remove_ready_tasks(removed);
 	}
 
 	if (TaskEvent::Handle task_event = TaskEvent::Handle::cast_dynamic(task))
@@ -436,15 +489,16 @@ RenderQueue::cancel(const Task::List &list)
 	TaskEvent::List events;
 
 	{
-		Glib::Threads::Mutex::Lock lock(mutex);
-		bool found = false;
+		Glib::Threads::RWLock::WriterLock lock(deps_lock);
+		TaskSet removed;
 		for(Task::List::const_iterator i = list.begin(); i != list.end(); ++i) {
-			if (remove_task(*i))
-				found = true;
+			if (!*i) continue;
+			removed.insert(*i);
+			detach_task(*i, removed);
 			if (TaskEvent::Handle task_event = TaskEvent::Handle::cast_dynamic(*i))
 				events.push_back(task_event);
 		}
-		if (found) remove_orphans();
+		remove_ready_tasks(removed);
 	}
 
 	for(TaskEvent::List::const_iterator i = events.begin(); i != events.end(); ++i)
@@ -454,11 +508,17 @@ RenderQueue::cancel(const Task::List &list)
 void
 RenderQueue::clear()
 {
-	Glib::Threads::Mutex::Lock lock(mutex);
-	ready_tasks.clear();
-	single_ready_tasks.clear();
-	not_ready_tasks.clear();
-	single_not_ready_tasks.clear();
+	Glib::Threads::RWLock::WriterLock lock(deps_lock);
+	{
+		Glib::Threads::Mutex::Lock single_lock(single_mutex);
+		single_ready_count -= (int)single_tasks.size();
+		single_tasks.clear();
+	}
+	{
+		Glib::Threads::Mutex::Lock pool_lock(pool_mutex);
+		ready_count -= (int)pool_ready.size();
+		pool_ready.clear();
+	}
 }
 
 /* === E N T R Y P O I N T ================================================= */
@@ -29,7 +29,11 @@
 
 #include <cstdio>
 
-#include <map>
+#include <atomic>
+#include <deque>
+#include <list>
+#include <set>
+#include <vector>
 
 #include <glibmm/threads.h>
 
@@ -46,49 +50,84 @@ namespace synfig
 namespace rendering
 {
 
+//! Runs tasks in separate threads when all their dependencies are complete.
+//! Ready tasks are executed by threads of ThreadPool, so the rendering tasks
+//! and the chunks of ThreadPool::Group are scheduled by the same workers.
+//! Each worker takes the last added slot from own queue (tasks unlocked by
+//! the finished task probably use the surfaces which are still in the CPU cache),
+//! and steals the first slot from queues of other workers when own queue is empty.
+//! Separate thread is reserved for tasks without multithreading support.
 class RenderQueue
 {
 public:
 	typedef std::list<Glib::Threads::Thread*> ThreadList;
-	typedef std::map<int, Task::Handle> ThreadTaskMap;
 	typedef std::set<Task::Handle> TaskSet;
-	typedef std::list<Task::Handle> TaskQueue;
+	typedef std::deque<Task::Handle> TaskQueue;
 
-private:
-	static int last_batch_index;
+	struct Stats {
+		long long tasks;      //!< count of processed tasks
+		long long steals;     //!< count of slots taken from queues of other threads of pool
+		long long idle_time;  //!< summary time of waiting of all threads, in microseconds
+		int queue_depth;      //!< current count of ready tasks
+		int max_queue_depth;  //!< max count of ready tasks
+
+		Stats(): tasks(), steals(), idle_time(), queue_depth(), max_queue_depth() { }
+	};
 
+private:
 	Glib::Threads::Mutex mutex;
-	Glib::Threads::Mutex threads_mutex;
+
+	//! readers (threads which finish tasks and enqueue new ones) don't block each other,
+	//! writer (cancel) modifies dependencies of tasks
+	Glib::Threads::RWLock deps_lock;
+
+	Glib::Threads::Mutex sleep_mutex;
 	Glib::Threads::Cond cond;
 	Glib::Threads::Cond single_cond;
+	std::atomic<int> single_sleeping;
+
+	//! tasks without multithreading support
+	TaskQueue single_tasks;
+	Glib::Threads::Mutex single_mutex;
+	std::atomic<int> single_ready_count;
 
-	TaskQueue ready_tasks;
-	TaskQueue single_ready_tasks;
-	TaskSet not_ready_tasks;
-	TaskSet single_not_ready_tasks;
+	//! tasks passed to ThreadPool but not started yet,
+	//! cancelled tasks are removed from this set and skipped by pool
+	TaskSet pool_ready;
+	Glib::Threads::Mutex pool_mutex;
+	std::atomic<int> ready_count;
+	//! count of slots passed to ThreadPool and not finished yet
+	std::atomic<int> pool_slots;
 
-	bool started;
+	std::atomic<bool> started;
 
 	ThreadList threads;
-	ThreadTaskMap tasks_in_process;
+
+	std::atomic<long long> stats_tasks;
+	std::atomic<long long> stats_idle_time;
+	std::atomic<int> stats_max_queue_depth;
 
 	void start();
 	void stop();
 
-	void process(int thread_index);
-	void done(int thread_index, const Task::Handle &task);
-	Task::Handle get(int thread_index);
+	void process();
+	void process_pool(Task::Handle task);
+	void process_task(const Task::Handle &task);
+	void done(const Task::Handle &task);
+	Task::Handle get();
+	void push(const Task::Handle &task);
+	void wakeup(int single_signals);
 
 	static void fix_task(const Task &task, const Task::RunParams &params);
-	bool remove_if_orphan(const Task::Handle &task, bool in_queue);
-	void remove_orphans();
-	bool remove_task(const Task::Handle &task);
+	void detach_task(const Task::Handle &task, TaskSet &removed);
+	void remove_ready_tasks(const TaskSet &tasks);
 
 public:
 	RenderQueue();
 	~RenderQueue();
 
 	int get_threads_count() const;
+	Stats get_stats() const;
 	void enqueue(const Task::Handle &task, const Task::RunParams &params);
 	void enqueue(const Task::List &tasks, const Task::RunParams &params);
 	void cancel(const Task::Handle &task);
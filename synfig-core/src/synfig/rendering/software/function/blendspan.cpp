@@ -0,0 +1,243 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/blendspan.cpp
+**	\brief BlendSpan
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+
+#include <synfig/general.h>
+#include <synfig/color/colorblendingfunctions.h>
+
+#include "blendspan.h"
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+#	define BLENDSPAN_SSE2
+#	include <emmintrin.h>
+#	include "blendspantemplates.h"
+#endif
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+#ifdef BLENDSPAN_SSE2
+class TraitsSSE2
+{
+public:
+	typedef __m128 V;
+	enum { pixels = 1 };
+
+	static V load(const Color *c) { return _mm_loadu_ps((const float*)c); }
+	static void store(Color *c, const V &v) { _mm_storeu_ps((float*)c, v); }
+	static V load_color(const Color &c) { return load(&c); }
+	static V load_covers(const ColorReal *c) { return _mm_set1_ps(*c); }
+
+	static V set1(float x) { return _mm_set1_ps(x); }
+	static V add(const V &a, const V &b) { return _mm_add_ps(a, b); }
+	static V sub(const V &a, const V &b) { return _mm_sub_ps(a, b); }
+	static V mul(const V &a, const V &b) { return _mm_mul_ps(a, b); }
+	static V div(const V &a, const V &b) { return _mm_div_ps(a, b); }
+
+	static V alpha(const V &a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)); }
+	static V alpha_mask() { return _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0)); }
+	static V select(const V &mask, const V &a, const V &b)
+		{ return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	static V abs_gt(const V &a, const V &b)
+		{ return _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), a), b); }
+	static V eq(const V &a, const V &b) { return _mm_cmpeq_ps(a, b); }
+};
+#endif
+
+}
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+software::BlendSpan::Kernel::Kernel(const char *name):
+	name(name)
+	{ memset(funcs, 0, sizeof(funcs)); }
+
+bool
+software::BlendSpan::init_kernel_sse2(Kernel &kernel)
+{
+#ifdef BLENDSPAN_SSE2
+	assert(sizeof(Color) == 4*sizeof(float));
+	kernel = Kernel("sse2");
+	BlendSpanTemplates::fill_kernel<TraitsSSE2>(kernel);
+	return true;
+#else
+	return false;
+#endif
+}
+
+software::BlendSpan::Kernel
+software::BlendSpan::create_kernel(const char *limit)
+{
+	if (!limit) limit = getenv("SYNFIG_RENDERING_BLEND_KERNEL");
+	std::string l = limit ? limit : "";
+
+	Kernel kernel;
+	if (l != "scalar")
+		if (l == "sse2" || !init_kernel_avx2(kernel))
+			init_kernel_sse2(kernel);
+	info("BlendSpan: use %s kernel", kernel.name);
+	return kernel;
+}
+
+const software::BlendSpan::Kernel&
+software::BlendSpan::get_kernel()
+{
+	static const Kernel kernel = create_kernel();
+	return kernel;
+}
+
+const char*
+software::BlendSpan::get_kernel_name()
+	{ return get_kernel().name; }
+
+bool
+software::BlendSpan::is_vectorized(Color::BlendMethod method)
+{
+	return method >= 0
+		&& method < Color::BLEND_END
+		&& get_kernel().funcs[method][0][0][0];
+}
+
+void
+software::BlendSpan::blend_scalar(
+	Color *dest,
+	const Color *src,
+	bool constant,
+	int count,
+	ColorReal amount,
+	Color::BlendMethod method,
+	const ColorReal *covers )
+{
+	if (constant) {
+		if (covers)
+			for(Color *end = dest + count; dest < end; ++dest, ++covers)
+				*dest = Color::blend(*src, *dest, amount*(*covers), method);
+		else
+			for(Color *end = dest + count; dest < end; ++dest)
+				*dest = Color::blend(*src, *dest, amount, method);
+	} else {
+		if (covers)
+			for(Color *end = dest + count; dest < end; ++dest, ++src, ++covers)
+				*dest = Color::blend(*src, *dest, amount*(*covers), method);
+		else
+			for(Color *end = dest + count; dest < end; ++dest, ++src)
+				*dest = Color::blend(*src, *dest, amount, method);
+	}
+}
+
+void
+software::BlendSpan::blend_generic(
+	Color *dest,
+	const Color *src,
+	bool constant,
+	int count,
+	ColorReal amount,
+	Color::BlendMethod method,
+	const ColorReal *covers )
+{
+	if (count <= 0) return;
+	assert(dest && src && method >= 0 && method < Color::BLEND_END);
+
+	// Color::blend() does nothing when amount is zero
+	if (fabsf(amount) <= COLOR_EPSILON) return;
+
+	// same as Surface::blit_to()
+	if ( !constant
+	  && !covers
+	  && method == Color::BLEND_STRAIGHT
+	  && fabsf(amount - 1.f) < 0.00001f )
+		{ memcpy(dest, src, count*sizeof(Color)); return; }
+
+	bool invert = false;
+	if ( amount < 0.f
+	  && (method == Color::BLEND_MULTIPLY || method == Color::BLEND_SCREEN) )
+		{ invert = true; amount = -amount; }
+
+	if (Func func = get_kernel().funcs[method][constant][covers != NULL][invert])
+		func(dest, src, count, amount, covers);
+	else
+		blend_scalar(dest, src, constant, count, invert ? -amount : amount, method, covers);
+}
+
+void
+software::BlendSpan::blend_rect(
+	synfig::Surface &dest,
+	const RectInt &dest_rect,
+	const synfig::Surface &src,
+	const VectorInt &src_offset,
+	ColorReal amount,
+	Color::BlendMethod method )
+{
+	if (!dest_rect.is_valid()) return;
+	assert( 0 <= dest_rect.minx && dest_rect.maxx <= dest.get_w()
+		 && 0 <= dest_rect.miny && dest_rect.maxy <= dest.get_h() );
+	assert( 0 <= src_offset[0] && src_offset[0] + dest_rect.get_width() <= src.get_w()
+		 && 0 <= src_offset[1] && src_offset[1] + dest_rect.get_height() <= src.get_h() );
+
+	int w = dest_rect.get_width();
+	for(int y = dest_rect.miny, sy = src_offset[1]; y < dest_rect.maxy; ++y, ++sy)
+		blend(&dest[y][dest_rect.minx], &src[sy][src_offset[0]], w, amount, method);
+}
+
+void
+software::BlendSpan::blend_color_rect(
+	synfig::Surface &dest,
+	const RectInt &dest_rect,
+	const Color &color,
+	ColorReal amount,
+	Color::BlendMethod method )
+{
+	if (!dest_rect.is_valid()) return;
+	assert( 0 <= dest_rect.minx && dest_rect.maxx <= dest.get_w()
+		 && 0 <= dest_rect.miny && dest_rect.maxy <= dest.get_h() );
+
+	int w = dest_rect.get_width();
+	for(int y = dest_rect.miny; y < dest_rect.maxy; ++y)
+		blend_color(&dest[y][dest_rect.minx], color, w, amount, method);
+}
+
+/* === E N T R Y P O I N T ================================================= */
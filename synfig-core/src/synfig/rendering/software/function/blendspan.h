@@ -0,0 +1,149 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/blendspan.h
+**	\brief BlendSpan Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SOFTWARE_BLENDSPAN_H
+#define __SYNFIG_RENDERING_SOFTWARE_BLENDSPAN_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <synfig/color.h>
+#include <synfig/rect.h>
+#include <synfig/surface.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+namespace software
+{
+
+//! Blends contiguous rows of pixels.
+//! Result is the same as dest[i] = Color::blend(src[i], dest[i], amount*covers[i], method),
+//! common blend methods are processed by SSE2 or AVX2 kernels when CPU supports them,
+//! other methods (and all methods on other CPUs) falls back to Color::blend.
+//! Kernel may be limited by environment variable SYNFIG_RENDERING_BLEND_KERNEL
+//! ("scalar", "sse2" or "avx2").
+class BlendSpan
+{
+public:
+	typedef void (*Func)(
+		Color *dest,
+		const Color *src,
+		int count,
+		ColorReal amount,
+		const ColorReal *covers );
+
+	//! Set of vectorized functions for specific instruction set.
+	//! Functions are indexed by blend method, 'constant source', 'has covers' and 'invert' flags,
+	//! NULL means that blend method is not vectorized.
+	//! Functions receives non-zero amount, 'src' points to single color when 'constant source' is set.
+	//! MULTIPLY and SCREEN inverts source when amount is negative, so their functions
+	//! receives absolute value of amount and 'invert' flag instead.
+	struct Kernel {
+		const char *name;
+		Func funcs[Color::BLEND_END][2][2][2];
+		explicit Kernel(const char *name = "scalar");
+	};
+
+private:
+	static const Kernel& get_kernel();
+	static bool init_kernel_sse2(Kernel &kernel);
+	static bool init_kernel_avx2(Kernel &kernel);
+
+	static void blend_scalar(
+		Color *dest,
+		const Color *src,
+		bool constant,
+		int count,
+		ColorReal amount,
+		Color::BlendMethod method,
+		const ColorReal *covers );
+
+	static void blend_generic(
+		Color *dest,
+		const Color *src,
+		bool constant,
+		int count,
+		ColorReal amount,
+		Color::BlendMethod method,
+		const ColorReal *covers );
+
+public:
+	//! creates the best kernel supported by CPU, 'limit' works
+	//! like SYNFIG_RENDERING_BLEND_KERNEL and overrides it when not NULL
+	static Kernel create_kernel(const char *limit = NULL);
+
+	//! name of the selected kernel: "scalar", "sse2" or "avx2"
+	static const char* get_kernel_name();
+	static bool is_vectorized(Color::BlendMethod method);
+
+	//! optional array 'covers' contains non-negative per-pixel multipliers for amount
+	static void blend(
+		Color *dest,
+		const Color *src,
+		int count,
+		ColorReal amount,
+		Color::BlendMethod method,
+		const ColorReal *covers = NULL )
+	{ blend_generic(dest, src, false, count, amount, method, covers); }
+
+	static void blend_color(
+		Color *dest,
+		const Color &color,
+		int count,
+		ColorReal amount,
+		Color::BlendMethod method,
+		const ColorReal *covers = NULL )
+	{ blend_generic(dest, &color, true, count, amount, method, covers); }
+
+	//! blends rect of 'src' with top-left corner at 'src_offset' into 'dest_rect' of 'dest'
+	static void blend_rect(
+		synfig::Surface &dest,
+		const RectInt &dest_rect,
+		const synfig::Surface &src,
+		const VectorInt &src_offset,
+		ColorReal amount,
+		Color::BlendMethod method );
+
+	static void blend_color_rect(
+		synfig::Surface &dest,
+		const RectInt &dest_rect,
+		const Color &color,
+		ColorReal amount,
+		Color::BlendMethod method );
+};
+
+} /* end namespace software */
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
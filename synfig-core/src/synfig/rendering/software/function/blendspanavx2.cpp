@@ -0,0 +1,126 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/blendspanavx2.cpp
+**	\brief BlendSpan AVX2 kernel
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cassert>
+
+#include <synfig/color/colorblendingfunctions.h>
+
+#include "blendspan.h"
+
+#endif
+
+// This file is built without -mavx2, so only the code between
+// target pragmas may use AVX2 instructions. All other headers must be
+// included before the pragmas, otherwise their inline functions
+// may be compiled with AVX2 and then used by another translation unit.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define BLENDSPAN_AVX2
+#	include <immintrin.h>
+#	ifdef __clang__
+#		pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#	else
+#		pragma GCC push_options
+#		pragma GCC target("avx2")
+#	endif
+#	include "blendspantemplates.h"
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+#ifdef BLENDSPAN_AVX2
+//! two pixels per register
+class TraitsAVX2
+{
+public:
+	typedef __m256 V;
+	enum { pixels = 2 };
+
+	static V load(const Color *c) { return _mm256_loadu_ps((const float*)c); }
+	static void store(Color *c, const V &v) { _mm256_storeu_ps((float*)c, v); }
+	static V load_color(const Color &c)
+		{ return _mm256_broadcast_ps((const __m128*)&c); }
+	static V load_covers(const ColorReal *c)
+		{ return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(c[0])), _mm_set1_ps(c[1]), 1); }
+
+	static V set1(float x) { return _mm256_set1_ps(x); }
+	static V add(const V &a, const V &b) { return _mm256_add_ps(a, b); }
+	static V sub(const V &a, const V &b) { return _mm256_sub_ps(a, b); }
+	static V mul(const V &a, const V &b) { return _mm256_mul_ps(a, b); }
+	static V div(const V &a, const V &b) { return _mm256_div_ps(a, b); }
+
+	static V alpha(const V &a) { return _mm256_permute_ps(a, _MM_SHUFFLE(3, 3, 3, 3)); }
+	static V alpha_mask() { return _mm256_castsi256_ps(_mm256_set_epi32(-1, 0, 0, 0, -1, 0, 0, 0)); }
+	static V select(const V &mask, const V &a, const V &b)
+		{ return _mm256_blendv_ps(b, a, mask); }
+	static V abs_gt(const V &a, const V &b)
+		{ return _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.f), a), b, _CMP_GT_OQ); }
+	static V eq(const V &a, const V &b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+};
+#endif
+
+}
+
+#ifdef BLENDSPAN_AVX2
+#	ifdef __clang__
+#		pragma clang attribute pop
+#	else
+#		pragma GCC pop_options
+#	endif
+#endif
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+bool
+software::BlendSpan::init_kernel_avx2(Kernel &kernel)
+{
+#ifdef BLENDSPAN_AVX2
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("avx2"))
+		return false;
+	assert(sizeof(Color) == 4*sizeof(float));
+	kernel = Kernel("avx2");
+	BlendSpanTemplates::fill_kernel<TraitsAVX2>(kernel);
+	return true;
+#else
+	return false;
+#endif
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,253 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/blendspantemplates.h
+**	\brief BlendSpanTemplates Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SOFTWARE_BLENDSPANTEMPLATES_H
+#define __SYNFIG_RENDERING_SOFTWARE_BLENDSPANTEMPLATES_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <synfig/color/colorblendingfunctions.h>
+
+#include "blendspan.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+namespace software
+{
+
+//! Blending formulas from colorblendingfunctions.h written for vector registers.
+//! Template argument T describes the instruction set, it should provide:
+//!   - type V - register which holds T::pixels colors in RGBA order,
+//!   - load(), store() - unaligned load and store of T::pixels colors,
+//!   - load_color() - fill all pixels of register by one color,
+//!   - load_covers() - fill all channels of each pixel by value from array,
+//!   - set1(), add(), sub(), mul(), div(),
+//!   - alpha() - copy alpha to all channels of each pixel,
+//!   - alpha_mask() - bitmask of alpha channels,
+//!   - select(mask, a, b) - bitwise select,
+//!   - abs_gt(a, b) - mask of |a| > b, eq(a, b) - mask of a == b.
+//! Kernels are instantiated separately for each instruction set,
+//! so this file should be included only where the instruction set is enabled.
+class BlendSpanTemplates
+{
+public:
+	template<typename T>
+	class Formulas
+	{
+	public:
+		typedef typename T::V V;
+
+		static V with_alpha(const V &c, const V &a)
+			{ return T::select(T::alpha_mask(), a, c); }
+
+		static V invert(const V &a)
+			{ return with_alpha(T::sub(T::set1(1.f), a), a); }
+
+		static V composite(const V &a, const V &b, const V &amount)
+		{
+			const V one = T::set1(1.f);
+			V a_src = T::mul(T::alpha(a), amount);
+			V a_dest = T::alpha(b);
+			V k = T::sub(one, a_src);
+			V c = T::add(T::mul(a, a_src), T::mul(T::mul(b, a_dest), k));
+			V a_out = T::add(a_src, T::mul(a_dest, k));
+			return T::select(
+				T::abs_gt(a_out, T::set1(COLOR_EPSILON)),
+				with_alpha(T::mul(c, T::div(T::set1(1.f), a_out)), a_out),
+				T::load_color(Color::alpha()) );
+		}
+
+		static V straight(const V &a, const V &b, const V &amount)
+		{
+			V a_src = T::alpha(a);
+			V a_dest = T::alpha(b);
+			V a_out = T::add(T::mul(T::sub(a_src, a_dest), amount), a_dest);
+			V bb = T::mul(b, a_dest);
+			V c = T::add(T::mul(T::sub(T::mul(a, a_src), bb), amount), bb);
+			return T::select(
+				T::abs_gt(a_out, T::set1(COLOR_EPSILON)),
+				with_alpha(T::mul(c, T::div(T::set1(1.f), a_out)), a_out),
+				T::load_color(Color::alpha()) );
+		}
+
+		static V onto(const V &a, const V &b, const V &amount)
+			{ return with_alpha(composite(a, with_alpha(b, T::set1(1.f)), amount), T::alpha(b)); }
+
+		static V behind(const V &a, const V &b, const V &amount)
+		{
+			V a_src = T::alpha(a);
+			a_src = T::select(
+				T::eq(a_src, T::set1(0.f)),
+				T::mul(T::set1(COLOR_EPSILON), amount),
+				T::mul(a_src, amount) );
+			return composite(b, with_alpha(a, a_src), T::set1(1.f));
+		}
+
+		static V add(const V &a, const V &b, const V &amount)
+		{
+			V a_dest = T::alpha(b);
+			V c = T::add(T::mul(b, a_dest), T::mul(a, T::mul(T::alpha(a), amount)));
+			return with_alpha(c, a_dest);
+		}
+
+		static V multiply(const V &a, const V &b, const V &amount)
+		{
+			V k = T::mul(T::alpha(a), amount);
+			V c = T::add(T::mul(T::sub(T::mul(b, a), b), k), b);
+			return with_alpha(c, T::alpha(b));
+		}
+
+		static V screen(const V &a, const V &b, const V &amount)
+		{
+			const V one = T::set1(1.f);
+			V c = T::sub(one, T::mul(T::sub(one, a), T::sub(one, b)));
+			return onto(with_alpha(c, a), b, amount);
+		}
+
+		static V alpha_over(const V &a, const V &b, const V &amount)
+		{
+			V a_rm = T::mul(T::sub(T::set1(1.f), T::alpha(a)), T::alpha(b));
+			return straight(with_alpha(b, a_rm), b, amount);
+		}
+	};
+
+	template<typename T, Color::BlendMethod method>
+	static typename T::V blend_pixels(const typename T::V &a, const typename T::V &b, const typename T::V &amount)
+	{
+		typedef Formulas<T> F;
+		switch(method)
+		{
+		case Color::BLEND_COMPOSITE:  return F::composite(a, b, amount);
+		case Color::BLEND_STRAIGHT:   return F::straight(a, b, amount);
+		case Color::BLEND_ONTO:       return F::onto(a, b, amount);
+		case Color::BLEND_BEHIND:     return F::behind(a, b, amount);
+		case Color::BLEND_ADD:        return F::add(a, b, amount);
+		case Color::BLEND_MULTIPLY:   return F::multiply(a, b, amount);
+		case Color::BLEND_SCREEN:     return F::screen(a, b, amount);
+		case Color::BLEND_ALPHA_OVER: return F::alpha_over(a, b, amount);
+		default: break;
+		}
+		assert(false);
+		return b;
+	}
+
+	//! MULTIPLY and SCREEN inverts source color when amount is negative,
+	//! caller passes absolute value of amount and sets the 'invert' flag
+	template<typename T, Color::BlendMethod method, bool constant, bool covered, bool invert>
+	static void blend_span(
+		Color *dest,
+		const Color *src,
+		int count,
+		ColorReal amount,
+		const ColorReal *covers )
+	{
+		typedef typename T::V V;
+		typedef Formulas<T> F;
+
+		const V eps = T::set1(COLOR_EPSILON);
+		V va = T::set1(amount);
+		V vc = constant ? T::load_color(*src) : T::set1(0.f);
+		if (constant && invert) vc = F::invert(vc);
+
+		Color *end = dest + (count - count%T::pixels);
+		for(; dest < end; dest += T::pixels)
+		{
+			V a = constant ? vc : T::load(src);
+			if (!constant) {
+				if (invert) a = F::invert(a);
+				src += T::pixels;
+			}
+			V b = T::load(dest);
+			if (covered)
+			{
+				V amount_pixels = T::mul(va, T::load_covers(covers));
+				covers += T::pixels;
+				T::store(dest, T::select(
+					T::abs_gt(amount_pixels, eps),
+					blend_pixels<T, method>(a, b, amount_pixels),
+					b ));
+			}
+			else
+			{
+				T::store(dest, blend_pixels<T, method>(a, b, va));
+			}
+		}
+
+		// tail
+		for(int i = 0; i < count%T::pixels; ++i, ++dest)
+		{
+			Color a = *src;
+			if (!constant) ++src;
+			if (invert) a = ~a;
+			ColorReal k = covered ? amount*(*covers++) : amount;
+			*dest = Color::blend(a, *dest, k, method);
+		}
+	}
+
+	template<typename T, Color::BlendMethod method, bool invert>
+	static void fill_method_invert(BlendSpan::Kernel &kernel)
+	{
+		kernel.funcs[method][0][0][invert] = &blend_span<T, method, false, false, invert>;
+		kernel.funcs[method][0][1][invert] = &blend_span<T, method, false, true, invert>;
+		kernel.funcs[method][1][0][invert] = &blend_span<T, method, true, false, invert>;
+		kernel.funcs[method][1][1][invert] = &blend_span<T, method, true, true, invert>;
+	}
+
+	template<typename T, Color::BlendMethod method>
+	static void fill_method(BlendSpan::Kernel &kernel)
+	{
+		fill_method_invert<T, method, false>(kernel);
+		if (method == Color::BLEND_MULTIPLY || method == Color::BLEND_SCREEN)
+			fill_method_invert<T, method, true>(kernel);
+	}
+
+	template<typename T>
+	static void fill_kernel(BlendSpan::Kernel &kernel)
+	{
+		fill_method<T, Color::BLEND_COMPOSITE>(kernel);
+		fill_method<T, Color::BLEND_STRAIGHT>(kernel);
+		fill_method<T, Color::BLEND_ONTO>(kernel);
+		fill_method<T, Color::BLEND_BEHIND>(kernel);
+		fill_method<T, Color::BLEND_ADD>(kernel);
+		fill_method<T, Color::BLEND_MULTIPLY>(kernel);
+		fill_method<T, Color::BLEND_SCREEN>(kernel);
+		fill_method<T, Color::BLEND_ALPHA_OVER>(kernel);
+	}
+};
+
+} /* end namespace software */
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -30,17 +30,26 @@
 #endif
 
 #include <cassert>
+#include <cstring>
 
 #include <algorithm>
 #include <functional>
 
+#include <sigc++/bind.h>
+
 #include "blur.h"
 
 #include "blurtemplates.h"
 #include "fft.h"
 #include <synfig/angle.h>
 #include <synfig/general.h>
+#include <synfig/threadpool.h>
+
+#endif
 
+#if defined(__SSE__) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+#	define BLUR_SSE
+#	include <xmmintrin.h>
 #endif
 
 using namespace std;
@@ -51,8 +60,194 @@ using namespace rendering;
 
 /* === G L O B A L S ======================================================= */
 
+namespace {
+	// minimal count of pixels to process in separate thread
+	const int band_pixels = 16384;
+	// count of columns processed together while walking through the rows,
+	// sixteen pixels are four cache lines
+	const int strip_cols = 16;
+}
+
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+//! Four channels of pixel processed at once.
+//! Math is done per channel in the same order as for single ColorReal,
+//! so the result is the same as result of blur of separate channels.
+class ColorReal4
+{
+public:
+	ColorReal channels[4];
+
+	ColorReal4() { }
+	ColorReal4(ColorReal x)
+		{ channels[0] = channels[1] = channels[2] = channels[3] = x; }
+
+#ifdef BLUR_SSE
+	explicit ColorReal4(__m128 x)
+		{ _mm_storeu_ps(channels, x); }
+	__m128 get() const
+		{ return _mm_loadu_ps(channels); }
+
+	friend ColorReal4 operator+ (const ColorReal4 &a, const ColorReal4 &b)
+		{ return ColorReal4(_mm_add_ps(a.get(), b.get())); }
+	friend ColorReal4 operator- (const ColorReal4 &a, const ColorReal4 &b)
+		{ return ColorReal4(_mm_sub_ps(a.get(), b.get())); }
+	friend ColorReal4 operator* (const ColorReal4 &a, const ColorReal4 &b)
+		{ return ColorReal4(_mm_mul_ps(a.get(), b.get())); }
+	friend ColorReal4 operator/ (const ColorReal4 &a, const ColorReal4 &b)
+		{ return ColorReal4(_mm_div_ps(a.get(), b.get())); }
+#else
+	ColorReal4(ColorReal r, ColorReal g, ColorReal b, ColorReal a)
+		{ channels[0] = r; channels[1] = g; channels[2] = b; channels[3] = a; }
+
+	friend ColorReal4 operator+ (const ColorReal4 &a, const ColorReal4 &b)
+	{
+		return ColorReal4( a.channels[0] + b.channels[0], a.channels[1] + b.channels[1],
+		                   a.channels[2] + b.channels[2], a.channels[3] + b.channels[3] );
+	}
+	friend ColorReal4 operator- (const ColorReal4 &a, const ColorReal4 &b)
+	{
+		return ColorReal4( a.channels[0] - b.channels[0], a.channels[1] - b.channels[1],
+		                   a.channels[2] - b.channels[2], a.channels[3] - b.channels[3] );
+	}
+	friend ColorReal4 operator* (const ColorReal4 &a, const ColorReal4 &b)
+	{
+		return ColorReal4( a.channels[0]*b.channels[0], a.channels[1]*b.channels[1],
+		                   a.channels[2]*b.channels[2], a.channels[3]*b.channels[3] );
+	}
+	friend ColorReal4 operator/ (const ColorReal4 &a, const ColorReal4 &b)
+	{
+		return ColorReal4( a.channels[0]/b.channels[0], a.channels[1]/b.channels[1],
+		                   a.channels[2]/b.channels[2], a.channels[3]/b.channels[3] );
+	}
+#endif
+
+	ColorReal4& operator+= (const ColorReal4 &x)
+		{ return *this = *this + x; }
+};
+
+typedef Array<ColorReal4, 2> Surface4;
+
+struct PatternJob {
+	Surface4 dst;
+	Surface4 src;
+	Array<ColorReal, 1> pattern;
+};
+
+struct Pattern2dJob {
+	Surface4 dst;
+	Surface4 src;
+	Array<ColorReal, 2> pattern;
+};
+
+struct BoxJob {
+	Surface4 surface;
+	int size;
+	int count;
+	BoxJob(): size(), count() { }
+};
+
+struct IIRJob {
+	Surface4 surface;
+	ColorReal4 k0, k1, k2, k3;
+};
+
+void pattern_rows(const PatternJob *job, int begin, int end)
+{
+	for(int r = begin; r < end; ++r)
+		BlurTemplates::blur_pattern(job->dst[r], job->src[r], job->pattern);
+}
+
+void pattern_cols(const PatternJob *job, int begin, int end)
+{
+	for(int c = begin; c < end; c += strip_cols)
+		BlurTemplates::blur_pattern_cols(
+			job->dst.get_range(1, c, min(c + strip_cols, end)),
+			job->src.get_range(1, c, min(c + strip_cols, end)),
+			job->pattern );
+}
+
+void pattern_2d_rows(const Pattern2dJob *job, int begin, int end)
+{
+	// blur_2d_pattern() skips margins of the size of pattern,
+	// so neighbour rows are added to get rows [begin, end) processed
+	int size = job->pattern.count - 1;
+	int rows = min(job->dst.count, job->src.count);
+	int b = max(begin - size, 0);
+	int e = min(end + size, rows);
+	if (b < e)
+		BlurTemplates::blur_2d_pattern(
+			job->dst.get_range(0, b, e),
+			job->src.get_range(0, b, e),
+			job->pattern );
+}
+
+void box_rows(const BoxJob *job, int begin, int end)
+{
+	deque<ColorReal4> q;
+	for(int r = begin; r < end; ++r)
+		for(int i = 0; i < job->count; ++i)
+			BlurTemplates::blur_box_discrete(job->surface[r], q, job->size);
+}
+
+void box_cols(const BoxJob *job, int begin, int end)
+{
+	vector<ColorReal4> q;
+	for(int c = begin; c < end; c += strip_cols)
+		for(int i = 0; i < job->count; ++i)
+			BlurTemplates::blur_box_discrete_cols(
+				job->surface.get_range(1, c, min(c + strip_cols, end)), q, job->size );
+}
+
+void iir_rows(const IIRJob *job, int begin, int end)
+{
+	for(int r = begin; r < end; ++r)
+		BlurTemplates::blur_iir(job->surface[r], job->k0, job->k1, job->k2, job->k3);
+}
+
+void iir_cols(const IIRJob *job, int begin, int end)
+{
+	vector<ColorReal4> d;
+	for(int c = begin; c < end; c += strip_cols)
+		BlurTemplates::blur_iir_cols(
+			job->surface.get_range(1, c, min(c + strip_cols, end)), d,
+			job->k0, job->k1, job->k2, job->k3 );
+}
+
+template<typename T>
+void process_parallel(void (*func)(const T*, int, int), const T &job, int count, int part)
+{
+	if (count <= part) {
+		func(&job, 0, count);
+		return;
+	}
+
+	ThreadPool::Group group;
+	for(int i = 0; i < count; i += part)
+		group.enqueue( sigc::bind(sigc::ptr_fun(func), &job, i, min(i + part, count)) );
+	group.run();
+}
+
+//! splits rows of \a surface into bands for threads
+template<typename T>
+void process_rows(void (*func)(const T*, int, int), const T &job, const Surface4 &surface)
+{
+	int part = max(1, band_pixels/max(1, surface.get_count(1)));
+	process_parallel(func, job, surface.get_count(0), part);
+}
+
+//! splits columns of \a surface into strips for threads
+template<typename T>
+void process_cols(void (*func)(const T*, int, int), const T &job, const Surface4 &surface)
+{
+	int part = strip_cols*max(1, band_pixels/(strip_cols*max(1, surface.get_count(0))));
+	process_parallel(func, job, surface.get_count(1), part);
+}
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 bool
@@ -249,43 +444,47 @@ software::Blur::blur_pattern(const Params &params)
 	}
 
 	// process
+	Surface4 arr_src(arr_src_surface.group_items<ColorReal4>());
+	Surface4 arr_dst(arr_dst_surface.group_items<ColorReal4>());
 	if (full)
 	{
 		BlurTemplates::normalize_half_pattern_2d( arr_full_pattern );
-		for(Array<ColorReal, 3>::Iterator dst(arr_dst_surface.reorder(2, 0, 1)), src(arr_src_surface.reorder(2, 0, 1)); dst; ++dst, ++src)
-			BlurTemplates::blur_2d_pattern(*dst, *src, arr_full_pattern);
+
+		Pattern2dJob job;
+		job.dst = arr_dst;
+		job.src = arr_src;
+		job.pattern = arr_full_pattern;
+		process_rows(&pattern_2d_rows, job, arr_dst);
 	}
 	else
 	{
 		BlurTemplates::normalize_half_pattern( arr_row_pattern );
 		BlurTemplates::normalize_half_pattern( arr_col_pattern );
 
-		Array<ColorReal, 3> arr_src_surface_rows(arr_src_surface.reorder(2, 0, 1));
-		Array<ColorReal, 3> arr_src_surface_cols(arr_src_surface_rows.reorder(0, 2, 1));
-
-		Array<ColorReal, 3> arr_dst_surface_rows(arr_dst_surface.reorder(2, 0, 1));
-		Array<ColorReal, 3> arr_dst_surface_cols(arr_dst_surface_rows.reorder(0, 2, 1));
-
 		if (cross)
 		{
 			arr_row_pattern.process< std::multiplies<ColorReal> >(0.5);
 			arr_col_pattern.process< std::multiplies<ColorReal> >(0.5);
 		}
 
-		for(Array<ColorReal, 3>::Iterator src_channel(arr_src_surface_rows), dst_channel(arr_dst_surface_rows); dst_channel; ++src_channel, ++dst_channel)
-			for(Array<ColorReal, 2>::Iterator sr(*src_channel), dr(*dst_channel); dr; ++sr, ++dr)
-				BlurTemplates::blur_pattern(*dr, *sr, arr_row_pattern);
+		PatternJob rows_job;
+		rows_job.dst = arr_dst;
+		rows_job.src = arr_src;
+		rows_job.pattern = arr_row_pattern;
+		process_rows(&pattern_rows, rows_job, arr_dst);
 
 		if (!cross)
 		{
-			swap(arr_src_surface_cols.pointer, arr_dst_surface_cols.pointer);
+			swap(arr_src.pointer, arr_dst.pointer);
 			swap(arr_src_surface.pointer, arr_dst_surface.pointer);
 			memset(&src_surface.front(), 0, sizeof(src_surface.front())*src_surface.size());
 		}
 
-		for(Array<ColorReal, 3>::Iterator src_channel(arr_src_surface_cols), dst_channel(arr_dst_surface_cols); dst_channel; ++src_channel, ++dst_channel)
-			for(Array<ColorReal, 2>::Iterator sr(*src_channel), dr(*dst_channel); dr; ++sr, ++dr)
-				BlurTemplates::blur_pattern(*dr, *sr, arr_row_pattern);
+		PatternJob cols_job;
+		cols_job.dst = arr_dst;
+		cols_job.src = arr_src;
+		cols_job.pattern = arr_col_pattern;
+		process_cols(&pattern_cols, cols_job, arr_dst);
 	}
 
 	// copy result surface and restore alpha
@@ -462,7 +661,6 @@ software::Blur::blur_fft(const Params &params)
 void
 software::Blur::blur_box(const Params &params)
 {
-	const Real precision(1e-5);
 	const int channels = 4;
 	int rows = params.src_rect.get_size()[1];
 	int cols = params.src_rect.get_size()[0];
@@ -495,44 +693,30 @@ software::Blur::blur_box(const Params &params)
 		return;
 	}
 
-	deque<ColorReal> q;
 	vector<ColorReal> surface_copy;
-	Array<ColorReal, 3> arr_surface_rows(arr_surface.reorder(2, 0, 1));
-	Array<ColorReal, 3> arr_surface_cols(arr_surface_rows.reorder(0, 2, 1));
+	Array<ColorReal, 3> arr_surface_copy;
 
 	if (cross)
 	{
 		arr_surface.process< std::multiplies<ColorReal> >(0.5);
 		surface_copy = surface;
-		arr_surface_cols.pointer = &surface_copy.front();
+		arr_surface_copy = Array<ColorReal, 3>(&surface_copy.front(), arr_surface);
 	}
 
-	if (true || fabs(size[0] - round(size[0])) < precision)
-		for(Array<ColorReal, 3>::Iterator channel(arr_surface_rows); channel; ++channel)
-			for(Array<ColorReal, 2>::Iterator r(*channel); r; ++r)
-				for(int i = 0; i < count; ++i)
-					BlurTemplates::blur_box_discrete(*r, q, (int)round(size[0]));
-	else
-		for(Array<ColorReal, 3>::Iterator channel(arr_surface_rows); channel; ++channel)
-			for(Array<ColorReal, 2>::Iterator r(*channel); r; ++r)
-				for(int i = 0; i < count; ++i)
-					BlurTemplates::blur_box_aa(*r, q, (ColorReal)size[0]);
-
-	if (true || fabs(size[1] - round(size[1])) < precision)
-		for(Array<ColorReal, 3>::Iterator channel(arr_surface_cols); channel; ++channel)
-			for(Array<ColorReal, 2>::Iterator c(*channel); c; ++c)
-				for(int i = 0; i < count; ++i)
-					BlurTemplates::blur_box_discrete(*c, q, (int)round(size[1]));
-	else
-		for(Array<ColorReal, 3>::Iterator channel(arr_surface_cols); channel; ++channel)
-			for(Array<ColorReal, 2>::Iterator c(*channel); c; ++c)
-				for(int i = 0; i < count; ++i)
-					BlurTemplates::blur_box_aa(*c, q, (ColorReal)size[1]);
+	BoxJob rows_job;
+	rows_job.surface = arr_surface.group_items<ColorReal4>();
+	rows_job.size = (int)round(size[0]);
+	rows_job.count = count;
+	process_rows(&box_rows, rows_job, rows_job.surface);
+
+	BoxJob cols_job;
+	cols_job.surface = (cross ? arr_surface_copy : arr_surface).group_items<ColorReal4>();
+	cols_job.size = (int)round(size[1]);
+	cols_job.count = count;
+	process_cols(&box_cols, cols_job, cols_job.surface);
 
 	if (cross)
-		arr_surface_rows
-			.process< std::plus<ColorReal> >(
-				arr_surface_cols.reorder(0, 2, 1) );
+		arr_surface.process< std::plus<ColorReal> >(arr_surface_copy);
 
 	BlurTemplates::surface_write(
 		*params.dest,
@@ -639,45 +823,34 @@ software::Blur::blur_iir(const Params &params)
 		return;
 	}
 
-	Array<ColorReal, 3> arr_surface_rows(arr_surface.reorder(2, 0, 1));
-	Array<ColorReal, 3> arr_surface_cols(arr_surface_rows.reorder(0, 2, 1));
-
 	IIRCoefficients cr = get_iir_coefficients(params.amplified_size[0]);
 	IIRCoefficients cc = get_iir_coefficients(params.amplified_size[1]);
 
-	ColorReal cr0 = (ColorReal)cr.k0;
-	ColorReal cr1 = (ColorReal)cr.k1;
-	ColorReal cr2 = (ColorReal)cr.k2;
-	ColorReal cr3 = (ColorReal)cr.k3;
-
-	ColorReal cc0 = (ColorReal)cc.k0;
-	ColorReal cc1 = (ColorReal)cc.k1;
-	ColorReal cc2 = (ColorReal)cc.k2;
-	ColorReal cc3 = (ColorReal)cc.k3;
+	Surface4 arr_src(arr_surface.group_items<ColorReal4>());
+	Surface4 arr_dst(arr_tmp_surface.group_items<ColorReal4>());
 
-	Array<ColorReal, 3> arr_src_surface_rows(arr_surface.reorder(2, 0, 1));
-	Array<ColorReal, 3> arr_src_surface_cols(arr_surface_rows.reorder(0, 2, 1));
-
-	Array<ColorReal, 3> arr_dst_surface_rows(arr_tmp_surface.reorder(2, 0, 1));
-	Array<ColorReal, 3> arr_dst_surface_cols(arr_dst_surface_rows.reorder(0, 2, 1));
-	
 	if (fabs(params.amplified_size[0]) > precision)
 	{
 		if (use_row_pattern)
 		{
-			for(Array<ColorReal, 3>::Iterator src_channel(arr_src_surface_rows), dst_channel(arr_dst_surface_rows); dst_channel; ++src_channel, ++dst_channel)
-				for(Array<ColorReal, 2>::Iterator sr(*src_channel), dr(*dst_channel); dr; ++sr, ++dr)
-					BlurTemplates::blur_pattern(*dr, *sr, arr_row_pattern);
-			swap(arr_src_surface_cols.pointer, arr_dst_surface_cols.pointer);
+			PatternJob job;
+			job.dst = arr_dst;
+			job.src = arr_src;
+			job.pattern = arr_row_pattern;
+			process_rows(&pattern_rows, job, arr_dst);
+			swap(arr_src.pointer, arr_dst.pointer);
 			swap(arr_surface.pointer, arr_tmp_surface.pointer);
-			arr_surface_cols.pointer = arr_surface.pointer;
 			memset(&surface.front(), 0, sizeof(surface.front())*surface.size());
 		}
 		else
 		{
-			for(Array<ColorReal, 3>::Iterator channel(arr_surface_rows); channel; ++channel)
-				for(Array<ColorReal, 2>::Iterator r(*channel); r; ++r)
-					BlurTemplates::blur_iir(*r, cr0, cr1, cr2, cr3);
+			IIRJob job;
+			job.surface = arr_src;
+			job.k0 = (ColorReal)cr.k0;
+			job.k1 = (ColorReal)cr.k1;
+			job.k2 = (ColorReal)cr.k2;
+			job.k3 = (ColorReal)cr.k3;
+			process_rows(&iir_rows, job, arr_src);
 		}
 	}
 
@@ -685,16 +858,22 @@ software::Blur::blur_iir(const Params &params)
 	{
 		if (use_col_pattern)
 		{
-			for(Array<ColorReal, 3>::Iterator src_channel(arr_src_surface_cols), dst_channel(arr_dst_surface_cols); dst_channel; ++src_channel, ++dst_channel)
-				for(Array<ColorReal, 2>::Iterator sr(*src_channel), dr(*dst_channel); dr; ++sr, ++dr)
-					BlurTemplates::blur_pattern(*dr, *sr, arr_col_pattern);
+			PatternJob job;
+			job.dst = arr_dst;
+			job.src = arr_src;
+			job.pattern = arr_col_pattern;
+			process_cols(&pattern_cols, job, arr_dst);
 			swap(arr_surface.pointer, arr_tmp_surface.pointer);
 		}
 		else
 		{
-			for(Array<ColorReal, 3>::Iterator channel(arr_surface_cols); channel; ++channel)
-				for(Array<ColorReal, 2>::Iterator c(*channel); c; ++c)
-					BlurTemplates::blur_iir(*c, cc0, cc1, cc2, cc3);
+			IIRJob job;
+			job.surface = arr_src;
+			job.k0 = (ColorReal)cc.k0;
+			job.k1 = (ColorReal)cc.k1;
+			job.k2 = (ColorReal)cc.k2;
+			job.k3 = (ColorReal)cc.k3;
+			process_cols(&iir_cols, job, arr_src);
 		}
 	}
 
@@ -31,6 +31,7 @@
 
 #include <algorithm>
 #include <deque>
+#include <vector>
 
 #include "array.h"
 
@@ -264,8 +265,8 @@ public:
 		}
 	}
 
-	template<typename T>
-	static void blur_pattern(const Array<T, 1> &dst, const Array<T, 1> &src, const Array<T, 1> &pattern)
+	template<typename T, typename P>
+	static void blur_pattern(const Array<T, 1> &dst, const Array<T, 1> &src, const Array<P, 1> &pattern)
 	{
 		typedef Array<T, 1> A;
 		if (pattern.count <= 0)
@@ -286,8 +287,38 @@ public:
 		}
 	}
 
-	template<typename T>
-	static void blur_2d_pattern(const Array<T, 2> &dst, const Array<T, 2> &src, const Array<T, 2> &pattern)
+	//! Blurs columns of \a src by \a pattern, the same as blur_pattern() for each column,
+	//! but walks through the rows, so memory of row-major surface is read sequentially
+	template<typename T, typename P>
+	static void blur_pattern_cols(const Array<T, 2> &dst, const Array<T, 2> &src, const Array<P, 1> &pattern)
+	{
+		typedef Array<T, 2> A;
+		typedef Array<T, 1> B;
+		if (pattern.count <= 0)
+		{
+			dst.assign(src);
+			return;
+		}
+
+		int pattern_size = pattern.count - 1;
+		int end = std::min(src.count, dst.count) - pattern_size;
+
+		int si = pattern_size;
+		for(typename A::Iterator di(dst, pattern_size, end); di; ++di, ++si)
+		{
+			for(typename B::Iterator d(*di), s(src[si]); d && s; ++d, ++s)
+				(*d) += (*s)*pattern[0];
+			for(int i = 1; i <= pattern_size; ++i)
+			{
+				const P &p = pattern[i];
+				for(typename B::Iterator d(*di), s0(src[si - i]), s1(src[si + i]); d && s0; ++d, ++s0, ++s1)
+					(*d) += (*s0 + *s1)*p;
+			}
+		}
+	}
+
+	template<typename T, typename P>
+	static void blur_2d_pattern(const Array<T, 2> &dst, const Array<T, 2> &src, const Array<P, 2> &pattern)
 	{
 		typedef Array<T, 2> A;
 		typedef Array<T, 1> B;
@@ -346,6 +377,43 @@ public:
 		}
 	}
 
+	//! Applies blur_box_discrete() to each column of \a x walking through the rows,
+	//! \a q is a buffer for queue of rows and sums of columns
+	template<typename T>
+	static void blur_box_discrete_cols(const Array<T, 2> &x, std::vector<T> &q, const int size)
+	{
+		typedef Array<T, 2> A;
+		typedef Array<T, 1> B;
+		if (size == 0) return;
+
+		int s = abs(size);
+		int full_size = 1 + 2*s;
+		int cols = x.get_count(1);
+		if (x.count < full_size || cols <= 0) return;
+		T w(T(1.0)/T(full_size));
+
+		q.resize((full_size + 1)*cols);
+		Array<T, 2> arr_q(&q.front());
+		arr_q.set_dim(full_size, cols).set_dim(cols, 1);
+		Array<T, 1> arr_sum(&q.front() + full_size*cols);
+		arr_sum.set_dim(cols, 1);
+		arr_sum.fill(T(0.0));
+
+		int k = 0;
+		for(typename A::Iterator i(x, 0, full_size); i; ++i, ++k)
+			for(typename B::Iterator ii(*i), qq(arr_q[k]), ss(arr_sum); ii; ++ii, ++qq, ++ss)
+				{ *qq = *ii; *ss += *ii; }
+
+		k = 0;
+		for(typename A::Iterator i(x, full_size), j(x, s); i; ++i, ++j, k = (k + 1)%full_size)
+			for(typename B::Iterator ii(*i), jj(*j), qq(arr_q[k]), ss(arr_sum); ii; ++ii, ++jj, ++qq, ++ss)
+			{
+				*jj = w*(*ss);
+				*ss += *ii - *qq;
+				*qq = *ii;
+			}
+	}
+
 	template<typename T>
 	static void blur_box_discrete(const Array<T, 1> &dst, const Array<const T, 1> &src, const int size, const int offset)
 	{
@@ -490,6 +558,33 @@ public:
 			*i = d0 = k0*(*i) + k1*d1 + k2*d2 + k3*d3, d3 = d2, d2 = d1, d1 = d0;
 	}
 
+	//! Applies blur_iir() to each column of \a x walking through the rows,
+	//! \a d is a buffer for state of columns
+	template<typename T>
+	static void blur_iir_cols(const Array<T, 2> &x, std::vector<T> &d, const T &k0, const T &k1, const T &k2, const T &k3)
+	{
+		typedef Array<T, 2> A;
+		typedef Array<T, 1> B;
+		int cols = x.get_count(1);
+		if (cols <= 0) return;
+
+		d.assign(3*cols, T(0.0));
+		T *d1 = &d.front(), *d2 = d1 + cols, *d3 = d2 + cols;
+		for(typename A::Iterator i(x); i; ++i)
+		{
+			int c = 0;
+			for(typename B::Iterator ii(*i); ii; ++ii, ++c)
+				*ii = k0*(*ii) + k1*d1[c] + k2*d2[c] + k3*d3[c], d3[c] = d2[c], d2[c] = d1[c], d1[c] = *ii;
+		}
+		std::fill(d.begin(), d.end(), T(0.0));
+		for(typename A::ReverseIterator i(x); i; ++i)
+		{
+			int c = 0;
+			for(typename B::Iterator ii(*i); ii; ++ii, ++c)
+				*ii = k0*(*ii) + k1*d1[c] + k2*d2[c] + k3*d3[c], d3[c] = d2[c], d2[c] = d1[c], d1[c] = *ii;
+		}
+	}
+
 	template<typename T>
 	static void blur_iir(const Array<T, 1> &dst, const Array<T, 1> &src, const T &k0, const T &k1, const T &k2, const T &k3)
 	{
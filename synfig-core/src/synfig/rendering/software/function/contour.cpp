@@ -30,6 +30,7 @@
 #endif
 
 #include "contour.h"
+#include "blendspan.h"
 
 #include <synfig/debug/debugsurface.h>
 
@@ -87,8 +88,7 @@ software::Contour::render_polyspan(
 			}
 			else
 			{
-				p.move_to(window.minx, window.miny);
-				p.put_block(window.maxy - window.miny, window.maxx - window.minx);
+				BlendSpan::blend_color_rect(target_surface, window, color, opacity, blend_method);
 			}
 		}
 		return;
@@ -114,16 +114,16 @@ software::Contour::render_polyspan(
 		else
 		{
 			// fill all the area above the first vertex
-			p.move_to(window.minx, window.miny);
 			y = window.miny;
-			int l = window.maxx - window.minx;
-
-			p.put_block(cur_mark->y - window.miny, l);
+			BlendSpan::blend_color_rect(
+				target_surface,
+				RectInt(window.minx, window.miny, window.maxx, cur_mark->y),
+				color, opacity, blend_method );
 
 			// fill the area to the left of the first vertex on that line
-			l = cur_mark->x - window.minx;
-			p.move_to(window.minx, cur_mark->y);
-			if (l) p.put_hline(l);
+			int l = cur_mark->x - window.minx;
+			BlendSpan::blend_color(
+				&target_surface[cur_mark->y][window.minx], color, l, opacity, blend_method );
 		}
 	}
 
@@ -182,7 +182,8 @@ software::Contour::render_polyspan(
 				}
 				else
 				{
-					p.put_hline(window.maxx - x);
+					BlendSpan::blend_color(
+						&target_surface[y][x], color, window.maxx - x, opacity, blend_method );
 				}
 
 				// fill area at the beginning of the next line
@@ -193,8 +194,9 @@ software::Contour::render_polyspan(
 				}
 				else
 				{
-					p.move_to(window.minx, cur_mark->y);
-					p.put_hline(cur_mark->x - window.minx);
+					BlendSpan::blend_color(
+						&target_surface[cur_mark->y][window.minx], color,
+						cur_mark->x - window.minx, opacity, blend_method );
 				}
 			}
 
@@ -217,7 +219,8 @@ software::Contour::render_polyspan(
 				}
 				else
 				{
-					p.put_hline(cur_mark->x - x);
+					BlendSpan::blend_color(
+						&target_surface[y][x], color, cur_mark->x - x, opacity, blend_method );
 				}
 			}
 
@@ -251,11 +254,14 @@ software::Contour::render_polyspan(
 		else
 		{
 			//fill the area at the end of the line
-			p.put_hline(window.maxx - x);
+			BlendSpan::blend_color(
+				&target_surface[y][x], color, window.maxx - x, opacity, blend_method );
 
 			//fill area at the beginning of the next line
-			p.move_to(window.minx, y+1);
-			p.put_block(window.maxy - y - 1, window.maxx - window.minx);
+			BlendSpan::blend_color_rect(
+				target_surface,
+				RectInt(window.minx, y+1, window.maxx, window.maxy),
+				color, opacity, blend_method );
 		}
 	}
 }
@@ -31,15 +31,22 @@
 
 #include <cassert>
 #include <climits>
+#include <cstdlib>
 //#include <ccomplex>
 
-#include <glibmm/thread.h>
-
+#include <algorithm>
+#include <map>
 #include <vector>
 #include <set>
 
+#include <glibmm/threads.h>
+#include <sigc++/bind.h>
+
 #include <fftw3.h>
 
+#include <synfig/general.h>
+#include <synfig/threadpool.h>
+
 #include "fft.h"
 
 #endif
@@ -51,6 +58,16 @@ using namespace rendering;
 
 /* === G L O B A L S ======================================================= */
 
+namespace {
+	//! plans are never destroyed while renderer is alive (other threads
+	//! may execute them), so count of cached plans is limited
+	const size_t max_plans = 256;
+	//! minimal count of elements of transform to split it between threads
+	const long long min_part_size = 65536;
+	//! time limit for measurement of plan when wisdom is used, in seconds
+	const double wisdom_timelimit = 5.0;
+}
+
 /* === P R O C E D U R E S ================================================= */
 
 /* === M E T H O D S ======================================================= */
@@ -58,12 +75,144 @@ using namespace rendering;
 class software::FFT::Internal
 {
 public:
+	//! Plan is applicable for any arrays with the same
+	//! dimensions, strides, direction and alignment
+	class PlanKey
+	{
+	public:
+		std::vector<int> dims;
+		int sign;
+		int alignment;
+
+		PlanKey(): sign(), alignment() { }
+		PlanKey(
+			int rank, const fftw_iodim *iodims,
+			int howmany_rank, const fftw_iodim *howmany_iodims,
+			int sign, int alignment
+		):
+			sign(sign), alignment(alignment)
+		{
+			dims.reserve(2 + 3*(rank + howmany_rank));
+			dims.push_back(rank);
+			dims.push_back(howmany_rank);
+			for(int i = 0; i < rank; ++i)
+				{ dims.push_back(iodims[i].n); dims.push_back(iodims[i].is); dims.push_back(iodims[i].os); }
+			for(int i = 0; i < howmany_rank; ++i)
+				{ dims.push_back(howmany_iodims[i].n); dims.push_back(howmany_iodims[i].is); dims.push_back(howmany_iodims[i].os); }
+		}
+
+		bool operator<(const PlanKey &other) const
+		{
+			if (sign != other.sign) return sign < other.sign;
+			if (alignment != other.alignment) return alignment < other.alignment;
+			return dims < other.dims;
+		}
+	};
+
+	typedef std::map<PlanKey, fftw_plan> PlanMap;
+
 	static std::set<int> counts;
-	static Glib::Mutex mutex;
+	static PlanMap plans;
+	static String wisdom_filename;
+	static bool wisdom_changed;
+	//! protects planner of FFTW and cache of plans, execution of plans doesn't need it
+	static Glib::Threads::Mutex mutex;
+
+	//! Creates new plan, should be called under the mutex
+	static fftw_plan create_plan(
+		int rank, const fftw_iodim *iodims,
+		int howmany_rank, const fftw_iodim *howmany_iodims,
+		Complex *pointer, int sign )
+	{
+		fftw_complex *p = (fftw_complex*)pointer;
+		if (wisdom_filename.empty())
+			return fftw_plan_guru_dft(rank, iodims, howmany_rank, howmany_iodims, p, p, sign, FFTW_ESTIMATE);
+
+		// with available wisdom planner doesn't touch the data
+		fftw_plan plan = fftw_plan_guru_dft(
+			rank, iodims, howmany_rank, howmany_iodims, p, p, sign, FFTW_MEASURE | FFTW_WISDOM_ONLY );
+		if (plan) return plan;
+
+		// measurement overwrites arrays, so measure on a scratch buffer with the same alignment
+		long long extent = 1;
+		for(int i = 0; i < rank; ++i)
+			extent += (long long)(iodims[i].n - 1)*iodims[i].is;
+		for(int i = 0; i < howmany_rank; ++i)
+			extent += (long long)(howmany_iodims[i].n - 1)*howmany_iodims[i].is;
+		int alignment = fftw_alignment_of((double*)pointer);
+		if (char *buffer = (char*)fftw_malloc(extent*sizeof(fftw_complex) + alignment))
+		{
+			fftw_complex *scratch = (fftw_complex*)(buffer + alignment);
+			plan = fftw_plan_guru_dft(
+				rank, iodims, howmany_rank, howmany_iodims, scratch, scratch, sign, FFTW_MEASURE );
+			fftw_free(buffer);
+			if (plan) { wisdom_changed = true; return plan; }
+		}
+
+		return fftw_plan_guru_dft(rank, iodims, howmany_rank, howmany_iodims, p, p, sign, FFTW_ESTIMATE);
+	}
+
+	static void transform(
+		int rank, const fftw_iodim *iodims,
+		int howmany_rank, const fftw_iodim *howmany_iodims,
+		Complex *pointer, int sign )
+	{
+		PlanKey key(rank, iodims, howmany_rank, howmany_iodims, sign, fftw_alignment_of((double*)pointer));
+
+		fftw_plan plan;
+		bool cached = true;
+		{
+			Glib::Threads::Mutex::Lock lock(mutex);
+			PlanMap::const_iterator i = plans.find(key);
+			if (i != plans.end()) {
+				plan = i->second;
+			} else {
+				plan = create_plan(rank, iodims, howmany_rank, howmany_iodims, pointer, sign);
+				if (plans.size() < max_plans)
+					plans[key] = plan;
+				else
+					cached = false;
+			}
+		}
+
+		fftw_execute_dft(plan, (fftw_complex*)pointer, (fftw_complex*)pointer);
+
+		if (!cached) {
+			Glib::Threads::Mutex::Lock lock(mutex);
+			fftw_destroy_plan(plan);
+		}
+	}
+
+	static void transform_part(fftw_iodim iodim, fftw_iodim howmany_iodim, Complex *pointer, int sign)
+		{ transform(1, &iodim, 1, &howmany_iodim, pointer, sign); }
+
+	//! Makes a set of 1d transforms, large sets are split between threads of ThreadPool
+	static void transform_rows(const fftw_iodim &iodim, const fftw_iodim &howmany_iodim, Complex *pointer, int sign)
+	{
+		long long parts = (long long)iodim.n*howmany_iodim.n/min_part_size;
+		parts = std::min(parts, (long long)ThreadPool::instance.get_max_threads());
+		parts = std::min(parts, (long long)howmany_iodim.n);
+		if (parts <= 1)
+			{ transform_part(iodim, howmany_iodim, pointer, sign); return; }
+
+		ThreadPool::Group group;
+		for(int i = 0, begin = 0; i < parts; ++i) {
+			int end = (int)((i + 1)*howmany_iodim.n/parts);
+			fftw_iodim part = howmany_iodim;
+			part.n = end - begin;
+			group.enqueue( sigc::bind( sigc::ptr_fun(&Internal::transform_part),
+				iodim, part, pointer + (long long)begin*howmany_iodim.is, sign ));
+			begin = end;
+		}
+		group.run();
+	}
 };
 
 std::set<int> software::FFT::Internal::counts;
-Glib::Mutex software::FFT::Internal::mutex;
+software::FFT::Internal::PlanMap software::FFT::Internal::plans;
+String software::FFT::Internal::wisdom_filename;
+bool software::FFT::Internal::wisdom_changed;
+Glib::Threads::Mutex software::FFT::Internal::mutex;
 
 void
 software::FFT::initialize()
@@ -77,12 +226,34 @@ software::FFT::initialize()
 			for(int c5 = c3; c5 < max5; c5 *= 5)
 				for(int c7 = c5; c7 < max7; c7 *= 7)
 					Internal::counts.insert(c7);
-	fftw_set_timelimit(0.0);
+
+	Glib::Threads::Mutex::Lock lock(Internal::mutex);
+	Internal::wisdom_changed = false;
+	if (const char *s = getenv("SYNFIG_FFTW_WISDOM"))
+		Internal::wisdom_filename = s;
+	if (Internal::wisdom_filename.empty()) {
+		fftw_set_timelimit(0.0);
+	} else {
+		fftw_set_timelimit(wisdom_timelimit);
+		if (!fftw_import_wisdom_from_filename(Internal::wisdom_filename.c_str()))
+			info("FFT: wisdom not loaded from '%s'", Internal::wisdom_filename.c_str());
+	}
 }
 
 void
 software::FFT::deinitialize()
 {
+	Glib::Threads::Mutex::Lock lock(Internal::mutex);
+	for(Internal::PlanMap::iterator i = Internal::plans.begin(); i != Internal::plans.end(); ++i)
+		fftw_destroy_plan(i->second);
+	Internal::plans.clear();
+
+	if (Internal::wisdom_changed && !Internal::wisdom_filename.empty())
+		if (!fftw_export_wisdom_to_filename(Internal::wisdom_filename.c_str()))
+			warning("FFT: cannot save wisdom to '%s'", Internal::wisdom_filename.c_str());
+	Internal::wisdom_filename.clear();
+	Internal::wisdom_changed = false;
+
 	Internal::counts.clear();
 }
 
@@ -117,15 +288,7 @@ software::FFT::fft(const Array<Complex, 1> &x, bool invert)
 	iodim.is = x.stride;
 	iodim.os = x.stride;
 
-	{
-		Glib::Mutex::Lock lock(Internal::mutex);
-		fftw_plan plan = fftw_plan_guru_dft(
-			1, &iodim, 0, NULL,
-			(fftw_complex*)x.pointer, (fftw_complex*)x.pointer,
-			invert ? FFTW_BACKWARD : FFTW_FORWARD, FFTW_ESTIMATE );
-		fftw_execute(plan);
-		fftw_destroy_plan(plan);
-	}
+	Internal::transform(1, &iodim, 0, NULL, x.pointer, invert ? FFTW_BACKWARD : FFTW_FORWARD);
 
 	// divide by count to complete back-FFT
 	if (invert)
@@ -152,26 +315,20 @@ software::FFT::fft2d(const Array<Complex, 2> &x, bool invert, bool do_rows, bool
 	iodim[1].is = x.stride;
 	iodim[1].os = x.stride;
 
+	int sign = invert ? FFTW_BACKWARD : FFTW_FORWARD;
+	long long size = (long long)x.count*x.sub().count;
+	if (do_rows && do_cols && size < 2*min_part_size)
 	{
-		Glib::Mutex::Lock lock(Internal::mutex);
-
-		fftw_plan plan;
-		if (do_rows && do_cols)
-		{
-			plan = fftw_plan_guru_dft(
-				2, iodim, 0, NULL,
-				(fftw_complex*)x.pointer, (fftw_complex*)x.pointer,
-				invert ? FFTW_BACKWARD : FFTW_FORWARD, FFTW_ESTIMATE );
-		}
-		else
-		{
-			plan = fftw_plan_guru_dft(
-				1, &iodim[do_rows ? 0 : 1], 1, &iodim[do_rows ? 1 : 0],
-				(fftw_complex*)x.pointer, (fftw_complex*)x.pointer,
-				invert ? FFTW_BACKWARD : FFTW_FORWARD, FFTW_ESTIMATE );
-		}
-		fftw_execute(plan);
-		fftw_destroy_plan(plan);
+		Internal::transform(2, iodim, 0, NULL, x.pointer, sign);
+	}
+	else
+	{
+		// 2d transform is a set of transforms of rows followed by transforms of columns,
+		// each set may be split between threads
+		if (do_rows)
+			Internal::transform_rows(iodim[0], iodim[1], x.pointer, sign);
+		if (do_cols)
+			Internal::transform_rows(iodim[1], iodim[0], x.pointer, sign);
 	}
 
 	// divide by count to complete back-FFT
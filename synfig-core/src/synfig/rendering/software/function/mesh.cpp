@@ -29,7 +29,10 @@
 #	include <config.h>
 #endif
 
+#include <vector>
+
 #include "mesh.h"
+#include "blendspan.h"
 
 #endif
 
@@ -111,10 +114,6 @@ software::Mesh::render_triangle(
 	if (ip0.x >= bounds.maxx && ip1.x >= bounds.maxx && ip2.x >= bounds.maxx) return;
 	if (ip0.y >= bounds.maxy && ip1.y >= bounds.maxy && ip2.y >= bounds.maxy) return;
 
-	synfig::Surface::alpha_pen apen(target_surface.get_pen(0, 0));
-	apen.set_alpha(opacity);
-	apen.set_blend_method(blend_method);
-
 	// sort points
 	if (ip0.y > ip1.y) std::swap(ip0, ip1);
 	if (ip0.y > ip2.y) std::swap(ip0, ip2);
@@ -147,14 +146,8 @@ software::Mesh::render_triangle(
 			if (x0 <  bounds.minx) x0 = bounds.minx;
 			if (x1 >= bounds.maxx) x1 = bounds.maxx-1;
 			if (x1 >= x0)
-			{
-				apen.move_to(x0, y);
-				for(int x = x0; x <= x1; ++x)
-				{
-					apen.put_value(color);
-					apen.inc_x();
-				}
-			}
+				BlendSpan::blend_color(
+					&target_surface[y][x0], color, x1 - x0 + 1, opacity, blend_method );
     	}
 
 		wx0 += dx02;
@@ -182,14 +175,8 @@ software::Mesh::render_triangle(
 			if (x0 <  bounds.minx) x0 = bounds.minx;
 			if (x1 >= bounds.maxx) x1 = bounds.maxx-1;
 			if (x1 >= x0)
-			{
-				apen.move_to(x0, y);
-				for(int x = x0; x <= x1; ++x)
-				{
-					apen.put_value(color);
-					apen.inc_x();
-				}
-			}
+				BlendSpan::blend_color(
+					&target_surface[y][x0], color, x1 - x0 + 1, opacity, blend_method );
     	}
 
 		wx0 += dx02_copy;
@@ -257,9 +244,9 @@ software::Mesh::render_triangle(
 	Vector tdx = matrix.get_transformed(Vector(1.0, 0.0), false);
 	//Vector tdy = matrix.get_transformed(Vector(0.0, 1.0), false);
 
-	synfig::Surface::alpha_pen apen(target_surface.get_pen(0, 0));
-	apen.set_alpha(opacity);
-	apen.set_blend_method(blend_method);
+	// row of texture samples and their covers (zero when outside of texture)
+	std::vector<Color> row;
+	std::vector<ColorReal> covers;
 
     // sort points
     if (ip0.y > ip1.y) std::swap(ip0, ip1);
@@ -294,26 +281,29 @@ software::Mesh::render_triangle(
 			if (x1 >= bounds.maxx) x1 = bounds.maxx-1;
 			if (x1 >= x0)
 			{
-				apen.move_to(x0, y);
+				int count = x1 - x0 + 1;
+				row.resize(count);
+				covers.resize(count);
 				Vector tex_point = matrix.get_transformed(Vector(Real(x0), Real(y)));
-				for(int x = x0; x <= x1; ++x)
+				for(int i = 0; i < count; ++i)
 				{
 					if (tex_point[0] < tex_bounds.minx || tex_point[0] > tex_bounds.maxx
 					 || tex_point[1] < tex_bounds.miny || tex_point[1] > tex_bounds.maxy)
 					{
-						apen.set_alpha(0.0);
-						apen.put_value(Color());
+						row[i] = Color();
+						covers[i] = 0.0;
 					}
 					else
 					{
-						apen.set_alpha(opacity);
-						apen.put_value(texture.cubic_sample(tex_point[0], tex_point[1]));
+						row[i] = texture.cubic_sample(tex_point[0], tex_point[1]);
+						covers[i] = 1.0;
 					}
 					// uncomment following line to debug
-					//apen.put_value(Color(0,0,1,0.5));
-					apen.inc_x();
+					//row[i] = Color(0,0,1,0.5);
 					tex_point += tdx;
 				}
+				BlendSpan::blend(
+					&target_surface[y][x0], &row.front(), count, opacity, blend_method, &covers.front() );
 			}
     	}
 
@@ -343,26 +333,29 @@ software::Mesh::render_triangle(
 			if (x1 >= bounds.maxx) x1 = bounds.maxx-1;
 			if (x1 >= x0)
 			{
-				apen.move_to(x0, y);
+				int count = x1 - x0 + 1;
+				row.resize(count);
+				covers.resize(count);
 				Vector tex_point = matrix.get_transformed(Vector(Real(x0), Real(y)));
-				for(int x = x0; x <= x1; ++x)
+				for(int i = 0; i < count; ++i)
 				{
 					if (tex_point[0] < tex_bounds.minx || tex_point[0] > tex_bounds.maxx
 					 || tex_point[1] < tex_bounds.miny || tex_point[1] > tex_bounds.maxy)
 					{
-						apen.set_alpha(0.0);
-						apen.put_value(Color());
+						row[i] = Color();
+						covers[i] = 0.0;
 					}
 					else
 					{
-						apen.set_alpha(opacity);
-						apen.put_value(texture.cubic_sample(tex_point[0], tex_point[1]));
+						row[i] = texture.cubic_sample(tex_point[0], tex_point[1]);
+						covers[i] = 1.0;
 					}
 					// uncomment following line to debug
-					//apen.put_value(Color(1,0,0,0.5));
-					apen.inc_x();
+					//row[i] = Color(1,0,0,0.5);
 					tex_point += tdx;
 				}
+				BlendSpan::blend(
+					&target_surface[y][x0], &row.front(), count, opacity, blend_method, &covers.front() );
 			}
     	}
 
@@ -477,6 +477,22 @@ namespace {
 			}
 		};
 	};
+
+	template<Color sampler_func(const void*, float, float)>
+	void sample_points(Color *dest, const synfig::Surface &src, const Vector *points, int count, bool cooked)
+	{
+		const Real w = (Real)src.get_w();
+		const Real h = (Real)src.get_h();
+		for(Color *end = dest + count; dest < end; ++dest, ++points) {
+			Real x = (*points)[0] - 0.5;
+			Real y = (*points)[1] - 0.5;
+			// negated comparisons also rejects NaN
+			if (!(x > -1.0 && x < w && y > -1.0 && y < h))
+				{ *dest = Color::alpha(); continue; }
+			*dest = sampler_func(&src, x, y);
+			if (cooked) *dest = ColorPrep::uncook_static(*dest);
+		}
+	}
 }
 
 
@@ -563,5 +579,30 @@ software::Resample::resample(
 		blend_method );
 }
 
+void
+software::Resample::sample(
+	Color *dest,
+	const synfig::Surface &src,
+	const Vector *points,
+	int count,
+	Color::Interpolation interpolation )
+{
+	typedef synfig::Surface Surface;
+	typedef Surface::sampler<ColorAccumulator, Surface::reader_cook<etl::clamping::truncate, etl::clamping::truncate> > SamplerCook;
+	typedef Surface::sampler<Color, Surface::reader<etl::clamping::truncate, etl::clamping::truncate> > Sampler;
+
+	switch(interpolation)
+	{
+	case Color::INTERPOLATION_LINEAR:
+		sample_points<SamplerCook::linear_sample>(dest, src, points, count, true); break;
+	case Color::INTERPOLATION_COSINE:
+		sample_points<SamplerCook::cosine_sample>(dest, src, points, count, true); break;
+	case Color::INTERPOLATION_CUBIC:
+		sample_points<SamplerCook::cubic_sample>(dest, src, points, count, true); break;
+	default:
+		sample_points<Sampler::nearest_sample>(dest, src, points, count, false); break;
+	}
+}
+
 
 /* === E N T R Y P O I N T ================================================= */
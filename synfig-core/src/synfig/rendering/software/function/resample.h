@@ -83,6 +83,16 @@ public:
 		bool blend,
 		ColorReal blend_amount,
 		Color::BlendMethod blend_method );
+
+	//! Reads colors of \a src at \a count arbitrary \a points,
+	//! coordinates of points are in pixels of \a src (pixel corners are integer),
+	//! points outside of surface or NaN points gives transparent color
+	static void sample(
+		Color *dest,
+		const synfig::Surface &src,
+		const Vector *points,
+		int count,
+		Color::Interpolation interpolation );
 };
 
 } /* end namespace software */
@@ -64,14 +64,9 @@ RendererDraftSW::RendererDraftSW()
 	// register optimizers
 	register_optimizer(new OptimizerDraftContour(2.0, true));
 	register_optimizer(new OptimizerDraftBlur());
+	register_optimizer(new OptimizerDraftTask());
 	register_optimizer(new OptimizerDraftLayerSkip("MotionBlur"));
 	register_optimizer(new OptimizerDraftLayerSkip("radial_blur"));
-	register_optimizer(new OptimizerDraftLayerSkip("curve_warp"));
-	register_optimizer(new OptimizerDraftLayerSkip("inside_out"));
-	register_optimizer(new OptimizerDraftLayerSkip("noise_distort"));
-	register_optimizer(new OptimizerDraftLayerSkip("spherize"));
-	register_optimizer(new OptimizerDraftLayerSkip("twirl"));
-	register_optimizer(new OptimizerDraftLayerSkip("warp"));
 	register_optimizer(new OptimizerDraftLayerSkip("metaballs"));
 	register_optimizer(new OptimizerDraftLayerSkip("clamp"));
 	register_optimizer(new OptimizerDraftLayerSkip("colorcorrect"));
@@ -98,7 +93,8 @@ RendererDraftSW::RendererDraftSW()
 	register_optimizer(new OptimizerBlendToTarget());
 	register_optimizer(new OptimizerList());
 	register_optimizer(new OptimizerBlendAssociative());
-	//register_optimizer(new OptimizerSplit());
+	if (OptimizerSplit::is_enabled())
+		register_optimizer(new OptimizerSplit(get_max_simultaneous_threads()));
 }
 
 String RendererDraftSW::get_name() const
@@ -71,7 +71,8 @@ RendererSW::RendererSW()
 	register_optimizer(new OptimizerList());
 	register_optimizer(new OptimizerBlendToTarget());
 	register_optimizer(new OptimizerBlendAssociative());
-	//register_optimizer(new OptimizerSplit());
+	if (OptimizerSplit::is_enabled())
+		register_optimizer(new OptimizerSplit(get_max_simultaneous_threads()));
 }
 
 RendererSW::~RendererSW() { }
@@ -0,0 +1,196 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/task/taskaccumulatesw.cpp
+**	\brief TaskAccumulateSW
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <vector>
+
+#include <sigc++/bind.h>
+
+#include <synfig/general.h>
+#include <synfig/threadpool.h>
+
+#include "../../common/task/taskaccumulate.h"
+#include "../function/blendspan.h"
+#include "tasksw.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+namespace {
+
+class TaskAccumulateSW: public TaskAccumulate, public TaskSW
+{
+public:
+	typedef etl::handle<TaskAccumulateSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+private:
+	// minimal count of pixels to process in separate thread
+	static const int band_pixels = 65536;
+
+	struct Source {
+		const synfig::Surface *surface;
+		RectInt rect;
+		VectorInt offset;
+		ColorReal amount;
+
+		Source(): surface(), amount() { }
+		Source(const synfig::Surface *surface, const RectInt &rect, const VectorInt &offset, ColorReal amount):
+			surface(surface), rect(rect), offset(offset), amount(amount) { }
+	};
+
+	typedef std::vector<Source> SourceList;
+
+	struct Rows {
+		synfig::Surface *surface;
+		RectInt rect;
+		const SourceList *sources;
+
+		Rows(): surface(), sources() { }
+	};
+
+	//! owns read locks of sub-tasks
+	struct LockList: public std::vector<LockRead*> {
+		~LockList() {
+			for(iterator i = begin(); i != end(); ++i)
+				delete *i;
+		}
+	};
+
+	void blend_rows(const Rows *rows, int begin, int end) const {
+		synfig::Surface &c = *rows->surface;
+		const RectInt &r = rows->rect;
+		c.fill(Color(0, 0, 0, 0), r.minx, begin, r.get_width(), end - begin);
+
+		// process all sources for the band at once,
+		// so band of the target stays in the cache
+		for(SourceList::const_iterator i = rows->sources->begin(); i != rows->sources->end(); ++i) {
+			int miny = std::max(begin, i->rect.miny);
+			int maxy = std::min(end, i->rect.maxy);
+			if (miny >= maxy) continue;
+
+			software::BlendSpan::blend_rect(
+				c,
+				RectInt(i->rect.minx, miny, i->rect.maxx, maxy),
+				*i->surface,
+				VectorInt(i->rect.minx, miny) + i->offset,
+				i->amount,
+				blend_method );
+		}
+	}
+
+	void blend(Rows &rows) const {
+		int w = rows.rect.get_width();
+		int h = rows.rect.get_height();
+		int band = std::max(1, band_pixels/w);
+		if (band >= h) {
+			blend_rows(&rows, rows.rect.miny, rows.rect.maxy);
+			return;
+		}
+
+		ThreadPool::Group group;
+		for(int y = rows.rect.miny; y < rows.rect.maxy; y += band)
+			group.enqueue( sigc::bind( sigc::mem_fun(this, &TaskAccumulateSW::blend_rows),
+				&rows, y, std::min(y + band, rows.rect.maxy) ));
+		group.run();
+	}
+
+public:
+	virtual bool run(RunParams&) const {
+		if (!is_valid()) return true;
+		if (!is_blend_method_supported(blend_method)) {
+			error("TaskAccumulateSW: unsupported blend method %d", (int)blend_method);
+			return false;
+		}
+
+		LockWrite la(this);
+		if (!la) return false;
+
+		Rows rows;
+		rows.surface = &la->get_surface();
+		rows.rect = target_rect;
+
+		assert( 0 <= rows.rect.minx && rows.rect.maxx <= rows.surface->get_w()
+			 && 0 <= rows.rect.miny && rows.rect.maxy <= rows.surface->get_h() );
+
+		// keep all sub-tasks locked while target is processing
+		LockList locks;
+		locks.reserve(sub_tasks.size());
+		SourceList sources;
+		sources.reserve(sub_tasks.size());
+
+		for(int i = 0; i < (int)sub_tasks.size(); ++i) {
+			const Task::Handle &sub = sub_task(i);
+			ColorReal amount = get_amount(i);
+			if (!sub || !sub->is_valid() || approximate_equal_lp(amount, ColorReal(0.0)))
+				continue;
+
+			VectorInt offset = get_offset(i);
+			RectInt rect = sub->target_rect - offset;
+			if (rect.is_valid())
+				etl::set_intersect(rect, rect, rows.rect);
+			if (!rect.is_valid())
+				continue;
+
+			locks.push_back(new LockRead(sub));
+			LockRead &lb = *locks.back();
+			if (!lb) return false;
+			const synfig::Surface &b = lb.cast_handle()->get_surface();
+
+			assert( 0 <= rect.minx + offset[0] && rect.maxx + offset[0] <= b.get_w()
+				 && 0 <= rect.miny + offset[1] && rect.maxy + offset[1] <= b.get_h() );
+
+			sources.push_back(Source(&b, rect, offset, amount));
+		}
+
+		rows.sources = &sources;
+		blend(rows);
+		return true;
+	}
+};
+
+
+Task::Token TaskAccumulateSW::token(
+	DescReal<TaskAccumulateSW, TaskAccumulate>("AccumulateSW") );
+
+} // end of anonimous namespace
+
+/* === E N T R Y P O I N T ================================================= */
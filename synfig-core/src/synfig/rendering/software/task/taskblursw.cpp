@@ -51,7 +51,7 @@ using namespace rendering;
 
 namespace {
 
-class TaskBlurSW: public TaskBlur, public TaskSW, public TaskInterfaceBlendToTarget
+class TaskBlurSW: public TaskBlur, public TaskSW, public TaskInterfaceBlendToTarget, public TaskInterfaceSplit
 {
 public:
 	typedef etl::handle<TaskBlurSW> Handle;
@@ -62,6 +62,9 @@ public:
 		{ return 1; }
 	virtual Color::BlendMethodFlags get_supported_blend_methods() const
 		{ return Color::BLEND_METHODS_ALL & ~Color::BLEND_METHODS_STRAIGHT; }
+	// blur reads margins around each pixel
+	virtual Real get_pixel_cost() const
+		{ return 4.0; }
 
 	virtual bool run(RunParams&) const {
 		if (!is_valid() || !sub_task() || !sub_task()->is_valid())
@@ -85,7 +88,7 @@ public:
 				blur.type, s,
 				blend, blend_method, amount ));
 
-		return false;
+		return true;
 	}
 };
 
@@ -0,0 +1,154 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/task/taskdistortsw.cpp
+**	\brief TaskDistortSW
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include <sigc++/bind.h>
+
+#include <synfig/general.h>
+#include <synfig/threadpool.h>
+
+#include "../../common/task/taskdistort.h"
+#include "tasksw.h"
+#include "../function/resample.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+	// minimal count of pixels to render in separate thread
+	const int band_pixels = 16384;
+}
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+namespace {
+
+class TaskDistortSW: public TaskDistort, public TaskSW, public TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskDistortSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	// each pixel calls mapping function and reads several pixels of source
+	virtual Real get_pixel_cost() const
+		{ return interpolation == Color::INTERPOLATION_NEAREST ? 2.0 : 4.0; }
+
+private:
+	struct Rows {
+		synfig::Surface *surface;
+		const synfig::Surface *src;
+		RectInt rect;
+		Vector origin;
+		Vector upp;
+		Vector src_origin;
+		Vector src_ppu;
+		Vector src_offset;
+
+		Rows(): surface(), src() { }
+	};
+
+	void fill_rows(const Rows *rows, int begin, int end) const
+	{
+		const RectInt &r = rows->rect;
+		int w = r.get_width();
+		std::vector<Point> points(w);
+		Vector dp(rows->upp[0], 0.0);
+		for(int y = begin; y < end; ++y) {
+			Point p( rows->origin[0],
+			         rows->origin[1] + (Real)(y - r.miny)*rows->upp[1] );
+			distortion->map_row(&points.front(), p, dp, w);
+
+			// convert points to pixels of source surface
+			for(std::vector<Point>::iterator i = points.begin(); i != points.end(); ++i)
+				*i = (*i - rows->src_origin).multiply_coords(rows->src_ppu) + rows->src_offset;
+
+			software::Resample::sample(
+				&(*rows->surface)[y][r.minx], *rows->src, &points.front(), w, interpolation );
+		}
+	}
+
+public:
+	virtual bool run(RunParams&) const {
+		if (!is_valid() || !distortion || !sub_task() || !sub_task()->is_valid())
+			return true;
+
+		LockWrite la(this);
+		LockRead lb(sub_task());
+		if (!la || !lb)
+			return false;
+
+		Rows rows;
+		rows.surface = &la->get_surface();
+		rows.src = &lb->get_surface();
+		rows.rect = target_rect;
+		rows.upp = get_units_per_pixel();
+		rows.origin = source_rect.get_min() + rows.upp*0.5;
+		rows.src_origin = sub_task()->source_rect.get_min();
+		rows.src_ppu = sub_task()->get_pixels_per_unit();
+		rows.src_offset = Vector(
+			(Real)sub_task()->target_rect.minx,
+			(Real)sub_task()->target_rect.miny );
+
+		int w = rows.rect.get_width();
+		int h = rows.rect.get_height();
+		int band = std::max(1, band_pixels/w);
+		if (band >= h) {
+			fill_rows(&rows, rows.rect.miny, rows.rect.maxy);
+			return true;
+		}
+
+		ThreadPool::Group group;
+		for(int y = rows.rect.miny; y < rows.rect.maxy; y += band)
+			group.enqueue( sigc::bind( sigc::mem_fun(this, &TaskDistortSW::fill_rows),
+				&rows, y, std::min(y + band, rows.rect.maxy) ));
+		group.run();
+		return true;
+	}
+};
+
+
+Task::Token TaskDistortSW::token(
+	DescReal<TaskDistortSW, TaskDistort>("DistortSW") );
+
+} // end of anonimous namespace
+
+/* === E N T R Y P O I N T ================================================= */
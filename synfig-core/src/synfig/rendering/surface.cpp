@@ -49,7 +49,7 @@ using namespace rendering;
 /* === M E T H O D S ======================================================= */
 
 synfig::Token Surface::token;
-int SurfaceResource::last_id = 0;
+std::atomic<int> SurfaceResource::last_id(0);
 
 Surface::Surface():
 	blank(true),
@@ -197,12 +197,15 @@ Surface::touch()
 
 SurfaceResource::SurfaceResource():
 	id(++last_id),
+	revision(),
 	width(),
 	height(),
 	blank(true)
 { }
 
 SurfaceResource::SurfaceResource(Surface::Handle surface):
+	id(++last_id),
+	revision(),
 	width(),
 	height(),
 	blank(true)
@@ -273,6 +276,7 @@ SurfaceResource::get_surface(
 			{ surfaces.clear(); surfaces[token] = surface; }
 		surface->touch();
 		blank = false;
+		++revision;
 	}
 	return surface;
 }
@@ -291,6 +295,7 @@ SurfaceResource::create(int width, int height)
 	}
 	blank = true;
 	surfaces.clear();
+	++revision;
 }
 
 void
@@ -307,6 +312,7 @@ SurfaceResource::assign(Surface::Handle surface)
 	height = 0;
 	blank = true;
 	surfaces.clear();
+	++revision;
 	if (!surface->is_exists())
 		return;
 
@@ -323,6 +329,7 @@ SurfaceResource::clear()
 	Glib::Threads::Mutex::Lock short_lock(mutex);
 	blank = true;
 	surfaces.clear();
+	++revision;
 }
 
 void
@@ -334,6 +341,7 @@ SurfaceResource::reset()
 	height = 0;
 	blank = true;
 	surfaces.clear();
+	++revision;
 }
 
 /* === E N T R Y P O I N T ================================================= */
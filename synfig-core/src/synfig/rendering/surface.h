@@ -27,6 +27,7 @@
 
 /* === H E A D E R S ======================================================= */
 
+#include <atomic>
 #include <map>
 #include <vector>
 
@@ -322,9 +323,10 @@ public:
 	};
 
 private:
-	static int last_id;
+	static std::atomic<int> last_id;
 
 	int id;
+	int revision;
 	int width;
 	int height;
 	bool blank;
@@ -356,6 +358,9 @@ public:
 
 	int get_id() const //!< helps to debug of renderer optimizers
 		{ return id; }
+	//! increments each time when content may be changed, see RenderCache
+	int get_revision() const
+		{ Glib::Threads::Mutex::Lock lock(mutex); return revision; }
 	int get_width() const
 		{ Glib::Threads::Mutex::Lock lock(mutex); return width; }
 	int get_height() const
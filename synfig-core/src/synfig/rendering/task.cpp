@@ -30,6 +30,7 @@
 #endif
 
 #include <synfig/general.h>
+#include <synfig/threadpool.h>
 
 #include "task.h"
 #include "renderer.h"
@@ -336,6 +337,23 @@ TaskList::calc_target_offset(const Task &a, const Task &b)
 }
 
 
+// TaskSurface
+
+bool
+TaskSurface::hash_params(TaskHash &hash) const
+{
+	// content is identified by resource and its revision,
+	// surface may be placed at any offset of the target
+	if (!target_surface)
+		return false;
+	hash.add(target_surface->get_id());
+	hash.add(target_surface->get_revision());
+	hash.add(target_rect.minx);
+	hash.add(target_rect.miny);
+	return true;
+}
+
+
 // TaskLockSurface
 
 void
@@ -424,8 +442,10 @@ void
 TaskEvent::wait()
 {
 	Glib::Threads::Mutex::Lock lock(mutex);
-	if (done || cancelled) return;
-	cond.wait(mutex);
+	// waiting thread may be the thread of pool which is required to finish the tasks,
+	// so let ThreadPool run another one
+	while(!done && !cancelled)
+		ThreadPool::instance.wait(cond, mutex);
 }
 
 bool
@@ -89,6 +89,41 @@ public:
 };
 
 
+//! Accumulates 64-bit FNV-1a hash of task parameters, see Task::hash_params(),
+//! also keeps all added bytes to compare parameters exactly when hashes are equal
+class TaskHash
+{
+public:
+	typedef unsigned long long Value;
+
+private:
+	Value value;
+	String data;
+
+public:
+	TaskHash(): value(14695981039346656037ull) { }
+
+	void add_data(const void *data, size_t size) {
+		for(const unsigned char *c = (const unsigned char*)data, *end = c + size; c != end; ++c)
+			value = (value ^ *c)*1099511628211ull;
+		this->data.append((const char*)data, size);
+	}
+
+	//! use only for plain values without padding bytes
+	template<typename T>
+	void add(const T &x)
+		{ add_data(&x, sizeof(x)); }
+
+	void add_string(const String &x)
+		{ add(x.size()); add_data(x.c_str(), x.size()); }
+
+	Value get() const
+		{ return value; }
+	const String& get_data() const
+		{ return data; }
+};
+
+
 // Mode
 
 
@@ -280,10 +315,28 @@ public:
 		Set tmp_deps;
 		Set tmp_back_deps;
 
+		//! count of unfinished dependencies, RenderQueue runs task when it reaches zero
+		std::atomic<int> deps_count;
+
 		RunParams params;
 		bool success;
 
-		RendererData(): batch_index(), index(), success() { }
+		RendererData(): batch_index(), index(), deps_count(), success() { }
+		RendererData(const RendererData &other):
+			batch_index(), index(), deps_count(), success() { *this = other; }
+
+		RendererData& operator=(const RendererData &other) {
+			batch_index = other.batch_index;
+			index = other.index;
+			deps = other.deps;
+			back_deps = other.back_deps;
+			tmp_deps = other.tmp_deps;
+			tmp_back_deps = other.tmp_back_deps;
+			deps_count = (int)other.deps_count;
+			params = other.params;
+			success = other.success;
+			return *this;
+		}
 	};
 
 	class LockReadBase: public SurfaceResource::LockReadBase
@@ -446,6 +499,12 @@ public:
 	virtual int get_pass_subtask_index() const
 		{ return PASSTO_THIS_TASK; }
 
+	//! Adds parameters of task (without coordinates and sub-tasks) to the hash.
+	//! Returns false if result of the task can not be identified by parameters,
+	//! such tasks (and their parents) will not be stored in RenderCache.
+	virtual bool hash_params(TaskHash & /* hash */) const
+		{ return false; }
+
 	void touch_coords();
 	void set_coords(const Rect &source_rect, const VectorInt &target_size);
 	void set_coords_zero();
@@ -471,10 +530,25 @@ class TaskInterfaceSplit
 public:
 	virtual bool is_splittable() const
 		{ return true; }
+	//! Relative cost of processing of one pixel, used by OptimizerSplit
+	//! to choose count of parts, 1.0 is a cost of simple blending
+	virtual Real get_pixel_cost() const
+		{ return 1.0; }
 	virtual ~TaskInterfaceSplit() { }
 };
 
 
+class TaskInterfaceDraft
+{
+public:
+	//! Returns simplified copy of task for draft renderer (see OptimizerDraftTask),
+	//! or null handle when task is already simple enough
+	virtual Task::Handle clone_draft() const
+		{ return Task::Handle(); }
+	virtual ~TaskInterfaceDraft() { }
+};
+
+
 class TaskInterfaceTargetAsSource
 {
 public:
@@ -508,6 +582,8 @@ public:
 	typedef etl::handle<TaskSurface> Handle;
 	static Token token;
 	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual bool hash_params(TaskHash &hash) const;
 };
 
 
@@ -62,14 +62,14 @@
 #include "importer.h"
 #include "cairoimporter.h"
 
+#include <sstream>
+#include <vector>
+
 #include <libxml++/libxml++.h>
+#include <libxml/tree.h>
 #include <ETL/stringf>
 #include "gradient.h"
 
-/*extern "C" {
-#include <libxml/tree.h>
-}*/
-
 #endif
 
 /* === U S I N G =========================================================== */
@@ -94,7 +94,7 @@ void *save_canvas_external_file_user_data = NULL;
 
 /* === P R O C E D U R E S ================================================= */
 
-xmlpp::Element* encode_canvas(xmlpp::Element* root,Canvas::ConstHandle canvas);
+xmlpp::Element* encode_canvas(xmlpp::Element* root,Canvas::ConstHandle canvas,std::ostream *stream = NULL);
 xmlpp::Element* encode_value_node(xmlpp::Element* root,ValueNode::ConstHandle value_node,Canvas::ConstHandle canvas);
 xmlpp::Element* encode_value_node_bone(xmlpp::Element* root,ValueNode::ConstHandle value_node,Canvas::ConstHandle canvas);
 xmlpp::Element* encode_value_node_bone_id(xmlpp::Element* root,ValueNode::ConstHandle value_node,Canvas::ConstHandle canvas);
@@ -925,7 +925,106 @@ xmlpp::Element* encode_layer(xmlpp::Element* root,Layer::ConstHandle layer)
 	return root;
 }
 
-xmlpp::Element* encode_canvas(xmlpp::Element* root,Canvas::ConstHandle canvas)
+namespace {
+
+//! Receives children of the root element of document.
+//! Without stream children are just added to the root element.
+//! With stream each child is written right after it was encoded and then released,
+//! so whole document tree is never kept in memory.
+class ElementWriter
+{
+private:
+	xmlpp::Element *parent;
+	std::ostream *stream;
+	std::vector<String> sections;
+	xmlpp::Document *document;
+
+	static String escape(const String &text)
+	{
+		String result;
+		result.reserve(text.size());
+		for(String::const_iterator i = text.begin(); i != text.end(); ++i)
+			switch(*i)
+			{
+			case '&':  result += "&amp;";  break;
+			case '<':  result += "&lt;";   break;
+			case '>':  result += "&gt;";   break;
+			case '"':  result += "&quot;"; break;
+			case '\n': result += "&#10;";  break;
+			case '\r': result += "&#13;";  break;
+			case '\t': result += "&#9;";   break;
+			default:   result += *i;
+			}
+		return result;
+	}
+
+	String indent() const
+		{ return String(2*(sections.size() + 1), ' '); }
+
+public:
+	//! \param root root element, its attributes should be already set
+	ElementWriter(xmlpp::Element *root, std::ostream *stream):
+		parent(root), stream(stream), document()
+	{
+		if (!stream) return;
+		*stream << "<" << root->get_name();
+		const xmlpp::Element::AttributeList attributes = root->get_attributes();
+		for(xmlpp::Element::AttributeList::const_iterator i = attributes.begin(); i != attributes.end(); ++i)
+			*stream << " " << (*i)->get_name() << "=\"" << escape((*i)->get_value()) << "\"";
+		*stream << ">\n";
+	}
+
+	~ElementWriter()
+		{ delete document; }
+
+	//! creates child element, call end() when it's encoded
+	xmlpp::Element* begin(const String &name)
+	{
+		if (!stream) return parent->add_child(name);
+		delete document;
+		document = new xmlpp::Document();
+		return document->create_root_node(name);
+	}
+
+	void end()
+	{
+		if (!stream || !document) return;
+		xmlBufferPtr buffer = xmlBufferCreate();
+		xmlNodeDump(buffer, document->cobj(), document->get_root_node()->cobj(), (int)sections.size() + 1, 1);
+		*stream << indent();
+		stream->write((const char*)xmlBufferContent(buffer), xmlBufferLength(buffer));
+		*stream << "\n";
+		xmlBufferFree(buffer);
+		delete document;
+		document = NULL;
+	}
+
+	//! starts element which contains other children
+	void begin_section(const String &name)
+	{
+		if (!stream) { parent = parent->add_child(name); return; }
+		*stream << indent() << "<" << name << ">\n";
+		sections.push_back(name);
+	}
+
+	void end_section()
+	{
+		if (!stream) { parent = parent->get_parent(); return; }
+		String name = sections.back();
+		sections.pop_back();
+		*stream << indent() << "</" << name << ">\n";
+	}
+
+	void finish()
+	{
+		if (!stream) return;
+		*stream << "</" << parent->get_name() << ">\n";
+	}
+};
+
+}
+
+xmlpp::Element* encode_canvas(xmlpp::Element* root,Canvas::ConstHandle canvas,std::ostream *stream)
 {
 	assert(canvas);
 	const RendDesc &rend_desc=canvas->rend_desc();
@@ -980,39 +1079,50 @@ xmlpp::Element* encode_canvas(xmlpp::Element* root,Canvas::ConstHandle canvas)
 			rend_desc.get_bg_color().get_b(),
 			rend_desc.get_bg_color().get_a())
 		);
+	}
+
+	// all attributes are set, so children may be written
+	ElementWriter writer(root, stream);
 
+	if(!canvas->is_inline())
+	{
 		if(!canvas->get_name().empty())
-			root->add_child("name")->set_child_text(canvas->get_name());
+			{ writer.begin("name")->set_child_text(canvas->get_name()); writer.end(); }
 		if(!canvas->get_description().empty())
-			root->add_child("desc")->set_child_text(canvas->get_description());
+			{ writer.begin("desc")->set_child_text(canvas->get_description()); writer.end(); }
 		if(!canvas->get_author().empty())
-			root->add_child("author")->set_child_text(canvas->get_description());
+			{ writer.begin("author")->set_child_text(canvas->get_description()); writer.end(); }
 
 		std::list<String> meta_keys(canvas->get_meta_data_keys());
 		while(!meta_keys.empty())
 		{
-			xmlpp::Element* meta_element(root->add_child("meta"));
+			xmlpp::Element* meta_element(writer.begin("meta"));
 			meta_element->set_attribute("name",meta_keys.front());
 			meta_element->set_attribute("content",canvas->get_meta_data(meta_keys.front()));
+			writer.end();
 			meta_keys.pop_front();
 		}
 		for(KeyframeList::const_iterator iter=canvas->keyframe_list().begin();iter!=canvas->keyframe_list().end();++iter)
-			encode_keyframe(root->add_child("keyframe"),*iter,canvas->rend_desc().get_frame_rate());
+			{ encode_keyframe(writer.begin("keyframe"),*iter,canvas->rend_desc().get_frame_rate()); writer.end(); }
 	}
 
 	// Output the <bones> section
 	if((!canvas->is_inline() && !ValueNode_Bone::get_bone_map(canvas).empty()))
 	{
-		xmlpp::Element *node=root->add_child("bones");
+		writer.begin_section("bones");
 
-		encode_value_node_bone(node->add_child("value_node"),ValueNode_Bone::get_root_bone(),canvas);
+		encode_value_node_bone(writer.begin("value_node"),ValueNode_Bone::get_root_bone(),canvas);
+		writer.end();
 
 		ValueNode_Bone::BoneList bone_list(ValueNode_Bone::get_ordered_bones(canvas));
 		for(ValueNode_Bone::BoneList::iterator iter=bone_list.begin();iter!=bone_list.end();++iter)
 		{
 			ValueNode_Bone::Handle bone(*iter);
-			encode_value_node_bone(node->add_child("value_node"),bone,canvas);
+			encode_value_node_bone(writer.begin("value_node"),bone,canvas);
+			writer.end();
 		}
+
+		writer.end_section();
 	}
 
 	// Output the <defs> section
@@ -1028,7 +1138,7 @@ xmlpp::Element* encode_canvas(xmlpp::Element* root,Canvas::ConstHandle canvas)
 
 	if((!canvas->is_inline() && !canvas->value_node_list().empty()) || !canvas->children().empty())
 	{
-		xmlpp::Element *node=root->add_child("defs");
+		writer.begin_section("defs");
 		const ValueNodeList &value_node_list(canvas->value_node_list());
 
 		for(ValueNodeList::const_iterator iter=value_node_list.begin();iter!=value_node_list.end();++iter)
@@ -1037,32 +1147,38 @@ xmlpp::Element* encode_canvas(xmlpp::Element* root,Canvas::ConstHandle canvas)
 			if(handle<ValueNode_Const>::cast_dynamic(*iter))
 			{
 				ValueNode_Const::Handle value_node(ValueNode_Const::Handle::cast_dynamic(*iter));
-				reinterpret_cast<xmlpp::Element*>(encode_value(node->add_child("value"),value_node->get_value(),canvas))->set_attribute("id",value_node->get_id());
+				reinterpret_cast<xmlpp::Element*>(encode_value(writer.begin("value"),value_node->get_value(),canvas))->set_attribute("id",value_node->get_id());
+				writer.end();
 				continue;
 			}
-			encode_value_node(node->add_child("value_node"),*iter,canvas);
+			encode_value_node(writer.begin("value_node"),*iter,canvas);
+			writer.end();
 			// writeme
 		}
 
 		for(Canvas::Children::const_iterator iter=canvas->children().begin();iter!=canvas->children().end();++iter)
 		{
-			encode_canvas(node->add_child("canvas"),*iter);
+			encode_canvas(writer.begin("canvas"),*iter);
+			writer.end();
 		}
+
+		writer.end_section();
 	}
 
 	Canvas::const_reverse_iterator iter;
 
 	for(iter=canvas->rbegin();iter!=canvas->rend();++iter)
-		encode_layer(root->add_child("layer"),*iter);
+		{ encode_layer(writer.begin("layer"),*iter); writer.end(); }
 
+	writer.finish();
 	return root;
 }
 
-xmlpp::Element* encode_canvas_toplevel(xmlpp::Element* root,Canvas::ConstHandle canvas)
+xmlpp::Element* encode_canvas_toplevel(xmlpp::Element* root,Canvas::ConstHandle canvas,std::ostream *stream = NULL)
 {
 	valuenode_too_new_count = 0;
 
-	xmlpp::Element* ret = encode_canvas(root, canvas);
+	xmlpp::Element* ret = encode_canvas(root, canvas, stream);
 
 	if (valuenode_too_new_count)
 		warning("saved %d valuenodes as constant values in old file format\n", valuenode_too_new_count);
@@ -1070,6 +1186,23 @@ xmlpp::Element* encode_canvas_toplevel(xmlpp::Element* root,Canvas::ConstHandle
 	return ret;
 }
 
+void
+encode_document(std::ostream &stream,Canvas::ConstHandle canvas)
+{
+	stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+	xmlpp::Document document;
+	encode_canvas_toplevel(document.create_root_node("canvas"),canvas,&stream);
+}
+
+static FileSystem::WriteStream::Handle
+open_write_stream(const FileSystem::Identifier &identifier, const String &filename)
+{
+	FileSystem::WriteStream::Handle stream = identifier.file_system->get_write_stream(filename);
+	if (stream && filename_extension(identifier.filename) == ".sifz")
+		stream = FileSystem::WriteStream::Handle(new ZWriteStream(stream));
+	return stream;
+}
+
 bool
 synfig::save_canvas(const FileSystem::Identifier &identifier, Canvas::ConstHandle canvas, bool safe)
 {
@@ -1080,21 +1213,16 @@ synfig::save_canvas(const FileSystem::Identifier &identifier, Canvas::ConstHandl
 	try
 	{
 		assert(canvas);
-		xmlpp::Document document;
 
-		encode_canvas_toplevel(document.create_root_node("canvas"),canvas);
-
-		FileSystem::WriteStream::Handle stream = identifier.file_system->get_write_stream(tmp_filename);
+		FileSystem::WriteStream::Handle stream = open_write_stream(identifier, tmp_filename);
 		if (!stream)
 		{
 			synfig::error("synfig::save_canvas(): Unable to open file for write");
 			return false;
 		}
 
-		if (filename_extension(identifier.filename) == ".sifz")
-			stream = FileSystem::WriteStream::Handle(new ZWriteStream(stream));
-
-		document.write_to_stream_formatted(*stream, "UTF-8");
+		// document is written while canvas is traversed
+		encode_document(*stream, canvas);
 
 		// close stream
 		stream.reset();
@@ -1119,11 +1247,15 @@ synfig::canvas_to_string(Canvas::ConstHandle canvas)
     ChangeLocale change_locale(LC_NUMERIC, "C");
 	assert(canvas);
 
-	xmlpp::Document document;
-
-	encode_canvas_toplevel(document.create_root_node("canvas"),canvas);
+	std::ostringstream stream;
+	encode_document(stream, canvas);
+	return stream.str();
+}
 
-	return document.write_to_string_formatted();
+FileSystem::WriteStream::Handle
+synfig::open_canvas_write_stream(const FileSystem::Identifier &identifier)
+{
+	return open_write_stream(identifier, identifier.filename);
 }
 
 void
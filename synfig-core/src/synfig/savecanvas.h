@@ -55,6 +55,11 @@ bool save_canvas(const FileSystem::Identifier &identifier, Canvas::ConstHandle c
 /*! \return The string with the XML canvas definition */
 String canvas_to_string(Canvas::ConstHandle canvas);
 
+//! Opens stream to save a canvas to \a identifier, data will be compressed for .sifz files.
+/*!	Allows to write string from canvas_to_string() in another thread
+**	while the canvas is edited, stream should be opened in the main thread */
+FileSystem::WriteStream::Handle open_canvas_write_stream(const FileSystem::Identifier &identifier);
+
 void set_save_canvas_external_file_callback(save_canvas_external_file_callback_t callback, void *user_data);
 
 void set_file_version(ReleaseVersion version);
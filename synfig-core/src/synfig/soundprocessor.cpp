@@ -30,11 +30,21 @@
 #endif
 
 #include <cmath>
+#include <cstring>
 
+#include <algorithm>
+#include <list>
+#include <map>
 #include <vector>
 
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glibmm/threads.h>
+
 #include <Mlt.h>
+#include <framework/mlt.h>
 
+#include "general.h"
 #include "soundprocessor.h"
 
 #endif
@@ -47,33 +57,300 @@ using namespace etl;
 
 /* === G L O B A L S ======================================================= */
 
+namespace {
+	// decoded sounds which are not used by any sound processor
+	// are removed from cache when they take more memory
+	const size_t max_unused_cache_size = 256*1024*1024;
+}
+
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+float get_sample(const void *data, mlt_audio_format format, int channels, int samples, int i, int c)
+{
+	switch(format) {
+	case mlt_audio_s16:   return (float)((const int16_t*)data)[i*channels + c]/32768.f;
+	case mlt_audio_s32:   return (float)((const int32_t*)data)[c*samples + i]/2147483648.f;
+	case mlt_audio_s32le: return (float)((const int32_t*)data)[i*channels + c]/2147483648.f;
+	case mlt_audio_float: return ((const float*)data)[c*samples + i];
+	case mlt_audio_f32le: return ((const float*)data)[i*channels + c];
+	default: break;
+	}
+	return 0.f;
+}
+
+int16_t to_int16(float x)
+	{ return (int16_t)round(std::max(-1.f, std::min(32767.f/32768.f, x))*32768.f); }
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
+//! Flat mixer: all sounds are decoded into memory and mixed by frames
+//! of special MLT producer, so seek of position costs nothing.
+//! Sounds are decoded by separate thread, and resampled to the output
+//! frequency while mixing, not yet decoded parts are silent.
 class SoundProcessor::Internal
 {
 public:
+	class Track {
+	public:
+		PCM::Handle pcm;
+		long long delay; // in samples
+		long long count; // in samples of output frequency
+		float volume;
+		Track(): delay(), count(), volume() { }
+	};
+
+	//! Opened file waiting for decoding
+	class Job {
+	public:
+		PCM::Handle pcm;
+		Mlt::Profile *profile;
+		Mlt::Producer *producer;
+		Job(): profile(), producer() { }
+	};
+
 	static bool initialized;
+	static Glib::Threads::Mutex cache_mutex;
+	static std::map<String, PCM::Handle> cache;
+
+	// decoding thread, guarded by cache_mutex
+	static Glib::Threads::Cond decode_cond;
+	static Glib::Threads::Thread *decode_thread;
+	static std::list<Job> decode_queue;
+	static bool decode_stopped;
+
 	std::vector<PlayOptions> stack;
 	Mlt::Profile profile;
-	Mlt::Producer *last_track;
+	Mlt::Producer *producer;
 	Mlt::Consumer *consumer;
 	bool playing;
-	Time position;
+
+	// tracks are read by thread of consumer
+	Glib::Threads::Mutex mutex;
+	std::vector<Track> tracks;
 
 	void clear() {
-		if (last_track != NULL) { delete last_track; last_track = NULL; }
 		if (consumer != NULL) { consumer->stop(); delete consumer; consumer = NULL; }
+		playing = false;
 		stack.clear();
 		stack.push_back(PlayOptions());
+		Glib::Threads::Mutex::Lock lock(mutex);
+		tracks.clear();
+		update_length();
+	}
+
+	Internal(): producer(), consumer(), playing() {
+		mlt_producer p = mlt_producer_new(profile.get_profile());
+		if (p) {
+			p->child = this;
+			p->get_frame = &get_frame;
+			producer = new Mlt::Producer(p);
+			mlt_producer_close(p);
+		}
+		clear();
+	}
+
+	~Internal() {
+		clear();
+		if (producer != NULL) delete producer;
+	}
+
+	//! sets length of producer by the longest track, call it under lock of mutex
+	void update_length() {
+		if (producer == NULL) return;
+		long long count = 0;
+		for(std::vector<Track>::const_iterator i = tracks.begin(); i != tracks.end(); ++i)
+			count = std::max(count, i->delay + i->count);
+		int length = std::max(1, (int)ceil((double)count*profile.fps()/frequency) + 1);
+		producer->set("length", length);
+		producer->set("out", length - 1);
+	}
+
+	//! mixes \a count samples starting from \a position into \a dst
+	void mix(float *dst, long long position, int count) {
+		std::fill(dst, dst + count*channels, 0.f);
+		Glib::Threads::Mutex::Lock lock(mutex);
+		for(std::vector<Track>::const_iterator i = tracks.begin(); i != tracks.end(); ++i) {
+			const PCM &pcm = *i->pcm;
+			long long ready = pcm.get_ready();
+			if (ready <= 0) continue;
+			long long begin = std::max(position, i->delay);
+			long long end = std::min(position + count, i->delay + i->count);
+			if (begin >= end) continue;
+
+			// linear resampling from the frequency of file
+			double k = (double)pcm.frequency/(double)frequency;
+			float *d = dst + (begin - position)*channels;
+			for(long long j = begin; j < end; ++j, d += channels) {
+				double x = (double)(j - i->delay)*k;
+				long long s0 = (long long)x;
+				if (s0 >= ready) break;
+				long long s1 = std::min(s0 + 1, ready - 1);
+				float f = (float)(x - (double)s0);
+				for(int c = 0; c < channels; ++c)
+					d[c] += (pcm.get_sample(s0, c)*(1.f - f) + pcm.get_sample(s1, c)*f)*i->volume;
+			}
+		}
 	}
 
-	Internal(): last_track(), consumer(), playing(), position(0.0) { clear(); }
-	~Internal() { clear(); }
+	static int get_frame(mlt_producer producer, mlt_frame_ptr frame, int /* index */) {
+		*frame = mlt_frame_init(MLT_PRODUCER_SERVICE(producer));
+		if (*frame) {
+			mlt_frame_set_position(*frame, mlt_producer_position(producer));
+			mlt_frame_push_audio(*frame, producer->child);
+			mlt_frame_push_audio(*frame, (void*)&get_audio);
+		}
+		mlt_producer_prepare_next(producer);
+		return 0;
+	}
+
+	static int get_audio(
+		mlt_frame frame, void **buffer, mlt_audio_format *format,
+		int *frequency, int *channels, int *samples )
+	{
+		Internal *internal = (Internal*)mlt_frame_pop_audio(frame);
+		mlt_position position = mlt_frame_get_position(frame);
+		float fps = (float)internal->profile.fps();
+
+		const int c = SoundProcessor::channels;
+		*frequency = SoundProcessor::frequency;
+		*channels = c;
+		*samples = mlt_sample_calculator(fps, *frequency, position);
+		int count = std::max(0, *samples);
+		vector<float> mixed(count*c + 1);
+		internal->mix(&mixed.front(), mlt_sample_calculator_to_now(fps, *frequency, position), count);
+
+		if (*format != mlt_audio_float && *format != mlt_audio_f32le)
+			*format = mlt_audio_s16;
+		int size = mlt_audio_format_size(*format, count, c);
+		*buffer = mlt_pool_alloc(size);
+		if (*format == mlt_audio_float) {
+			float *dst = (float*)*buffer;
+			for(int i = 0; i < count; ++i)
+				for(int j = 0; j < c; ++j)
+					dst[j*count + i] = mixed[i*c + j];
+		} else
+		if (*format == mlt_audio_f32le) {
+			memcpy(*buffer, &mixed.front(), count*c*sizeof(float));
+		} else {
+			int16_t *dst = (int16_t*)*buffer;
+			for(int i = 0; i < count*c; ++i)
+				dst[i] = (int16_t)round(std::max(-1.f, std::min(1.f, mixed[i]))*32767.f);
+		}
+		mlt_frame_set_audio(frame, *buffer, *format, size, mlt_pool_release);
+		return 0;
+	}
+
+	//! opens file and allocates samples by the frequency and length of file,
+	//! samples are decoded later by decoding thread
+	static bool open(const String &filename, Job &job) {
+		job.profile = new Mlt::Profile();
+		job.producer = new Mlt::Producer(*job.profile, (String("avformat:") + filename).c_str());
+		if (!job.producer->is_valid() || job.producer->get_producer() == NULL) {
+			close(job);
+			return false;
+		}
+
+		// use parameters of audio stream, so decoder will not resample it
+		int index = job.producer->get_int("audio_index");
+		int frequency = job.producer->get_int(strprintf("meta.media.%d.codec.sample_rate", index).c_str());
+		int channels = job.producer->get_int(strprintf("meta.media.%d.codec.channels", index).c_str());
+		if (index < 0) {
+			close(job);
+			return false;
+		}
+
+		job.pcm = new PCM();
+		job.pcm->frequency = frequency > 0 ? frequency : SoundProcessor::frequency;
+		job.pcm->channels = std::max(1, std::min(SoundProcessor::channels, channels));
+		job.pcm->count = std::max(0ll, (long long)mlt_sample_calculator_to_now(
+			(float)job.profile->fps(), job.pcm->frequency, job.producer->get_length() ));
+		job.pcm->samples.resize(job.pcm->count*job.pcm->channels);
+		return true;
+	}
+
+	static void close(Job &job) {
+		delete job.producer;
+		delete job.profile;
+		job.producer = NULL;
+		job.profile = NULL;
+	}
+
+	//! decodes samples of opened file
+	static void decode(Job &job) {
+		PCM &pcm = *job.pcm;
+		float fps = (float)job.profile->fps();
+		int length = job.producer->get_length();
+		long long position = 0;
+		for(int i = 0; i < length && position < pcm.count; ++i) {
+			{
+				Glib::Threads::Mutex::Lock lock(cache_mutex);
+				if (decode_stopped) break;
+			}
+
+			Mlt::Frame *frame = job.producer->get_frame();
+			if (!frame) break;
+
+			mlt_audio_format format = mlt_audio_s16;
+			int freq = pcm.frequency;
+			int c = pcm.channels;
+			int samples = mlt_sample_calculator(fps, freq, i);
+			const void *data = frame->get_audio(format, freq, c, samples);
+			if (data && samples > 0 && c > 0) {
+				int count = (int)std::min((long long)samples, pcm.count - position);
+				int16_t *dst = &pcm.samples[position*pcm.channels];
+				for(int j = 0; j < count; ++j)
+					for(int k = 0; k < pcm.channels; ++k)
+						*dst++ = format == mlt_audio_s16 && k < c
+							   ? ((const int16_t*)data)[j*c + k]
+							   : to_int16(get_sample(data, format, c, samples, j, std::min(k, c - 1)));
+				position += count;
+				pcm.ready = position;
+			}
+			delete frame;
+		}
+		// the rest of samples is silent
+		pcm.ready = pcm.count;
+	}
+
+	static void process() {
+		Glib::Threads::Mutex::Lock lock(cache_mutex);
+		while(true) {
+			if (decode_queue.empty()) {
+				if (decode_stopped) break;
+				decode_cond.wait(cache_mutex);
+				continue;
+			}
+
+			Job job = decode_queue.front();
+			decode_queue.pop_front();
+
+			bool stopped = decode_stopped;
+			lock.release();
+			if (!stopped)
+				decode(job);
+			close(job);
+			lock.acquire();
+
+			job.pcm->finished = true;
+			decode_cond.broadcast();
+		}
+	}
 };
 
 bool SoundProcessor::Internal::initialized = false;
+Glib::Threads::Mutex SoundProcessor::Internal::cache_mutex;
+std::map<String, SoundProcessor::PCM::Handle> SoundProcessor::Internal::cache;
+Glib::Threads::Cond SoundProcessor::Internal::decode_cond;
+Glib::Threads::Thread *SoundProcessor::Internal::decode_thread = NULL;
+std::list<SoundProcessor::Internal::Job> SoundProcessor::Internal::decode_queue;
+bool SoundProcessor::Internal::decode_stopped = false;
+
+const int SoundProcessor::frequency;
+const int SoundProcessor::channels;
 
 SoundProcessor::SoundProcessor()
 {
@@ -107,53 +384,24 @@ void SoundProcessor::addSound(const PlayOptions &playOptions, const Sound &sound
 			internal->stack.back().volume * playOptions.volume );
 	if (options.volume <= 0.0) return;
 
-	// Create track
-	String filename;
-	filename = String("avformat:")+sound.filename;
-	
-	Mlt::Producer *track = new Mlt::Producer(internal->profile, filename.c_str());
-	if (track->get_producer() == NULL) { delete track; return; }
-	int delay = (int)round(options.delay*internal->profile.fps());
-	if (-delay >= track->get_length()) { delete track; return; }
-	if (delay < 0) {
-		// cut
-		track->set_in_and_out(-delay, -1);
-	} else
-	if (delay > 0) {
-		Mlt::Playlist *playlist = new Mlt::Playlist();
-		playlist->blank(delay);
-		playlist->append(*track);
-		delete track;
-		track = playlist;
-	}
-
-	if (internal->last_track == NULL)
-		{ internal->last_track = track; return; }
-
-	set_position(0.0);
-
-	// Combine tracks
-	Mlt::Tractor *tractor = new Mlt::Tractor();
-
-	Mlt::Multitrack *multitrack = tractor->multitrack();
-	multitrack->connect(*internal->last_track, 0);
-	multitrack->connect(*track, 1);
-	delete multitrack;
-
-	Mlt::Transition transition(internal->profile, "mix");
-	transition.set("combine", 1);
-	Mlt::Field *field = tractor->field();
-	field->plant_transition(transition, 0, 1);
-	delete field;
-
-	delete internal->last_track;
-	internal->last_track = tractor;
+	// don't wait for decoding, not yet decoded parts will be silent
+	Internal::Track track;
+	track.pcm = decode(sound, false);
+	if (!track.pcm) return;
+	track.delay = (long long)round(options.delay*frequency);
+	track.count = (long long)ceil((double)track.pcm->get_count()*frequency/track.pcm->frequency);
+	track.volume = (float)options.volume;
+	if (-track.delay >= track.count) return;
+
+	Glib::Threads::Mutex::Lock lock(internal->mutex);
+	internal->tracks.push_back(track);
+	internal->update_length();
 }
 
 Time SoundProcessor::get_position() const
 {
-	return Time(internal->last_track == NULL ? 0.0 :
-				(double)internal->last_track->position()/internal->profile.fps() );
+	return Time(internal->producer == NULL ? 0.0 :
+				(double)internal->producer->position()/internal->profile.fps() );
 }
 
 void SoundProcessor::set_position(Time value)
@@ -161,10 +409,10 @@ void SoundProcessor::set_position(Time value)
 	Time dt = value - get_position();
 	if (dt >= Time(-0.01) && dt <= Time(0.01))
 		return;
-	if (internal->last_track != NULL) {
+	if (internal->producer != NULL) {
 		bool restart = internal->playing && internal->consumer;
 		if (restart) set_playing(false);
-		internal->last_track->seek( (int)round(value*internal->profile.fps()) );
+		internal->producer->seek( (int)round(value*internal->profile.fps()) );
 		if (restart) set_playing(true);
 	}
 }
@@ -177,10 +425,12 @@ void SoundProcessor::set_playing(bool value)
 	if (value == internal->playing) return;
 	internal->playing = value;
 	if (internal->playing) {
-		if (internal->last_track != NULL) {
-			internal->last_track->set_speed(1.0);
+		if (internal->producer != NULL && !internal->tracks.empty()) {
+			internal->producer->set_speed(1.0);
 			internal->consumer = new Mlt::Consumer(internal->profile, "sdl_audio");
-			internal->consumer->connect(*internal->last_track);
+			internal->consumer->set("frequency", frequency);
+			internal->consumer->set("channels", channels);
+			internal->consumer->connect(*internal->producer);
 			internal->consumer->start();
 		}
 	} else {
@@ -192,14 +442,92 @@ void SoundProcessor::set_playing(bool value)
 	}
 }
 
+SoundProcessor::PCM::Handle
+SoundProcessor::decode(const Sound &sound, bool wait)
+{
+	assert(Internal::initialized);
+
+	GStatBuf buf;
+	if (sound.filename.empty() || g_stat(sound.filename.c_str(), &buf))
+		return PCM::Handle();
+
+	PCM::Handle pcm;
+	{
+		Glib::Threads::Mutex::Lock lock(Internal::cache_mutex);
+		std::map<String, PCM::Handle>::const_iterator i = Internal::cache.find(sound.filename);
+		if ( i != Internal::cache.end()
+		  && i->second->size == (long long)buf.st_size
+		  && i->second->mtime == (long long)buf.st_mtime )
+			pcm = i->second;
+	}
+
+	if (!pcm) {
+		// open outside of lock, other sounds may be opened at the same time
+		Internal::Job job;
+		if (!Internal::open(sound.filename, job)) {
+			synfig::warning("SoundProcessor: cannot decode sound: %s", sound.filename.c_str());
+			return PCM::Handle();
+		}
+		pcm = job.pcm;
+		pcm->size = (long long)buf.st_size;
+		pcm->mtime = (long long)buf.st_mtime;
+
+		Glib::Threads::Mutex::Lock lock(Internal::cache_mutex);
+		if (!Internal::decode_thread || Internal::decode_stopped) {
+			Internal::close(job);
+			return PCM::Handle();
+		}
+		Internal::decode_queue.push_back(job);
+		Internal::decode_cond.broadcast();
+		Internal::cache[sound.filename] = pcm;
+
+		// remove unused sounds
+		size_t unused = 0;
+		for(std::map<String, PCM::Handle>::const_iterator i = Internal::cache.begin(); i != Internal::cache.end(); ++i)
+			if (i->second->count() == 1)
+				unused += i->second->samples.size()*sizeof(int16_t);
+		for(std::map<String, PCM::Handle>::iterator i = Internal::cache.begin(); unused > max_unused_cache_size && i != Internal::cache.end();)
+			if (i->second->count() == 1) {
+				unused -= i->second->samples.size()*sizeof(int16_t);
+				Internal::cache.erase(i++);
+			} else ++i;
+	}
+
+	if (wait) {
+		Glib::Threads::Mutex::Lock lock(Internal::cache_mutex);
+		while(!pcm->is_finished())
+			Internal::decode_cond.wait(Internal::cache_mutex);
+	}
+
+	return pcm;
+}
+
 bool SoundProcessor::subsys_init() {
 	if (!Internal::initialized)
 		Internal::initialized = Mlt::Factory::init();
+	if (Internal::initialized && !Internal::decode_thread) {
+		Internal::decode_stopped = false;
+		Internal::decode_thread = Glib::Threads::Thread::create(sigc::ptr_fun(&Internal::process));
+	}
 	return Internal::initialized;
 }
 
 bool SoundProcessor::subsys_stop()
-	{ return true; }
+{
+	if (Internal::decode_thread) {
+		{
+			Glib::Threads::Mutex::Lock lock(Internal::cache_mutex);
+			Internal::decode_stopped = true;
+			Internal::decode_cond.broadcast();
+		}
+		Internal::decode_thread->join();
+		Internal::decode_thread = NULL;
+	}
+
+	Glib::Threads::Mutex::Lock lock(Internal::cache_mutex);
+	Internal::cache.clear();
+	return true;
+}
 
 
 /* === E N T R Y P O I N T ================================================= */
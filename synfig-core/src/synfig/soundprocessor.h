@@ -28,8 +28,13 @@
 /* === H E A D E R S ======================================================= */
 
 #include <ETL/handle>
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <limits>
+#include <vector>
+
+#include <stdint.h>
 
 #include "time.h"
 #include "real.h"
@@ -63,6 +68,38 @@ public:
 		explicit Sound(const String &filename): filename(FileSystem::fix_slashes(filename)) { }
 	};
 
+	//! Decoded sound, interleaved 16-bit samples with the frequency
+	//! and count of channels of the file (up to SoundProcessor::channels).
+	//! Samples are allocated once when file is opened and then filled
+	//! by decoding thread, only first get_ready() samples may be read.
+	class PCM: public etl::shared_object {
+	public:
+		typedef etl::handle<PCM> Handle;
+		std::vector<int16_t> samples;
+		int frequency;
+		int channels;
+		//! count of samples per channel
+		long long count;
+		//! count of already decoded samples per channel
+		std::atomic<long long> ready;
+		std::atomic<bool> finished;
+		//! size and modification time of file, to detect changes
+		long long size;
+		long long mtime;
+
+		PCM(): frequency(), channels(), count(), ready(), finished(), size(), mtime() { }
+		long long get_count() const { return count; }
+		long long get_ready() const { return ready; }
+		bool is_finished() const { return finished; }
+		//! returns sample \a i of channel \a channel in range [-1, 1],
+		//! missing channels repeat the last one
+		float get_sample(long long i, int channel) const
+			{ return (float)samples[i*channels + std::min(channel, channels - 1)]*(1.f/32768.f); }
+	};
+
+	static const int frequency = 48000;
+	static const int channels = 2;
+
 private:
 	class Internal;
 	Internal *internal;
@@ -84,6 +121,11 @@ public:
 	bool get_playing() const;
 	void set_playing(bool value);
 
+	//! Opens the sound and decodes it in background, each file is decoded once
+	//! and shared by all sound processors. When \a wait is set, waits
+	//! until the whole file will be decoded. It's thread-safe.
+	static PCM::Handle decode(const Sound &sound, bool wait = true);
+
 	static bool subsys_init();
 	static bool subsys_stop();
 };
@@ -31,6 +31,9 @@
 #	include <config.h>
 #endif
 
+#include <deque>
+#include <algorithm>
+
 #include "target_scanline.h"
 
 #include "general.h"
@@ -65,14 +68,39 @@ using namespace rendering;
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+//! Frame which is currently rendering by Target_Scanline::render_frames_pipelined()
+struct FrameSlot
+{
+	int frame;
+	SurfaceResource::Handle surface;
+	TaskEvent::Handle event;
+
+	FrameSlot(): frame() { }
+};
+
+void
+cancel_frames(std::deque<FrameSlot> &pipeline)
+{
+	for(std::deque<FrameSlot>::const_iterator i = pipeline.begin(); i != pipeline.end(); ++i)
+		Renderer::cancel(i->event);
+	pipeline.clear();
+}
+
+} // end of anonimous namespace
+
 /* === M E T H O D S ======================================================= */
 
 Target_Scanline::Target_Scanline():
-	threads_(2)
+	threads_(2),
+	frame_workers_(1)
 {
 	curr_frame_=0;
 	if (const char *s = getenv("SYNFIG_TARGET_DEFAULT_ENGINE"))
 		set_engine(s);
+	if (const char *s = getenv("SYNFIG_TARGET_FRAME_WORKERS"))
+		set_frame_workers(atoi(s));
 }
 
 int
@@ -81,8 +109,8 @@ Target_Scanline::next_frame(Time& time)
 	return Target::next_frame(time);
 }
 
-bool
-synfig::Target_Scanline::call_renderer(Context &context, const etl::handle<rendering::SurfaceResource> &surface, int /* quality */, const RendDesc &renddesc, ProgressCallback * /* cb */)
+rendering::Task::Handle
+synfig::Target_Scanline::build_task(Context &context, const etl::handle<rendering::SurfaceResource> &surface, const RendDesc &renddesc)
 {
 	rendering::Task::Handle task;
 	surface->create(renddesc.get_w(), renddesc.get_h());
@@ -102,10 +130,6 @@ synfig::Target_Scanline::call_renderer(Context &context, const etl::handle<rende
 
 	if (task)
 	{
-		rendering::Renderer::Handle renderer = rendering::Renderer::get_renderer(get_engine());
-		if (!renderer)
-			throw "Renderer '" + get_engine() + "' not found";
-
 		Vector p0 = renddesc.get_tl();
 		Vector p1 = renddesc.get_br();
 		if (p0[0] > p1[0] || p0[1] > p1[1]) {
@@ -121,6 +145,19 @@ synfig::Target_Scanline::call_renderer(Context &context, const etl::handle<rende
 		task->target_surface = surface;
 		task->target_rect = RectInt( VectorInt(), surface->get_size() );
 		task->source_rect = Rect(p0, p1);
+	}
+	return task;
+}
+
+bool
+synfig::Target_Scanline::call_renderer(Context &context, const etl::handle<rendering::SurfaceResource> &surface, int /* quality */, const RendDesc &renddesc, ProgressCallback * /* cb */)
+{
+	rendering::Task::Handle task = build_task(context, surface, renddesc);
+	if (task)
+	{
+		rendering::Renderer::Handle renderer = rendering::Renderer::get_renderer(get_engine());
+		if (!renderer)
+			throw "Renderer '" + get_engine() + "' not found";
 
 		rendering::Task::List list;
 		list.push_back(task);
@@ -129,6 +166,103 @@ synfig::Target_Scanline::call_renderer(Context &context, const etl::handle<rende
 	return true;
 }
 
+bool
+synfig::Target_Scanline::render_frames_pipelined(ProgressCallback *cb, const ContextParams &context_params, int total_frames)
+{
+	rendering::Renderer::Handle renderer = rendering::Renderer::get_renderer(get_engine());
+	if (!renderer)
+		throw "Renderer '" + get_engine() + "' not found";
+
+	std::deque<FrameSlot> pipeline;
+	int frames = total_frames;
+	int workers = std::max(1, get_frame_workers());
+
+	try {
+		while(frames || !pipeline.empty())
+		{
+			// build next frames while there are free workers,
+			// canvas is shared, so frames are built one after another,
+			// but rendering of built frames goes simultaneously
+			while(frames && (int)pipeline.size() < workers)
+			{
+				Time t;
+				frames = next_frame(t);
+
+				// If we have a callback, and it returns
+				// false, go ahead and bail. (it may be a user cancel)
+				if(cb && !cb->amount_complete(total_frames-frames,total_frames))
+					{ cancel_frames(pipeline); return false; }
+
+				Context context = canvas->get_context(context_params);
+				context.set_render_method(SOFTWARE);
+
+				// Set the time that we wish to render
+				if(!get_avoid_time_sync() || canvas->get_time()!=t) {
+					canvas->set_time(t);
+					canvas->load_resources(t);
+				}
+				canvas->set_outline_grow(desc.get_outline_grow());
+
+				FrameSlot slot;
+				slot.frame = curr_frame_;
+				slot.surface = new SurfaceResource();
+				slot.event = new TaskEvent();
+
+				if (Task::Handle task = build_task(context, slot.surface, desc))
+					renderer->enqueue(task, slot.event);
+				else
+					slot.event->finish(true);
+				pipeline.push_back(slot);
+			}
+
+			// pass the oldest frame to the target,
+			// so target always receives frames in sequence
+			FrameSlot slot = pipeline.front();
+			pipeline.pop_front();
+			slot.event->wait();
+
+			if (!slot.event->is_done())
+			{
+				// For some reason, the accelerated renderer failed.
+				if(cb)cb->error(_("Accelerated Renderer Failure"));
+				cancel_frames(pipeline);
+				return false;
+			}
+
+			SurfaceResource::LockRead<SurfaceSW> lock(slot.surface);
+			if(!lock)
+			{
+				if(cb)cb->error(_("Bad surface"));
+				cancel_frames(pipeline);
+				return false;
+			}
+
+			// target may check the current frame number while writing,
+			// so temporary set it to the number of frame which passed to target
+			int built_frame = curr_frame_;
+			curr_frame_ = slot.frame;
+			bool success = add_frame(&lock->get_surface());
+			curr_frame_ = built_frame;
+
+			// Put the surface we renderer
+			// onto the target.
+			if(!success)
+			{
+				if(cb)cb->error(_("Unable to put surface on target"));
+				cancel_frames(pipeline);
+				return false;
+			}
+		}
+	}
+	catch(...)
+	{
+		cancel_frames(pipeline);
+		throw;
+	}
+
+	return true;
+}
+
 bool
 synfig::Target_Scanline::render(ProgressCallback *cb)
 {
@@ -163,7 +297,18 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 
 	//synfig::info("1time_set_to %s",t.get_string().c_str());
 
-	if(total_frames>=1)
+	bool pipelined = total_frames>1 && get_frame_workers()>1;
+	#if USE_PIXELRENDERING_LIMIT
+	// frames which are split to blocks are not pipelined
+	if(desc.get_w()*desc.get_h() > PIXEL_RENDERING_LIMIT)
+		pipelined = false;
+	#endif
+
+	if(pipelined)
+	{
+		return render_frames_pipelined(cb, context_params, total_frames);
+	}
+	else if(total_frames>=1)
 	{
 		do{
 			// Grab the time
@@ -38,7 +38,7 @@
 
 namespace synfig {
 
-namespace rendering { class SurfaceResource; }
+namespace rendering { class SurfaceResource; class Task; }
 
 /*!	\class Target_Scanline
 **	\brief This is a Target class that implements the render function
@@ -49,10 +49,20 @@ class Target_Scanline : public Target
 	//! Number of threads to use
 	int threads_;
 
+	//! Number of frames which may be rendered simultaneously
+	int frame_workers_;
+
 	String engine_;
 
+	etl::handle<rendering::Task> build_task(Context &context, const etl::handle<rendering::SurfaceResource> &surface, const RendDesc &renddesc);
 	bool call_renderer(Context &context, const etl::handle<rendering::SurfaceResource> &surface, int quality, const RendDesc &renddesc, ProgressCallback *cb);
 
+	//! Renders the animation keeping up to get_frame_workers() frames in the rendering queue
+	/*! Frames are built one after another (canvas time is shared),
+	**	rendered simultaneously and passed to the target in sequence.
+	*/
+	bool render_frames_pipelined(ProgressCallback *cb, const ContextParams &context_params, int total_frames);
+
 public:
 	typedef etl::handle<Target_Scanline> Handle;
 	typedef etl::loose_handle<Target_Scanline> LooseHandle;
@@ -98,6 +108,10 @@ public:
 	void set_threads(int x) { threads_=x; }
 	//! Gets the number of threads
 	int get_threads()const { return threads_; }
+	//! Sets the number of frames which may be rendered simultaneously
+	void set_frame_workers(int x) { frame_workers_=x; }
+	//! Gets the number of frames which may be rendered simultaneously
+	int get_frame_workers()const { return frame_workers_; }
 	//! Gets engine
 	const String& get_engine()const { return engine_; }
 	//! Sets engine
@@ -45,12 +45,17 @@ struct TargetParam
 	 *  its own valid default settings.
 	 */
 	TargetParam (const std::string& Video_codec = "none", int Bitrate = -1):
-		video_codec(Video_codec), bitrate(Bitrate), sequence_separator("."), offset_x(0), offset_y(0),rows(0),columns(0),append(true),dir(HR)
+		video_codec(Video_codec), bitrate(Bitrate), sequence_separator("."), compression(-1), offset_x(0), offset_y(0),rows(0),columns(0),append(true),dir(HR)
 	{ }
 
 	std::string video_codec;
 	int bitrate;
 	std::string sequence_separator;
+	//! Compression level of image targets (0-9), -1 means default of target
+	int compression;
+	//! Filter of PNG encoder: "none", "sub", "up", "avg", "paeth" or "all",
+	//! empty string means default of target
+	std::string filter;
 	//TODO: It is a spike. Need to separate this class.
 	int offset_x;
 	int offset_y;
@@ -53,6 +53,14 @@ using namespace synfig;
 
 /* === G L O B A L S ======================================================= */
 
+namespace {
+	//! index of queue of current thread of pool, -1 for other threads
+	thread_local int current_worker = -1;
+	//! set for threads of pool and for the thread which created the pool,
+	//! only these threads are counted in ThreadPool::running_threads
+	thread_local bool counted_thread = false;
+}
+
 /* === M E T H O D S ======================================================= */
 
 ThreadPool ThreadPool::instance;
@@ -60,18 +68,45 @@ ThreadPool ThreadPool::instance;
 
 // ThreadPool::Group
 
+//! Tasks of group splitted into chunks, chunks are processed by the caller and by threads of pool,
+//! each thread takes the next unprocessed chunk, so the caller never waits for
+//! the threads which was not started yet
+class ThreadPool::Group::Work: public etl::shared_object {
+public:
+	List tasks;
+	std::vector<int> chunks; //!< index of the first task of each chunk and the end index
+	std::atomic<int> next_chunk;
+	std::atomic<int> done_chunks;
+	Glib::Threads::Mutex mutex;
+	Glib::Threads::Cond cond;
+
+	Work(): next_chunk(0), done_chunks(0) { }
+
+	int get_chunks_count() const
+		{ return (int)chunks.size() - 1; }
+
+	bool process_chunk() {
+		int index = next_chunk++;
+		if (index >= get_chunks_count())
+			return false;
+		for(int i = chunks[index]; i < chunks[index + 1]; ++i)
+			try { tasks[i].second(); } catch(...) { }
+		if (++done_chunks == get_chunks_count())
+			{ Glib::Threads::Mutex::Lock lock(mutex); cond.signal(); }
+		return true;
+	}
+};
+
 ThreadPool::Group::Group():
-	multithreading(), running_threads(0), sum_weight() { }
+	sum_weight() { }
 
 ThreadPool::Group::~Group()
 	{ run(); }
 
 void
-ThreadPool::Group::process(int begin, int end) {
-	for(int i = begin; i < end; ++i)
-		try { tasks[i].second(); } catch(...) { }
-	Glib::Threads::Mutex::Lock lock(mutex);
-	if (!--running_threads) cond.signal();
+ThreadPool::Group::process(etl::handle<Work> work) {
+	while(work->process_chunk())
+		++instance.stolen_chunks;
 }
 
 void
@@ -83,48 +118,45 @@ ThreadPool::Group::enqueue(const Slot &slot, Real weight) {
 
 void
 ThreadPool::Group::run(bool force_thread) {
-	// enqueue parallel tasks
-	Real sum = 0.0;
-	int begin = 0;
-	int end = 0;
+	if (tasks.empty()) return;
+
+	etl::handle<Work> work(new Work());
+	work->tasks.swap(tasks);
 
-	for(int i = 0; i < (int)tasks.size(); ++i) {
-		end = i + 1;
-		sum += tasks[i].first;
+	// split tasks into chunks with weight about 1.0
+	Real sum = 0.0;
+	work->chunks.push_back(0);
+	for(int i = 0; i < (int)work->tasks.size(); ++i) {
+		sum += work->tasks[i].first;
 		if (sum_weight - sum < 0.75) break;
 		if (sum >= 0.75) {
-			multithreading = true;
-			++running_threads;
-			instance.enqueue( sigc::bind( sigc::mem_fun(this, &Group::process), begin, end ));
+			work->chunks.push_back(i + 1);
 			sum_weight -= sum;
 			sum = 0.0;
-			begin = end;
 		}
 	}
-	end = (int)tasks.size();
+	if (work->chunks.back() < (int)work->tasks.size())
+		work->chunks.push_back((int)work->tasks.size());
+	sum_weight = 0.0;
 
-	// run in current thread
-	if (begin < end) {
-		if (force_thread) {
-			multithreading = true;
-			++running_threads;
-			instance.enqueue( sigc::bind( sigc::mem_fun(this, &Group::process), begin, end ));
-		} else {
-			for(int i = begin; i < end; ++i)
-				try { tasks[i].second(); } catch(...) { }
-		}
+	int count = work->get_chunks_count();
+	if (count <= 1 && !force_thread) {
+		// run in current thread
+		work->process_chunk();
+		return;
 	}
 
-	// wait
-	if (multithreading) {
-		Glib::Threads::Mutex::Lock lock(mutex);
-		while(running_threads > 0) instance.wait(cond, mutex);
-	}
+	// the caller processes chunks too, so it needs one helper less
+	int helpers = std::min(force_thread ? count : count - 1, instance.get_max_threads());
+	for(int i = 0; i < helpers; ++i)
+		instance.enqueue( sigc::bind( sigc::ptr_fun(&Group::process), work ));
 
-	// reset
-	multithreading = false;
-	tasks.clear();
-	sum_weight = 0.0;
+	if (!force_thread)
+		while(work->process_chunk()) { }
+
+	// wait for chunks in process
+	Glib::Threads::Mutex::Lock lock(work->mutex);
+	while(work->done_chunks < count) instance.wait(work->cond, work->mutex);
 }
 
 
@@ -134,11 +166,19 @@ ThreadPool::ThreadPool():
 	max_running_threads(0),
 	running_threads(0),
 	ready_threads(0),
+	queue_size(0),
+	next_worker(0),
+	stolen_chunks(0),
+	stats_tasks(0),
+	stats_steals(0),
+	stats_idle_time(0),
+	stats_max_queue_depth(0),
 	stopped(false)
 {
-	max_running_threads = g_get_num_processors();
-	if (max_running_threads < 1) max_running_threads = 1;
-	if (max_running_threads > 2) --max_running_threads;
+	int count = g_get_num_processors();
+	if (count > 2) --count;
+	set_max_threads(count);
+	counted_thread = true;
 	++running_threads;
 }
 
@@ -147,6 +187,12 @@ ThreadPool::ThreadPool(const ThreadPool&):
 	running_threads(0),
 	ready_threads(0),
 	queue_size(0),
+	next_worker(0),
+	stolen_chunks(0),
+	stats_tasks(0),
+	stats_steals(0),
+	stats_idle_time(0),
+	stats_max_queue_depth(0),
 	stopped(false) { }
 
 ThreadPool::~ThreadPool() {
@@ -166,14 +212,81 @@ ThreadPool::~ThreadPool() {
 		}
 		thread->join();
 	}
+
+	for(std::vector<Worker*>::iterator i = workers.begin(); i != workers.end(); ++i)
+		delete *i;
+	workers.clear();
 }
 
 void
-ThreadPool::thread_loop(int
-	#ifdef DEBUG_PTHREAD_MEASURE
-	index
-	#endif
-) {
+ThreadPool::set_max_threads(int count) {
+	Glib::Threads::Mutex::Lock lock(mutex);
+	max_running_threads = std::max(1, count);
+
+	// queues cannot be removed while threads may access them,
+	// otherwise threads will share the queues
+	if (!threads.empty() || queue_size) return;
+	while((int)workers.size() > max_running_threads)
+		{ delete workers.back(); workers.pop_back(); }
+	while((int)workers.size() < max_running_threads)
+		workers.push_back(new Worker());
+}
+
+void
+ThreadPool::push(const Slot &slot) {
+	// slot enqueued by the thread of pool probably uses the same data,
+	// so keep it in the queue of this thread
+	int count = (int)workers.size();
+	Worker &worker = current_worker >= 0
+		           ? *workers[current_worker % count]
+		           : *workers[(unsigned int)(next_worker++) % count];
+	{
+		Glib::Threads::Mutex::Lock lock(worker.mutex);
+		worker.queue.push_back(slot);
+	}
+
+	int depth = ++queue_size;
+	int max_depth = stats_max_queue_depth;
+	while(depth > max_depth && !stats_max_queue_depth.compare_exchange_weak(max_depth, depth)) { }
+}
+
+bool
+ThreadPool::pop(Slot &slot) {
+	int count = (int)workers.size();
+	int own = current_worker % count;
+
+	// take the last slot from own queue
+	{
+		Worker &worker = *workers[own];
+		Glib::Threads::Mutex::Lock lock(worker.mutex);
+		if (!worker.queue.empty()) {
+			slot = worker.queue.back();
+			worker.queue.pop_back();
+			--queue_size;
+			return true;
+		}
+	}
+
+	// steal the first slot from other threads
+	for(int i = 1; i < count; ++i) {
+		Worker &worker = *workers[(own + i) % count];
+		Glib::Threads::Mutex::Lock lock(worker.mutex);
+		if (!worker.queue.empty()) {
+			slot = worker.queue.front();
+			worker.queue.pop_front();
+			--queue_size;
+			++stats_steals;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+ThreadPool::thread_loop(int index) {
+	current_worker = index;
+	counted_thread = true;
 	++running_threads;
 
 	#ifdef DEBUG_PTHREAD_MEASURE
@@ -185,21 +298,23 @@ ThreadPool::thread_loop(int
 
 	while(true) {
 		Slot slot;
-		{
+		if (running_threads > max_running_threads || !pop(slot)) {
 			Glib::Threads::Mutex::Lock lock(mutex);
-			while(queue.empty() || running_threads > max_running_threads) {
-				if (stopped) return;
-				++ready_threads;
-				--running_threads;
-				cond.wait(mutex);
-				++running_threads;
-				--ready_threads;
-			}
-			slot = queue.front();
-			queue.pop();
-			--queue_size;
+			if (stopped) break;
+			// slot may be added while we tried to pop, see enqueue()
+			if (queue_size > 0 && running_threads <= max_running_threads) continue;
+			++ready_threads;
+			--running_threads;
+			gint64 time = g_get_monotonic_time();
+			cond.wait(mutex);
+			stats_idle_time += g_get_monotonic_time() - time;
+			++running_threads;
+			--ready_threads;
+			continue;
 		}
 
+		++stats_tasks;
+
 		#ifdef DEBUG_PTHREAD_MEASURE
 		struct timespec spec;
 		clock_gettime(clock_id, &spec);
@@ -249,17 +364,33 @@ ThreadPool::wakeup() {
 
 void
 ThreadPool::enqueue(const Slot &slot) {
+	push(slot);
 	Glib::Threads::Mutex::Lock lock(mutex);
-	++queue_size;
-	queue.push(slot);
 	wakeup();
 }
 
 void
 ThreadPool::wait(Glib::Threads::Cond &cond, Glib::Threads::Mutex &mutex) {
+	// other threads are not counted as running, so waiting doesn't release their place
+	if (!counted_thread) {
+		cond.wait(mutex);
+		return;
+	}
+
 	if (--running_threads < max_running_threads)
 		if (queue_size) // wakeup or create ready thread if we have tasks in queue
 			{ Glib::Threads::Mutex::Lock lock(this->mutex); wakeup(); }
 	cond.wait(mutex);
 	++running_threads;
 }
+
+ThreadPool::Stats
+ThreadPool::get_stats() const {
+	Stats stats;
+	stats.tasks = stats_tasks;
+	stats.steals = stats_steals;
+	stats.idle_time = stats_idle_time;
+	stats.queue_depth = queue_size;
+	stats.max_queue_depth = stats_max_queue_depth;
+	return stats;
+}
@@ -28,9 +28,11 @@
 /* === H E A D E R S ======================================================= */
 
 #include <atomic>
-#include <queue>
+#include <deque>
+#include <vector>
 
 #include <sigc++/signal.h>
+#include <ETL/handle>
 #include <glibmm/threads.h>
 
 #include "real.h"
@@ -53,15 +55,12 @@ public:
 	typedef std::vector<Entry> List;
 
 	private:
-		bool multithreading;
-		std::atomic<int> running_threads;
-		Glib::Threads::Mutex mutex;
-		Glib::Threads::Cond cond;
+		class Work;
 
 		List tasks;
 		Real sum_weight;
 
-		void process(int begin, int end);
+		static void process(etl::handle<Work> work);
 	public:
 		Group();
 		~Group();
@@ -70,19 +69,45 @@ public:
 		void run(bool force_thread = false);
 	};
 
+	struct Stats {
+		long long tasks;      //!< count of processed slots
+		long long steals;     //!< count of slots taken from queues of other threads
+		long long idle_time;  //!< summary time of waiting of all threads, in microseconds
+		int queue_depth;      //!< current count of queued slots
+		int max_queue_depth;  //!< max count of queued slots
+
+		Stats(): tasks(), steals(), idle_time(), queue_depth(), max_queue_depth() { }
+	};
+
 private:
+	//! Each thread has own queue, thread takes the last added slot from own queue
+	//! (it's probably uses the data which are still in the CPU cache),
+	//! and steals the first slot from queues of other threads when own queue is empty.
+	struct Worker {
+		Glib::Threads::Mutex mutex;
+		std::deque<Slot> queue;
+	};
+
 	Glib::Threads::Mutex mutex;
 	Glib::Threads::Cond cond;
 	int max_running_threads;
 	std::atomic<int> running_threads;
 	std::atomic<int> ready_threads;
 	std::atomic<int> queue_size;
-	std::queue<Slot> queue;
+	std::atomic<int> next_worker;
+	std::atomic<long long> stolen_chunks;
+	std::atomic<long long> stats_tasks;
+	std::atomic<long long> stats_steals;
+	std::atomic<long long> stats_idle_time;
+	std::atomic<int> stats_max_queue_depth;
+	std::vector<Worker*> workers;
 	std::vector<Glib::Threads::Thread*> threads;
 	bool stopped;
 
 	void thread_loop(int index);
 	void wakeup();
+	void push(const Slot &slot);
+	bool pop(Slot &slot);
 
 	ThreadPool();
 	ThreadPool(const ThreadPool&);
@@ -92,15 +117,30 @@ public:
 
 	~ThreadPool();
 
+	//! adds slot to the queue of current thread of pool,
+	//! or to the queue of one of threads when called from outside of pool
 	void enqueue(const Slot &slot);
+	//! waits for condition, when called from thread of pool (or from the thread
+	//! which created the pool) other thread of pool may run while this one waits
 	void wait(Glib::Threads::Cond &cond, Glib::Threads::Mutex &mutex);
 
+	//! changes count of simultaneously running threads,
+	//! should be called before any slot was enqueued
+	void set_max_threads(int count);
+
 	int get_max_threads() const
 		{ return max_running_threads; }
 	int get_running_threads() const
 		{ return running_threads; }
 	int get_queue_size() const
 		{ return queue_size + running_threads; }
+	//! count of parts of groups which was processed by threads of pool, not by caller
+	long long get_stolen_chunks() const
+		{ return stolen_chunks; }
+	//! summary time of waiting of threads of pool, in microseconds
+	long long get_idle_time() const
+		{ return stats_idle_time; }
+	Stats get_stats() const;
 };
 
 }; // END of namespace synfig
@@ -285,6 +285,9 @@ public:
 
 class synfig::ValueNode_AnimatedInterfaceConst::Internal {
 public:
+	static bool less_than_waypoint(const Time &t, const Waypoint &waypoint)
+		{ return t < waypoint.get_time(); }
+
 	template<typename T>
 	static T pass(const T &x) { return x; }
 	
@@ -343,6 +346,52 @@ public:
 		typedef vector<PathSegment> curve_list_type;
 		curve_list_type curve_list;
 
+		//! Parameters of waypoint used to compile segments,
+		//! segments are recompiled only around changed waypoints
+		struct WaypointKey
+		{
+			bool is_static;
+			Real time;
+			Waypoint::Interpolation before;
+			Waypoint::Interpolation after;
+			Real tension;
+			Real continuity;
+			Real bias;
+			Real temporal_tension;
+			ValueBase value;
+
+			explicit WaypointKey(const Waypoint &waypoint):
+				is_static(waypoint.is_static()),
+				time(waypoint.get_time()),
+				before(waypoint.get_before()),
+				after(waypoint.get_after()),
+				tension(waypoint.get_tension()),
+				continuity(waypoint.get_continuity()),
+				bias(waypoint.get_bias()),
+				temporal_tension(waypoint.get_temporal_tension())
+			{
+				if (is_static) value = waypoint.get_value();
+			}
+
+			// non-static waypoints are always treated as changed
+			bool operator==(const WaypointKey &other) const
+			{
+				return is_static && other.is_static
+					&& time == other.time
+					&& before == other.before
+					&& after == other.after
+					&& tension == other.tension
+					&& continuity == other.continuity
+					&& bias == other.bias
+					&& temporal_tension == other.temporal_tension
+					&& value == other.value;
+			}
+		};
+		std::vector<WaypointKey> keys;
+
+		static bool less_than_segment_end(const Time &t, const PathSegment &segment)
+			{ return t < segment.first.get_s(); }
+
 		// Bounds of this curve
 		Time r,s;
 
@@ -395,257 +444,308 @@ public:
 			return ret;
 		}
 
-		virtual void on_changed()
+		//! Compiles segment between waypoints \a i and \a i+1,
+		//! segment \a i-1 must be already compiled
+		void compile_segment(int i)
 		{
-			if (getenv("SYNFIG_DEBUG_ON_CHANGED"))
-				printf("%s:%d _Hermite::on_changed()\n", __FILE__, __LINE__);
+			WaypointList::iterator iter = animated.waypoint_list_.begin() + i;
+			WaypointList::iterator next = iter + 1;
+			WaypointList::iterator after_next = next + 1;
+
+			typename curve_list_type::value_type curve;
+			curve.start=iter;
+			curve.end=next;
+
+			// Set up the positions
+			curve.first.set_rs(iter->get_time(), next->get_time());
+			curve.second.set_rs(iter->get_time(), next->get_time());
+			// Retrieve the interpolations
+			Waypoint::Interpolation iter_get_after(iter->get_after());
+			Waypoint::Interpolation next_get_after(next->get_after());
+			Waypoint::Interpolation iter_get_before(iter->get_before());
+			Waypoint::Interpolation next_get_before(next->get_before());
 
-			if(animated.waypoint_list_.size()<=1)
-				return;
-			std::sort(animated.waypoint_list_.begin(), animated.waypoint_list_.end());
-
-			r=animated.waypoint_list_.front().get_time();
-			s=animated.waypoint_list_.back().get_time();
-
-			curve_list.clear();
+			if(is_angle())
+			{
+				if(iter_get_after==INTERPOLATION_TCB)
+					iter_get_after=INTERPOLATION_LINEAR;
+				if(next_get_after==INTERPOLATION_TCB)
+					next_get_after=INTERPOLATION_LINEAR;
+				if(iter_get_before==INTERPOLATION_TCB)
+					iter_get_before=INTERPOLATION_LINEAR;
+				if(next_get_before==INTERPOLATION_TCB)
+					next_get_before=INTERPOLATION_LINEAR;
+			}
 
-			WaypointList::iterator prev,iter,next=animated.waypoint_list_.begin();
-			int i=0;
-			// The curve list must be calculated because we sorted the waypoints.
-			for(iter=next++;iter!=animated.waypoint_list_.end() && next!=animated.waypoint_list_.end();prev=iter,iter=next++,i++)
+			if(iter->is_static() && next->is_static())
 			{
-				typename curve_list_type::value_type curve;
-				WaypointList::iterator after_next(next);
-				++after_next;
-
-				curve.start=iter;
-				curve.end=next;
-
-				// Set up the positions
-				curve.first.set_rs(iter->get_time(), next->get_time());
-				curve.second.set_rs(iter->get_time(), next->get_time());
-				// Retrieve the interpolations
-				Waypoint::Interpolation iter_get_after(iter->get_after());
-				Waypoint::Interpolation next_get_after(next->get_after());
-				Waypoint::Interpolation iter_get_before(iter->get_before());
-				Waypoint::Interpolation next_get_before(next->get_before());
-
-				if(is_angle())
+				curve.second.p1()=iter->get_value().get(T());
+				curve.second.p2()=next->get_value().get(T());
+				///
+				/// ANY/CONSTANT ------ ANY/ANY
+				///               or
+				/// ANY/ANY-------------CONSTANT/ANY
+				///
+				if(iter_get_after==INTERPOLATION_CONSTANT || next_get_before==INTERPOLATION_CONSTANT)
 				{
-					if(iter_get_after==INTERPOLATION_TCB)
-						iter_get_after=INTERPOLATION_LINEAR;
-					if(next_get_after==INTERPOLATION_TCB)
-						next_get_after=INTERPOLATION_LINEAR;
-					if(iter_get_before==INTERPOLATION_TCB)
-						iter_get_before=INTERPOLATION_LINEAR;
-					if(next_get_before==INTERPOLATION_TCB)
-						next_get_before=INTERPOLATION_LINEAR;
+					// Sections must be constant on both sides.
+					// NOTE: this is commented out because of some
+					// user interface issues. Namely, if a section is
+					// constant and the user turns off the constant on
+					// one waypoint, this will end up turning it back on.
+					// Confusing.
+					//iter->get_after()=next->get_before()=INTERPOLATION_CONSTANT;
+					curve.second.p1()=
+					curve.second.p2()=iter->get_value().get(T());
+					curve.second.t1()=
+					curve.second.t2()=subtract_func(curve.second.p1(),curve.second.p2());
 				}
-
-				if(iter->is_static() && next->is_static())
+				else
 				{
-					curve.second.p1()=iter->get_value().get(T());
-					curve.second.p2()=next->get_value().get(T());
-					///
-					/// ANY/CONSTANT ------ ANY/ANY
-					///               or
-					/// ANY/ANY-------------CONSTANT/ANY
+					/// iter             next
+					/// ANY/TCB -------- ANY/ANY and iter is middle waypoint
 					///
-					if(iter_get_after==INTERPOLATION_CONSTANT || next_get_before==INTERPOLATION_CONSTANT)
+				    if(iter_get_after==INTERPOLATION_TCB && iter!=animated.waypoint_list_.begin() && !is_angle())
 					{
-						// Sections must be constant on both sides.
-						// NOTE: this is commented out because of some
-						// user interface issues. Namely, if a section is
-						// constant and the user turns off the constant on
-						// one waypoint, this will end up turning it back on.
-						// Confusing.
-						//iter->get_after()=next->get_before()=INTERPOLATION_CONSTANT;
-						curve.second.p1()=
-						curve.second.p2()=iter->get_value().get(T());
-						curve.second.t1()=
-						curve.second.t2()=subtract_func(curve.second.p1(),curve.second.p2());
-					}
-					else
-					{
-						/// iter             next
-						/// ANY/TCB -------- ANY/ANY and iter is middle waypoint
-						///
-					    if(iter_get_after==INTERPOLATION_TCB && iter!=animated.waypoint_list_.begin() && !is_angle())
+						if(iter->get_before()!=INTERPOLATION_TCB && i > 0)
 						{
-							if(iter->get_before()!=INTERPOLATION_TCB && !curve_list.empty())
-							{
-								curve.second.t1()=curve_list.back().second.t2();
-							}
-							else
-							{
-								const Real& t(iter->get_tension());		// Tension
-								const Real& c(iter->get_continuity());	// Continuity
-								const Real& b(iter->get_bias());		// Bias
-								// The following line works where the previous line fails.
-								value_type Pp; Pp=curve_list.back().second.p1();	// P_{i-1}
-								const value_type& Pc(curve.second.p1());	// P_i
-								const value_type& Pn(curve.second.p2());	// P_{i+1}
-
-								/// TCB calculation
-								value_type vect(static_cast<value_type>
-												(subtract_func(Pc,Pp) *
-												           (((1.0-t) * (1.0+c) * (1.0+b)) / 2.0) +
-												 (Pn-Pc) * (((1.0-t) * (1.0-c) * (1.0-b)) / 2.0)));
-								curve.second.t1()=vect;
-							}
+							curve.second.t1()=curve_list[i-1].second.t2();
 						}
 						else
 						{
-							///
-							/// ANY/LINEAR ----- ANY/ANY
-							///            or
-							/// ANY/EASE ------- ANY/ANY
-							///            or
-							/// ANY/TCB -------- ANY/ANY and iter is first.
-							///            or
-							/// ANY/CLAMPED ---- ANT/ANY and iter is first
-						    if(
-							iter_get_after==INTERPOLATION_LINEAR || iter_get_after==INTERPOLATION_HALT ||
-							(iter_get_after==INTERPOLATION_TCB && iter==animated.waypoint_list_.begin()) ||
-							(iter_get_after==INTERPOLATION_CLAMPED && iter==animated.waypoint_list_.begin())
-							)
-							{
-								/// t1 = p2 - p1
-								curve.second.t1()=subtract_func(curve.second.p2(),curve.second.p1());
-							}
-						}
-						/// iter             next
-						/// ANY/CLAMPED ---- ANY/ANY and iter is middle waypoint
-						if(iter_get_after == INTERPOLATION_CLAMPED && iter!=animated.waypoint_list_.begin() && !is_angle())
-						{
-							value_type Pp; Pp=curve_list.back().second.p1(); // P_{i-1}
-							const value_type& Pc(curve.second.p1());         // P_i
-							const value_type& Pn(curve.second.p2());         // P_{i+1}
-							Time T1(curve_list.back().first.p1());
-							Time T2(iter->get_time());
-							Time T3(next->get_time());
-							value_type vect(clamped_tangent(Pp, Pc, Pn, T1, T2, T3));
+							const Real& t(iter->get_tension());		// Tension
+							const Real& c(iter->get_continuity());	// Continuity
+							const Real& b(iter->get_bias());		// Bias
+							// The following line works where the previous line fails.
+							value_type Pp; Pp=curve_list[i-1].second.p1();	// P_{i-1}
+							const value_type& Pc(curve.second.p1());	// P_i
+							const value_type& Pn(curve.second.p2());	// P_{i+1}
+
+							/// TCB calculation
+							value_type vect(static_cast<value_type>
+											(subtract_func(Pc,Pp) *
+											           (((1.0-t) * (1.0+c) * (1.0+b)) / 2.0) +
+											 (Pn-Pc) * (((1.0-t) * (1.0-c) * (1.0-b)) / 2.0)));
 							curve.second.t1()=vect;
 						}
+					}
+					else
+					{
 						///
-						/// TCB/!TCB and list not empty
-						///
-						if(iter_get_before==INTERPOLATION_TCB && iter->get_after()!=INTERPOLATION_TCB && !curve_list.empty())
+						/// ANY/LINEAR ----- ANY/ANY
+						///            or
+						/// ANY/EASE ------- ANY/ANY
+						///            or
+						/// ANY/TCB -------- ANY/ANY and iter is first.
+						///            or
+						/// ANY/CLAMPED ---- ANT/ANY and iter is first
+					    if(
+						iter_get_after==INTERPOLATION_LINEAR || iter_get_after==INTERPOLATION_HALT ||
+						(iter_get_after==INTERPOLATION_TCB && iter==animated.waypoint_list_.begin()) ||
+						(iter_get_after==INTERPOLATION_CLAMPED && iter==animated.waypoint_list_.begin())
+						)
 						{
-							/// It means that there is one previous waypoint
-							/// that is at cuerve_list.back()
-							/// then its second tangent must be the same than
-							/// our first one for continuity of the tangents.
-							curve_list.back().second.t2()=curve.second.t1();
-							curve_list.back().second.sync();
+							/// t1 = p2 - p1
+							curve.second.t1()=subtract_func(curve.second.p2(),curve.second.p1());
 						}
-						/// iter          next          after_next
-						/// ANY/ANY ------TCB/ANY ----- ANY/ANY
-						///
-						if(next_get_before==INTERPOLATION_TCB && after_next!=animated.waypoint_list_.end()  && !is_angle())
-						{
-							const Real &t(next->get_tension());       // Tension
-							const Real &c(next->get_continuity());    // Continuity
-							const Real &b(next->get_bias());          // Bias
-							const value_type &Pp(curve.second.p1());  // P_{i-1}
-							const value_type &Pc(curve.second.p2());  // P_i
-							value_type Pn; Pn=after_next->get_value().get(T()); // P_{i+1}
+					}
+					/// iter             next
+					/// ANY/CLAMPED ---- ANY/ANY and iter is middle waypoint
+					if(iter_get_after == INTERPOLATION_CLAMPED && iter!=animated.waypoint_list_.begin() && !is_angle())
+					{
+						value_type Pp; Pp=curve_list[i-1].second.p1(); // P_{i-1}
+						const value_type& Pc(curve.second.p1());         // P_i
+						const value_type& Pn(curve.second.p2());         // P_{i+1}
+						Time T1(curve_list[i-1].first.p1());
+						Time T2(iter->get_time());
+						Time T3(next->get_time());
+						value_type vect(clamped_tangent(Pp, Pc, Pn, T1, T2, T3));
+						curve.second.t1()=vect;
+					}
+					///
+					/// TCB/!TCB and list not empty
+					///
+					if(iter_get_before==INTERPOLATION_TCB && iter->get_after()!=INTERPOLATION_TCB && i > 0)
+					{
+						/// It means that there is one previous waypoint
+						/// that is at cuerve_list.back()
+						/// then its second tangent must be the same than
+						/// our first one for continuity of the tangents.
+						curve_list[i-1].second.t2()=curve.second.t1();
+						curve_list[i-1].second.sync();
+					}
+					/// iter          next          after_next
+					/// ANY/ANY ------TCB/ANY ----- ANY/ANY
+					///
+					if(next_get_before==INTERPOLATION_TCB && after_next!=animated.waypoint_list_.end()  && !is_angle())
+					{
+						const Real &t(next->get_tension());       // Tension
+						const Real &c(next->get_continuity());    // Continuity
+						const Real &b(next->get_bias());          // Bias
+						const value_type &Pp(curve.second.p1());  // P_{i-1}
+						const value_type &Pc(curve.second.p2());  // P_i
+						value_type Pn; Pn=after_next->get_value().get(T()); // P_{i+1}
+
+						/// TCB calculation
+						value_type vect(static_cast<value_type>(subtract_func(Pc,Pp) * (((1.0-t)*(1.0-c)*(1.0+b))/2.0) +
+																			 (Pn-Pc) * (((1.0-t)*(1.0+c)*(1.0-b))/2.0)));
+						curve.second.t2()=vect;
+					}
+					else
+						/// iter          next
+						/// ANY/ANY ----- LINEAR/ANY
+						///           or
+						/// ANY/ANY ----- EASE/ANY
+						///           or
+						/// ANY/ANY ----- TCB/ANY ---- END
+						///           or
+						/// ANY/ANY ----- CLAMPED/ANY ----END
+					    if(
+						next_get_before==INTERPOLATION_LINEAR || next_get_before==INTERPOLATION_HALT ||
+						(next_get_before==INTERPOLATION_TCB && after_next==animated.waypoint_list_.end()) ||
+						(next_get_before==INTERPOLATION_CLAMPED && after_next==animated.waypoint_list_.end())
+						)
+					{
+						/// t2 = p2 - p1
+						curve.second.t2()=subtract_func(curve.second.p2(),curve.second.p1());
+					}
+					/// iter             next         after_next
+					/// ANY/ANY ---- CLAMPED/ANY      ANY/ANY
+					if(next_get_before == INTERPOLATION_CLAMPED && after_next!=animated.waypoint_list_.end()  && !is_angle())
+					{
+						const value_type &Pp(curve.second.p1());            // P_{i-1}
+						const value_type &Pc(curve.second.p2());            // P_i
+						value_type Pn; Pn=after_next->get_value().get(T()); // P_{i+1}
+						Time T1(iter->get_time());
+						Time T2(next->get_time());
+						Time T3(after_next->get_time());
+						value_type vect(clamped_tangent(Pp, Pc, Pn, T1, T2, T3));
+						curve.second.t2()=vect;
+					}
+					// Adjust for time
+					const float timeadjust(0.5);
+					/// iter           next
+					/// ANY/EASE ------ANY/ANY
+					///
+					if(iter_get_after==INTERPOLATION_HALT)
+						curve.second.t1()*=0;
+					// if this isn't the first curve
+					else
+					/// prev         iter              next
+					/// ANY/ANY -----ANY/!LINEAR ----- ANY/ANY
+					///
+					if(iter_get_after != INTERPOLATION_LINEAR && i > 0)
+						// adjust it for the curve that came before it
+						curve.second.t1() = static_cast<T>(curve.second.t1() * // cast to prevent warning
+							//                  (time span of this curve) * 1.5
+							// -----------------------------------------------------------------
+							// ((time span of this curve) * 0.5) + (time span of previous curve)
+							  (curve.second.get_dt()*(timeadjust+1)) /
+							  (curve.second.get_dt()*timeadjust + curve_list[i-1].second.get_dt()));
+					/// iter           next
+					/// ANY/ANY ------EASE/ANY
+					///
+					if(next_get_before==INTERPOLATION_HALT)
+						curve.second.t2()*=0;
+					// if this isn't the last curve
+					else
+					/// iter           next               after_next
+					/// ANY/ANY ----- !LINEAR/ANY ------- ANY/ANY
+					///
+					if(next_get_before != INTERPOLATION_LINEAR && after_next!=animated.waypoint_list_.end())
+						// adjust it for the curve that came after it
+						curve.second.t2() = static_cast<T>(curve.second.t2() * // cast to prevent warning
+							//                (time span of this curve) * 1.5
+							// -------------------------------------------------------------
+							// ((time span of this curve) * 0.5) + (time span of next curve)
+							  (curve.second.get_dt()*(timeadjust+1)) /
+							  (curve.second.get_dt()*timeadjust+(after_next->get_time()-next->get_time())));
+				} // not CONSTANT
+			}
+
+			// Set up the time to the default stuff
+			curve.first.set_rs(iter->get_time(), next->get_time());
+			curve.first.p1()=iter->get_time();
+			curve.first.p2()=next->get_time();
+			curve.first.t1()=(curve.first.p2()-curve.first.p1())*(1.0f-iter->get_temporal_tension());
+			curve.first.t2()=(curve.first.p2()-curve.first.p1())*(1.0f-next->get_temporal_tension());
 
-							/// TCB calculation
-							value_type vect(static_cast<value_type>(subtract_func(Pc,Pp) * (((1.0-t)*(1.0-c)*(1.0+b))/2.0) +
-																				 (Pn-Pc) * (((1.0-t)*(1.0+c)*(1.0-b))/2.0)));
-							curve.second.t2()=vect;
-						}
-						else
-							/// iter          next
-							/// ANY/ANY ----- LINEAR/ANY
-							///           or
-							/// ANY/ANY ----- EASE/ANY
-							///           or
-							/// ANY/ANY ----- TCB/ANY ---- END
-							///           or
-							/// ANY/ANY ----- CLAMPED/ANY ----END
-						    if(
-							next_get_before==INTERPOLATION_LINEAR || next_get_before==INTERPOLATION_HALT ||
-							(next_get_before==INTERPOLATION_TCB && after_next==animated.waypoint_list_.end()) ||
-							(next_get_before==INTERPOLATION_CLAMPED && after_next==animated.waypoint_list_.end())
-							)
-						{
-							/// t2 = p2 - p1
-							curve.second.t2()=subtract_func(curve.second.p2(),curve.second.p1());
-						}
-						/// iter             next         after_next
-						/// ANY/ANY ---- CLAMPED/ANY      ANY/ANY
-						if(next_get_before == INTERPOLATION_CLAMPED && after_next!=animated.waypoint_list_.end()  && !is_angle())
-						{
-							const value_type &Pp(curve.second.p1());            // P_{i-1}
-							const value_type &Pc(curve.second.p2());            // P_i
-							value_type Pn; Pn=after_next->get_value().get(T()); // P_{i+1}
-							Time T1(iter->get_time());
-							Time T2(next->get_time());
-							Time T3(after_next->get_time());
-							value_type vect(clamped_tangent(Pp, Pc, Pn, T1, T2, T3));
-							curve.second.t2()=vect;
-						}
-						// Adjust for time
-						const float timeadjust(0.5);
-						/// iter           next
-						/// ANY/EASE ------ANY/ANY
-						///
-						if(iter_get_after==INTERPOLATION_HALT)
-							curve.second.t1()*=0;
-						// if this isn't the first curve
-						else
-						/// prev         iter              next
-						/// ANY/ANY -----ANY/!LINEAR ----- ANY/ANY
-						///
-						if(iter_get_after != INTERPOLATION_LINEAR && !curve_list.empty())
-							// adjust it for the curve that came before it
-							curve.second.t1() = static_cast<T>(curve.second.t1() * // cast to prevent warning
-								//                  (time span of this curve) * 1.5
-								// -----------------------------------------------------------------
-								// ((time span of this curve) * 0.5) + (time span of previous curve)
-								  (curve.second.get_dt()*(timeadjust+1)) /
-								  (curve.second.get_dt()*timeadjust + curve_list.back().second.get_dt()));
-						/// iter           next
-						/// ANY/ANY ------EASE/ANY
-						///
-						if(next_get_before==INTERPOLATION_HALT)
-							curve.second.t2()*=0;
-						// if this isn't the last curve
-						else
-						/// iter           next               after_next
-						/// ANY/ANY ----- !LINEAR/ANY ------- ANY/ANY
-						///
-						if(next_get_before != INTERPOLATION_LINEAR && after_next!=animated.waypoint_list_.end())
-							// adjust it for the curve that came after it
-							curve.second.t2() = static_cast<T>(curve.second.t2() * // cast to prevent warning
-								//                (time span of this curve) * 1.5
-								// -------------------------------------------------------------
-								// ((time span of this curve) * 0.5) + (time span of next curve)
-								  (curve.second.get_dt()*(timeadjust+1)) /
-								  (curve.second.get_dt()*timeadjust+(after_next->get_time()-next->get_time())));
-					} // not CONSTANT
-				}
 
-				// Set up the time to the default stuff
-				curve.first.set_rs(iter->get_time(), next->get_time());
-				curve.first.p1()=iter->get_time();
-				curve.first.p2()=next->get_time();
-				curve.first.t1()=(curve.first.p2()-curve.first.p1())*(1.0f-iter->get_temporal_tension());
-				curve.first.t2()=(curve.first.p2()-curve.first.p1())*(1.0f-next->get_temporal_tension());
+			curve.first.sync();
+			
+			// for proper integer interpolation
+			curve.second.p1() = premult( curve.second.p1() );
+			curve.second.p2() = premult( curve.second.p2() );
+			curve.second.t1() = premult( curve.second.t1() );
+			curve.second.t2() = premult( curve.second.t2() );
+			curve.second.sync();
 
+			curve_list[i] = curve;
+		}
 
-				curve.first.sync();
-				
-				// for proper integer interpolation
-				curve.second.p1() = premult( curve.second.p1() );
-				curve.second.p2() = premult( curve.second.p2() );
-				curve.second.t1() = premult( curve.second.t1() );
-				curve.second.t2() = premult( curve.second.t2() );
-				curve.second.sync();
+		virtual void on_changed()
+		{
+			if (getenv("SYNFIG_DEBUG_ON_CHANGED"))
+				printf("%s:%d _Hermite::on_changed()\n", __FILE__, __LINE__);
 
-				curve_list.push_back(curve);
+			if(animated.waypoint_list_.size()<=1)
+			{
+				curve_list.clear();
+				keys.clear();
+				return;
+			}
+			std::sort(animated.waypoint_list_.begin(), animated.waypoint_list_.end());
+
+			r=animated.waypoint_list_.front().get_time();
+			s=animated.waypoint_list_.back().get_time();
+
+			// find the range of changed waypoints
+			int count = (int)animated.waypoint_list_.size();
+			int old_count = (int)keys.size();
+			std::vector<WaypointKey> new_keys;
+			new_keys.reserve(count);
+			for(WaypointList::const_iterator i = animated.waypoint_list_.begin(); i != animated.waypoint_list_.end(); ++i)
+				new_keys.push_back(WaypointKey(*i));
+
+			int min_count = std::min(count, old_count);
+			int prefix = 0;
+			while(prefix < min_count && keys[prefix] == new_keys[prefix])
+				++prefix;
+			int suffix = 0;
+			while(suffix < min_count - prefix && keys[old_count - suffix - 1] == new_keys[count - suffix - 1])
+				++suffix;
+			keys.swap(new_keys);
+
+			// segment uses two waypoints at the each side and tangents of
+			// the previous segment, also it changes tangent of the previous segment,
+			// so recompile segments which may be affected by changed waypoints
+			int segments = count - 1;
+			int old_segments = old_count > 1 ? old_count - 1 : 0;
+			int begin = std::max(0, prefix - 3);
+			int end = std::min(segments, count - suffix + 3);
+			int old_end = end < segments ? end + old_count - count : old_segments;
+			if (old_segments == 0)
+				{ begin = 0; end = segments; old_end = 0; curve_list.clear(); }
+
+			curve_list.erase(curve_list.begin() + begin, curve_list.begin() + old_end);
+			curve_list.insert(curve_list.begin() + begin, end - begin, typename curve_list_type::value_type());
+			assert((int)curve_list.size() == segments);
+
+			// waypoint list may be reallocated, so update iterators of all segments
+			WaypointList::iterator iter = animated.waypoint_list_.begin();
+			for(typename curve_list_type::iterator i = curve_list.begin(); i != curve_list.end(); ++i, ++iter)
+				{ i->start = iter; i->end = iter + 1; }
+
+			for(int i = begin; i < end; ++i)
+				compile_segment(i);
+
+			// the next segment is not changed, but it may change tangent of
+			// the last recompiled segment, so compile it again and keep the old result
+			if (end < segments)
+			{
+				typename curve_list_type::value_type next = curve_list[end];
+				compile_segment(end);
+				curve_list[end] = next;
 			}
 		}
 
@@ -660,12 +760,9 @@ public:
 			if(t>=s)
 				return animated.waypoint_list_.back().get_value(t);
 
-			typename curve_list_type::const_iterator iter;
-
-			// This next line will set iter to the
-			// correct iterator for the given time.
-			for(iter=curve_list.begin();iter<curve_list.end() && t>=iter->first.get_s();++iter)
-				continue;
+			// find the first segment which ends after the given time
+			typename curve_list_type::const_iterator iter =
+				std::upper_bound(curve_list.begin(), curve_list.end(), t, less_than_segment_end);
 			if(iter==curve_list.end())
 				return animated.waypoint_list_.back().get_value(t);
 			return iter->resolve(t);
@@ -751,13 +848,10 @@ public:
 			if(t>=s)
 				return animated.waypoint_list_.back().get_value(t);
 
-			WaypointList::const_iterator iter;
-			WaypointList::const_iterator next;
-
-			// This next line will set iter to the
-			// correct iterator for the given time.
-			for(next=animated.waypoint_list_.begin(),iter=next++;next!=animated.waypoint_list_.end() && t>=next->get_time();iter=next++)
-				continue;
+			// find the last waypoint which is not after the given time
+			WaypointList::const_iterator next =
+				std::upper_bound(animated.waypoint_list_.begin(), animated.waypoint_list_.end(), t, less_than_waypoint);
+			WaypointList::const_iterator iter = next - 1;
 
 			return iter->get_value(t);
 		}
@@ -842,14 +936,10 @@ public:
 			if(t>s)
 				return animated.waypoint_list_.back().get_value(t);
 
-			WaypointList::const_iterator iter;
-			WaypointList::const_iterator next;
-
-			// This next line will set iter to the
-			// correct iterator for the given time.
-			for(next=animated.waypoint_list_.begin(),iter=next++;next!=animated.waypoint_list_.end() && t>=next->get_time();iter=next++)
-				if(iter->get_time()==t)
-					return iter->get_value(t);
+			// find the last waypoint which is not after the given time
+			WaypointList::const_iterator next =
+				std::upper_bound(animated.waypoint_list_.begin(), animated.waypoint_list_.end(), t, less_than_waypoint);
+			WaypointList::const_iterator iter = next - 1;
 
 			if(iter->get_time()==t)
 				return iter->get_value(t);
@@ -0,0 +1,152 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file writerqueue.cpp
+**	\brief Queue of frames written by background threads
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cstdlib>
+
+#include <algorithm>
+
+#include <glib.h>
+
+#include "writerqueue.h"
+
+#include "general.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+WriterQueue::WriterQueue(int threads, int max_queue_size):
+	max_queue_size(max_queue_size),
+	processing(),
+	stopped(),
+	failed()
+{
+	if (threads < 0) threads = get_default_threads_count();
+	if (this->max_queue_size <= 0) this->max_queue_size = std::max(1, threads);
+	for(int i = 0; i < threads; ++i)
+		this->threads.push_back(
+			Glib::Threads::Thread::create(
+				sigc::mem_fun(*this, &WriterQueue::process) ));
+}
+
+WriterQueue::~WriterQueue()
+{
+	wait();
+	{
+		Glib::Threads::Mutex::Lock lock(mutex);
+		stopped = true;
+		cond.broadcast();
+	}
+	while(!threads.empty())
+		{ threads.front()->join(); threads.pop_front(); }
+}
+
+int
+WriterQueue::get_default_threads_count()
+{
+	// encoding usually is faster than rendering,
+	// so a few threads are enough to hide it
+	int count = std::min(2, (int)g_get_num_processors() - 1);
+	if (const char *s = getenv("SYNFIG_TARGET_WRITER_THREADS"))
+		count = atoi(s);
+	return std::max(0, count);
+}
+
+void
+WriterQueue::process()
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	while(true)
+	{
+		if (queue.empty())
+		{
+			if (stopped) break;
+			cond.wait(mutex);
+			continue;
+		}
+
+		Frame::Handle frame = queue.front();
+		queue.pop_front();
+		++processing;
+		cond.broadcast();
+
+		lock.release();
+		bool success = false;
+		try { success = frame->write(); }
+		catch(...) { synfig::error("WriterQueue: unknown exception while writing frame"); }
+		frame.reset();
+		lock.acquire();
+
+		if (!success) failed = true;
+		--processing;
+		cond.broadcast();
+	}
+}
+
+bool
+WriterQueue::push(const Frame::Handle &frame)
+{
+	if (!frame) return true;
+
+	if (threads.empty())
+	{
+		if (!frame->write()) failed = true;
+		return !failed;
+	}
+
+	Glib::Threads::Mutex::Lock lock(mutex);
+	while((int)queue.size() >= max_queue_size)
+		cond.wait(mutex);
+	queue.push_back(frame);
+	cond.broadcast();
+	return !failed;
+}
+
+bool
+WriterQueue::wait()
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	while(!queue.empty() || processing)
+		cond.wait(mutex);
+	return !failed;
+}
+
+/* === E N T R Y P O I N T ================================================= */
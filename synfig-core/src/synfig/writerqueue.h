@@ -0,0 +1,101 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file writerqueue.h
+**	\brief Queue of frames written by background threads
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_WRITERQUEUE_H
+#define __SYNFIG_WRITERQUEUE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <deque>
+#include <list>
+
+#include <glibmm/threads.h>
+
+#include <ETL/handle>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig {
+
+//! Bounded queue of rendered frames which are encoded and written to files
+//! by background threads, so target may render the next frame
+//! while previous one is compressed.
+//! Count of threads may be set by environment variable SYNFIG_TARGET_WRITER_THREADS,
+//! zero means that frames are written synchronously by push().
+class WriterQueue
+{
+public:
+	//! Frame to write, it should own all data it needs,
+	//! pixels should be moved (swapped) into frame instead of copying
+	class Frame: public etl::shared_object
+	{
+	public:
+		typedef etl::handle<Frame> Handle;
+		virtual ~Frame() { }
+		//! encodes and writes frame, called from one of writer threads
+		virtual bool write() = 0;
+	};
+
+private:
+	typedef std::deque<Frame::Handle> FrameQueue;
+	typedef std::list<Glib::Threads::Thread*> ThreadList;
+
+	Glib::Threads::Mutex mutex;
+	Glib::Threads::Cond cond;
+	FrameQueue queue;
+	ThreadList threads;
+	int max_queue_size;
+	int processing;
+	bool stopped;
+	bool failed;
+
+	void process();
+
+public:
+	//! \param threads count of writer threads, negative means default
+	//! \param max_queue_size max count of frames waiting for writing, when it's reached push() blocks
+	explicit WriterQueue(int threads = -1, int max_queue_size = 0);
+	~WriterQueue();
+
+	static int get_default_threads_count();
+	int get_threads_count() const { return (int)threads.size(); }
+
+	//! adds frame to queue, waits while queue is full,
+	//! returns false if some of previous frames was not written
+	bool push(const Frame::Handle &frame);
+
+	//! waits until all frames will be written,
+	//! returns false if some frames was not written
+	bool wait();
+};
+
+}; // END of namespace synfig
+
+/* === E N D =============================================================== */
+
+#endif
@@ -56,6 +56,8 @@ SynfigToolGeneralOptions::SynfigToolGeneralOptions(const char* argv0)
 	_should_be_quiet = false;
 	_should_print_benchmarks = false;
 	_threads = 1;
+	_frame_workers = 0; // not set, targets use own value
+	_jobs = 1;
 }
 
 std::string SynfigToolGeneralOptions::get_binary_path() const
@@ -73,6 +75,26 @@ void SynfigToolGeneralOptions::set_threads(size_t threads)
 	_threads = threads;
 }
 
+size_t SynfigToolGeneralOptions::get_frame_workers() const
+{
+	return _frame_workers;
+}
+
+void SynfigToolGeneralOptions::set_frame_workers(size_t frame_workers)
+{
+	_frame_workers = frame_workers;
+}
+
+size_t SynfigToolGeneralOptions::get_jobs() const
+{
+	return _jobs;
+}
+
+void SynfigToolGeneralOptions::set_jobs(size_t jobs)
+{
+	_jobs = jobs;
+}
+
 int SynfigToolGeneralOptions::get_verbosity() const
 {
 	return _verbosity;
@@ -89,6 +89,16 @@ public:
 
 	void set_threads(size_t threads);
 
+	//! zero means that --frame-workers is not set
+	size_t get_frame_workers() const;
+
+	void set_frame_workers(size_t frame_workers);
+
+	//! count of jobs processed simultaneously
+	size_t get_jobs() const;
+
+	void set_jobs(size_t jobs);
+
 	int get_verbosity() const;
 
 	void set_verbosity(int verbosity);
@@ -107,6 +117,8 @@ private:
 	std::string _binary_path;
 	int _verbosity;
 	size_t _threads;
+	size_t _frame_workers;
+	size_t _jobs;
 	bool _should_be_quiet,
 		 _should_print_benchmarks;
 
@@ -31,6 +31,9 @@
 
 #include <iostream>
 #include <list>
+#include <map>
+#include <set>
+#include <vector>
 #include <algorithm>
 #include <errno.h>
 #include <cstring>
@@ -40,6 +43,10 @@
 //#include <boost/format.hpp>
 #include <chrono>
 
+#include <glibmm/threads.h>
+
+#include <ETL/stringf>
+
 #include <autorevision.h>
 #include <synfig/general.h>
 #include <synfig/localization.h>
@@ -53,7 +60,11 @@
 #include <synfig/importer.h>
 #include <synfig/loadcanvas.h>
 #include <synfig/savecanvas.h>
+#include <synfig/valuenodes/valuenode_animated.h>
 #include <synfig/filesystemnative.h>
+#include <synfig/threadpool.h>
+#include <synfig/rendering/renderer.h>
+#include <synfig/rendering/renderqueue.h>
 
 #include "definitions.h"
 #include "job.h"
@@ -66,16 +77,244 @@
 
 using namespace synfig;
 
+namespace {
+
+//! prints counters of thread pool and of rendering queue
+void print_threads_stats()
+{
+	if ( !SynfigToolGeneralOptions::instance()->should_print_benchmarks()
+	  && SynfigToolGeneralOptions::instance()->get_verbosity() < 1 )
+		return;
+
+	ThreadPool::Stats pool_stats = ThreadPool::instance.get_stats();
+	std::cout << etl::strprintf(
+		_("Thread pool: %lld tasks, %lld steals, idle %f seconds, max queue depth %d."),
+		pool_stats.tasks,
+		pool_stats.steals,
+		(double)pool_stats.idle_time*1e-6,
+		pool_stats.max_queue_depth )
+			  << std::endl;
+
+	if (const rendering::RenderQueue *queue = rendering::Renderer::get_queue())
+	{
+		rendering::RenderQueue::Stats stats = queue->get_stats();
+		std::cout << etl::strprintf(
+			_("Rendering queue: %lld tasks, %lld steals, idle %f seconds, max queue depth %d."),
+			stats.tasks,
+			stats.steals,
+			(double)stats.idle_time*1e-6,
+			stats.max_queue_depth )
+				  << std::endl;
+	}
+}
+
+//! Processes jobs by several threads.
+//! Jobs which use the same canvas (e.g. color and alpha outputs of --extract-alpha,
+//! or files which import the same external file) are never processed
+//! simultaneously, because canvas keeps the current time.
+class JobRunner
+{
+private:
+	typedef std::set<Canvas*> CanvasSet;
+
+	std::list<Job> pending;
+	std::map<const Job*, CanvasSet> job_canvases;
+	CanvasSet busy_canvases;
+	std::list<SynfigToolException> errors;
+	int frames;
+	Glib::Threads::Mutex mutex;
+	Glib::Threads::Cond cond;
+
+	static int get_frames_count(const Job& job)
+	{
+		const RendDesc &desc = job.desc;
+		return desc.get_frame_end() > desc.get_frame_start()
+			 ? desc.get_frame_end() - desc.get_frame_start() + 1 : 1;
+	}
+
+	static void collect_canvas_value(const ValueBase &value, CanvasSet &visited, CanvasSet &out_roots)
+	{
+		if (value.get_type() == type_canvas)
+			if (Canvas::LooseHandle canvas = value.get(Canvas::LooseHandle()))
+				collect_canvases(*canvas, visited, out_roots);
+	}
+
+	//! Collects roots of all canvases used to render \a canvas,
+	//! external files are loaded once and shared between jobs
+	static void collect_canvases(Canvas &canvas, CanvasSet &visited, CanvasSet &out_roots)
+	{
+		if (!visited.insert(&canvas).second)
+			return;
+		out_roots.insert(canvas.get_root().get());
+		for(Canvas::iterator i = canvas.begin(); i != canvas.end(); ++i)
+		{
+			collect_canvas_value((*i)->get_param("canvas"), visited, out_roots);
+			// animated canvas parameter switches between several canvases
+			Layer::DynamicParamList::const_iterator param = (*i)->dynamic_param_list().find("canvas");
+			if (param != (*i)->dynamic_param_list().end())
+				if (ValueNode_Animated::Handle animated = ValueNode_Animated::Handle::cast_dynamic(param->second))
+					for(ValueNode_Animated::WaypointList::const_iterator j = animated->waypoint_list().begin(); j != animated->waypoint_list().end(); ++j)
+						collect_canvas_value(j->get_value(), visited, out_roots);
+		}
+	}
+
+	bool is_busy(const CanvasSet &canvases) const
+	{
+		for(CanvasSet::const_iterator i = canvases.begin(); i != canvases.end(); ++i)
+			if (busy_canvases.count(*i)) return true;
+		return false;
+	}
+
+	//! Takes the next job which canvases are not busy, returns false when all jobs are taken
+	bool take_job(std::list<Job>& job)
+	{
+		Glib::Threads::Mutex::Lock lock(mutex);
+		while(!pending.empty())
+		{
+			for(std::list<Job>::iterator i = pending.begin(); i != pending.end(); ++i)
+			{
+				const CanvasSet &canvases = job_canvases[&*i];
+				if (is_busy(canvases)) continue;
+				busy_canvases.insert(canvases.begin(), canvases.end());
+				job.splice(job.end(), pending, i);
+				return true;
+			}
+			cond.wait(mutex);
+		}
+		return false;
+	}
+
+	void release_job(const Job& job, const SynfigToolException* error)
+	{
+		Glib::Threads::Mutex::Lock lock(mutex);
+		const CanvasSet &canvases = job_canvases[&job];
+		for(CanvasSet::const_iterator i = canvases.begin(); i != canvases.end(); ++i)
+			busy_canvases.erase(*i);
+		if (error)
+			errors.push_back(*error);
+		else
+			frames += get_frames_count(job);
+		cond.broadcast();
+	}
+
+	void thread_loop()
+	{
+		while(true)
+		{
+			std::list<Job> job;
+			if (!take_job(job))
+				break;
+			try
+			{
+				process_job(job.front(), false);
+				// target finalizes the output file in destructor
+				job.front().target.reset();
+				release_job(job.front(), NULL);
+			}
+			catch(SynfigToolException& e)
+			{
+				synfig::error("%s: %s", job.front().filename.c_str(), e.get_message().c_str());
+				release_job(job.front(), &e);
+			}
+			catch(std::exception& e)
+			{
+				SynfigToolException error(SYNFIGTOOL_RENDERFAILURE, e.what());
+				synfig::error("%s: %s", job.front().filename.c_str(), e.what());
+				release_job(job.front(), &error);
+			}
+		}
+	}
+
+public:
+	//! Canvases of jobs should be loaded, list nodes keep addresses of jobs while splicing
+	explicit JobRunner(std::list<Job>& job_list): frames()
+	{
+		pending.swap(job_list);
+		for(std::list<Job>::iterator i = pending.begin(); i != pending.end(); ++i)
+		{
+			CanvasSet visited;
+			CanvasSet &canvases = job_canvases[&*i];
+			canvases.insert(i->root.get());
+			if (i->canvas)
+				collect_canvases(*i->canvas, visited, canvases);
+		}
+	}
+
+	//! Runs jobs, the first failure of job is rethrown when all jobs are done
+	void run(int threads_count)
+	{
+		int jobs_count = (int)pending.size();
+		std::chrono::system_clock::time_point start_timepoint =
+			std::chrono::system_clock::now();
+
+		// current thread processes jobs too
+		std::vector<Glib::Threads::Thread*> threads;
+		for(int i = 1; i < threads_count; ++i)
+			threads.push_back( Glib::Threads::Thread::create(
+				sigc::mem_fun(*this, &JobRunner::thread_loop) ));
+		thread_loop();
+		for(std::vector<Glib::Threads::Thread*>::iterator i = threads.begin(); i != threads.end(); ++i)
+			(*i)->join();
+
+		std::chrono::duration<double> duration =
+			std::chrono::system_clock::now() - start_timepoint;
+		if ( SynfigToolGeneralOptions::instance()->should_print_benchmarks()
+		  || SynfigToolGeneralOptions::instance()->get_verbosity() >= 1 )
+		{
+			std::cout << etl::strprintf(
+				_("Rendered %d of %d jobs (%d frames) in %f seconds, %f frames per second."),
+				jobs_count - (int)errors.size(),
+				jobs_count,
+				frames,
+				duration.count(),
+				duration.count() > 0.0 ? frames/duration.count() : 0.0 )
+					  << std::endl;
+		}
+
+		if (!errors.empty())
+			throw errors.front();
+	}
+};
+
+}
+
 void process_job_list(std::list<Job>& job_list, const TargetParam& target_params)
 {
 	if (job_list.empty())
 		throw (SynfigToolException(SYNFIGTOOL_BORED, _("Nothing to do!")));
 
-	for(; !job_list.empty(); job_list.pop_front())
+	int jobs = (int)std::min(job_list.size(), SynfigToolGeneralOptions::instance()->get_jobs());
+	if (jobs <= 1)
+	{
+		for(; !job_list.empty(); job_list.pop_front())
+		{
+			if (setup_job(job_list.front(), target_params))
+				process_job(job_list.front());
+		}
+		print_threads_stats();
+		return;
+	}
+
+	// Canvases are loaded and targets are created by current thread,
+	// modules and opened importers are shared between all jobs
+	std::list<Job> ready_jobs;
+	while(!job_list.empty())
 	{
 		if (setup_job(job_list.front(), target_params))
-			process_job(job_list.front());
+			ready_jobs.splice(ready_jobs.end(), job_list, job_list.begin());
+		else
+			job_list.pop_front();
 	}
+
+	// frame workers are divided between simultaneous jobs,
+	// without --frame-workers option targets keep value from SYNFIG_TARGET_FRAME_WORKERS
+	int frame_workers = (int)SynfigToolGeneralOptions::instance()->get_frame_workers();
+	for(std::list<Job>::iterator i = ready_jobs.begin(); i != ready_jobs.end(); ++i)
+		if (Target_Scanline::Handle target = Target_Scanline::Handle::cast_dynamic(i->target))
+			target->set_frame_workers(std::max(1, (frame_workers > 0 ? frame_workers : target->get_frame_workers())/jobs));
+
+	JobRunner(ready_jobs).run(jobs);
+	print_threads_stats();
 }
 
 std::string get_extension(const std::string &filename)
@@ -217,12 +456,16 @@ bool setup_job(Job& job, const TargetParam& target_parameters)
 
 	// Set the threads for the target
 	if (job.target && Target_Scanline::Handle::cast_dynamic(job.target))
+	{
 		Target_Scanline::Handle::cast_dynamic(job.target)->set_threads(SynfigToolGeneralOptions::instance()->get_threads());
+		if (SynfigToolGeneralOptions::instance()->get_frame_workers() > 0)
+			Target_Scanline::Handle::cast_dynamic(job.target)->set_frame_workers(SynfigToolGeneralOptions::instance()->get_frame_workers());
+	}
 
 	return true;
 }
 
-void process_job (Job& job)
+void process_job (Job& job, bool progress_line)
 {
 	VERBOSE_OUT(3) << job.filename.c_str() << " -- " << std::endl;
 	synfig::info("\tw: %d, h: %d, a: %d, pxaspect: %f, imaspect: %f, span: %f", 
@@ -254,7 +497,7 @@ void process_job (Job& job)
                                     % job.desc.get_focus()[1]
                     << std::endl;*/
 
-	RenderProgress p;
+	RenderProgress p(progress_line);
 	p.task(job.filename + " ==> " + job.outfilename);
 
 	if(job.sifout)
@@ -38,7 +38,9 @@ void process_job_list(std::list<Job>& job_list,
 bool setup_job(Job& job, const synfig::TargetParam& target_parameters);
 
 /// Process an individual job
-void process_job(Job& job);
+/// \param progress_line print the progress line updated while rendering,
+/// 	otherwise only the final line will be printed (used for simultaneous jobs)
+void process_job(Job& job, bool progress_line = true);
 
 std::string get_absolute_path(std::string relative_path);
 
@@ -34,6 +34,7 @@
 #include <iostream>
 #include <string>
 #include <list>
+#include <vector>
 
 //#include <boost/program_options/options_description.hpp>
 //#include <boost/program_options/parsers.hpp>
@@ -280,18 +281,30 @@ int main(int argc, char* argv[])
 		std::list<Job> job_list;
 
 		// Processing --------------------------------------------------
-		Job job;
-		job = parser.extract_job();
-		job.desc = job.canvas->rend_desc() = parser.extract_renddesc(job.canvas->rend_desc());
-
-		if (job.extract_alpha) {
-			job.alpha_mode = synfig::TARGET_ALPHA_MODE_REDUCE;
-			job_list.push_front(job);
-			job.alpha_mode = synfig::TARGET_ALPHA_MODE_EXTRACT;
-			job.outfilename = _appendAlphaToFilename(job.outfilename);
-			job_list.push_front(job);
-		} else {
-			job_list.push_front(job);
+		std::vector<std::string> input_files = parser.get_input_files();
+		if (input_files.empty())
+			input_files.push_back(std::string()); // extract_job() reports about missing argument
+
+		for(std::vector<std::string>::const_iterator i = input_files.begin(); i != input_files.end(); ++i)
+		{
+			Job job;
+			job = parser.extract_job(*i);
+			job.desc = job.canvas->rend_desc() = parser.extract_renddesc(job.canvas->rend_desc());
+
+			if (input_files.size() > 1 && !job.outfilename.empty())
+				throw SynfigToolException(SYNFIGTOOL_INVALIDOUTPUT,
+						_("Output filename cannot be used with several input files."));
+
+			if (job.extract_alpha) {
+				std::list<Job>::iterator pos = job_list.end();
+				job.alpha_mode = synfig::TARGET_ALPHA_MODE_REDUCE;
+				pos = job_list.insert(pos, job);
+				job.alpha_mode = synfig::TARGET_ALPHA_MODE_EXTRACT;
+				job.outfilename = _appendAlphaToFilename(job.outfilename);
+				job_list.insert(pos, job);
+			} else {
+				job_list.push_back(job);
+			}
 		}
 
 		process_job_list(job_list, parser.extract_targetparam());
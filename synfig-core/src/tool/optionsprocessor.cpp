@@ -29,6 +29,8 @@
 #	include <config.h>
 #endif
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 //#include <boost/format.hpp>
 
@@ -101,9 +103,13 @@ SynfigCommandLineParser::SynfigCommandLineParser() :
 	set_quality(),
 	set_gamma(),
 	set_num_threads(),
+	set_frame_workers(),
+	set_num_jobs(),
 	set_input_file(),
 	set_output_file(),
 	set_sequence_separator(),
+	set_compression(-1),
+	set_png_filter(),
 	set_canvas_id(),
 	set_fps(),
 	set_time(),
@@ -159,9 +165,13 @@ SynfigCommandLineParser::SynfigCommandLineParser() :
 	//og_set.add_option("quality",     'Q', quality_arg_desc, etl::strprintf(_("Specify image quality for accelerated renderer (Default: %d)"), DEFAULT_QUALITY).c_str(), "NUM");
 	add_option(og_set, "gamma",       'g', set_gamma,		_("Gamma"), "2.2");
 	add_option(og_set, "threads",     'T', set_num_threads, _("Enable multithreaded renderer using the specified number of threads"), "NUM");
+	add_option(og_set, "frame-workers", ' ', set_frame_workers, _("Render up to NUM frames of animation simultaneously"), "NUM");
+	add_option(og_set, "jobs",        'j', set_num_jobs,	_("Render up to NUM input files simultaneously"), "NUM");
 	add_option(og_set, "input-file",  'i', set_input_file, 	_("Specify input filename"), "filename");
 	add_option(og_set, "output-file", 'o', set_output_file, _("Specify output filename"), "filename");
 	add_option(og_set, "sequence-separator", ' ', set_sequence_separator, _("Output file sequence separator string (Use double quotes if you want to use spaces)"), "string");
+	add_option(og_set, "compression", ' ', set_compression, _("Compression level of output images"), "0..9");
+	add_option(og_set, "png-filter",  ' ', set_png_filter,	_("Filter of PNG encoder: none, sub, up, avg, paeth or all"), "filter");
 	add_option(og_set, "canvas",      'c', set_canvas_id, 	_("Render the canvas with the given id instead of the root."), "id");
 	add_option(og_set, "fps",         ' ', set_fps, 		_("Set the frame rate"), "NUM");
 	add_option(og_set, "time",        ' ', set_time, 		_("Render a single frame at <seconds>"), "seconds");
@@ -363,6 +373,32 @@ void SynfigCommandLineParser::process_settings_options()
 
 	VERBOSE_OUT(1) << _("Threads set to ")
 				   << SynfigToolGeneralOptions::instance()->get_threads() << std::endl;
+
+	if (set_frame_workers > 0)
+	{
+		SynfigToolGeneralOptions::instance()->set_frame_workers(set_frame_workers);
+		VERBOSE_OUT(1) << _("Frame workers set to ")
+					   << SynfigToolGeneralOptions::instance()->get_frame_workers() << std::endl;
+	}
+
+	if (set_num_jobs > 0)
+	{
+		SynfigToolGeneralOptions::instance()->set_jobs(set_num_jobs);
+		VERBOSE_OUT(1) << _("Jobs set to ")
+					   << SynfigToolGeneralOptions::instance()->get_jobs() << std::endl;
+	}
+
+	// Simultaneous jobs share the rendering threads. Threads of jobs mostly
+	// wait for the renderer, so rendering keeps the threads budget
+	// (--threads or count of processors) except one thread reserved
+	// for preparing of frames and encoding. Renderer reads it at initialization of synfig::Main.
+	if (set_num_jobs > 1 && !getenv("SYNFIG_RENDERING_THREADS"))
+	{
+		int budget = set_num_threads > 0 ? set_num_threads : g_get_num_processors();
+		int rendering_threads = std::max(1, budget - 1);
+		g_setenv("SYNFIG_RENDERING_THREADS", etl::strprintf("%d", rendering_threads).c_str(), TRUE);
+		VERBOSE_OUT(1) << _("Rendering threads set to ") << rendering_threads << std::endl;
+	}
 }
 
 //void OptionsProcessor::process_info_options()
@@ -679,19 +715,43 @@ TargetParam SynfigCommandLineParser::extract_targetparam()
                        << "'."
 					   << std::endl;
 	}
+	if (set_compression >= 0)
+	{
+		params.compression = std::min(9, set_compression);
+		VERBOSE_OUT(1) << _("Compression level set to: ") << params.compression << std::endl;
+	}
+	if (!set_png_filter.empty())
+	{
+		params.filter = set_png_filter;
+		VERBOSE_OUT(1) << _("PNG filter set to: ") << params.filter << std::endl;
+	}
 
 	return params;
 }
 
+std::vector<std::string> SynfigCommandLineParser::get_input_files() const
+{
+	std::vector<std::string> files;
+	if (!set_input_file.empty())
+		files.push_back(set_input_file);
+	// first of remaining options is already used as input file
+	Glib::OptionGroup::vecustrings::const_iterator i = remaining_options_list.begin();
+	if (i != remaining_options_list.end() && set_input_file == *i)
+		++i;
+	for(; i != remaining_options_list.end(); ++i)
+		files.push_back(*i);
+	return files;
+}
+
 //Job OptionsProcessor::extract_job()
-Job SynfigCommandLineParser::extract_job()
+Job SynfigCommandLineParser::extract_job(const std::string& input_file)
 {
 	Job job;
 
 	// Common input file loading
-	if (!set_input_file.empty())
+	if (!input_file.empty())
 	{
-		job.filename = set_input_file;
+		job.filename = input_file;
 
 		// Open the composition
 		string errors, warnings;
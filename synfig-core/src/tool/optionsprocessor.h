@@ -50,10 +50,13 @@ public:
 	/// Options that will only display information
 	void process_info_options();
 
+	/// Input files from --input-file option and from the rest of command line
+	std::vector<std::string> get_input_files() const;
+
 	/// Extract the necessary options to create a job
 	/// After this, it is necessary to overwrite the necessary RendDesc options
 	/// and set the target parameters, if provided. Then can be processed
-	Job extract_job();
+	Job extract_job(const std::string& input_file);
 
 	/// Overwrite the input RendDesc object with the options given in the command line
 	synfig::RendDesc extract_renddesc(const synfig::RendDesc& renddesc);
@@ -151,9 +154,13 @@ private:
 //			(",Q", quality_arg_desc->default_value(DEFAULT_QUALITY), )
 	double			set_gamma;
 	int				set_num_threads;
+	int				set_frame_workers;
+	int				set_num_jobs;
 	Glib::ustring	set_input_file;
 	Glib::ustring	set_output_file;
 	Glib::ustring	set_sequence_separator;
+	int				set_compression;
+	Glib::ustring	set_png_filter;
 	Glib::ustring	set_canvas_id;
 	double			set_fps;
 	Glib::ustring	set_time;
@@ -25,8 +25,8 @@
 #include <ETL/stringf>
 #include <sstream>
 
-RenderProgress::RenderProgress()
-    : last_frame_(0), last_printed_line_length_(0),
+RenderProgress::RenderProgress(bool progress_line)
+    : progress_line_(progress_line), last_frame_(0), last_printed_line_length_(0),
       start_timepoint_(Clock::now()), last_timepoint_(Clock::now())
 { }
 
@@ -58,6 +58,11 @@ bool RenderProgress::amount_complete(int current_frame, int frames_count)
     std::ostringstream outputStream;
 
     const bool isFinished = (current_frame == frames_count);
+    if (!isFinished && !progress_line_)
+    {
+        return true;
+    }
+
     if (!isFinished)
     {
         // avoid reporting the progress too often
@@ -99,6 +104,13 @@ bool RenderProgress::amount_complete(int current_frame, int frames_count)
         extendLineToClearRest(line, last_printed_line_length_);
     last_printed_line_length_ = line.size();
 
+    if (!progress_line_)
+    {
+        // whole line by single output operation, it may be printed from several threads
+        std::cerr << (taskname_ + ": " + _("DONE") + "\n") << std::flush;
+        return true;
+    }
+
     std::cerr << extendedLine;
     if (isFinished)
     {
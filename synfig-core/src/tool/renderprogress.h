@@ -37,7 +37,10 @@ class RenderProgress : public synfig::ProgressCallback
 {
 public:
 
-    RenderProgress();
+    //! \param progress_line print the progress line updated while rendering,
+    //!     otherwise only the final line will be printed, so output of
+    //!     several simultaneous renderings will not be mixed
+    explicit RenderProgress(bool progress_line = true);
 
     virtual bool task(const std::string& taskname);
 
@@ -47,6 +50,7 @@ public:
 
     virtual bool amount_complete(int scanline, int height);
 private:
+    bool progress_line_;
     std::string taskname_;
     int last_frame_;
     size_t last_printed_line_length_;
@@ -0,0 +1,160 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file blendspan.cpp
+**	\brief Test and benchmark of vectorized BlendSpan kernels
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <synfig/rendering/software/function/blendspan.h>
+
+#include "testhelpers.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace synfig;
+using namespace rendering::software;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+const int test_width = 1001;
+const int bench_width = 1920;
+const int bench_height = 1080;
+
+/* === P R O C E D U R E S ================================================= */
+
+void fill_covers(vector<ColorReal> &covers)
+{
+	for(vector<ColorReal>::iterator i = covers.begin(); i != covers.end(); ++i)
+		*i = rand()%8 ? (float)rand()/(float)RAND_MAX : (rand()%2 ? 1.f : 0.f);
+}
+
+int test(const BlendSpan::Kernel &kernel)
+{
+	const ColorReal amounts[] = { 1.f, 0.5f, 0.01f };
+	int failures = 0;
+	vector<Color> src(test_width), dest(test_width);
+	vector<ColorReal> covers(test_width);
+	fill_colors(src);
+	fill_colors(dest);
+	fill_covers(covers);
+
+	for(int m = 0; m < Color::BLEND_END; ++m)
+	for(int constant = 0; constant < 2; ++constant)
+	for(int covered = 0; covered < 2; ++covered)
+	for(int invert = 0; invert < 2; ++invert)
+	for(int k = 0; k < (int)(sizeof(amounts)/sizeof(amounts[0])); ++k)
+	{
+		BlendSpan::Func func = kernel.funcs[m][constant][covered][invert];
+		if (!func) continue;
+
+		Color::BlendMethod method = (Color::BlendMethod)m;
+		ColorReal amount = amounts[k];
+		vector<Color> expected(dest), actual(dest);
+		for(int i = 0; i < test_width; ++i)
+			expected[i] = Color::blend(
+				src[constant ? 0 : i],
+				expected[i],
+				(invert ? -amount : amount)*(covered ? covers[i] : 1.f),
+				method );
+		func(&actual.front(), &src.front(), test_width, amount, covered ? &covers.front() : NULL);
+
+		if (memcmp(&expected.front(), &actual.front(), expected.size()*sizeof(Color)))
+		{
+			cerr << kernel.name << ": blend method " << m
+			     << (constant ? " constant" : "")
+			     << (covered ? " covered" : "")
+			     << (invert ? " inverted" : "")
+			     << " amount " << amount
+			     << ": differs from Color::blend" << endl;
+			++failures;
+		}
+	}
+
+	return failures;
+}
+
+void benchmark(const BlendSpan::Kernel &kernel)
+{
+	const int count = bench_width*bench_height;
+	vector<Color> src(count), dest(count);
+	fill_colors(src);
+	fill_colors(dest);
+
+	for(int m = 0; m < Color::BLEND_END; ++m)
+	{
+		BlendSpan::Func func = kernel.funcs[m][0][0][0];
+		if (!func) continue;
+
+		Color::BlendMethod method = (Color::BlendMethod)m;
+		chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+		for(int y = 0; y < bench_height; ++y)
+			func(&dest[y*bench_width], &src[y*bench_width], bench_width, 0.5f, NULL);
+		double kernel_speed = mpixels_per_second(begin, count);
+
+		begin = chrono::steady_clock::now();
+		for(int i = 0; i < count; ++i)
+			dest[i] = Color::blend(src[i], dest[i], 0.5f, method);
+		double scalar_speed = mpixels_per_second(begin, count);
+
+		cout << setw(6) << kernel.name << "  blend method " << setw(2) << m
+		     << "  kernel " << fixed << setprecision(1) << setw(8) << kernel_speed
+		     << "  scalar " << setw(8) << scalar_speed
+		     << " Mpixels/s" << endl;
+	}
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main(int argc, char **argv)
+{
+	const char *names[] = { "sse2", "avx2" };
+	bool bench = benchmark_requested(argc, argv);
+
+	int failures = 0;
+	for(int i = 0; i < 2; ++i)
+	{
+		BlendSpan::Kernel kernel;
+		if (!create_kernel(kernel, &BlendSpan::create_kernel, names[i]))
+			continue;
+		failures += test(kernel);
+		if (bench)
+			benchmark(kernel);
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file blurfft.cpp
+**	\brief Test and benchmark of blur
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <sigc++/bind.h>
+
+#include <synfig/surface.h>
+#include <synfig/threadpool.h>
+#include <synfig/rendering/software/function/blur.h>
+#include <synfig/rendering/software/function/fft.h>
+
+#include "testhelpers.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+const int test_threads = 4;
+const int bench_repeats = 3;
+
+struct Resolution {
+	int width;
+	int height;
+	const char *name;
+};
+
+const Resolution resolutions[] = {
+	{ 1920, 1080, "1080p" },
+	{ 3840, 2160, "4K"    }
+};
+
+struct BlurType {
+	rendering::Blur::Type type;
+	Real size;
+	const char *name;
+};
+
+// first sizes are large enough to choose blur by Fourier transform,
+// next ones are processed by pattern and box blur
+const BlurType blur_types[] = {
+	{ rendering::Blur::GAUSSIAN, 64.0, "gaussian"  },
+	{ rendering::Blur::DISC,     32.0, "disc"      },
+	{ rendering::Blur::GAUSSIAN,  8.0, "gaussian8" },
+	{ rendering::Blur::DISC,      4.0, "disc4"     },
+	{ rendering::Blur::BOX,       8.0, "box8"      }
+};
+
+/* === P R O C E D U R E S ================================================= */
+
+void fill_surface(synfig::Surface &surface)
+{
+	for(int y = 0; y < surface.get_h(); ++y)
+		for(int x = 0; x < surface.get_w(); ++x)
+			surface[y][x] = Color(random_value(0.f, 1.f), random_value(0.f, 1.f), random_value(0.f, 1.f), random_value(0.f, 1.f));
+}
+
+//! source surface should be larger than destination by extra size of blur at each side
+VectorInt extra_size(const BlurType &type)
+	{ return software::Blur::get_extra_size(type.type, Vector(type.size, type.size)); }
+
+void blur(synfig::Surface *dest, const synfig::Surface *src, const BlurType *type)
+{
+	software::Blur::blur(
+		software::Blur::Params(
+			*dest, RectInt(0, 0, dest->get_w(), dest->get_h()),
+			*src, extra_size(*type),
+			type->type, Vector(type->size, type->size),
+			false, Color::BLEND_COMPOSITE, 1.0 ));
+}
+
+bool equal(const synfig::Surface &a, const synfig::Surface &b)
+{
+	const ColorReal precision = 1e-5;
+	for(int y = 0; y < a.get_h(); ++y)
+		for(int x = 0; x < a.get_w(); ++x)
+			if ( fabs(a[y][x].get_r() - b[y][x].get_r()) > precision
+			  || fabs(a[y][x].get_g() - b[y][x].get_g()) > precision
+			  || fabs(a[y][x].get_b() - b[y][x].get_b()) > precision
+			  || fabs(a[y][x].get_a() - b[y][x].get_a()) > precision )
+				return false;
+	return true;
+}
+
+int test(const BlurType &type)
+{
+	int failures = 0;
+
+	// blur of single point keeps its energy
+	VectorInt extra = extra_size(type);
+	int w = 2*extra[0] + 1, h = 2*extra[1] + 1;
+	synfig::Surface src(w + 2*extra[0], h + 2*extra[1]);
+	src.clear();
+	src[src.get_h()/2][src.get_w()/2] = Color(1.0, 1.0, 1.0, 1.0);
+	synfig::Surface dest(w, h);
+	blur(&dest, &src, &type);
+
+	ColorReal sum = 0.0;
+	for(int y = 0; y < h; ++y)
+		for(int x = 0; x < w; ++x)
+			sum += dest[y][x].get_a();
+	if (fabs(sum - 1.0) > 1e-3)
+	{
+		cerr << type.name << ": energy of blurred point is " << sum << endl;
+		++failures;
+	}
+
+	// concurrent blurs gives the same result as single one
+	fill_surface(src);
+	blur(&dest, &src, &type);
+	synfig::Surface concurrent[test_threads];
+	ThreadPool::Group group;
+	for(int i = 0; i < test_threads; ++i)
+	{
+		concurrent[i].set_wh(w, h);
+		group.enqueue( sigc::bind(sigc::ptr_fun(&blur), &concurrent[i], &src, &type) );
+	}
+	group.run(true);
+	for(int i = 0; i < test_threads; ++i)
+		if (!equal(dest, concurrent[i]))
+		{
+			cerr << type.name << ": concurrent blur differs from single one" << endl;
+			++failures;
+			break;
+		}
+
+	return failures;
+}
+
+void benchmark(const BlurType &type, const Resolution &resolution)
+{
+	VectorInt extra = extra_size(type);
+	synfig::Surface src(resolution.width + 2*extra[0], resolution.height + 2*extra[1]);
+	synfig::Surface dest(resolution.width, resolution.height);
+	fill_surface(src);
+
+	// first call includes planning of transforms
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	blur(&dest, &src, &type);
+	double first = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+	begin = chrono::steady_clock::now();
+	for(int i = 0; i < bench_repeats; ++i)
+		blur(&dest, &src, &type);
+	double next = chrono::duration<double>(chrono::steady_clock::now() - begin).count()/bench_repeats;
+
+	cout << setw(10) << type.name << "  " << setw(6) << resolution.name
+	     << fixed << setprecision(1)
+	     << "  first " << setw(8) << first*1000.0 << " ms"
+	     << "  next " << setw(8) << next*1000.0 << " ms" << endl;
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main(int argc, char **argv)
+{
+	software::FFT::initialize();
+
+	int failures = 0;
+	for(int i = 0; i < (int)(sizeof(blur_types)/sizeof(blur_types[0])); ++i)
+		failures += test(blur_types[i]);
+
+	if (benchmark_requested(argc, argv))
+	{
+		cout << "threads: " << ThreadPool::instance.get_max_threads() << endl;
+		for(int i = 0; i < (int)(sizeof(blur_types)/sizeof(blur_types[0])); ++i)
+			for(int j = 0; j < (int)(sizeof(resolutions)/sizeof(resolutions[0])); ++j)
+				benchmark(blur_types[i], resolutions[j]);
+	}
+
+	software::FFT::deinitialize();
+	return failures ? 1 : 0;
+}
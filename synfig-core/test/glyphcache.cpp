@@ -0,0 +1,176 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file glyphcache.cpp
+**	\brief Test of GlyphCache of the text layer
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cstdlib>
+#include <iostream>
+
+#include <unistd.h>
+#include <utime.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <ETL/stringf>
+
+#include "../src/modules/lyr_freetype/glyphcache.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+// automake treats this exit code as skipped test
+#define EXIT_SKIP 77
+
+/* === G L O B A L S ======================================================= */
+
+const char *font_paths[] = {
+	"/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+	"/usr/share/fonts/dejavu/DejaVuSans.ttf",
+	"/usr/share/fonts/TTF/DejaVuSans.ttf",
+	"/usr/share/fonts/truetype/liberation/LiberationSans-Regular.ttf",
+	"/usr/share/fonts/truetype/freefont/FreeSans.ttf",
+	"/Library/Fonts/Arial.ttf",
+	"C:\\WINDOWS\\FONTS\\arial.ttf",
+	NULL };
+
+const FT_Int32 load_flags[] = { FT_LOAD_DEFAULT, FT_LOAD_NO_HINTING };
+const int max_test_glyphs = 512;
+
+/* === P R O C E D U R E S ================================================= */
+
+String find_font()
+{
+	const char *s = getenv("SYNFIG_TEST_FONT");
+	if (s && *s) return s;
+	for(const char **path = font_paths; *path; ++path)
+		if (g_file_test(*path, G_FILE_TEST_IS_REGULAR))
+			return *path;
+	return String();
+}
+
+bool same_glyphs(const GlyphCache::Glyph &a, const GlyphCache::Glyph &b)
+{
+	if ( a.advance != b.advance
+	  || a.top != b.top
+	  || a.even_odd != b.even_odd
+	  || a.chunks.size() != b.chunks.size() )
+		return false;
+	for(int i = 0; i < (int)a.chunks.size(); ++i)
+		if ( a.chunks[i].type != b.chunks[i].type
+		  || a.chunks[i].p1 != b.chunks[i].p1
+		  || a.chunks[i].pp0 != b.chunks[i].pp0
+		  || a.chunks[i].pp1 != b.chunks[i].pp1 )
+			return false;
+	return true;
+}
+
+// every glyph from cache should be the same as loaded directly from face
+int test_glyphs(FT_Face face, const String &face_id)
+{
+	GlyphCache &cache = GlyphCache::instance();
+	int count = (int)face->num_glyphs < max_test_glyphs ? (int)face->num_glyphs : max_test_glyphs;
+	int failures = 0;
+
+	for(int k = 0; k < (int)(sizeof(load_flags)/sizeof(load_flags[0])); ++k)
+	for(int i = 0; i < count; ++i)
+	{
+		GlyphCache::Glyph::Handle uncached = GlyphCache::load(face, i, load_flags[k]);
+		GlyphCache::Glyph::Handle cached = cache.get(face, face_id, i, load_flags[k]);
+		GlyphCache::Glyph::Handle again = cache.get(face, face_id, i, load_flags[k]);
+		if (!uncached != !cached || cached != again)
+			{ cerr << "glyph " << i << ": inconsistent cache lookup" << endl; ++failures; continue; }
+		if (uncached && !same_glyphs(*uncached, *cached))
+			{ cerr << "glyph " << i << ": cached glyph differs from uncached one" << endl; ++failures; }
+	}
+
+	return failures;
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main()
+{
+	String font = find_font();
+	if (font.empty())
+		{ cout << "no font found, set SYNFIG_TEST_FONT to run this test" << endl; return EXIT_SKIP; }
+
+	// work with copy of the font to be able to modify it
+	gchar *contents = NULL;
+	gsize length = 0;
+	String filename = etl::strprintf("%s%cglyphcache_test_%d.ttf", g_get_tmp_dir(), ETL_DIRECTORY_SEPARATOR, (int)getpid());
+	if ( !g_file_get_contents(font.c_str(), &contents, &length, NULL)
+	  || !g_file_set_contents(filename.c_str(), contents, length, NULL) )
+		{ g_free(contents); cerr << "cannot copy font " << font << endl; return 1; }
+	g_free(contents);
+
+	FT_Library library;
+	FT_Face face;
+	if (FT_Init_FreeType(&library))
+		{ g_remove(filename.c_str()); cerr << "cannot initialize FreeType" << endl; return 1; }
+	if (FT_New_Face(library, filename.c_str(), 0, &face))
+		{ FT_Done_FreeType(library); g_remove(filename.c_str()); cerr << "cannot open font " << font << endl; return 1; }
+
+	int failures = 0;
+	String face_id = GlyphCache::get_face_id(face, filename);
+	failures += test_glyphs(face, face_id);
+
+	// the same face opened from other file should not share glyphs
+	if (GlyphCache::get_face_id(face, font) == face_id)
+		{ cerr << "different font files have the same identifier" << endl; ++failures; }
+
+	// modified font file should get new identifier
+	GStatBuf buf;
+	struct utimbuf times;
+	if (!g_stat(filename.c_str(), &buf))
+	{
+		times.actime = buf.st_atime;
+		times.modtime = buf.st_mtime + 10;
+		if (!g_utime(filename.c_str(), &times))
+		{
+			String modified_id = GlyphCache::get_face_id(face, filename);
+			if (modified_id == face_id)
+				{ cerr << "modified font file has the same identifier" << endl; ++failures; }
+			failures += test_glyphs(face, modified_id);
+		}
+	}
+
+	GlyphCache::instance().clear();
+	FT_Done_Face(face);
+	FT_Done_FreeType(library);
+	g_remove(filename.c_str());
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,326 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file loadcanvas.cpp
+**	\brief Test and benchmark of loading of sif files
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <glib.h>
+
+#include <ETL/stringf>
+
+#include <synfig/main.h>
+#include <synfig/canvas.h>
+#include <synfig/canvascache.h>
+#include <synfig/layer.h>
+#include <synfig/loadcanvas.h>
+#include <synfig/filesystemnative.h>
+#include <synfig/debug/measure.h>
+
+#include "testhelpers.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace etl;
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+//! Size of generated file, small one checks that streaming parser and cache
+//! give the same canvas as DOM parser, large one is used for benchmark
+struct Fixture {
+	int value_nodes_count;
+	int waypoints_count;
+	int layers_count;
+};
+
+const Fixture small_fixture = {  20,  50,   100 };
+const Fixture large_fixture = { 200, 500, 20000 };
+
+const Real time_step = 0.04;
+
+int value_nodes_count;
+int waypoints_count;
+int layers_count;
+bool benchmark;
+
+String filename;
+
+/* === P R O C E D U R E S ================================================= */
+
+Real sample_value(int node, int i)
+	{ return sin(0.37*i + node) + 0.01*i; }
+
+void write_file()
+{
+	ofstream f(filename.c_str());
+	f << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << endl
+	  << "<canvas version=\"1.0\" width=\"480\" height=\"270\" xres=\"2834.645669\" yres=\"2834.645669\""
+	  << " view-box=\"-4 2.25 4 -2.25\" antialias=\"1\" fps=\"24\" begin-time=\"0f\" end-time=\"5s\""
+	  << " bgcolor=\"0.5 0.5 0.5 1.0\">" << endl
+	  << "<name>loadcanvas test</name>" << endl
+	  << "<keyframe time=\"1s\" active=\"true\">k1</keyframe>" << endl
+	  << "<keyframe time=\"2s\" active=\"false\">k2</keyframe>" << endl
+	  << "<defs>" << endl;
+	f.precision(12);
+	for(int j = 0; j < value_nodes_count; ++j)
+	{
+		f << "<animated type=\"real\" id=\"v" << j << "\""
+		  << " guid=\"" << strprintf("%08X%08X%08X%08X", 0x10AD, 0xCA4, 0x5, j + 1) << "\">" << endl;
+		for(int i = 0; i < waypoints_count; ++i)
+			f << "<waypoint time=\"" << (Real)i*time_step << "\" before=\"clamped\" after=\"clamped\">"
+			  << "<real value=\"" << sample_value(j, i) << "\"/></waypoint>" << endl;
+		f << "</animated>" << endl;
+	}
+	f << "</defs>" << endl;
+	for(int i = 0; i < layers_count; ++i)
+		f << "<layer type=\"group\" active=\"true\" version=\"0.3\" desc=\"g" << i << "\">" << endl
+		  << "<param name=\"amount\" use=\"v" << (i % value_nodes_count) << "\"/>" << endl
+		  << "<param name=\"z_depth\"><real value=\"" << 0.001*i << "\"/></param>" << endl
+		  << "<param name=\"canvas\"><canvas></canvas></param>" << endl
+		  << "</layer>" << endl;
+	f << "</canvas>" << endl;
+}
+
+long peak_rss_kb()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+Canvas::Handle load(bool streaming, bool cache, const char *name)
+{
+	String errors;
+	debug::Measure *measure = benchmark ? new debug::Measure(name) : NULL;
+	Canvas::Handle canvas = CanvasParser()
+		.set_streaming(streaming)
+		.set_cache(cache)
+		.parse_from_file_as(FileSystemNative::instance()->get_identifier(filename), name, errors);
+	delete measure;
+
+	// peak is never decreased, so the streaming parser should be measured first
+	if (benchmark)
+		cout << name << ": peak RSS " << peak_rss_kb() << " KiB" << endl;
+	if (!canvas)
+		cerr << name << ": cannot load file: " << errors << endl;
+	return canvas;
+}
+
+int compare(const Canvas::Handle &a, const Canvas::Handle &b)
+{
+	if (a->size() != b->size() || (int)a->size() != layers_count)
+	{
+		cerr << "layers count differs: " << a->size() << ", " << b->size() << endl;
+		return 1;
+	}
+	if (a->value_node_list().size() != b->value_node_list().size())
+	{
+		cerr << "value nodes count differs: "
+		     << a->value_node_list().size() << ", " << b->value_node_list().size() << endl;
+		return 1;
+	}
+	for(int j = 0; j < value_nodes_count; j += 17)
+	{
+		String id = strprintf("v%d", j);
+		ValueNode::Handle na = a->find_value_node(id, true);
+		ValueNode::Handle nb = b->find_value_node(id, true);
+		for(int i = 0; i < waypoints_count; i += 7)
+		{
+			Time t((Real)i*time_step);
+			Real va = (*na)(t).get(Real());
+			Real vb = (*nb)(t).get(Real());
+			if (fabs(va - vb) > 1e-9 || fabs(va - sample_value(j, i)) > 1e-6)
+			{
+				cerr << id << ": values differs at " << (Real)t << ": " << va << " != " << vb << endl;
+				return 1;
+			}
+		}
+	}
+	Canvas::const_iterator ia = a->begin(), ib = b->begin();
+	for(; ia != a->end(); ++ia, ++ib)
+		if ((*ia)->get_description() != (*ib)->get_description()
+		 || (*ia)->get_param("z_depth").get(Real()) != (*ib)->get_param("z_depth").get(Real()))
+		{
+			cerr << "layers differs: " << (*ia)->get_description() << ", " << (*ib)->get_description() << endl;
+			return 1;
+		}
+	// exported value nodes should be linked to layers, not copied
+	for(ia = a->begin(); ia != a->end(); ++ia)
+	{
+		int i = atoi((*ia)->get_description().c_str() + 1);
+		Layer::DynamicParamList::const_iterator param = (*ia)->dynamic_param_list().find("amount");
+		ValueNode::Handle node = a->find_value_node(strprintf("v%d", i % value_nodes_count), true);
+		if (param == (*ia)->dynamic_param_list().end() || param->second.get() != node.get())
+		{
+			cerr << "layer " << (*ia)->get_description() << " is not linked to exported value node" << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//! GUIDs relative to root canvas, like they are stored in file
+void collect_guids(const Canvas::Handle &canvas, map<String, GUID> &guids)
+{
+	const GUID &root = canvas->get_guid();
+	for(ValueNodeList::const_iterator i = canvas->value_node_list().begin(); i != canvas->value_node_list().end(); ++i)
+		guids["value node " + (*i)->get_id()] = (*i)->get_guid() ^ root;
+	for(KeyframeList::const_iterator i = canvas->keyframe_list().begin(); i != canvas->keyframe_list().end(); ++i)
+		guids["keyframe " + i->get_description()] = i->get_guid() ^ root;
+	for(Canvas::const_iterator i = canvas->begin(); i != canvas->end(); ++i)
+	{
+		guids["layer " + (*i)->get_description()] = (*i)->get_guid() ^ root;
+		Canvas::LooseHandle sub_canvas = (*i)->get_param("canvas").get(Canvas::LooseHandle());
+		if (sub_canvas)
+			guids["canvas " + (*i)->get_description()] = sub_canvas->get_guid() ^ root;
+	}
+}
+
+//! compares GUIDs of objects which names starts with \a prefix
+int compare_guids(const Canvas::Handle &a, const Canvas::Handle &b, const String &prefix)
+{
+	map<String, GUID> guids_a, guids_b;
+	collect_guids(a, guids_a);
+	collect_guids(b, guids_b);
+
+	int count = 0;
+	for(map<String, GUID>::const_iterator i = guids_a.begin(); i != guids_a.end(); ++i)
+	{
+		if (i->first.compare(0, prefix.size(), prefix))
+			continue;
+		map<String, GUID>::const_iterator j = guids_b.find(i->first);
+		if (j == guids_b.end() || j->second != i->second)
+		{
+			cerr << i->first << ": GUID differs" << endl;
+			return 1;
+		}
+		++count;
+	}
+	if (!count)
+	{
+		cerr << "no GUIDs to compare" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+//! changes name of canvas in file, but keeps size and modification time of file
+void replace_name()
+{
+	struct stat buf;
+	stat(filename.c_str(), &buf);
+
+	String data;
+	{
+		ifstream f(filename.c_str());
+		data.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+	}
+	size_t pos = data.find("loadcanvas test");
+	data.replace(pos, 15, "loadcanvas TEST");
+	{
+		ofstream f(filename.c_str());
+		f << data;
+	}
+
+	struct utimbuf times;
+	times.actime = buf.st_atime;
+	times.modtime = buf.st_mtime;
+	utime(filename.c_str(), &times);
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main(int argc, char **argv)
+{
+	Main main(".");
+
+	benchmark = benchmark_requested(argc, argv);
+	const Fixture &fixture = benchmark ? large_fixture : small_fixture;
+	value_nodes_count = fixture.value_nodes_count;
+	waypoints_count = fixture.waypoints_count;
+	layers_count = fixture.layers_count;
+
+	// fixture is written into temporary directory and removed at the end
+	filename = strprintf("%s%cloadcanvas_test_%d.sif", g_get_tmp_dir(), ETL_DIRECTORY_SEPARATOR, (int)getpid());
+	write_file();
+
+	int failures = 0;
+	// first load writes the cache, second one reads it
+	Canvas::Handle streamed = load(true, true, "load streaming");
+	Canvas::Handle cached = load(true, true, "load cache");
+	Canvas::Handle parsed = load(false, false, "load dom");
+	if (streamed && cached && parsed)
+	{
+		failures += compare(streamed, parsed);
+		failures += compare(cached, parsed);
+		// only GUIDs of value nodes are stored in file, other ones are generated while loading,
+		// but cache should keep all of them
+		failures += compare_guids(cached, parsed, "value node ");
+		failures += compare_guids(cached, streamed, "");
+	}
+	else
+		++failures;
+
+	String cache_filename = CanvasCache::get_cache_filename(etl::absolute_path(filename));
+	if (!ifstream(cache_filename.c_str()))
+	{
+		cerr << "cache is not written" << endl;
+		++failures;
+	}
+
+	// cache should be rejected by content hash
+	replace_name();
+	Canvas::Handle changed = load(true, true, "load changed");
+	if (!changed || changed->get_name() != "loadcanvas TEST")
+	{
+		cerr << "outdated cache is used" << endl;
+		++failures;
+	}
+
+	remove(cache_filename.c_str());
+	remove(filename.c_str());
+	return failures ? 1 : 0;
+}
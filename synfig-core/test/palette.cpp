@@ -0,0 +1,123 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file palette.cpp
+**	\brief Test of parallel palette quantization
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <synfig/palette.h>
+#include <synfig/surface.h>
+#include <synfig/threadpool.h>
+
+#include "testhelpers.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+struct Resolution {
+	int width;
+	int height;
+};
+
+const Resolution resolutions[] = {
+	{    1,   1 },
+	{   17,  33 },
+	{   48,  48 },
+	{  333, 101 },
+	{ 1001,  64 }
+};
+
+const int resolutions_count = (int)(sizeof(resolutions)/sizeof(resolutions[0]));
+const int test_repeats = 5;
+
+/* === P R O C E D U R E S ================================================= */
+
+void fill_surface(Surface &surface)
+{
+	for(int y = 0; y < surface.get_h(); ++y)
+		for(int x = 0; x < surface.get_w(); ++x)
+			surface[y][x] = Color(random_value(), random_value(), random_value(), rand()%8 ? 1.f : 0.f);
+}
+
+int test(const Resolution &r, int colors, bool dithering)
+{
+	Surface source(r.width, r.height);
+	fill_surface(source);
+	Palette palette(source, colors);
+
+	Surface expected_surface(source), actual_surface;
+	etl::surface<unsigned char> expected, actual;
+	palette.quantize(expected_surface, expected, dithering, false);
+
+	// threads may meet each other at different places each time
+	for(int i = 0; i < test_repeats; ++i)
+	{
+		actual_surface = source;
+		palette.quantize(actual_surface, actual, dithering, true);
+		bool same = true;
+		for(int y = 0; y < r.height && same; ++y)
+			if ( memcmp(expected[y], actual[y], r.width)
+			  || memcmp(expected_surface[y], actual_surface[y], r.width*sizeof(Color)) )
+				same = false;
+		if (!same)
+		{
+			cerr << r.width << "x" << r.height << ", " << colors << " colors"
+			     << (dithering ? ", dithering" : "")
+			     << ": threaded quantization differs from sequential one" << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main()
+{
+	cout << "threads: " << ThreadPool::instance.get_max_threads() << endl;
+
+	int failures = 0;
+	for(int i = 0; i < resolutions_count; ++i)
+		for(int d = 0; d < 2; ++d)
+		{
+			failures += test(resolutions[i], 256, d);
+			failures += test(resolutions[i], 16, d);
+		}
+	return failures ? 1 : 0;
+}
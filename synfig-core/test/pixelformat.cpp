@@ -0,0 +1,177 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file pixelformat.cpp
+**	\brief Test and benchmark of vectorized PixelFormat conversions
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <synfig/color/pixelformat.h>
+
+#include "testhelpers.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+const int test_width = 1001;
+const int test_height = 7;
+const int bench_width = 1920;
+const int bench_height = 1080;
+const int bench_repeats = 10;
+
+struct Format {
+	PixelFormat pf;
+	const char *name;
+};
+
+const Format formats[] = {
+	{ PF_RGB,                          "RGB8"         },
+	{ PF_BGR,                          "BGR8"         },
+	{ PF_RGB|PF_A,                     "RGBA8"        },
+	{ PF_BGR|PF_A,                     "BGRA8"        },
+	{ PF_RGB|PF_A_START,               "ARGB8"        },
+	{ PF_BGR|PF_A|PF_A_PREMULT,        "BGRA8 premult" },
+	{ PF_RGB|PF_A_START|PF_A_PREMULT,  "ARGB8 premult" },
+	{ PF_GRAY,                         "gray"         },
+	{ PF_GRAY|PF_A,                    "gray alpha"   },
+	{ PF_GRAY|PF_A_START|PF_A_PREMULT, "alpha gray premult" }
+};
+
+const int formats_count = (int)(sizeof(formats)/sizeof(formats[0]));
+
+/* === P R O C E D U R E S ================================================= */
+
+void fill_bytes(vector<unsigned char> &bytes)
+{
+	for(vector<unsigned char>::iterator i = bytes.begin(); i != bytes.end(); ++i)
+		*i = (unsigned char)(rand()%8 ? rand() : 0);
+}
+
+int test(const PixelFormatKernel &scalar, const PixelFormatKernel &kernel, const Gamma &gamma)
+{
+	int failures = 0;
+	vector<Color> colors(test_width*test_height);
+	fill_colors(colors);
+
+	for(int i = 0; i < formats_count; ++i)
+	for(int g = 0; g < 2; ++g)
+	{
+		const Format &f = formats[i];
+		const Gamma *gm = g ? &gamma : NULL;
+		int stride = test_width*pixel_size(f.pf) + 3;
+		vector<unsigned char> expected(stride*test_height), actual(stride*test_height);
+		scalar.color_to_pixelformat(&expected.front(), &colors.front(), f.pf, gm, test_width, test_height, stride);
+		kernel.color_to_pixelformat(&actual.front(), &colors.front(), f.pf, gm, test_width, test_height, stride);
+		if (expected != actual)
+		{
+			cerr << kernel.name << ": " << f.name << (gm ? " with gamma" : "")
+			     << ": color_to_pixelformat differs from scalar version" << endl;
+			++failures;
+		}
+	}
+
+	for(int i = 0; i < formats_count; ++i)
+	{
+		const Format &f = formats[i];
+		vector<unsigned char> bytes(test_width*test_height*pixel_size(f.pf));
+		fill_bytes(bytes);
+		vector<Color> expected(test_width*test_height), actual(test_width*test_height);
+		scalar.pixelformat_to_color(&expected.front(), &bytes.front(), f.pf, test_width, test_height);
+		kernel.pixelformat_to_color(&actual.front(), &bytes.front(), f.pf, test_width, test_height);
+		if (memcmp(&expected.front(), &actual.front(), expected.size()*sizeof(Color)))
+		{
+			cerr << kernel.name << ": " << f.name
+			     << ": pixelformat_to_color differs from scalar version" << endl;
+			++failures;
+		}
+	}
+
+	return failures;
+}
+
+void benchmark(const PixelFormatKernel &kernel, const Gamma &gamma)
+{
+	const int count = bench_width*bench_height;
+	vector<Color> colors(count);
+	fill_colors(colors);
+	vector<unsigned char> bytes(count*sizeof(Color));
+
+	for(int i = 0; i < formats_count; ++i)
+	{
+		const Format &f = formats[i];
+		cout << setw(6) << kernel.name << "  " << setw(20) << f.name;
+		for(int g = 0; g < 2; ++g)
+		{
+			chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+			for(int j = 0; j < bench_repeats; ++j)
+				kernel.color_to_pixelformat(&bytes.front(), &colors.front(), f.pf, g ? &gamma : NULL, count);
+			cout << "  " << (g ? "gamma" : "to pf") << " "
+			     << fixed << setprecision(1) << setw(8) << mpixels_per_second(begin, (long long)count*bench_repeats);
+		}
+		chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+		for(int j = 0; j < bench_repeats; ++j)
+			kernel.pixelformat_to_color(&colors.front(), &bytes.front(), f.pf, count);
+		cout << "  from pf " << setw(8) << mpixels_per_second(begin, (long long)count*bench_repeats)
+		     << " Mpixels/s" << endl;
+	}
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main(int argc, char **argv)
+{
+	Gamma gamma(2.2f);
+	const char *names[] = { "scalar", "sse2", "avx2" };
+	bool bench = benchmark_requested(argc, argv);
+
+	PixelFormatKernel scalar = PixelFormatKernel::create("scalar");
+	int failures = 0;
+	for(int i = 0; i < 3; ++i)
+	{
+		PixelFormatKernel kernel;
+		if (!create_kernel(kernel, &PixelFormatKernel::create, names[i]))
+			continue;
+		failures += test(scalar, kernel, gamma);
+		if (bench)
+			benchmark(kernel, gamma);
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file rendercache.cpp
+**	\brief Test of reusing of static task sub-trees by RenderCache
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <iostream>
+
+#include <synfig/main.h>
+#include <synfig/rendering/rendercache.h>
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/common/task/tasktransformation.h>
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+const int frame_width = 256;
+const int frame_height = 256;
+const char renderer[] = "software";
+
+/* === P R O C E D U R E S ================================================= */
+
+// the same tasks as Layer_Bitmap builds
+Task::Handle build_bitmap(const SurfaceResource::Handle &surface, const Matrix &matrix)
+{
+	TaskSurface::Handle task_surface(new TaskSurface());
+	task_surface->target_surface = surface;
+	task_surface->target_rect = RectInt(VectorInt(), surface->get_size());
+	task_surface->source_rect = Rect(0.0, 0.0, 1.0, 1.0);
+
+	TaskTransformationAffine::Handle task_transform(new TaskTransformationAffine());
+	task_transform->transformation->matrix = matrix;
+	task_transform->sub_task() = task_surface;
+	return task_transform;
+}
+
+// static background and sprite which moves from frame to frame
+Task::List build_frame(
+	const SurfaceResource::Handle &background,
+	const SurfaceResource::Handle &sprite,
+	int frame )
+{
+	Matrix background_matrix;
+	background_matrix.m00 = 2.0; background_matrix.m20 = -1.0;
+	background_matrix.m11 = 2.0; background_matrix.m21 = -1.0;
+
+	Matrix sprite_matrix;
+	sprite_matrix.m00 = 0.5; sprite_matrix.m20 = -0.5 + 0.01*frame;
+	sprite_matrix.m11 = 0.5; sprite_matrix.m21 = -0.5;
+
+	TaskBlend::Handle blend(new TaskBlend());
+	blend->sub_task_a() = build_bitmap(background, background_matrix);
+	blend->sub_task_b() = build_bitmap(sprite, sprite_matrix);
+	blend->target_surface = new SurfaceResource();
+	blend->target_surface->create(frame_width, frame_height);
+	blend->set_coords(Rect(-1.0, -1.0, 1.0, 1.0), VectorInt(frame_width, frame_height));
+
+	return Task::List(1, blend);
+}
+
+SurfaceResource::Handle get_cached_surface(const Task::List &list)
+{
+	TaskBlend::Handle blend = TaskBlend::Handle::cast_dynamic(list.back());
+	TaskSurface::Handle surface = blend ? TaskSurface::Handle::cast_dynamic(blend->sub_task_a()) : TaskSurface::Handle();
+	return surface ? surface->target_surface : SurfaceResource::Handle();
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main()
+{
+	Main main(".");
+
+	SurfaceResource::Handle background(new SurfaceResource());
+	background->create(frame_width, frame_height);
+	SurfaceResource::Handle sprite(new SurfaceResource());
+	sprite->create(64, 64);
+
+	RenderCache cache(64*1024*1024);
+	int failures = 0;
+
+	// first frame: background is met for the first time, nothing to store
+	Task::List list = build_frame(background, sprite, 0);
+	RenderCache::EntryList entries;
+	cache.process(list, renderer, entries);
+	if (list.size() != 1 || !entries.empty())
+		{ cerr << "frame 0: unknown sub-tree is stored" << endl; ++failures; }
+	cache.store(entries);
+
+	// second frame: background is met again, it renders separately to be stored,
+	// moving sprite has new parameters and should not be stored
+	list = build_frame(background, sprite, 1);
+	entries.clear();
+	cache.process(list, renderer, entries);
+	if (list.size() != 2 || entries.size() != 1)
+		{ cerr << "frame 1: static sub-tree is not separated" << endl; ++failures; }
+	SurfaceResource::Handle stored = entries.empty() ? SurfaceResource::Handle() : entries.front().surface;
+	cache.store(entries);
+
+	// next frames: background is taken from cache
+	for(int frame = 2; frame < 5; ++frame)
+	{
+		list = build_frame(background, sprite, frame);
+		entries.clear();
+		cache.process(list, renderer, entries);
+		if (list.size() != 1 || !entries.empty() || !stored || get_cached_surface(list) != stored)
+			{ cerr << "frame " << frame << ": static sub-tree is not reused" << endl; ++failures; }
+		cache.store(entries);
+	}
+
+	// modified surface gets new revision, so old result must not be used
+	background->clear();
+	list = build_frame(background, sprite, 5);
+	entries.clear();
+	cache.process(list, renderer, entries);
+	if (stored && get_cached_surface(list) == stored)
+		{ cerr << "frame 5: outdated sub-tree is reused" << endl; ++failures; }
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file testhelpers.h
+**	\brief Helpers shared by tests and benchmarks of rendering functions
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_TEST_TESTHELPERS_H
+#define __SYNFIG_TEST_TESTHELPERS_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <synfig/color.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+//! random value in range [min, max], default range is a bit wider
+//! than [0, 1] to check clamping
+inline float random_value(float min = -0.2f, float max = 1.2f)
+	{ return min + (float)rand()/(float)RAND_MAX*(max - min); }
+
+//! random colors, every 8th color is fully transparent
+inline void fill_colors(std::vector<synfig::Color> &colors)
+{
+	for(std::vector<synfig::Color>::iterator i = colors.begin(); i != colors.end(); ++i)
+		*i = synfig::Color(random_value(), random_value(), random_value(), rand()%8 ? random_value() : 0.f);
+}
+
+inline double mpixels_per_second(std::chrono::steady_clock::time_point begin, long long pixels)
+{
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return seconds > 0.0 ? (double)pixels/seconds*1e-6 : 0.0;
+}
+
+//! Benchmarks are slow, so they run only by request:
+//! with --benchmark argument or when SYNFIG_TEST_BENCHMARK is set
+inline bool benchmark_requested(int argc, char **argv)
+{
+	for(int i = 1; i < argc; ++i)
+		if (!strcmp(argv[i], "--benchmark"))
+			return true;
+	const char *s = getenv("SYNFIG_TEST_BENCHMARK");
+	return s && *s && strcmp(s, "0");
+}
+
+//! Creates kernel of instruction set \a name by \a create function,
+//! returns false when this instruction set is not supported by CPU
+template<typename Kernel>
+bool create_kernel(Kernel &kernel, Kernel (*create)(const char*), const char *name)
+{
+	kernel = create(name);
+	if (!strcmp(kernel.name, name))
+		return true;
+	std::cout << name << ": not supported" << std::endl;
+	return false;
+}
+
+/* === E N D =============================================================== */
+
+#endif
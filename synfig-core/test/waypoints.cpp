@@ -0,0 +1,239 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file waypoints.cpp
+**	\brief Test and benchmark of evaluation of animated value nodes
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2026 agent
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cmath>
+#include <iostream>
+
+#include <synfig/type.h>
+#include <synfig/base_types.h>
+#include <synfig/waypoint.h>
+#include <synfig/debug/measure.h>
+#include <synfig/valuenodes/valuenode_animated.h>
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace std;
+using namespace etl;
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+const int waypoints_count = 5000;
+const int samples_count = 200000;
+const Real time_step = 0.04;
+
+const Interpolation interpolations[] = {
+	INTERPOLATION_TCB,
+	INTERPOLATION_CLAMPED,
+	INTERPOLATION_LINEAR,
+	INTERPOLATION_HALT,
+	INTERPOLATION_TCB,
+	INTERPOLATION_CONSTANT };
+const int interpolations_count = sizeof(interpolations)/sizeof(interpolations[0]);
+
+/* === P R O C E D U R E S ================================================= */
+
+Real sample_value(int i)
+	{ return sin(0.37*i) + 0.01*i; }
+
+Time sample_time(int i)
+	{ return Time((Real)i*time_step*(Real)waypoints_count/(Real)samples_count); }
+
+ValueNode_Animated::Handle create_animated(const WaypointList &waypoints)
+{
+	ValueNode_Animated::Handle node = ValueNode_Animated::create(type_real);
+	for(WaypointList::const_iterator i = waypoints.begin(); i != waypoints.end(); ++i)
+	{
+		Waypoint waypoint(i->get_value(), i->get_time());
+		waypoint.set_before(i->get_before());
+		waypoint.set_after(i->get_after());
+		waypoint.set_parent_value_node(node.get());
+		node->editable_waypoint_list().push_back(waypoint);
+	}
+	node->changed();
+	return node;
+}
+
+ValueNode_Animated::Handle create_animated()
+{
+	WaypointList waypoints;
+	for(int i = 0; i < waypoints_count; ++i)
+	{
+		Waypoint waypoint(ValueBase(sample_value(i)), Time((Real)i*time_step));
+		waypoint.set_before(interpolations[i % interpolations_count]);
+		waypoint.set_after(interpolations[(i + 1) % interpolations_count]);
+		waypoints.push_back(waypoint);
+	}
+	return create_animated(waypoints);
+}
+
+int compare(const ValueNode_Animated &a, const ValueNode_Animated &b, const char *name)
+{
+	for(int i = 0; i < samples_count; ++i)
+	{
+		Time t = sample_time(i);
+		Real va = a(t).get(Real());
+		Real vb = b(t).get(Real());
+		if (fabs(va - vb) > 1e-9)
+		{
+			cerr << name << ": values differs at " << (Real)t << ": " << va << " != " << vb << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int waypoints_test_values()
+{
+	ValueNode_Animated::Handle node = create_animated();
+	const WaypointList &waypoints = node->waypoint_list();
+	for(WaypointList::const_iterator i = waypoints.begin(); i != waypoints.end(); ++i)
+	{
+		Real expected = i->get_value().get(Real());
+		Real value = (*node)(i->get_time()).get(Real());
+		if (fabs(value - expected) > 1e-6)
+		{
+			cerr << "waypoints_test_values: value at " << (Real)i->get_time()
+			     << " is " << value << ", expected " << expected << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int waypoints_test_incremental()
+{
+	int failures = 0;
+	ValueNode_Animated::Handle node = create_animated();
+
+	// change value and interpolation of waypoint
+	{
+		Waypoint &waypoint = node->editable_waypoint_list()[waypoints_count/2];
+		waypoint.set_value(ValueBase(Real(10.0)));
+		waypoint.set_before(INTERPOLATION_TCB);
+		waypoint.set_after(INTERPOLATION_CLAMPED);
+		node->changed();
+		failures += compare(*node, *create_animated(node->waypoint_list()), "change waypoint");
+	}
+
+	// move waypoint in time
+	{
+		Waypoint &waypoint = node->editable_waypoint_list()[waypoints_count/3];
+		waypoint.set_time(waypoint.get_time() + Time(0.5*time_step));
+		node->changed();
+		failures += compare(*node, *create_animated(node->waypoint_list()), "move waypoint");
+	}
+
+	// add waypoint
+	{
+		node->new_waypoint(Time(((Real)waypoints_count/4 + 0.5)*time_step), ValueBase(Real(-10.0)));
+		failures += compare(*node, *create_animated(node->waypoint_list()), "add waypoint");
+	}
+
+	// remove waypoint
+	{
+		UniqueID uid = node->waypoint_list()[waypoints_count/5];
+		node->erase(uid);
+		failures += compare(*node, *create_animated(node->waypoint_list()), "remove waypoint");
+	}
+
+	// waypoint with TCB before and other interpolation after changes
+	// tangent of the previous segment, edits close to it should keep that change
+	{
+		WaypointList waypoints;
+		for(int i = 0; i < 20; ++i)
+		{
+			Waypoint waypoint(ValueBase(sample_value(i)), Time((Real)i*time_step));
+			waypoint.set_before(i == 14 ? INTERPOLATION_TCB : INTERPOLATION_CLAMPED);
+			waypoint.set_after(i == 14 ? INTERPOLATION_LINEAR : INTERPOLATION_CLAMPED);
+			waypoints.push_back(waypoint);
+		}
+		for(int i = 1; i < 14; ++i)
+		{
+			ValueNode_Animated::Handle node = create_animated(waypoints);
+			node->editable_waypoint_list()[i].set_value(ValueBase(Real(10.0)));
+			node->changed();
+			failures += compare(*node, *create_animated(node->waypoint_list()), "change waypoint before TCB/LINEAR");
+		}
+	}
+
+	return failures;
+}
+
+void waypoints_benchmark()
+{
+	ValueNode_Animated::Handle node = create_animated();
+	Real sum = 0.0;
+
+	{
+		debug::Measure measure("evaluate sequentially");
+		for(int i = 0; i < samples_count; ++i)
+			sum += (*node)(sample_time(i)).get(Real());
+	}
+
+	{
+		debug::Measure measure("evaluate randomly");
+		for(int i = 0; i < samples_count; ++i)
+			sum += (*node)(sample_time((int)((long long)i*7919 % samples_count))).get(Real());
+	}
+
+	{
+		debug::Measure measure("change one waypoint");
+		for(int i = 0; i < 100; ++i)
+		{
+			node->editable_waypoint_list()[(i*37) % waypoints_count].set_value(ValueBase(sample_value(i)));
+			node->changed();
+		}
+	}
+
+	cout << "checksum: " << sum << endl;
+}
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main()
+{
+	Type::subsys_init();
+
+	int failures = 0;
+
+	failures += waypoints_test_values();
+	failures += waypoints_test_incremental();
+	waypoints_benchmark();
+
+	Type::subsys_stop();
+
+	return failures;
+}
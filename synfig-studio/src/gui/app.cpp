@@ -555,6 +555,11 @@ public:
 				value=strprintf("%i",App::auto_recover->get_timeout_ms());
 				return true;
 			}
+			if(key=="autosave_backup_threaded")
+			{
+				value=strprintf("%i",App::auto_recover->get_threaded());
+				return true;
+			}
 			if(key=="restrict_radius_ducks")
 			{
 				value=strprintf("%i",(int)App::restrict_radius_ducks);
@@ -729,6 +734,12 @@ public:
 				App::auto_recover->set_timeout_ms(i);
 				return true;
 			}
+			if(key=="autosave_backup_threaded")
+			{
+				int i(atoi(value.c_str()));
+				App::auto_recover->set_threaded(i);
+				return true;
+			}
 			if(key=="file_history.size")
 			{
 				int i(atoi(value.c_str()));
@@ -907,6 +918,7 @@ public:
 #endif
 		ret.push_back("autosave_backup");
 		ret.push_back("autosave_backup_interval");
+		ret.push_back("autosave_backup_threaded");
 		ret.push_back("restrict_radius_ducks");
 		ret.push_back("resize_imported_images");
 		ret.push_back("enable_experimental_features");
@@ -2284,6 +2296,7 @@ App::restore_default_settings()
 	synfigapp::Main::settings().set_value("pref.ui_handle_tooltip_flag",         temp.str());
 	synfigapp::Main::settings().set_value("pref.autosave_backup",                "1");
 	synfigapp::Main::settings().set_value("pref.autosave_backup_interval",       "15000");
+	synfigapp::Main::settings().set_value("pref.autosave_backup_threaded",       "1");
 	synfigapp::Main::settings().set_value("pref.image_editor_path",             "");
 
 }
@@ -30,14 +30,23 @@
 #endif
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
 #include <sigc++/sigc++.h>
 
+#include <glib.h>
+#include <glib/gstdio.h>
+
 #include <ETL/stringf>
 #include <ETL/clock>
 //#include <ETL/thread>
 #include <glibmm/thread.h>
+#include <glibmm/miscutils.h>
 
+#include <synfig/filesystemnative.h>
 #include <synfig/general.h>
+#include <synfig/threadpool.h>
 
 #include <glibmm/main.h>
 
@@ -69,8 +78,77 @@ using namespace synfig;
 /* === G L O B A L S ======================================================= */
 //const double delay_factor = 3;
 //Warning: Unused variable delay_factor
+
+namespace {
+	const char peaks_magic[8] = { 'S', 'I', 'F', 'P', 'E', 'A', 'K', 'S' };
+	const unsigned int peaks_version = 1;
+	const unsigned int peaks_byte_order = 0x01020304;
+
+	//! header of peaks file, all numbers are stored in native byte order
+	struct PeaksHeader {
+		char magic[8];
+		unsigned int version;
+		unsigned int byte_order;
+		long long size;
+		long long mtime;
+		int frequency;
+		int block;
+		long long count;
+	};
+
+	// analysis service, used only from main thread
+	bool save_peaks = true;
+	std::map<std::string, studio::AudioPeaks::Handle> peaks_cache;
+	std::set<std::string> peaks_loading;
+	sigc::signal<void, std::string> peaks_ready;
+}
+
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+void on_peaks_analyzed(std::string filename, studio::AudioPeaks::Handle peaks)
+{
+	peaks_loading.erase(filename);
+	peaks_cache[filename] = peaks;
+	peaks_ready.emit(filename);
+}
+
+//! runs in thread pool, result is passed to main thread by on_peaks_analyzed()
+void analyze_peaks(std::string filename, bool save)
+{
+	studio::AudioPeaks::Handle peaks(new studio::AudioPeaks());
+	GStatBuf buf;
+	if (!g_stat(filename.c_str(), &buf)) {
+		peaks->size = (long long)buf.st_size;
+		peaks->mtime = (long long)buf.st_mtime;
+		if (!peaks->load(filename)) {
+			SoundProcessor::PCM::Handle pcm = SoundProcessor::decode(SoundProcessor::Sound(filename));
+			if (pcm) {
+				peaks->build(*pcm);
+				if (save) peaks->save(filename);
+			}
+		}
+	}
+
+	Glib::signal_idle().connect_once(
+		sigc::bind(sigc::ptr_fun(&on_peaks_analyzed), filename, peaks) );
+}
+
+//! removes peaks of file from cache if file was changed
+void check_peaks(const std::string &filename)
+{
+	std::map<std::string, studio::AudioPeaks::Handle>::iterator i = peaks_cache.find(filename);
+	if (i == peaks_cache.end()) return;
+	GStatBuf buf;
+	if ( g_stat(filename.c_str(), &buf)
+	  || i->second->size != (long long)buf.st_size
+	  || i->second->mtime != (long long)buf.st_mtime )
+		peaks_cache.erase(i);
+}
+
+}
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -79,11 +157,176 @@ using namespace synfig;
 struct FSOUND_SAMPLE;
 using studio::AudioContainer;
 
-bool build_profile(FSOUND_SAMPLE */*sample*/, double &/*samplerate*/, std::vector<char> &/*samples*/)
-	{ return false; } // not implemented
+struct scrubinfo {};
 
+//----- AudioPeaks Implementation -----------
+void studio::AudioPeaks::build(const SoundProcessor::PCM &pcm)
+{
+	frequency = pcm.frequency;
+	levels.clear();
+	levels.push_back(std::vector<Peak>());
+
+	long long count = pcm.get_ready();
+	if (count <= 0) return;
+	std::vector<Peak> &first = levels.front();
+	first.reserve(count/block + 1);
+	const float k = 1.f/32768.f;
+	const int16_t *data = &pcm.samples.front();
+	for(long long i = 0; i < count; i += block) {
+		const int16_t *s = data + i*pcm.channels;
+		const int16_t *end = data + std::min(i + block, count)*pcm.channels;
+		int16_t min = *s, max = *s;
+		for(; s < end; ++s)
+			{ min = std::min(min, *s); max = std::max(max, *s); }
+		first.push_back(Peak(min*k, max*k));
+	}
+	build_levels();
+}
 
-struct scrubinfo {};
+void studio::AudioPeaks::build_levels()
+{
+	levels.resize(1);
+	while(levels.back().size() > 1) {
+		const std::vector<Peak> &prev = levels.back();
+		std::vector<Peak> next((prev.size() + 1)/2);
+		for(size_t i = 0; i < next.size(); ++i) {
+			next[i] = prev[2*i];
+			if (2*i + 1 < prev.size())
+				next[i].merge(prev[2*i + 1]);
+		}
+		levels.push_back(std::vector<Peak>());
+		levels.back().swap(next);
+	}
+}
+
+studio::AudioPeaks::Peak studio::AudioPeaks::get_peak(double begin, double end) const
+{
+	if (empty()) return Peak();
+	if (end < begin) std::swap(begin, end);
+
+	// interval in peaks of first level
+	double b = begin*frequency/block;
+	double e = end*frequency/block;
+
+	// choose level where interval covers a few peaks
+	int level = 0;
+	while(level + 1 < (int)levels.size() && (double)(2 << level) <= 0.5*(e - b))
+		++level;
+
+	const std::vector<Peak> &peaks = levels[level];
+	double k = 1.0/(double)(1 << level);
+	long long i0 = std::max(0ll, (long long)floor(b*k));
+	long long i1 = std::min((long long)peaks.size(), (long long)ceil(e*k));
+	if (i0 >= i1) return Peak();
+
+	Peak peak = peaks[i0];
+	for(long long i = i0 + 1; i < i1; ++i)
+		peak.merge(peaks[i]);
+	return peak;
+}
+
+void studio::AudioPeaks::get_peaks(std::vector<Peak> &out, double begin, double end, int count) const
+{
+	out.clear();
+	if (count <= 0) return;
+	out.resize(count);
+	double step = (end - begin)/count;
+	for(int i = 0; i < count; ++i)
+		out[i] = get_peak(begin + i*step, begin + (i + 1)*step);
+}
+
+std::string studio::AudioPeaks::get_peaks_directory()
+{
+	return Glib::get_user_cache_dir()
+		 + ETL_DIRECTORY_SEPARATOR + "synfig"
+		 + ETL_DIRECTORY_SEPARATOR + "peaks";
+}
+
+std::string studio::AudioPeaks::get_peaks_filename(const std::string &sound_filename)
+{
+	gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, absolute_path(sound_filename).c_str(), -1);
+	std::string filename = get_peaks_directory() + ETL_DIRECTORY_SEPARATOR + hash + ".peaks";
+	g_free(hash);
+	return filename;
+}
+
+bool studio::AudioPeaks::load(const std::string &sound_filename)
+{
+	std::string filename = get_peaks_filename(sound_filename);
+	GStatBuf buf;
+	if (g_stat(filename.c_str(), &buf)) return false;
+	long long file_size = (long long)buf.st_size;
+
+	FileSystem::ReadStream::Handle stream =
+		FileSystemNative::instance()->get_read_stream(filename);
+	if (!stream) return false;
+
+	PeaksHeader header;
+	if ( !stream->read((char*)&header, sizeof(header))
+	  || memcmp(header.magic, peaks_magic, sizeof(peaks_magic))
+	  || header.version != peaks_version
+	  || header.byte_order != peaks_byte_order
+	  || header.size != size
+	  || header.mtime != mtime
+	  || header.frequency <= 0
+	  || header.block != block
+	  || header.count <= 0
+	  || header.count > (file_size - (long long)sizeof(header))/(long long)sizeof(Peak) ) return false;
+
+	// count is checked against the file size, so broken file cannot cause huge allocation
+	std::vector<Peak> first(header.count);
+	if (!stream->read((char*)&first.front(), first.size()*sizeof(Peak)))
+		return false;
+
+	frequency = header.frequency;
+	levels.clear();
+	levels.push_back(std::vector<Peak>());
+	levels.front().swap(first);
+	build_levels();
+	return true;
+}
+
+bool studio::AudioPeaks::save(const std::string &sound_filename) const
+{
+	if (empty()) return false;
+
+	std::string directory = get_peaks_directory();
+	if (g_mkdir_with_parents(directory.c_str(), 0755)) {
+		synfig::warning("AudioPeaks: cannot create directory: %s", directory.c_str());
+		return false;
+	}
+
+	// unique name of temporary file, because the same file may be analyzed by several processes
+	std::string filename = get_peaks_filename(sound_filename);
+	std::string tmp_filename = strprintf("%s.%08x.TMP", filename.c_str(), (unsigned int)g_random_int());
+	FileSystem::WriteStream::Handle stream = FileSystemNative::instance()->get_write_stream(tmp_filename);
+	if (!stream) {
+		synfig::warning("AudioPeaks: cannot write peaks file: %s", filename.c_str());
+		return false;
+	}
+
+	const std::vector<Peak> &first = levels.front();
+	PeaksHeader header;
+	memcpy(header.magic, peaks_magic, sizeof(peaks_magic));
+	header.version = peaks_version;
+	header.byte_order = peaks_byte_order;
+	header.size = size;
+	header.mtime = mtime;
+	header.frequency = frequency;
+	header.block = block;
+	header.count = (long long)first.size();
+	stream->write((const char*)&header, sizeof(header));
+	stream->write((const char*)&first.front(), first.size()*sizeof(Peak));
+	bool success = !stream->fail();
+	stream.reset();
+
+	if (success && FileSystemNative::instance()->file_rename(tmp_filename, filename))
+		return true;
+
+	synfig::warning("AudioPeaks: cannot write peaks file: %s", filename.c_str());
+	FileSystemNative::instance()->file_remove(tmp_filename);
+	return false;
+}
 
 //----- AudioProfile Implementation -----------
 void studio::AudioProfile::clear()
@@ -113,6 +356,8 @@ double studio::AudioProfile::get_offset() const
 
 struct studio::AudioContainer::AudioImp
 {
+	std::string			filename;
+
 	//Sample load time information
 	FSOUND_SAMPLE *		sample;
 	int					channel;
@@ -219,8 +464,49 @@ bool studio::AudioContainer::load(const std::string &filename,const std::string
 	return imp->load(filename,filedirectory);
 }
 
-handle<studio::AudioProfile> studio::AudioContainer::get_profile(float /*samplerate*/)
-	{ return handle<studio::AudioProfile>(); }
+handle<studio::AudioProfile> studio::AudioContainer::get_profile(float samplerate)
+{
+	if (!imp || imp->filename.empty() || samplerate <= 0)
+		return handle<studio::AudioProfile>();
+	if (profilevalid && prof && prof->get_samplerate() == samplerate)
+		return prof;
+
+	AudioPeaks::Handle peaks = get_peaks(imp->filename);
+	if (!peaks || peaks->empty())
+		return handle<studio::AudioProfile>();
+
+	if (!prof) prof = new AudioProfile();
+	prof->clear();
+	prof->set_samplerate(samplerate);
+	prof->parent = this;
+	int count = (int)ceil(peaks->get_duration()*samplerate);
+	peaks->get_peaks(prof->samples, 0.0, count/(double)samplerate, count);
+	profilevalid = true;
+	return prof;
+}
+
+studio::AudioPeaks::Handle studio::AudioContainer::get_peaks(const std::string &filename)
+{
+	std::map<std::string, AudioPeaks::Handle>::const_iterator i = peaks_cache.find(filename);
+	if (i != peaks_cache.end())
+		return i->second;
+
+	if (!filename.empty() && !peaks_loading.count(filename)) {
+		peaks_loading.insert(filename);
+		ThreadPool::instance.enqueue( sigc::bind(
+			sigc::ptr_fun(&analyze_peaks), filename, save_peaks ));
+	}
+	return AudioPeaks::Handle();
+}
+
+sigc::signal<void, std::string>& studio::AudioContainer::signal_peaks_ready()
+	{ return peaks_ready; }
+
+bool studio::AudioContainer::get_save_peaks()
+	{ return save_peaks; }
+
+void studio::AudioContainer::set_save_peaks(bool x)
+	{ save_peaks = x; }
 
 void studio::AudioContainer::clear()
 {
@@ -275,11 +561,20 @@ bool AudioContainer::isPaused() const
 
 //----------- Audio imp information -------------------
 
-bool studio::AudioContainer::AudioImp::load(const std::string &/*filename*/,
-											const std::string &/*filedirectory*/)
+bool studio::AudioContainer::AudioImp::load(const std::string &filename,
+											const std::string &filedirectory)
 {
 	clear();
-	return false;
+	std::string full_filename = filedirectory.empty() || Glib::path_is_absolute(filename)
+	                          ? filename : Glib::build_filename(filedirectory, filename);
+	if (full_filename.empty() || !g_file_test(full_filename.c_str(), G_FILE_TEST_IS_REGULAR))
+		return false;
+
+	// start analysis, so peaks will be ready when they are needed
+	this->filename = full_filename;
+	check_peaks(full_filename);
+	AudioContainer::get_peaks(full_filename);
+	return true;
 }
 
 void studio::AudioContainer::AudioImp::play(double /*t*/)
@@ -293,6 +588,7 @@ void studio::AudioContainer::AudioImp::stop()
 
 void studio::AudioContainer::AudioImp::clear()
 {
+	filename.clear();
 	channel = 0;
 	sample = 0;
 	playing = false;
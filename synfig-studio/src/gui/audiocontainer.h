@@ -30,9 +30,11 @@
 
 #include <ETL/handle>
 
+#include <algorithm>
 #include <vector>
 #include <string>
 
+#include <synfig/soundprocessor.h>
 #include <synfig/time.h>
 
 /* === M A C R O S ========================================================= */
@@ -45,11 +47,65 @@ namespace studio {
 
 class AudioContainer;
 
+//! Minimal and maximal values of sound samples at several resolutions.
+//! Peaks of each next level covers twice more samples than peaks of previous one,
+//! so peaks for any time interval are found by few peaks of suitable level.
+class AudioPeaks : public etl::shared_object
+{
+public:
+	typedef etl::handle<AudioPeaks> Handle;
+
+	class Peak {
+	public:
+		float min, max;
+		Peak(): min(), max() { }
+		Peak(float min, float max): min(min), max(max) { }
+		void merge(const Peak &x)
+			{ min = std::min(min, x.min); max = std::max(max, x.max); }
+	};
+
+	//! count of samples for each peak of first level
+	static const int block = 64;
+
+	int frequency;
+	//! size and modification time of sound file
+	long long size;
+	long long mtime;
+	std::vector< std::vector<Peak> > levels;
+
+	AudioPeaks(): frequency(), size(), mtime() { }
+
+	bool empty() const
+		{ return frequency <= 0 || levels.empty() || levels.front().empty(); }
+	double get_duration() const
+		{ return empty() ? 0.0 : (double)levels.front().size()*block/frequency; }
+
+	//! builds all levels from decoded sound
+	void build(const synfig::SoundProcessor::PCM &pcm);
+	//! builds next levels from the first one
+	void build_levels();
+
+	//! returns peak of time interval in seconds
+	Peak get_peak(double begin, double end) const;
+	//! fills \a count peaks for equal parts of time interval
+	void get_peaks(std::vector<Peak> &out, double begin, double end, int count) const;
+
+	//! reads the first level from file saved in cache directory of user,
+	//! size and mtime should be set to check that file is not outdated
+	bool load(const std::string &sound_filename);
+	bool save(const std::string &sound_filename) const;
+
+	//! returns directory for peaks files inside of cache directory of user
+	static std::string get_peaks_directory();
+	//! returns name of peaks file, it's made from hash of absolute path to sound file
+	static std::string get_peaks_filename(const std::string &sound_filename);
+};
+
 //Note: Might want to abstract something to share data between profile and parent
 class AudioProfile : public etl::shared_object
 {
 public:
-	typedef std::vector<char>	SampleProfile;
+	typedef std::vector<AudioPeaks::Peak>	SampleProfile;
 
 private:
 	SampleProfile	samples;
@@ -66,10 +122,10 @@ public:	//samples interface
 	void clear();
 	unsigned int size() const {return samples.size();}
 
-	char operator[](int i) const
+	AudioPeaks::Peak operator[](int i) const
 	{
 		if(i >= 0 && i < (int)samples.size()) return samples[i];
-		else return 0;
+		else return AudioPeaks::Peak();
 	}
 
 public: //
@@ -110,6 +166,16 @@ public: //info gather interface
 	etl::handle<AudioProfile>	get_profile(float samplerate = DEF_DISPLAYSAMPLERATE);
 	bool get_current_time(double &out);
 
+public: //analysis service
+	//! Returns peaks of sound file. If they are not ready then returns empty handle
+	//! and starts analysis in background, signal_peaks_ready() is emitted when it's done.
+	//! Each file is decoded once, peaks are also saved next to the file when allowed.
+	static AudioPeaks::Handle get_peaks(const std::string &filename);
+	static sigc::signal<void, std::string>& signal_peaks_ready();
+
+	static bool get_save_peaks();
+	static void set_save_peaks(bool x);
+
 public: //operational interface
 	bool load(const std::string &filename, const std::string &filedirectory = "");
 	void clear();
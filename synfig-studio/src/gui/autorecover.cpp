@@ -62,7 +62,8 @@ using namespace studio;
 
 AutoRecover::AutoRecover():
 	enabled(1),
-	timeout_ms(15000)
+	timeout_ms(15000),
+	threaded(true)
 { }
 
 AutoRecover::~AutoRecover()
@@ -102,7 +103,7 @@ AutoRecover::auto_backup()
 		for(std::list< etl::handle<Instance> >::iterator i = App::instance_list.begin(); i != App::instance_list.end(); ++i)
 			try
 			{
-				if ((*i)->backup())
+				if ((*i)->backup(threaded, sigc::bind(sigc::ptr_fun(&AutoRecover::on_backup_finished), (*i)->get_file_name())))
 					++count;
 			}
 			catch(...)
@@ -124,6 +125,13 @@ AutoRecover::auto_backup()
 		synfig::error("AutoRecover::auto_backup(): %d FILES NOT BACKED UP.", total - count);
 }
 
+void
+AutoRecover::on_backup_finished(bool success, synfig::String filename)
+{
+	if (!success)
+		synfig::error("AutoRecover::auto_backup(): FILE NOT BACKED UP: %s", filename.c_str());
+}
+
 bool
 AutoRecover::recovery_needed()const
 {
@@ -44,9 +44,11 @@ class AutoRecover
 {
 	bool enabled;
 	int timeout_ms;
+	bool threaded;
 	sigc::connection connection;
 
 	void set_timer(bool enabled, int timeout_ms);
+	static void on_backup_finished(bool success, synfig::String filename);
 public:
 	AutoRecover();
 	~AutoRecover();
@@ -61,6 +63,12 @@ public:
 	void set_timeout_ms(int value)
 		{ set_timer(get_enabled(), value); }
 
+	//! when set, files are written in background, see synfigapp::Instance::backup()
+	bool get_threaded() const
+		{ return threaded; }
+	void set_threaded(bool value)
+		{ threaded = value; }
+
 	void auto_backup();
 
 	bool recovery_needed()const;
@@ -39,8 +39,10 @@
 
 #include <synfig/general.h>
 #include <synfig/layers/layer_pastecanvas.h>
+#include <synfig/layers/layer_sound.h>
 #include <synfig/valuenodes/valuenode_dynamiclist.h>
 
+#include <gui/audiocontainer.h>
 #include <gui/instance.h>
 
 #include "cellrenderer_timetrack.h"
@@ -456,6 +458,48 @@ find_editable_waypoint(const ValueDesc &v, const Time &t, const Time& scope = Ti
 	return UniqueID::nil();
 }
 
+static void
+render_waveform(
+	const ::Cairo::RefPtr< ::Cairo::Context>& cr,
+	const Gdk::Rectangle& cell_area,
+	const Layer_Sound &layer,
+	const Time &lower,
+	const Time &upper,
+	const Time &time_offset,
+	double time_k )
+{
+	String filename;
+	try { filename = layer.get_real_filename(); } catch(...) { }
+	if (filename.empty())
+		return;
+
+	// peaks are not ready yet, cell will be redrawn by AudioContainer::signal_peaks_ready()
+	AudioPeaks::Handle peaks = AudioContainer::get_peaks(filename);
+	if (!peaks || peaks->empty())
+		return;
+
+	// one peak per pixel, so drawing time depends on visible width only
+	const int width = cell_area.get_width();
+	Time delay = layer.get_param("delay").get(Time());
+	double begin = (double)lower/time_k + (double)time_offset - (double)delay;
+	double end = (double)upper/time_k + (double)time_offset - (double)delay;
+	std::vector<AudioPeaks::Peak> list;
+	peaks->get_peaks(list, begin, end, width);
+
+	const double h = 0.5*(cell_area.get_height() - 2);
+	const double y = cell_area.get_y() + 0.5*cell_area.get_height();
+	for(int i = 0; i < width; ++i) {
+		const AudioPeaks::Peak &peak = list[i];
+		if (peak.max <= peak.min)
+			continue;
+		double min = std::max(-1.0, std::min(1.0, (double)peak.min));
+		double max = std::max(-1.0, std::min(1.0, (double)peak.max));
+		cr->rectangle(cell_area.get_x() + i, y - max*h, 1, std::max(1.0, (max - min)*h));
+	}
+	Gdk::Cairo::set_source_color(cr, Gdk::Color("#7f7fbf"));
+	cr->fill();
+}
+
 /* === M E T H O D S ======================================================= */
 
 CellRenderer_TimeTrack::CellRenderer_TimeTrack():
@@ -541,6 +585,11 @@ CellRenderer_TimeTrack::render_vfunc(
 	Time time_dilation = get_time_dilation_from_vdesc(value_desc);
 	double time_k = time_dilation == Time::zero() ? 1.0 : 1.0/(double)time_dilation;
 
+	//render waveform of sound layer
+	if (value_desc.parent_is_layer() && value_desc.get_param_name() == "filename")
+		if (etl::handle<Layer_Sound> layer = etl::handle<Layer_Sound>::cast_dynamic(value_desc.get_layer()))
+			render_waveform(cr, cell_area, *layer, lower, upper, time_offset, time_k);
+
 	//render time points where value changed
 	{
 		std::set<Time> times;
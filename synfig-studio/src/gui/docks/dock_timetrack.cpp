@@ -40,6 +40,7 @@
 
 #include <helpers.h>
 #include <app.h>
+#include <audiocontainer.h>
 #include <instance.h>
 #include <canvasview.h>
 #include <workarea.h>
@@ -377,6 +378,8 @@ Dock_Timetrack::init_canvas_view_vfunc(etl::loose_handle<CanvasView> canvas_view
 		sigc::mem_fun(*canvas_view, &studio::CanvasView::on_waypoint_clicked_canvasview) );
 	canvas_view->time_model()->signal_changed().connect(
 		sigc::mem_fun(*tree_view,&Gtk::TreeView::queue_draw) );
+	AudioContainer::signal_peaks_ready().connect(
+		sigc::hide(sigc::mem_fun(*tree_view,&Gtk::TreeView::queue_draw)) );
 	canvas_view->set_ext_widget(get_name(), tree_view);
 	tree_view->show();
 
@@ -278,6 +278,7 @@ WorkArea::WorkArea(etl::loose_handle<synfigapp::CanvasInterface> canvas_interfac
 
 	canvas_interface->signal_rend_desc_changed().connect(sigc::mem_fun(*this, &WorkArea::refresh_dimension_info));
 	canvas_interface->signal_time_changed().connect(sigc::mem_fun(*this, &WorkArea::queue_draw));
+	get_canvas()->signal_child_changed().connect(sigc::mem_fun(*this, &WorkArea::on_canvas_child_changed));
 	// When either of the scrolling adjustments change, then redraw.
 	get_scrollx_adjustment()->signal_value_changed().connect(sigc::mem_fun(*this, &WorkArea::queue_scroll));
 	get_scrolly_adjustment()->signal_value_changed().connect(sigc::mem_fun(*this, &WorkArea::queue_scroll));
@@ -2096,6 +2097,22 @@ studio::WorkArea::queue_render(bool refresh)
 		Glib::PRIORITY_DEFAULT );
 }
 
+void
+studio::WorkArea::queue_render_changes()
+	{ queue_render(!renderer_canvas->is_changes_tracked()); }
+
+void
+studio::WorkArea::on_canvas_child_changed(const synfig::Node *node)
+{
+	// changes of the root layers are tracked by renderer,
+	// all other changes makes the whole rendered cache outdated
+	const Layer *layer = dynamic_cast<const Layer*>(node);
+	if (layer && layer->get_canvas().get() == get_canvas().get())
+		renderer_canvas->invalidate_layer(layer);
+	else
+		renderer_canvas->clear_render();
+}
+
 void
 studio::WorkArea::set_cursor(const Glib::RefPtr<Gdk::Cursor> &x)
 {
@@ -427,6 +427,10 @@ public:
 	//! initiate background rendering of canvas
 	void queue_render(bool refresh = true);
 
+	//! initiate background rendering of canvas after its change,
+	//! keeps rendered tiles which are not affected by tracked changes of layers
+	void queue_render_changes();
+
 	void zoom_in();
 	void zoom_out();
 	void zoom_fit();
@@ -464,6 +468,7 @@ private:
 	bool on_hruler_event(GdkEvent* event);
 	bool on_vruler_event(GdkEvent* event);
 	void on_duck_selection_single(const etl::handle<Duck>& duck_guid);
+	void on_canvas_child_changed(const synfig::Node *node);
 }; // END of class WorkArea
 
 
@@ -45,6 +45,7 @@
 #include <synfig/canvas.h>
 #include <synfig/context.h>
 #include <synfig/threadpool.h>
+#include <synfig/layers/layer_composite.h>
 #include <synfig/rendering/renderer.h>
 #include <synfig/rendering/common/task/tasktransformation.h>
 
@@ -85,6 +86,70 @@ static long long
 image_rect_size(const RectInt &rect)
 	{ return 4ll*rect.get_width()*rect.get_height(); }
 
+//! returns area of frame which may be changed by change of the layer
+static Rect
+calc_layer_rect(const Layer &layer, const Context &context)
+{
+	// simple composite layer changes only own area,
+	// other layers may change anything under them
+	const Layer_Composite *composite = dynamic_cast<const Layer_Composite*>(&layer);
+	if ( composite
+	  && !layer.reads_context()
+	  && !Color::is_straight(composite->get_blend_method())
+	  && !Color::is_onto(composite->get_blend_method()) )
+	{
+		CanvasBase empty_queue;
+		empty_queue.push_back(Layer::Handle());
+		return layer.get_full_bounding_rect(Context(empty_queue.begin(), context));
+	}
+	return layer.get_full_bounding_rect(context);
+}
+
+//! returns true if layer blends own content onto the context pixel by pixel,
+//! so it doesn't move pixels of context to other places
+static bool
+is_plain_blend(const Layer &layer)
+{
+	const Layer_Composite *composite = dynamic_cast<const Layer_Composite*>(&layer);
+	return composite && !layer.reads_context();
+}
+
+static void
+calc_layer_rects(const Context &context, Renderer_Canvas::LayerRectMap &out_rects)
+{
+	// transformations and filters move or spread pixels of layers under them,
+	// so changes of these layers may affect the whole frame
+	bool plain = true;
+	for(Context i = context; !i->empty(); i = i.get_next()) {
+		out_rects[i->get()] = plain ? calc_layer_rect(**i, i.get_next()) : Rect::full_plane();
+		if (!is_plain_blend(**i)) plain = false;
+	}
+}
+
+static RectInt
+rect_to_pixels(const Rect &rect, const Vector &tl, const Vector &br, int w, int h)
+{
+	if (!rect.is_valid())
+		return RectInt::zero();
+	if (approximate_equal(tl[0], br[0]) || approximate_equal(tl[1], br[1]))
+		return RectInt(0, 0, w, h);
+
+	Real kx = (Real)w/(br[0] - tl[0]);
+	Real ky = (Real)h/(br[1] - tl[1]);
+	Real x0 = (rect.minx - tl[0])*kx, x1 = (rect.maxx - tl[0])*kx;
+	Real y0 = (rect.miny - tl[1])*ky, y1 = (rect.maxy - tl[1])*ky;
+
+	// clamp before conversion to int, rect may be infinite,
+	// and add one pixel for antialiasing
+	RectInt r(
+		(int)floor(std::max(-1.0, std::min((Real)w + 1.0, std::min(x0, x1)))) - 1,
+		(int)floor(std::max(-1.0, std::min((Real)h + 1.0, std::min(y0, y1)))) - 1,
+		(int)ceil (std::max(-1.0, std::min((Real)w + 1.0, std::max(x0, x1)))) + 1,
+		(int)ceil (std::max(-1.0, std::min((Real)h + 1.0, std::max(y0, y1)))) + 1 );
+	r &= RectInt(0, 0, w, h);
+	return r;
+}
+
 /* === M E T H O D S ======================================================= */
 
 Renderer_Canvas::Renderer_Canvas():
@@ -99,6 +164,7 @@ Renderer_Canvas::Renderer_Canvas():
 	max_enqueued_tasks (6),
 	enqueued_tasks(),
 	tiles_size(),
+	changes_tracked(),
 	pixel_format()
 {
 	// check endianness
@@ -307,6 +373,17 @@ Renderer_Canvas::erase_tile(TileList &list, TileList::iterator i, rendering::Tas
 	list.erase(i);
 }
 
+void
+Renderer_Canvas::erase_all_tiles(rendering::Task::List &events)
+{
+	// mutex must be already locked
+	for(TileMap::iterator i = tiles.begin(); i != tiles.end(); ++i)
+		while(!i->second.empty())
+			erase_tile(i->second, i->second.end() - 1, events);
+	tiles.clear();
+	frame_changes.clear();
+}
+
 void
 Renderer_Canvas::remove_extra_tiles(rendering::Task::List &events)
 {
@@ -342,7 +419,85 @@ Renderer_Canvas::remove_extra_tiles(rendering::Task::List &events)
 
 	// remove empty entries from tiles map
 	for(TileMap::iterator i = tiles.begin(); i != tiles.end(); )
-		if (i->second.empty()) tiles.erase(i++); else ++i;
+		if (i->second.empty()) { frame_changes.erase(i->first); tiles.erase(i++); } else ++i;
+}
+
+void
+Renderer_Canvas::check_root_layers(const Canvas::Handle &canvas, rendering::Task::List &events)
+{
+	// mutex must be already locked
+
+	// insertion, removing or reordering of layers is not tracked by invalidate_layer()
+	LayerList layers;
+	layers.reserve(root_layers.size());
+	for(Canvas::const_iterator i = canvas->begin(); i != canvas->end(); ++i)
+		layers.push_back(i->get());
+
+	if (layers != root_layers) {
+		erase_all_tiles(events);
+		root_layers.swap(layers);
+	}
+}
+
+void
+Renderer_Canvas::apply_frame_changes(
+	const Canvas::Handle &canvas,
+	const FrameId &id,
+	rendering::Task::List &events )
+{
+	// mutex must be already locked
+
+	FrameChangesMap::iterator fc = frame_changes.find(id);
+	if (fc == frame_changes.end() || fc->second.changed_layers.empty())
+		return;
+	FrameChanges &changes = fc->second;
+
+	TileMap::iterator ft = tiles.find(id);
+	if (ft == tiles.end() || ft->second.empty())
+		{ frame_changes.erase(fc); return; }
+	TileList &frame_tiles = ft->second;
+
+	RendDesc rend_desc = canvas->rend_desc();
+	rend_desc.clear_flags();
+	rend_desc.set_wh(id.width, id.height);
+	ContextParams context_params(rend_desc.get_render_excluded_contexts());
+
+	// calculate areas of layers at the frame time
+	canvas->set_time(id.time);
+	canvas->set_outline_grow(rend_desc.get_outline_grow());
+	LayerRectMap layer_rects;
+	{
+		CanvasBase sub_queue;
+		Context context = canvas->get_context_sorted(context_params, sub_queue);
+		calc_layer_rects(context, layer_rects);
+	}
+
+	// area of the each changed layer before and after the change
+	bool full = false;
+	Rect rect = Rect::zero();
+	for(LayerSet::const_iterator i = changes.changed_layers.begin(); i != changes.changed_layers.end() && !full; ++i) {
+		LayerRectMap::const_iterator prev = changes.layer_rects.find(*i);
+		LayerRectMap::const_iterator next = layer_rects.find(*i);
+		if (prev == changes.layer_rects.end())
+			{ full = true; break; } // previous state is unknown
+		rect |= prev->second;
+		if (next != layer_rects.end())
+			rect |= next->second;
+	}
+
+	// remaining tiles are actual for the new state
+	changes.changed_layers.clear();
+	changes.layer_rects.swap(layer_rects);
+
+	RectInt dirty_rect = full
+		? id.rect()
+		: rect_to_pixels(rect, rend_desc.get_tl(), rend_desc.get_br(), id.width, id.height);
+	if (!dirty_rect.is_valid())
+		return;
+
+	for(int i = (int)frame_tiles.size() - 1; i >= 0; --i)
+		if (frame_tiles[i] && (frame_tiles[i]->rect && dirty_rect))
+			erase_tile(frame_tiles, frame_tiles.begin() + i, events);
 }
 
 void
@@ -416,12 +571,15 @@ Renderer_Canvas::enqueue_render_frame(
 	const rendering::Renderer::Handle &renderer,
 	const Canvas::Handle &canvas,
 	const RectInt &window_rect,
-	const FrameId &id )
+	const FrameId &id,
+	rendering::Task::List &events )
 {
 	// mutex must be already locked
 
 	const int tile_grid_step = 64;
 
+	apply_frame_changes(canvas, id, events);
+
 	RendDesc rend_desc = canvas->rend_desc();
 	int      w         = id.width;
 	int      h         = id.height;
@@ -460,6 +618,10 @@ Renderer_Canvas::enqueue_render_frame(
 	CanvasBase sub_queue;
 	Context context = canvas->get_context_sorted(context_params, sub_queue);
 	rendering::Task::Handle task = context.build_rendering_task();
+	FrameChanges &changes = frame_changes[id];
+	changes.changed_layers.clear();
+	changes.layer_rects.clear();
+	calc_layer_rects(context, changes.layer_rects);
 	sub_queue.clear();
 
 	// add transformation task to flip result if needed
@@ -531,6 +693,10 @@ Renderer_Canvas::enqueue_render()
 		etl::handle<TimeModel> time_model = canvas_view->time_model();
 		bool			is_playing = canvas_view->is_playing();
 
+		changes_tracked = false;
+		if (canvas)
+			check_root_layers(canvas, events);
+
 		build_onion_frames();
 
 		rendering::Renderer::Handle renderer = rendering::Renderer::get_renderer(renderer_name);
@@ -546,12 +712,12 @@ Renderer_Canvas::enqueue_render()
 
 				// generate rendering task for thumbnail
 				// do it first to be sure that thmubnails will always fully covered by the single tile
-				if (enqueue_render_frame(renderer, canvas, current_thumb.rect(), current_thumb))
+				if (enqueue_render_frame(renderer, canvas, current_thumb.rect(), current_thumb, events))
 					++enqueued;
 
 				// generate rendering tasks for visible areas
 				for(FrameList::const_iterator i = onion_frames.begin(); i != onion_frames.end(); ++i)
-					if (enqueue_render_frame(renderer, canvas, window_rect, i->id))
+					if (enqueue_render_frame(renderer, canvas, window_rect, i->id, events))
 						++enqueued;
 
 				remove_extra_tiles(events);
@@ -589,16 +755,16 @@ Renderer_Canvas::enqueue_render()
 
 					if (future_exists && (!past_exists || future_priority)) {
 						// queue future
-						if (enqueue_render_frame(renderer, canvas, current_thumb.rect(), current_thumb.with_time(future_time)))
+						if (enqueue_render_frame(renderer, canvas, current_thumb.rect(), current_thumb.with_time(future_time), events))
 							++enqueued;
-						if (enqueue_render_frame(renderer, canvas, window_rect, current_frame.with_time(future_time)))
+						if (enqueue_render_frame(renderer, canvas, window_rect, current_frame.with_time(future_time), events))
 							++enqueued;
 						++future;
 					} else {
 						// queue past
-						if (enqueue_render_frame(renderer, canvas, current_thumb.rect(), current_thumb.with_time(past_time)))
+						if (enqueue_render_frame(renderer, canvas, current_thumb.rect(), current_thumb.with_time(past_time), events))
 							++enqueued;
-						if (enqueue_render_frame(renderer, canvas, window_rect, current_frame.with_time(past_time)))
+						if (enqueue_render_frame(renderer, canvas, window_rect, current_frame.with_time(past_time), events))
 							++enqueued;
 						++past;
 					}
@@ -643,18 +809,30 @@ Renderer_Canvas::clear_render()
 	{
 		Glib::Threads::Mutex::Lock lock(mutex);
 		cleared = !tiles.empty();
-		for(TileMap::iterator i = tiles.begin(); i != tiles.end(); ++i)
-			while(!i->second.empty()) {
-				TileList::iterator j = i->second.end(); --j;
-				erase_tile(i->second, j++, events);
-			}
-		tiles.clear();
+		erase_all_tiles(events);
 	}
 	rendering::Renderer::cancel(events);
 	if (cleared && get_work_area())
 		get_work_area()->signal_rendering()();
 }
 
+void
+Renderer_Canvas::invalidate_layer(const Layer *layer)
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	changes_tracked = true;
+	for(TileMap::const_iterator i = tiles.begin(); i != tiles.end(); ++i)
+		if (!i->second.empty())
+			frame_changes[i->first].changed_layers.insert(layer);
+}
+
+bool
+Renderer_Canvas::is_changes_tracked()
+{
+	Glib::Threads::Mutex::Lock lock(mutex);
+	return changes_tracked;
+}
+
 Renderer_Canvas::FrameStatus
 Renderer_Canvas::merge_status(FrameStatus a, FrameStatus b) {
 	static FrameStatus map[FS_Count][FS_Count] = {
@@ -680,6 +858,10 @@ Renderer_Canvas::calc_frame_status(const FrameId &id, const RectInt &window_rect
 	if (i == tiles.end() || i->second.empty())
 		return FS_None;
 
+	// some tiles may be outdated by changes of layers
+	FrameChangesMap::const_iterator fc = frame_changes.find(id);
+	bool changed = fc != frame_changes.end() && !fc->second.changed_layers.empty();
+
 	std::vector<RectInt> rects;
 	rects.reserve(20);
 	rects.push_back(window_rect);
@@ -694,7 +876,7 @@ Renderer_Canvas::calc_frame_status(const FrameId &id, const RectInt &window_rect
 
 	if (rects.size() == 1 && rects.front() == window_rect)
 		return FS_None;
-	if (rects.empty())
+	if (rects.empty() && !changed)
 		return FS_Done;
 	return FS_PartiallyDone;
 }
@@ -32,10 +32,12 @@
 
 #include <vector>
 #include <map>
+#include <set>
 
 #include <glibmm/threads.h>
 
 #include <synfig/time.h>
+#include <synfig/layer.h>
 #include <synfig/rendering/task.h>
 #include <synfig/rendering/renderer.h>
 
@@ -136,6 +138,22 @@ public:
 	typedef std::vector<Tile::Handle> TileList;
 	typedef std::map<FrameId, TileList> TileMap;
 
+	//! layer pointers are used as keys only and never dereferenced
+	typedef std::vector<const synfig::Layer*> LayerList;
+	typedef std::set<const synfig::Layer*> LayerSet;
+	typedef std::map<const synfig::Layer*, synfig::Rect> LayerRectMap;
+
+	//! tracked changes of the root layers for one frame
+	class FrameChanges {
+	public:
+		//! areas affected by the root layers, calculated while building of the last rendering task
+		LayerRectMap layer_rects;
+		//! layers changed after that, tiles under them are not removed yet
+		LayerSet changed_layers;
+	};
+
+	typedef std::map<FrameId, FrameChanges> FrameChangesMap;
+
 private:
 	// cache options
 	const long long max_tiles_size_soft; //!< threshold for creation of new tiles
@@ -148,7 +166,8 @@ private:
 	const synfig::Real weight_zoom_out;
 	const int max_enqueued_tasks;
 
-	//! controls access to fields: enqueued_tasks, tiles, onion_frames, visible_frames, current_frame, frame_duration, tiles_size
+	//! controls access to fields: enqueued_tasks, tiles, onion_frames, visible_frames, current_frame, frame_duration, tiles_size,
+	//! frame_changes, root_layers, changes_tracked
 	Glib::Threads::Mutex mutex;
 
 	int enqueued_tasks;
@@ -166,6 +185,13 @@ private:
 	//! increment of this field makes all tiles outdated
 	long long tiles_size;
 
+	//! changes of layers for all frames which have tiles
+	FrameChangesMap frame_changes;
+	//! root layers of canvas, any change of this list makes all tiles outdated
+	LayerList root_layers;
+	//! true when all changes of canvas since last enqueue_render() are passed to invalidate_layer()
+	bool changes_tracked;
+
 	synfig::PixelFormat pixel_format;
 
 	//! uses to normalize alpha value after blending of onion surfaces
@@ -199,15 +225,30 @@ private:
 	//! mutex must be locked before call
 	void erase_tile(TileList &list, TileList::iterator i, synfig::rendering::Task::List &events);
 
+	//! mutex must be locked before call
+	void erase_all_tiles(synfig::rendering::Task::List &events);
+
 	//! mutex must be locked before call
 	void remove_extra_tiles(synfig::rendering::Task::List &events);
 
+	//! mutex must be locked before call
+	//! removes all tiles if list of the root layers was changed
+	void check_root_layers(const synfig::Canvas::Handle &canvas, synfig::rendering::Task::List &events);
+
 	//! mutex must be locked before call
 	void build_onion_frames();
 
 	//! mutex must be locked before call
 	FrameStatus calc_frame_status(const FrameId &id, const synfig::RectInt &window_rect);
 
+	//! mutex must be locked before call
+	//! removes tiles affected by changed layers
+	//! function can change the canvas time
+	void apply_frame_changes(
+		const synfig::Canvas::Handle &canvas,
+		const FrameId &id,
+		synfig::rendering::Task::List &events );
+
 	//! mutex must be locked before call
 	//! returns true if rendering task actually enqueued
 	//! function can change the canvas time
@@ -215,7 +256,8 @@ private:
 		const synfig::rendering::Renderer::Handle &renderer,
 		const synfig::Canvas::Handle &canvas,
 		const synfig::RectInt &window_rect,
-		const FrameId &id );
+		const FrameId &id,
+		synfig::rendering::Task::List &events );
 
 public:
 	Renderer_Canvas();
@@ -227,6 +269,13 @@ public:
 	void wait_render();
 	void clear_render();
 
+	//! marks tiles under the root layer as outdated in all frames,
+	//! tiles will be removed by the next enqueue_render()
+	void invalidate_layer(const synfig::Layer *layer);
+	//! returns true if all changes of canvas since last enqueue_render()
+	//! are tracked by invalidate_layer(), so clear_render() is not required
+	bool is_changes_tracked();
+
 	void get_render_status(StatusMap &out_map);
 
 	// just paint already rendered tiles at window
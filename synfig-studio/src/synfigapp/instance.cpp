@@ -36,6 +36,8 @@
 #include "instance.h"
 #include "canvasinterface.h"
 #include <iostream>
+#include <sstream>
+#include <glibmm/main.h>
 #include <synfig/context.h>
 #include <synfig/canvasfilenaming.h>
 #include <synfig/loadcanvas.h>
@@ -44,6 +46,7 @@
 #include <synfig/filesystem.h>
 #include <synfig/filesystemnative.h>
 #include <synfig/filesystemtemporary.h>
+#include <synfig/zstreambuf.h>
 #include <synfig/valuenodes/valuenode_add.h>
 #include <synfig/valuenodes/valuenode_composite.h>
 #include <synfig/valuenodes/valuenode_const.h>
@@ -127,10 +130,24 @@ synfigapp::find_instance(etl::handle<synfig::Canvas> canvas)
 
 /* === M E T H O D S ======================================================= */
 
+class Instance::Backup: public etl::shared_object
+{
+public:
+	FileSystem::Identifier identifier;
+	FileSystemTemporary::Handle temporary_filesystem;
+	String data;
+	bool compress;
+	bool success;
+	BackupCallback callback;
+
+	Backup(): compress(), success() { }
+};
+
 Instance::Instance(etl::handle<synfig::Canvas> canvas, synfig::FileSystem::Handle container):
 	CVSInfo(canvas->get_file_name()),
 	canvas_(canvas),
-	container_(container)
+	container_(container),
+	backup_thread_()
 {
 	assert(canvas->is_root());
 
@@ -163,6 +180,7 @@ Instance::set_file_name(const synfig::String &name)
 
 Instance::~Instance()
 {
+	wait_backup();
 	instance_map_.erase(canvas_);
 
 	if (getenv("SYNFIG_DEBUG_DESTRUCTORS"))
@@ -574,8 +592,73 @@ Instance::save_all_layers()
 		save_layer(*i);
 }
 
+void
+Instance::compress_backup(Backup &backup)
+{
+	if (!backup.compress)
+		return;
+	std::ostringstream stream;
+	{
+		zstreambuf buf(stream.rdbuf());
+		std::ostream zstream(&buf);
+		zstream.write(backup.data.c_str(), backup.data.size());
+	}
+	backup.data = stream.str();
+}
+
+bool
+Instance::write_backup(Backup &backup)
+{
+	compress_backup(backup);
+
+	FileSystem::WriteStream::Handle stream = backup.identifier.file_system->get_write_stream(backup.identifier.filename);
+	if (!stream)
+	{
+		synfig::error("Instance::write_backup(): Unable to open file for write");
+		return false;
+	}
+	stream->write(backup.data.c_str(), backup.data.size());
+	bool success = (bool)*stream;
+	stream.reset();
+	if (!success)
+	{
+		synfig::error("Instance::write_backup(): Unable to write backup");
+		return false;
+	}
+
+	return backup.temporary_filesystem->save_temporary();
+}
+
+void
+Instance::process_backup(etl::handle<Backup> backup)
+{
+	backup->success = write_backup(*backup);
+
+	// report the result from the main loop, idle callback keeps reference to backup,
+	// so the handles of file system are released by the main thread
+	Glib::signal_idle().connect_once(
+		sigc::bind(sigc::ptr_fun(&Instance::on_backup_finished), backup) );
+}
+
+void
+Instance::on_backup_finished(etl::handle<Backup> backup)
+{
+	if (backup->callback)
+		backup->callback(backup->success);
+}
+
+void
+Instance::wait_backup()
+{
+	if (backup_thread_)
+	{
+		backup_thread_->join();
+		backup_thread_ = NULL;
+	}
+}
+
 bool
-Instance::backup()
+Instance::backup(bool threaded, const BackupCallback &callback)
 {
 	if (!get_action_count())
 		return true;
@@ -586,18 +669,50 @@ Instance::backup()
 		warning("Cannot backup, canvas was not attached to temporary file system: %s", get_file_name().c_str());
 		return false;
 	}
+
+	// file may be still written by previous backup
+	wait_backup();
+
 	// don't save images while backup
 	//if (success)
 	//	save_all_layers();
-	if (!save_canvas(get_canvas()->get_identifier(), get_canvas(), false))
-		return false;
-	
-	return temporary_filesystem->save_temporary();
+	if (threaded)
+	{
+		// canvas may be changed while backup is written, so store it into memory first,
+		// file system is not used from the main thread until wait_backup()
+		etl::handle<Backup> backup(new Backup());
+		backup->identifier = get_canvas()->get_identifier();
+		backup->temporary_filesystem = temporary_filesystem;
+		backup->compress = filename_extension(backup->identifier.filename) == ".sifz";
+		backup->data = canvas_to_string(get_canvas());
+		backup->callback = callback;
+		try
+		{
+			backup_thread_ = Glib::Threads::Thread::create(
+				sigc::bind(sigc::ptr_fun(&Instance::process_backup), backup) );
+			return true;
+		}
+		catch(...)
+		{
+			backup->success = write_backup(*backup);
+			on_backup_finished(backup);
+			return backup->success;
+		}
+	}
+
+	bool success = save_canvas(get_canvas()->get_identifier(), get_canvas(), false)
+	            && temporary_filesystem->save_temporary();
+	if (callback)
+		callback(success);
+	return success;
 }
 
 bool
 Instance::save_as(const synfig::String &file_name)
 {
+	// temporary files will be copied, so backup should be completely written
+	wait_backup();
+
 	Canvas::Handle canvas = get_canvas();
 
 	FileSystem::Identifier previous_canvas_identifier = canvas->get_identifier();
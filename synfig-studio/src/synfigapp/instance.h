@@ -36,6 +36,7 @@
 #include <list>
 #include <set>
 #include <sigc++/sigc++.h>
+#include <glibmm/threads.h>
 #include "action_system.h"
 #include "selectionmanager.h"
 #include "cvs.h"
@@ -101,6 +102,20 @@ private:
 
 	std::list< synfig::Layer::Handle > layers_to_save;
 
+	//! Contents of backup file written by separate thread, see backup()
+	class Backup;
+
+	//! Thread which writes backup, see backup()
+	Glib::Threads::Thread *backup_thread_;
+
+	static void compress_backup(Backup &backup);
+	//! Compresses and writes backup file, returns true on success
+	static bool write_backup(Backup &backup);
+	static void process_backup(etl::handle<Backup> backup);
+	static void on_backup_finished(etl::handle<Backup> backup);
+	//! Waits until previous backup will be written
+	void wait_backup();
+
 	bool import_external_canvas(synfig::Canvas::Handle canvas, std::map<synfig::Canvas*, synfig::Canvas::Handle> &imported);
 	etl::handle<Action::Group> import_external_canvases();
 
@@ -173,8 +188,15 @@ public:
 
 	bool save_as(const synfig::String &filename);
 
+	//! Called with result of backup(), from the main loop
+	typedef sigc::slot<void, bool> BackupCallback;
+
 	//! Saves the instance to current temporary container
-	bool backup();
+	/*!	When \a threaded is set, canvas is stored into memory and then
+	**	compressed and written by separate thread, so caller doesn't wait for disk.
+	**	In this case returned value only means that backup is started,
+	**	the result is passed to \a callback */
+	bool backup(bool threaded = false, const BackupCallback &callback = BackupCallback());
 
 	//! generate layer name (also known in code as 'description')
 	synfig::String generate_new_description(const synfig::Layer::Handle &layer);